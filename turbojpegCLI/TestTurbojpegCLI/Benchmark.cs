@@ -23,6 +23,27 @@ namespace TestTurbojpegCLI
 				benchmarks.Add(benchBitmap); // bitmap needs to run first to establish baseline timing.
 				benchmarks.Add(benchTJSimpleAPI);
 				benchmarks.Add(benchTJOptimized);
+				benchmarks.Add(benchPrivacyMask);
+				benchmarks.Add(benchDecompressRGB);
+				benchmarks.Add(benchDecompressGray);
+				benchmarks.Add(benchDecompressLuma);
+				benchmarks.Add(benchDecompressPreview);
+				benchmarks.Add(benchMjpegReplay);
+				benchmarks.Add(benchFrameSkipper);
+				benchmarks.Add(benchIncremental);
+				benchmarks.Add(benchAbbreviated);
+				benchmarks.Add(benchDecoderSession);
+				benchmarks.Add(benchMemoryArena);
+				benchmarks.Add(benchBufferPool);
+				benchmarks.Add(benchNativeImage);
+				benchmarks.Add(benchPredictiveSizing);
+				benchmarks.Add(benchStreamOutput);
+				benchmarks.Add(benchFileInput);
+				benchmarks.Add(benchWorkerPool);
+				benchmarks.Add(benchSchedulerScaling);
+				benchmarks.Add(benchStreamScheduler);
+				benchmarks.Add(benchLoadGovernor);
+				benchmarks.Add(benchMemoryBudget);
 			}
 			catch (Exception ex)
 			{
@@ -134,5 +155,634 @@ namespace TestTurbojpegCLI
 				fs.Write(recompressed, 0, recompressedSize);
 			}
 		}
+
+		/// <summary>
+		/// Masks a privacy zone in the coefficient domain, which is the alternative to decompressing, pixelating and recompressing.
+		/// </summary>
+		private static void benchPrivacyMask()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			byte[] masked = null;
+			System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+			sw.Start();
+			using (TJPrivacyMask mask = new TJPrivacyMask())
+			{
+				mask.addRegion(100, 100, 400, 300);
+				for (int i = 0; i < numIterations; i++)
+					mask.apply(data, data.Length, ref masked);
+				sw.Stop();
+				PrintBenchmarkResult("turbojpegCLI privacy mask", sw.ElapsedMilliseconds);
+				using (FileStream fs = new FileStream("out-privacy-mask.jpg", FileMode.Create))
+				{
+					fs.Write(masked, 0, mask.getOutputSize());
+				}
+			}
+		}
+
+		/// <summary>
+		/// The decompression benchmarks below only decode, so they are compared with each other rather than with the Bitmap round trip.
+		/// </summary>
+		private static void benchDecompressRGB()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+			sw.Start();
+			using (TJDecompressor decomp = new TJDecompressor(data))
+			{
+				byte[] rawImg = new byte[decomp.getWidth() * decomp.getHeight() * TJ.getPixelSize(PixelFormat.RGB)];
+				for (int i = 0; i < numIterations; i++)
+					decomp.decompress(rawImg, PixelFormat.RGB, Flag.NONE);
+			}
+			sw.Stop();
+			PrintBenchmarkResult("decompress RGB", sw.ElapsedMilliseconds);
+		}
+
+		private static void benchDecompressGray()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+			sw.Start();
+			using (TJDecompressor decomp = new TJDecompressor(data))
+			{
+				byte[] rawImg = new byte[decomp.getWidth() * decomp.getHeight()];
+				for (int i = 0; i < numIterations; i++)
+					decomp.decompress(rawImg, PixelFormat.GRAY, Flag.NONE);
+			}
+			sw.Stop();
+			PrintBenchmarkResult("decompress GRAY", sw.ElapsedMilliseconds);
+		}
+
+		private static void benchDecompressLuma()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+			sw.Start();
+			using (TJDecompressor decomp = new TJDecompressor(data))
+			{
+				// Padding each row to a multiple of 16 lets the IDCT write every row in place.
+				int pitch = (decomp.getWidth() + 15) & ~15;
+				byte[] rawImg = new byte[pitch * decomp.getHeight()];
+				for (int i = 0; i < numIterations; i++)
+					decomp.decompressLuma(rawImg, 0, 0, pitch, Flag.NONE);
+			}
+			sw.Stop();
+			PrintBenchmarkResult("decompress luma-only", sw.ElapsedMilliseconds);
+		}
+
+		private static void benchDecompressPreview()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+			sw.Start();
+			using (TJDecompressor decomp = new TJDecompressor(data))
+			{
+				// The first scan of a progressive image is enough for a 1/8 scale thumbnail.
+				int width = decomp.getWidth() / 8, height = decomp.getHeight() / 8;
+				byte[] rawImg = new byte[decomp.getScaledWidth(width, height) * decomp.getScaledHeight(width, height) * TJ.getPixelSize(PixelFormat.RGB)];
+				for (int i = 0; i < numIterations; i++)
+					decomp.decompressPreview(rawImg, 0, 0, width, 0, height, PixelFormat.RGB, Flag.NONE, 1, 0);
+			}
+			sw.Stop();
+			PrintBenchmarkResult("decompress preview 1/8", sw.ElapsedMilliseconds);
+		}
+
+		/// <summary>
+		/// Replays the input image as a Motion-JPEG file as fast as possible, so frames are dropped whenever decoding falls behind.
+		/// </summary>
+		private static void benchMjpegReplay()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			string mjpegPath = "out-replay.mjpg";
+			using (FileStream fs = new FileStream(mjpegPath, FileMode.Create))
+			{
+				for (int i = 0; i < numIterations; i++)
+					fs.Write(data, 0, data.Length);
+			}
+			System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+			sw.Start();
+			using (TJMjpegStream stream = new TJMjpegStream())
+			{
+				stream.replayFile(mjpegPath, 0);
+				stream.flush();
+				sw.Stop();
+				PrintBenchmarkResult("MJPEG replay (" + stream.getFramesDecoded() + "/" + stream.getFramesReceived() + ")", sw.ElapsedMilliseconds);
+			}
+		}
+
+		/// <summary>
+		/// Feeds the same frame repeatedly, as a static camera scene would, so only the first frame is decoded.
+		/// </summary>
+		private static void benchFrameSkipper()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+			sw.Start();
+			using (TJFrameSkipper skipper = new TJFrameSkipper())
+			{
+				for (int i = 0; i < numIterations; i++)
+					skipper.decompress(data);
+				sw.Stop();
+				PrintBenchmarkResult("frame skipper (" + skipper.getDecodesAvoided() + " skipped)", sw.ElapsedMilliseconds);
+			}
+		}
+
+		/// <summary>
+		/// Feeds the image in 16 KB pieces, as if it were arriving over a network, outputting every progressive pass.
+		/// </summary>
+		private static void benchIncremental()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+			sw.Start();
+			using (TJIncrementalDecoder decoder = new TJIncrementalDecoder())
+			{
+				for (int i = 0; i < numIterations; i++)
+				{
+					decoder.reset();
+					for (int offset = 0; offset < data.Length; offset += 16384)
+						decoder.feed(data, offset, Math.Min(16384, data.Length - offset));
+					decoder.finish();
+				}
+				sw.Stop();
+				PrintBenchmarkResult("incremental (" + decoder.getPassesCompleted() + " passes)", sw.ElapsedMilliseconds);
+			}
+		}
+
+		/// <summary>
+		/// Streams a quarter-size frame through a compressor and a decompressor, first as complete JPEG images and then as
+		/// abbreviated images after sending the tables once, and reports the bytes per frame of each.
+		/// </summary>
+		private static void benchAbbreviated()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			byte[] frame;
+			int width, height;
+			using (TJDecompressor decomp = new TJDecompressor(data))
+			{
+				width = decomp.getScaledWidth(decomp.getWidth() / 4, decomp.getHeight() / 4);
+				height = decomp.getScaledHeight(decomp.getWidth() / 4, decomp.getHeight() / 4);
+				frame = decomp.decompress(width, 0, height, PixelFormat.RGB, Flag.NONE);
+			}
+			using (TJCompressor comp = new TJCompressor(frame, width, height))
+			using (TJDecompressor decomp = new TJDecompressor())
+			{
+				comp.setJPEGQuality(jpegQuality);
+				byte[] rawImg = new byte[frame.Length];
+				byte[] jpegBuf = new byte[TJ.bufSize(width, height, comp.getSubsamp())];
+				long totalBytes = 0;
+				System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+				sw.Start();
+				for (int i = 0; i < numIterations; i++)
+				{
+					comp.compress(ref jpegBuf, Flag.NONE);
+					totalBytes += comp.getCompressedSize();
+					decomp.setSourceImage(jpegBuf, comp.getCompressedSize());
+					decomp.decompress(rawImg, PixelFormat.RGB, Flag.NONE);
+				}
+				sw.Stop();
+				PrintBenchmarkResult("full frames (" + (totalBytes / numIterations) + " B)", sw.ElapsedMilliseconds);
+
+				byte[] tables = comp.compressTables();
+				decomp.setTables(tables);
+				totalBytes = 0;
+				sw.Reset();
+				sw.Start();
+				for (int i = 0; i < numIterations; i++)
+				{
+					comp.compressAbbreviated(ref jpegBuf, Flag.NONE);
+					totalBytes += comp.getCompressedSize();
+					decomp.setSourceImage(jpegBuf, comp.getCompressedSize());
+					decomp.decompress(rawImg, PixelFormat.RGB, Flag.NONE);
+				}
+				sw.Stop();
+				PrintBenchmarkResult("abbreviated (" + (totalBytes / numIterations) + " B + " + tables.Length + " B once)", sw.ElapsedMilliseconds);
+			}
+		}
+
+		private static void benchDecoderSession()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+			sw.Start();
+			using (TJDecompressor decomp = new TJDecompressor())
+			{
+				for (int i = 0; i < numIterations; i++)
+				{
+					decomp.setSourceImage(data, data.Length);
+					decomp.decompress(PixelFormat.BGR, Flag.NONE);
+				}
+			}
+			sw.Stop();
+			PrintBenchmarkResult("TJDecompressor per frame", sw.ElapsedMilliseconds);
+
+			sw.Reset();
+			sw.Start();
+			using (TJDecoderSession session = new TJDecoderSession())
+			{
+				for (int i = 0; i < numIterations; i++)
+					session.decompress(data);
+				sw.Stop();
+				PrintBenchmarkResult("TJDecoderSession (" + session.getHeadersReused() + " headers reused, ~" + (long)session.getSetupTimeSaved() + " ms saved)", sw.ElapsedMilliseconds);
+			}
+		}
+
+		private static void benchMemoryArena()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+			sw.Start();
+			using (TJDecompressor decomp = new TJDecompressor())
+			{
+				for (int i = 0; i < numIterations; i++)
+				{
+					decomp.setSourceImage(data, data.Length);
+					decomp.decompress(PixelFormat.BGR, Flag.NONE);
+				}
+				sw.Stop();
+				TJMemoryStats stats = decomp.getMemoryStats();
+				PrintBenchmarkResult("Decompress with arena (" + stats.heapAllocations + " heap allocations, " + stats.allocationsAvoided + " of " + stats.allocationRequests + " avoided, " + (stats.bytesReserved / 1024) + " KiB reserved)", sw.ElapsedMilliseconds);
+			}
+		}
+
+		private static void benchBufferPool()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			using (TJDecompressor decomp = new TJDecompressor(data))
+			{
+				int gen2 = GC.CollectionCount(2);
+				System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+				sw.Start();
+				for (int i = 0; i < numIterations; i++)
+					decomp.decompress(PixelFormat.BGR, Flag.NONE);
+				sw.Stop();
+				PrintBenchmarkResult("New array per frame (" + (GC.CollectionCount(2) - gen2) + " gen2 GCs)", sw.ElapsedMilliseconds);
+
+				TJBufferPool pool = new TJBufferPool();
+				decomp.setBufferPool(pool);
+				gen2 = GC.CollectionCount(2);
+				sw.Reset();
+				sw.Start();
+				for (int i = 0; i < numIterations; i++)
+				{
+					byte[] frame = decomp.decompress(PixelFormat.BGR, Flag.NONE);
+					pool.release(frame);
+				}
+				sw.Stop();
+				PrintBenchmarkResult("Pooled (" + (GC.CollectionCount(2) - gen2) + " gen2 GCs, " + pool.getHits() + " hits, " + pool.getMisses() + " misses)", sw.ElapsedMilliseconds);
+			}
+		}
+
+		private static void benchNativeImage()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			using (TJDecompressor decomp = new TJDecompressor(data))
+			using (TJCompressor comp = new TJCompressor())
+			{
+				comp.setJPEGQuality(jpegQuality);
+				int width = decomp.getWidth();
+				int height = decomp.getHeight();
+				byte[] pixels = new byte[width * height * 3];
+				byte[] jpegBuf = new byte[TJ.bufSize(width, height, comp.getSubsamp())];
+				System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+				sw.Start();
+				for (int i = 0; i < numIterations; i++)
+				{
+					decomp.decompress(pixels, PixelFormat.BGR, Flag.NONE);
+					comp.setSourceImage(pixels, width, height, PixelFormat.BGR);
+					comp.compress(ref jpegBuf, Flag.NONE);
+				}
+				sw.Stop();
+				PrintBenchmarkResult("Decompress + compress via byte[]", sw.ElapsedMilliseconds);
+
+				using (NativeImage image = new NativeImage(width, height, PixelFormat.BGR))
+				{
+					comp.setSourceImage(image);
+					sw.Reset();
+					sw.Start();
+					for (int i = 0; i < numIterations; i++)
+					{
+						decomp.decompress(image, Flag.NONE);
+						comp.compress(ref jpegBuf, Flag.NONE);
+					}
+					sw.Stop();
+					PrintBenchmarkResult("Decompress + compress via NativeImage", sw.ElapsedMilliseconds);
+				}
+			}
+		}
+
+		private static void benchPredictiveSizing()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			using (TJDecompressor decomp = new TJDecompressor(data))
+			using (TJCompressor comp = new TJCompressor())
+			{
+				byte[] pixels = decomp.decompress(PixelFormat.BGR, Flag.NONE);
+				comp.setSourceImage(pixels, decomp.getWidth(), decomp.getHeight(), PixelFormat.BGR);
+				comp.setJPEGQuality(jpegQuality);
+				System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+				sw.Start();
+				for (int i = 0; i < numIterations; i++)
+					comp.compressToExactSize(Flag.NONE);
+				sw.Stop();
+				PrintBenchmarkResult("Worst-case buffer (" + (TJ.bufSize(decomp.getWidth(), decomp.getHeight(), comp.getSubsamp()) / 1024) + " KiB)", sw.ElapsedMilliseconds);
+
+				comp.setPredictiveSizing(true);
+				sw.Reset();
+				sw.Start();
+				for (int i = 0; i < numIterations; i++)
+					comp.compressToExactSize(Flag.NONE);
+				sw.Stop();
+				PrintBenchmarkResult("Predicted buffer (" + (comp.getPredictedBufferSize() / 1024) + " KiB, " + (comp.getOverflowRate() * 100).ToString("0.0") + "% overflowed, " + (comp.getBytesSaved() / 1048576) + " MiB saved)", sw.ElapsedMilliseconds);
+			}
+		}
+
+		private static void benchStreamOutput()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			string outPath = Path.GetTempFileName();
+			try
+			{
+				using (TJDecompressor decomp = new TJDecompressor(data))
+				using (TJCompressor comp = new TJCompressor())
+				using (FileStream file = new FileStream(outPath, FileMode.Create, FileAccess.Write))
+				{
+					byte[] pixels = decomp.decompress(PixelFormat.BGR, Flag.NONE);
+					comp.setSourceImage(pixels, decomp.getWidth(), decomp.getHeight(), PixelFormat.BGR);
+					comp.setJPEGQuality(jpegQuality);
+					System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+					sw.Start();
+					for (int i = 0; i < numIterations; i++)
+					{
+						file.SetLength(0);
+						byte[] jpeg = comp.compress(Flag.NONE);
+						file.Write(jpeg, 0, comp.getCompressedSize());
+					}
+					sw.Stop();
+					PrintBenchmarkResult("Compress to array, then write to file", sw.ElapsedMilliseconds);
+
+					sw.Reset();
+					sw.Start();
+					for (int i = 0; i < numIterations; i++)
+					{
+						file.SetLength(0);
+						comp.compress(file, Flag.NONE);
+					}
+					sw.Stop();
+					PrintBenchmarkResult("Compress to file in " + (comp.getStreamChunkSize() / 1024) + " KiB chunks", sw.ElapsedMilliseconds);
+				}
+			}
+			finally
+			{
+				File.Delete(outPath);
+			}
+		}
+
+		private static void benchFileInput()
+		{
+			byte[] pixels = null;
+			System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+			sw.Start();
+			for (int i = 0; i < numIterations; i++)
+			{
+				using (TJDecompressor decomp = new TJDecompressor(File.ReadAllBytes(inputFilePath)))
+					pixels = decomp.decompress(PixelFormat.BGR, Flag.NONE);
+			}
+			sw.Stop();
+			PrintBenchmarkResult("File.ReadAllBytes, then decompress", sw.ElapsedMilliseconds);
+
+			sw.Reset();
+			sw.Start();
+			for (int i = 0; i < numIterations; i++)
+			{
+				using (TJDecompressor decomp = TJDecompressor.fromFile(inputFilePath))
+					pixels = decomp.decompress(PixelFormat.BGR, Flag.NONE);
+			}
+			sw.Stop();
+			PrintBenchmarkResult("Decompress from memory-mapped file", sw.ElapsedMilliseconds);
+
+			sw.Reset();
+			sw.Start();
+			for (int i = 0; i < numIterations; i++)
+			{
+				using (FileStream file = new FileStream(inputFilePath, FileMode.Open, FileAccess.Read, FileShare.Read, 4096, FileOptions.SequentialScan))
+				using (TJDecompressor decomp = new TJDecompressor())
+				{
+					decomp.setSourceImage(file);
+					pixels = decomp.decompress(PixelFormat.BGR, Flag.NONE);
+				}
+			}
+			sw.Stop();
+			PrintBenchmarkResult("Decompress from FileStream", sw.ElapsedMilliseconds);
+		}
+
+		private static void benchWorkerPool()
+		{
+			byte[] jpeg = File.ReadAllBytes(inputFilePath);
+			System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+			sw.Start();
+			Task<byte[]>[] runTasks = new Task<byte[]>[numIterations];
+			for (int i = 0; i < numIterations; i++)
+			{
+				runTasks[i] = Task.Run(() =>
+				{
+					using (TJDecompressor decomp = new TJDecompressor(jpeg))
+						return decomp.decompress(PixelFormat.BGR, Flag.NONE);
+				});
+			}
+			Task.WaitAll(runTasks);
+			sw.Stop();
+			PrintBenchmarkResult("Task.Run decompress", sw.ElapsedMilliseconds);
+
+			using (TJWorkerPool pool = new TJWorkerPool())
+			{
+				sw.Reset();
+				sw.Start();
+				Task<TJDecompressResult>[] poolTasks = new Task<TJDecompressResult>[numIterations];
+				for (int i = 0; i < numIterations; i++)
+					poolTasks[i] = pool.decompressAsync(jpeg, PixelFormat.BGR, Flag.NONE);
+				Task.WaitAll(poolTasks);
+				sw.Stop();
+				PrintBenchmarkResult("TJWorkerPool decompress", sw.ElapsedMilliseconds);
+				Console.WriteLine("    " + pool.getThreadCount() + " workers, peak queue depth " + pool.getPeakQueueDepth() + ", average wait " + pool.getAverageQueueTime().ToString("0.0") + " ms");
+			}
+		}
+
+		/// <summary>
+		/// Decodes a batch of mixed-size images (the input at full, 1/2, 1/4 and 1/8 size) on schedulers with 1, 2, 4 ... N workers.
+		/// </summary>
+		private static void benchSchedulerScaling()
+		{
+			byte[] data = File.ReadAllBytes(inputFilePath);
+			List<byte[]> sizes = new List<byte[]>();
+			using (TJDecompressor decomp = new TJDecompressor(data))
+			using (TJCompressor comp = new TJCompressor())
+			{
+				comp.setJPEGQuality(jpegQuality);
+				foreach (int divisor in new int[] { 1, 2, 4, 8 })
+				{
+					int width = decomp.getScaledWidth(decomp.getWidth() / divisor, decomp.getHeight() / divisor);
+					int height = decomp.getScaledHeight(decomp.getWidth() / divisor, decomp.getHeight() / divisor);
+					byte[] pixels = decomp.decompress(width, 0, height, PixelFormat.BGR, Flag.NONE);
+					comp.setSourceImage(pixels, width, height, PixelFormat.BGR);
+					sizes.Add(comp.compressToExactSize());
+				}
+			}
+			byte[][] batch = new byte[Math.Max(numIterations, 4) * 4][];
+			for (int i = 0; i < batch.Length; i++)
+				batch[i] = sizes[i % sizes.Count];
+
+			double singleWorkerMs = 0;
+			for (int workers = 1; ; workers = Math.Min(workers * 2, Environment.ProcessorCount))
+			{
+				using (TJScheduler scheduler = new TJScheduler(workers))
+				{
+					scheduler.decompressBatch(batch, PixelFormat.BGR, Flag.NONE); // warm up the workers' handles
+					System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+					sw.Start();
+					scheduler.decompressBatch(batch, PixelFormat.BGR, Flag.NONE);
+					sw.Stop();
+					if (workers == 1)
+						singleWorkerMs = sw.Elapsed.TotalMilliseconds;
+					PrintBenchmarkResult("TJScheduler " + workers + " workers (" + (singleWorkerMs / sw.Elapsed.TotalMilliseconds).ToString("0.00") + "x, " + scheduler.getJobsStolen() + " stolen, " + scheduler.getNumaNodeCount() + " NUMA nodes)", sw.ElapsedMilliseconds);
+				}
+				if (workers >= Environment.ProcessorCount)
+					break;
+			}
+		}
+
+		/// <summary>
+		/// Queues a backlog on one busy stream, then measures how long a quiet stream's frames and interactive requests take, first on a plain TJWorkerPool and then through a TJStreamScheduler.
+		/// </summary>
+		private static void benchStreamScheduler()
+		{
+			byte[] jpeg = File.ReadAllBytes(inputFilePath);
+			int backlog = Math.Max(numIterations, 4) * 8;
+			int probes = Math.Max(numIterations / 4, 4);
+			using (TJWorkerPool pool = new TJWorkerPool())
+			{
+				Task.WaitAll(pool.decompressAsync(jpeg, PixelFormat.BGR, Flag.NONE)); // warm up a worker's handles
+
+				System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+				sw.Start();
+				List<Task> busy = new List<Task>();
+				for (int i = 0; i < backlog; i++)
+					busy.Add(pool.decompressAsync(jpeg, PixelFormat.BGR, Flag.NONE));
+				List<Task> quiet = new List<Task>();
+				for (int i = 0; i < probes; i++)
+					quiet.Add(pool.decompressAsync(jpeg, PixelFormat.BGR, Flag.NONE));
+				Task.WaitAll(quiet.ToArray());
+				sw.Stop();
+				PrintBenchmarkResult("TJWorkerPool quiet stream behind a backlog of " + backlog, sw.ElapsedMilliseconds);
+				Task.WaitAll(busy.ToArray());
+
+				using (TJStreamScheduler scheduler = new TJStreamScheduler(pool))
+				{
+					TJScheduledStream busyStream = scheduler.addStream("busy", 1);
+					TJScheduledStream quietStream = scheduler.addStream("quiet", 1);
+					sw.Reset();
+					sw.Start();
+					busy.Clear();
+					for (int i = 0; i < backlog; i++)
+						busy.Add(scheduler.decompressAsync(busyStream, jpeg, PixelFormat.BGR, Flag.NONE));
+					quiet.Clear();
+					for (int i = 0; i < probes; i++)
+						quiet.Add(scheduler.decompressAsync(quietStream, jpeg, PixelFormat.BGR, Flag.NONE));
+					Task.WaitAll(quiet.ToArray());
+					sw.Stop();
+					PrintBenchmarkResult("TJStreamScheduler quiet stream behind a backlog of " + backlog, sw.ElapsedMilliseconds);
+
+					sw.Reset();
+					sw.Start();
+					Task.WaitAll(scheduler.decompressAsync(scheduler.getInteractiveLane(), jpeg, PixelFormat.BGR, Flag.NONE));
+					sw.Stop();
+					PrintBenchmarkResult("TJStreamScheduler interactive request", sw.ElapsedMilliseconds);
+					Task.WaitAll(busy.ToArray());
+					foreach (TJScheduledStream stream in new TJScheduledStream[] { busyStream, quietStream, scheduler.getInteractiveLane() })
+						Console.WriteLine("    " + stream.getName() + ": " + stream.getFramesCompleted() + " frames, average latency " + stream.getAverageLatency().ToString("0.0") + " ms, max " + stream.getMaxLatency().ToString("0.0") + " ms");
+				}
+			}
+		}
+
+		/// <summary>
+		/// Offers a TJStreamScheduler 1.5x the frames it can decode, then 0.3x, and prints each load level change the governor makes with its measured effect.
+		/// </summary>
+		private static void benchLoadGovernor()
+		{
+			byte[] jpeg = File.ReadAllBytes(inputFilePath);
+			using (TJWorkerPool pool = new TJWorkerPool())
+			using (TJStreamScheduler scheduler = new TJStreamScheduler(pool))
+			{
+				System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+				sw.Start();
+				Task.WaitAll(pool.decompressAsync(jpeg, PixelFormat.BGR, Flag.NONE));
+				sw.Stop();
+				double frameMs = Math.Max(sw.Elapsed.TotalMilliseconds, 0.1);
+
+				TJLoadGovernor governor = new TJLoadGovernor(Math.Max((int)(frameMs * 4), 10));
+				governor.setEvaluationInterval(250);
+				governor.setStepDownIntervals(2);
+				governor.LevelChanged += (sender, e) => Console.WriteLine("    " + e.ToString());
+				scheduler.setLoadGovernor(governor);
+				TJScheduledStream stream = scheduler.addStream("camera", 1);
+
+				List<Task> frames = new List<Task>();
+				foreach (double load in new double[] { 1.5, 0.3 })
+				{
+					int perTick = Math.Max((int)Math.Round(load * pool.getThreadCount() * 10 / frameMs), 1);
+					int ticks = load > 1 ? 300 : 200;
+					sw.Restart();
+					for (int tick = 0; tick < ticks; tick++)
+					{
+						for (int i = 0; i < perTick; i++)
+							frames.Add(scheduler.decompressAsync(stream, jpeg, PixelFormat.BGR, Flag.NONE));
+						while (sw.ElapsedMilliseconds < (tick + 1) * 10)
+							System.Threading.Thread.Sleep(1);
+					}
+					Task.WaitAll(frames.ToArray());
+					frames.Clear();
+					PrintBenchmarkResult("TJLoadGovernor at " + load + "x load (level " + governor.getLevel() + ", average latency " + stream.getAverageLatency().ToString("0.0") + " ms)", sw.ElapsedMilliseconds);
+					stream.resetLatency();
+				}
+			}
+		}
+
+		/// <summary>
+		/// Decodes the input on a TJWorkerPool with the shared memory budget unlimited, then limited to two images' worth, then limited to less than one image.
+		/// </summary>
+		private static void benchMemoryBudget()
+		{
+			byte[] jpeg = File.ReadAllBytes(inputFilePath);
+			long estimate;
+			using (TJDecompressor decomp = new TJDecompressor(jpeg))
+				estimate = decomp.getMemoryEstimate(0, 0, PixelFormat.BGR);
+			TJMemoryBudget budget = TJMemoryBudget.getShared();
+			long previousLimit = budget.getLimit();
+			try
+			{
+				using (TJWorkerPool pool = new TJWorkerPool())
+				{
+					foreach (long limit in new long[] { 0, estimate * 2, estimate / 2 })
+					{
+						budget.setLimit(limit);
+						budget.resetPeakReservedBytes();
+						long queued = budget.getJobsQueued();
+						long downscaled = budget.getJobsDownscaled();
+						System.Diagnostics.Stopwatch sw = new System.Diagnostics.Stopwatch();
+						sw.Start();
+						Task<TJDecompressResult>[] tasks = new Task<TJDecompressResult>[numIterations];
+						for (int i = 0; i < numIterations; i++)
+							tasks[i] = pool.decompressAsync(jpeg, PixelFormat.BGR, Flag.NONE);
+						Task.WaitAll(tasks);
+						sw.Stop();
+						PrintBenchmarkResult("TJMemoryBudget limit " + (limit == 0 ? "none" : (limit / 1024) + " KB"), sw.ElapsedMilliseconds);
+						Console.WriteLine("    estimate " + (estimate / 1024) + " KB per image, peak reserved " + (budget.getPeakReservedBytes() / 1024) + " KB, " + (budget.getJobsQueued() - queued) + " queued, " + (budget.getJobsDownscaled() - downscaled) + " downscaled to " + tasks[0].Result.getWidth() + "x" + tasks[0].Result.getHeight());
+					}
+				}
+			}
+			finally
+			{
+				budget.setLimit(previousLimit);
+			}
+		}
 	}
 }
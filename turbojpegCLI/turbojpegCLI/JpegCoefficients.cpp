@@ -0,0 +1,518 @@
+#include "JpegCoefficients.h"
+#include "TJException.h"
+
+namespace turbojpegCLI
+{
+	JCOEF* JpegBlock::getCoefficients()
+	{
+		if (coefficients == nullptr)
+			throw gcnew Exception("This JpegBlock is not associated with any coefficients");
+		// The coefficients are freed when another image is read or the instance is disposed.
+		owner->checkValid();
+		return coefficients;
+	}
+
+	short JpegBlock::default::get(int index)
+	{
+		if (index < 0 || index >= DCTSIZE2)
+			throw gcnew ArgumentException("Invalid argument in JpegBlock indexer");
+		return getCoefficients()[index];
+	}
+
+	void JpegBlock::default::set(int index, short value)
+	{
+		if (index < 0 || index >= DCTSIZE2)
+			throw gcnew ArgumentException("Invalid argument in JpegBlock indexer");
+		getCoefficients()[index] = value;
+	}
+
+	/// <summary>
+	/// Gets a coefficient by its position in zigzag order, which is the order the
+	/// coefficients are entropy coded in (and roughly ascending frequency).
+	/// </summary>
+	short JpegBlock::getZigzag(int index)
+	{
+		if (index < 0 || index >= DCTSIZE2)
+			throw gcnew ArgumentException("Invalid argument in getZigzag()");
+		return getCoefficients()[tjcliNaturalOrder[index]];
+	}
+
+	/// <summary>
+	/// Sets a coefficient by its position in zigzag order.
+	/// </summary>
+	void JpegBlock::setZigzag(int index, short value)
+	{
+		if (index < 0 || index >= DCTSIZE2)
+			throw gcnew ArgumentException("Invalid argument in setZigzag()");
+		getCoefficients()[tjcliNaturalOrder[index]] = value;
+	}
+
+	/// <summary>
+	/// Sets all 64 coefficients to 0.
+	/// </summary>
+	void JpegBlock::clear()
+	{
+		memset(getCoefficients(), 0, sizeof(JBLOCK));
+	}
+
+	/// <summary>
+	/// Copies the 64 coefficients, in natural order, into <code>dst</code>.
+	/// </summary>
+	void JpegBlock::copyTo(array<short>^ dst)
+	{
+		JCOEF* block = getCoefficients();
+		if (dst == nullptr || dst->Length < DCTSIZE2)
+			throw gcnew ArgumentException("Invalid argument in copyTo()");
+		pin_ptr<short> pinnedDst = &dst[0];
+		memcpy(pinnedDst, block, sizeof(JBLOCK));
+	}
+
+	/// <summary>
+	/// Replaces the 64 coefficients with the first 64 values of <code>src</code>, in natural order.
+	/// </summary>
+	void JpegBlock::copyFrom(array<short>^ src)
+	{
+		JCOEF* block = getCoefficients();
+		if (src == nullptr || src->Length < DCTSIZE2)
+			throw gcnew ArgumentException("Invalid argument in copyFrom()");
+		pin_ptr<short> pinnedSrc = &src[0];
+		memcpy(block, pinnedSrc, sizeof(JBLOCK));
+	}
+
+	/// <summary>
+	/// Returns the address of the block's 64 16-bit coefficients, in natural order.  The
+	/// address is only valid until the JpegCoefficients instance reads another image or
+	/// is disposed.
+	/// </summary>
+	IntPtr JpegBlock::getPointer()
+	{
+		return IntPtr(getCoefficients());
+	}
+
+	JpegComponentCoefficients::JpegComponentCoefficients(tjcli_decoder* handle, int componentIndex)
+	{
+		this->componentIndex = componentIndex;
+		int w, h;
+		if (tjcliGetBlockDimensions(handle, componentIndex, &w, &h) == -1)
+			throw gcnew TJException(&handle->jerr);
+		blocksWide = w;
+		blocksHigh = h;
+
+		jpeg_component_info* compptr = &handle->cinfo.comp_info[componentIndex];
+		componentId = compptr->component_id;
+		hSampFactor = compptr->h_samp_factor;
+		vSampFactor = compptr->v_samp_factor;
+		quantTableIndex = compptr->quant_tbl_no;
+		if (compptr->quant_table != NULL)
+		{
+			quantTable = gcnew array<UInt16>(DCTSIZE2);
+			for (int i = 0; i < DCTSIZE2; i++)
+				quantTable[i] = compptr->quant_table->quantval[i];
+		}
+
+		rows = new JBLOCKROW[blocksHigh];
+		if (tjcliGetBlockRows(handle, componentIndex, rows) == -1)
+		{
+			delete[] rows;
+			rows = 0;
+			throw gcnew TJException(&handle->jerr);
+		}
+	}
+
+	void JpegComponentCoefficients::release()
+	{
+		delete[] rows;
+		rows = 0;
+	}
+
+	void JpegComponentCoefficients::checkValid()
+	{
+		if (rows == 0)
+			throw gcnew Exception("These coefficients are no longer valid because another image was read or the JpegCoefficients instance was disposed");
+	}
+
+	/// <summary>
+	/// Returns the position of this component in the image (0 for Y in a YCbCr image).
+	/// </summary>
+	int JpegComponentCoefficients::getComponentIndex()
+	{
+		return componentIndex;
+	}
+
+	/// <summary>
+	/// Returns the component identifier stored in the JPEG frame header.
+	/// </summary>
+	int JpegComponentCoefficients::getComponentId()
+	{
+		return componentId;
+	}
+
+	/// <summary>
+	/// Returns the width of this component in 8x8 blocks.
+	/// </summary>
+	int JpegComponentCoefficients::getBlocksWide()
+	{
+		return blocksWide;
+	}
+
+	/// <summary>
+	/// Returns the height of this component in 8x8 blocks.
+	/// </summary>
+	int JpegComponentCoefficients::getBlocksHigh()
+	{
+		return blocksHigh;
+	}
+
+	/// <summary>
+	/// Returns the horizontal sampling factor of this component.  A component whose
+	/// sampling factor is half of JpegCoefficients.getMaxHSampFactor() is subsampled 2:1 horizontally.
+	/// </summary>
+	int JpegComponentCoefficients::getHSampFactor()
+	{
+		return hSampFactor;
+	}
+
+	/// <summary>
+	/// Returns the vertical sampling factor of this component.
+	/// </summary>
+	int JpegComponentCoefficients::getVSampFactor()
+	{
+		return vSampFactor;
+	}
+
+	/// <summary>
+	/// Returns which of the image's quantization tables (0-3) this component uses.
+	/// </summary>
+	int JpegComponentCoefficients::getQuantTableIndex()
+	{
+		return quantTableIndex;
+	}
+
+	/// <summary>
+	/// Returns a copy of this component's quantization table, in natural (row-major) order.
+	/// A coefficient multiplied by the corresponding entry gives the dequantized value.
+	/// Returns null if the image did not define the table.
+	/// </summary>
+	array<UInt16>^ JpegComponentCoefficients::getQuantTable()
+	{
+		if (quantTable == nullptr)
+			return nullptr;
+		return (array<UInt16>^)quantTable->Clone();
+	}
+
+	/// <summary>
+	/// Returns a view of one block.  Changes made through the view are included when
+	/// the image is saved.
+	/// </summary>
+	///
+	/// <param name="blockX">the column of the block, from 0 to getBlocksWide() - 1</param>
+	///
+	/// <param name="blockY">the row of the block, from 0 to getBlocksHigh() - 1</param>
+	JpegBlock JpegComponentCoefficients::getBlock(int blockX, int blockY)
+	{
+		checkValid();
+		if (blockX < 0 || blockX >= blocksWide || blockY < 0 || blockY >= blocksHigh)
+			throw gcnew ArgumentException("Invalid argument in getBlock()");
+		return JpegBlock(this, rows[blockY][blockX]);
+	}
+
+	/// <summary>
+	/// Returns the address of a row of blocks, for callers which process coefficients
+	/// with unsafe code.  The row holds getBlocksWide() consecutive blocks of 64 16-bit
+	/// coefficients each, in natural order.
+	/// </summary>
+	///
+	/// <param name="blockY">the row, from 0 to getBlocksHigh() - 1</param>
+	IntPtr JpegComponentCoefficients::getBlockRow(int blockY)
+	{
+		checkValid();
+		if (blockY < 0 || blockY >= blocksHigh)
+			throw gcnew ArgumentException("Invalid argument in getBlockRow()");
+		return IntPtr(rows[blockY]);
+	}
+
+	/// <summary>
+	/// Returns false if the JpegCoefficients instance has read another image or been
+	/// disposed since this object was obtained, in which case its blocks must not be used.
+	/// </summary>
+	bool JpegComponentCoefficients::isValid()
+	{
+		return rows != 0;
+	}
+
+	/// <summary>
+	/// Constructs a JpegCoefficients instance.
+	/// When using the parameterless constructor, you must call setSourceImage().
+	/// </summary>
+	JpegCoefficients::JpegCoefficients()
+	{
+		Initialize();
+		handle = tjcliInitDecoder();
+		if (handle == nullptr)
+			throw gcnew TJException("Unable to create a libjpeg decompressor");
+	}
+	/// <summary>
+	/// Constructs a JpegCoefficients instance and reads the coefficients of a jpeg image.
+	/// </summary>
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	JpegCoefficients::JpegCoefficients(array<Byte>^ jpegImage)
+	{
+		Initialize();
+		handle = tjcliInitDecoder();
+		if (handle == nullptr)
+			throw gcnew TJException("Unable to create a libjpeg decompressor");
+		if (jpegImage == nullptr)
+			throw gcnew ArgumentException("Invalid argument in JpegCoefficients()");
+		setSourceImage(jpegImage, jpegImage->Length);
+	}
+	/// <summary>
+	/// Constructs a JpegCoefficients instance and reads the coefficients of a jpeg image.
+	/// </summary>
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	/// <param name="imageSize">The length of the image data in the array.</param>
+	JpegCoefficients::JpegCoefficients(array<Byte>^ jpegImage, int imageSize)
+	{
+		Initialize();
+		handle = tjcliInitDecoder();
+		if (handle == nullptr)
+			throw gcnew TJException("Unable to create a libjpeg decompressor");
+		setSourceImage(jpegImage, imageSize);
+	}
+
+	/// <summary>
+	/// Call this when finished with the JpegCoefficients to free any native structures.
+	/// If you use a C# using() block, you won't need to call this.
+	/// </summary>
+	JpegCoefficients::~JpegCoefficients()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+
+		this->!JpegCoefficients();
+		isDisposed = true;
+	}
+	JpegCoefficients::!JpegCoefficients()
+	{
+		// This is the Finalizer, for disposing of unmanaged data.
+		releaseComponents();
+		tjcliDestroyDecoder(handle);
+		handle = 0;
+		tjcliDestroyEncoder(encoder);
+		encoder = 0;
+	}
+
+	void JpegCoefficients::releaseComponents()
+	{
+		if (components == nullptr)
+			return;
+		for (int i = 0; i < components->Length; i++)
+			components[i]->release();
+		components = nullptr;
+	}
+
+	/// <summary>
+	/// Sets whether APPn and COM markers (EXIF, ICC profiles, comments, etc.) are
+	/// kept when reading an image, so that save() can copy them to the new image.
+	/// Takes effect at the next setSourceImage().  Default value if unset: true
+	/// </summary>
+	void JpegCoefficients::setSaveMarkers(bool save)
+	{
+		saveMarkers = save;
+	}
+
+	/// <summary>
+	/// Gets whether APPn and COM markers are kept when reading an image.  Default value if unset: true
+	/// </summary>
+	bool JpegCoefficients::getSaveMarkers()
+	{
+		return saveMarkers;
+	}
+
+	/// <summary>
+	/// Reads the quantized DCT coefficients of the JPEG image of length
+	/// <code>imageSize</code> bytes stored in <code>jpegImage</code>.  The image is
+	/// entropy decoded only.  Any JpegComponentCoefficients and JpegBlock objects
+	/// obtained for the previous image become invalid.
+	/// </summary>
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	/// <param name="imageSize">The length of the image data in the array.</param>
+	void JpegCoefficients::setSourceImage(array<Byte>^ jpegImage, int imageSize)
+	{
+		if (jpegImage == nullptr || imageSize < 1)
+			throw gcnew ArgumentException("Invalid argument in setSourceImage()");
+		if (jpegImage->Length < imageSize)
+			throw gcnew Exception("Source buffer is not large enough");
+
+		releaseComponents();
+		width = height = 0;
+		if (tjcliSetSaveMarkers(handle, saveMarkers ? 1 : 0) == -1)
+			throw gcnew TJException(&handle->jerr);
+		{
+			pin_ptr<Byte> pinnedJpegImage = &jpegImage[0];
+			if (tjcliReadCoefficients(handle, pinnedJpegImage, (unsigned long)imageSize) == -1)
+				throw gcnew TJException(&handle->jerr);
+		}
+
+		j_decompress_ptr cinfo = &handle->cinfo;
+		switch (cinfo->jpeg_color_space)
+		{
+			case JCS_RGB: colorspace = Colorspace::RGB; break;
+			case JCS_YCbCr: colorspace = Colorspace::YCbCr; break;
+			case JCS_GRAYSCALE: colorspace = Colorspace::GRAY; break;
+			case JCS_CMYK: colorspace = Colorspace::CMYK; break;
+			case JCS_YCCK: colorspace = Colorspace::YCCK; break;
+			default: colorspace = (Colorspace)-1; break;
+		}
+		progressive = cinfo->progressive_mode != 0;
+		array<JpegComponentCoefficients^>^ newComponents = gcnew array<JpegComponentCoefficients^>(cinfo->num_components);
+		try
+		{
+			for (int i = 0; i < newComponents->Length; i++)
+				newComponents[i] = gcnew JpegComponentCoefficients(handle, i);
+		}
+		catch (Exception^)
+		{
+			for (int i = 0; i < newComponents->Length; i++)
+				if (newComponents[i] != nullptr)
+					newComponents[i]->release();
+			throw;
+		}
+		components = newComponents;
+		width = (int)cinfo->image_width;
+		height = (int)cinfo->image_height;
+	}
+
+	/// <summary>
+	/// Returns the width of the source image associated with this instance.
+	/// </summary>
+	int JpegCoefficients::getWidth()
+	{
+		if (components == nullptr)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		return width;
+	}
+
+	/// <summary>
+	/// Returns the height of the source image associated with this instance.
+	/// </summary>
+	int JpegCoefficients::getHeight()
+	{
+		if (components == nullptr)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		return height;
+	}
+
+	/// <summary>
+	/// Returns the colorspace used in the source image associated with this instance.
+	/// </summary>
+	Colorspace JpegCoefficients::getColorspace()
+	{
+		if (components == nullptr)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		return colorspace;
+	}
+
+	/// <summary>
+	/// Returns true if the source image associated with this instance is progressive.
+	/// save() writes progressive images for progressive sources.
+	/// </summary>
+	bool JpegCoefficients::isProgressive()
+	{
+		if (components == nullptr)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		return progressive;
+	}
+
+	/// <summary>
+	/// Returns the number of components (color channels) in the source image associated with this instance.
+	/// </summary>
+	int JpegCoefficients::getNumComponents()
+	{
+		if (components == nullptr)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		return components->Length;
+	}
+
+	/// <summary>
+	/// Returns the largest horizontal sampling factor of any component.  Together with
+	/// each component's own sampling factor this describes the chroma subsampling.
+	/// </summary>
+	int JpegCoefficients::getMaxHSampFactor()
+	{
+		if (components == nullptr)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		return handle->cinfo.max_h_samp_factor;
+	}
+
+	/// <summary>
+	/// Returns the largest vertical sampling factor of any component.
+	/// </summary>
+	int JpegCoefficients::getMaxVSampFactor()
+	{
+		if (components == nullptr)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		return handle->cinfo.max_v_samp_factor;
+	}
+
+	/// <summary>
+	/// Returns the coefficients of one component of the source image associated with this instance.
+	/// </summary>
+	///
+	/// <param name="componentIndex">the component, from 0 to getNumComponents() - 1</param>
+	JpegComponentCoefficients^ JpegCoefficients::getComponent(int componentIndex)
+	{
+		if (components == nullptr)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		if (componentIndex < 0 || componentIndex >= components->Length)
+			throw gcnew ArgumentException("Invalid argument in getComponent()");
+		return components[componentIndex];
+	}
+
+	/// <summary>
+	/// Entropy codes the coefficients, including any changes made to them, into a new
+	/// JPEG image.  The quantization tables, sampling factors, restart interval and
+	/// progressive mode of the source image are kept, and the coefficients are not
+	/// requantized, so unmodified blocks are reproduced exactly.  Saved markers are
+	/// copied to the new image (see setSaveMarkers()).
+	/// </summary>
+	///
+	/// <param name="optimizeCoding">true to compute optimal Huffman tables for the image
+	/// (smaller output, slower), false to use the standard tables.  Progressive images
+	/// are always optimized.</param>
+	///
+	/// <returns>the new JPEG image</returns>
+	array<Byte>^ JpegCoefficients::save(bool optimizeCoding)
+	{
+		if (components == nullptr)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		if (encoder == nullptr)
+		{
+			encoder = tjcliInitEncoder();
+			if (encoder == nullptr)
+				throw gcnew TJException("Unable to create a libjpeg compressor");
+		}
+		unsigned char* jpegBuf;
+		unsigned long jpegSize;
+		if (tjcliWriteCoefficients(handle, encoder, optimizeCoding ? 1 : 0, saveMarkers ? 1 : 0, &jpegBuf, &jpegSize) == -1)
+			throw gcnew TJException(&encoder->jerr);
+		array<Byte>^ output = gcnew array<Byte>((int)jpegSize);
+		if (jpegSize > 0)
+		{
+			pin_ptr<Byte> pinnedOutput = &output[0];
+			memcpy(pinnedOutput, jpegBuf, jpegSize);
+		}
+		return output;
+	}
+
+	/// <summary>
+	/// Entropy codes the coefficients, including any changes made to them, into a new
+	/// JPEG image with optimized Huffman tables.  See save(bool).
+	/// </summary>
+	///
+	/// <returns>the new JPEG image</returns>
+	array<Byte>^ JpegCoefficients::save()
+	{
+		return save(true);
+	}
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include "TJ.h"
+#include "jpegnative.h"
+using namespace System;
+using namespace System::Collections::Generic;
+namespace turbojpegCLI
+{
+	ref class JpegCoefficients;
+	ref class JpegComponentCoefficients;
+
+	/// <summary>
+	/// <para>A zero-copy view of the 64 quantized DCT coefficients of one 8x8 block, as
+	/// stored in a JpegCoefficients instance.  Reading or writing through the view
+	/// reads or writes the coefficients in place.</para>
+	/// <para>A JpegBlock is only valid until its JpegCoefficients instance reads another
+	/// image or is disposed.  After that every access throws, except that a pointer
+	/// obtained earlier from getPointer() is left dangling.</para>
+	/// </summary>
+	public value struct JpegBlock
+	{
+	private:
+		JpegComponentCoefficients^ owner;
+		JCOEF* coefficients;
+
+		JCOEF* getCoefficients();
+	internal:
+		JpegBlock(JpegComponentCoefficients^ owner, JCOEF* coefficients) : owner(owner), coefficients(coefficients) {}
+	public:
+
+		/// <summary>
+		/// Gets or sets a coefficient by its position in natural (row-major) order, so
+		/// index 0 is the DC coefficient, index 1 is the first horizontal frequency and
+		/// index 8 is the first vertical frequency.
+		/// </summary>
+		property short default[int]
+		{
+			short get(int index);
+			void set(int index, short value);
+		}
+
+		short getZigzag(int index);
+		void setZigzag(int index, short value);
+		void clear();
+		void copyTo(array<short>^ dst);
+		void copyFrom(array<short>^ src);
+		IntPtr getPointer();
+	};
+
+	/// <summary>
+	/// The quantized DCT coefficients of one component (color channel) of a JPEG image,
+	/// arranged as a grid of 8x8 blocks.  Obtain instances from JpegCoefficients.getComponent().
+	/// </summary>
+	public ref class JpegComponentCoefficients
+	{
+	private:
+		JBLOCKROW* rows;
+		int componentIndex;
+		int componentId;
+		int blocksWide;
+		int blocksHigh;
+		int hSampFactor;
+		int vSampFactor;
+		int quantTableIndex;
+		array<UInt16>^ quantTable;
+	internal:
+		JpegComponentCoefficients(tjcli_decoder* handle, int componentIndex);
+		void release();
+		void checkValid();
+	public:
+
+		int getComponentIndex();
+		int getComponentId();
+		int getBlocksWide();
+		int getBlocksHigh();
+		int getHSampFactor();
+		int getVSampFactor();
+		int getQuantTableIndex();
+		array<UInt16>^ getQuantTable();
+
+		JpegBlock getBlock(int blockX, int blockY);
+		IntPtr getBlockRow(int blockY);
+		bool isValid();
+	};
+
+	/// <summary>
+	/// <para>Read/write access to the quantized DCT coefficients of a JPEG image, without
+	/// decoding it to pixels.  This is useful for compressed-domain processing, such as
+	/// analyzing blocks, masking regions or watermarking, followed by save(), which
+	/// entropy codes the (possibly modified) coefficients into a new JPEG image with no
+	/// generational loss.</para>
+	/// <para>Native callers can perform the same operations with the tjcli* functions
+	/// declared in jpegnative.h.</para>
+	/// <para>Instances are not thread safe; use one per thread.</para>
+	/// </summary>
+	public ref class JpegCoefficients
+	{
+	private:
+		String^ NO_ASSOC_ERROR;
+		tjcli_decoder* handle;
+		tjcli_encoder* encoder;
+		array<JpegComponentCoefficients^>^ components;
+		int width;
+		int height;
+		Colorspace colorspace;
+		bool progressive;
+		bool saveMarkers;
+		bool isDisposed;
+		!JpegCoefficients();
+
+		void Initialize()
+		{
+			NO_ASSOC_ERROR = "No JPEG image is associated with this instance";
+			handle = 0;
+			encoder = 0;
+			width = 0;
+			height = 0;
+			colorspace = (Colorspace)-1;
+			progressive = false;
+			saveMarkers = true;
+			isDisposed = false;
+		}
+
+		void releaseComponents();
+	public:
+
+		JpegCoefficients();
+		JpegCoefficients(array<Byte>^ jpegImage);
+		JpegCoefficients(array<Byte>^ jpegImage, int imageSize);
+		~JpegCoefficients();
+
+		void setSaveMarkers(bool save);
+		bool getSaveMarkers();
+		void setSourceImage(array<Byte>^ jpegImage, int imageSize);
+
+		int getWidth();
+		int getHeight();
+		Colorspace getColorspace();
+		bool isProgressive();
+		int getNumComponents();
+		int getMaxHSampFactor();
+		int getMaxVSampFactor();
+		JpegComponentCoefficients^ getComponent(int componentIndex);
+
+		array<Byte>^ save(bool optimizeCoding);
+		array<Byte>^ save();
+	};
+}
@@ -0,0 +1,271 @@
+#include "NativeImage.h"
+#include <malloc.h>
+#include <string.h>
+using namespace System::Threading;
+
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>Allocates an image.  Each row is padded to a multiple of 32 bytes; use getPitch()
+	/// to find out how long the rows are.  The contents are not initialized.</para>
+	/// </summary>
+	///
+	/// <param name="width">width of the image, in pixels</param>
+	///
+	/// <param name="height">height of the image, in pixels</param>
+	///
+	/// <param name="pixelFormat">pixel format of the image (one of the PixelFormat enum values)</param>
+	NativeImage::NativeImage(int width, int height, PixelFormat pixelFormat)
+	{
+		if (width < 1 || height < 1)
+			throw gcnew ArgumentException("Invalid argument in NativeImage()");
+		int rowSize = width * TJ::getPixelSize(pixelFormat);
+		Initialize(width, (rowSize + 31) & ~31, height, pixelFormat);
+	}
+
+	/// <summary>
+	/// <para>Allocates an image with the given pitch.  The contents are not initialized.</para>
+	/// </summary>
+	///
+	/// <param name="width">width of the image, in pixels</param>
+	///
+	/// <param name="pitch">bytes per row of the image, at least
+	/// <code>width * TJ.getPixelSize(pixelFormat)</code>.  Setting this to 0 is the same as
+	/// setting it to <code>width * TJ.getPixelSize(pixelFormat)</code>.</param>
+	///
+	/// <param name="height">height of the image, in pixels</param>
+	///
+	/// <param name="pixelFormat">pixel format of the image (one of the PixelFormat enum values)</param>
+	NativeImage::NativeImage(int width, int pitch, int height, PixelFormat pixelFormat)
+	{
+		if (width < 1 || height < 1 || pitch < 0)
+			throw gcnew ArgumentException("Invalid argument in NativeImage()");
+		int rowSize = width * TJ::getPixelSize(pixelFormat);
+		if (pitch == 0)
+			pitch = rowSize;
+		if (pitch < rowSize)
+			throw gcnew ArgumentException("Invalid argument in NativeImage()");
+		Initialize(width, pitch, height, pixelFormat);
+	}
+
+	void NativeImage::Initialize(int width, int pitch, int height, PixelFormat pixelFormat)
+	{
+		if ((long long)pitch * height > Int32::MaxValue)
+			throw gcnew ArgumentException("Image is too large");
+		memory = gcnew Memory((long long)pitch * height);
+		origin = memory->buffer;
+		this->width = width;
+		this->height = height;
+		this->pitch = pitch;
+		this->pixelFormat = pixelFormat;
+		view = false;
+		isDisposed = false;
+	}
+
+	NativeImage::NativeImage(Memory^ memory, unsigned char* origin, int width, int pitch, int height, PixelFormat pixelFormat)
+	{
+		memory->addReference();
+		this->memory = memory;
+		this->origin = origin;
+		this->width = width;
+		this->height = height;
+		this->pitch = pitch;
+		this->pixelFormat = pixelFormat;
+		view = true;
+		isDisposed = false;
+	}
+
+	/// <summary>
+	/// <para>Call this when finished with the image or view.  The memory is freed once the
+	/// image and all of its views have been disposed.</para>
+	/// <para>If you use a C# using() block, you won't need to call this.</para>
+	/// </summary>
+	NativeImage::~NativeImage()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+		isDisposed = true;
+		memory->release();
+	}
+
+	NativeImage::Memory::Memory(long long size)
+	{
+		buffer = (unsigned char*)_aligned_malloc((size_t)size, 64);
+		if (buffer == nullptr)
+			throw gcnew OutOfMemoryException();
+		this->size = size;
+		// The image itself holds one reference, and each view another.
+		references = 1;
+		GC::AddMemoryPressure(size);
+	}
+	NativeImage::Memory::~Memory()
+	{
+		this->!Memory();
+	}
+	NativeImage::Memory::!Memory()
+	{
+		// This is the Finalizer, which frees the memory if an image or view was never disposed.
+		if (buffer != nullptr)
+		{
+			_aligned_free(buffer);
+			GC::RemoveMemoryPressure(size);
+			buffer = nullptr;
+		}
+	}
+	void NativeImage::Memory::addReference()
+	{
+		Interlocked::Increment(references);
+	}
+	void NativeImage::Memory::release()
+	{
+		if (Interlocked::Decrement(references) == 0)
+			delete this;
+	}
+
+	unsigned char* NativeImage::getPointer()
+	{
+		if (isDisposed)
+			throw gcnew ObjectDisposedException("NativeImage");
+		return origin;
+	}
+
+	/// <summary>
+	/// Returns the width of the image, in pixels.
+	/// </summary>
+	int NativeImage::getWidth()
+	{
+		return width;
+	}
+
+	/// <summary>
+	/// Returns the height of the image, in pixels.
+	/// </summary>
+	int NativeImage::getHeight()
+	{
+		return height;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes from the start of one row to the start of the next.
+	/// A view has the pitch of the image it was taken from.
+	/// </summary>
+	int NativeImage::getPitch()
+	{
+		return pitch;
+	}
+
+	/// <summary>
+	/// Returns the pixel format of the image.
+	/// </summary>
+	PixelFormat NativeImage::getPixelFormat()
+	{
+		return pixelFormat;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes from the first pixel of the image to the end of the last
+	/// one: <code>(height - 1) * pitch + width * TJ.getPixelSize(pixelFormat)</code>.
+	/// </summary>
+	int NativeImage::getSize()
+	{
+		return (height - 1) * pitch + width * TJ::getPixelSize(pixelFormat);
+	}
+
+	/// <summary>
+	/// Returns the address of the first pixel, for passing to other native code.  The address
+	/// is valid until the image (and, for a view, the image it was taken from) is disposed.
+	/// </summary>
+	IntPtr NativeImage::getData()
+	{
+		return IntPtr(getPointer());
+	}
+
+	/// <summary>
+	/// Returns true if this is a view returned by getSubImage().
+	/// </summary>
+	bool NativeImage::isView()
+	{
+		return view;
+	}
+
+	/// <summary>
+	/// <para>Returns a view of a rectangle of this image.  Nothing is copied; the view shares
+	/// this image's memory and pitch, so writes through either are seen by both.  A view of a
+	/// view is a view of the same image.</para>
+	/// <para>Dispose the view when finished with it.</para>
+	/// </summary>
+	///
+	/// <param name="x">x offset (in pixels) of the rectangle</param>
+	///
+	/// <param name="y">y offset (in pixels) of the rectangle</param>
+	///
+	/// <param name="width">width (in pixels) of the rectangle</param>
+	///
+	/// <param name="height">height (in pixels) of the rectangle</param>
+	NativeImage^ NativeImage::getSubImage(int x, int y, int width, int height)
+	{
+		unsigned char* pixels = getPointer();
+		if (x < 0 || y < 0 || width < 1 || height < 1 || x + width > this->width || y + height > this->height)
+			throw gcnew ArgumentException("Invalid argument in getSubImage()");
+		unsigned char* viewOrigin = pixels + (size_t)y * pitch + (size_t)x * TJ::getPixelSize(pixelFormat);
+		return gcnew NativeImage(memory, viewOrigin, width, pitch, height, pixelFormat);
+	}
+
+	/// <summary>
+	/// Copies pixels from a managed buffer into this image.
+	/// </summary>
+	///
+	/// <param name="src">buffer holding at least <code>height</code> rows of pixels in this
+	/// image's pixel format</param>
+	///
+	/// <param name="srcPitch">bytes per row of <code>src</code>, or 0 if its rows are unpadded</param>
+	void NativeImage::copyFrom(array<Byte>^ src, int srcPitch)
+	{
+		unsigned char* pixels = getPointer();
+		int rowSize = width * TJ::getPixelSize(pixelFormat);
+		if (srcPitch == 0)
+			srcPitch = rowSize;
+		if (src == nullptr || srcPitch < rowSize)
+			throw gcnew ArgumentException("Invalid argument in copyFrom()");
+		if (src->Length < (long long)(height - 1) * srcPitch + rowSize)
+			throw gcnew Exception("Source buffer is not large enough");
+		pin_ptr<Byte> pinnedSrc = &src[0];
+		unsigned char* srcRows = pinnedSrc;
+		for (int row = 0; row < height; row++)
+			memcpy(pixels + (size_t)row * pitch, srcRows + (long long)row * srcPitch, rowSize);
+	}
+
+	/// <summary>
+	/// Copies the pixels of this image into a managed buffer.
+	/// </summary>
+	///
+	/// <param name="dst">buffer to receive <code>height</code> rows of pixels</param>
+	///
+	/// <param name="dstPitch">bytes per row of <code>dst</code>, or 0 for unpadded rows</param>
+	void NativeImage::copyTo(array<Byte>^ dst, int dstPitch)
+	{
+		unsigned char* pixels = getPointer();
+		int rowSize = width * TJ::getPixelSize(pixelFormat);
+		if (dstPitch == 0)
+			dstPitch = rowSize;
+		if (dst == nullptr || dstPitch < rowSize)
+			throw gcnew ArgumentException("Invalid argument in copyTo()");
+		if (dst->Length < (long long)(height - 1) * dstPitch + rowSize)
+			throw gcnew Exception("Destination buffer is not large enough");
+		pin_ptr<Byte> pinnedDst = &dst[0];
+		unsigned char* dstRows = pinnedDst;
+		for (int row = 0; row < height; row++)
+			memcpy(dstRows + (long long)row * dstPitch, pixels + (size_t)row * pitch, rowSize);
+	}
+
+	/// <summary>
+	/// Returns a copy of the pixels of this image in a new managed buffer with unpadded rows.
+	/// </summary>
+	array<Byte>^ NativeImage::toArray()
+	{
+		array<Byte>^ dst = gcnew array<Byte>(width * TJ::getPixelSize(pixelFormat) * height);
+		copyTo(dst, 0);
+		return dst;
+	}
+}
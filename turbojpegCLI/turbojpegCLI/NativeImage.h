@@ -0,0 +1,70 @@
+#pragma once
+#include "TJ.h"
+using namespace System;
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>An uncompressed image held in unmanaged memory, with its width, height, pitch
+	/// and pixel format.  TJCompressor and TJDecompressor read and write it directly, so
+	/// frames can pass through a pipeline without being pinned or copied and without
+	/// giving the garbage collector anything to do.</para>
+	/// <para>The memory is aligned to 64 bytes and, unless a pitch is given, each row is
+	/// padded to a multiple of 32 bytes so that every row starts aligned too.</para>
+	/// <para>getSubImage() returns a view of a rectangle of the image which shares its
+	/// memory.  The memory is freed when the image and all of its views have been disposed,
+	/// and no sooner, so a view stays valid even if the image is disposed first.</para>
+	/// </summary>
+	public ref class NativeImage
+	{
+	private:
+		/// <summary>
+		/// The unmanaged memory shared by an image and its views.  It is freed when the last
+		/// of them is disposed, or by the finalizer once none of them are reachable.
+		/// </summary>
+		ref class Memory
+		{
+		private:
+			int references;
+		public:
+			unsigned char* buffer;
+			long long size;
+			Memory(long long size);
+			~Memory();
+			!Memory();
+			void addReference();
+			void release();
+		};
+
+		Memory^ memory;
+		unsigned char* origin;
+		int width;
+		int height;
+		int pitch;
+		PixelFormat pixelFormat;
+		bool view;
+		bool isDisposed;
+
+		void Initialize(int width, int pitch, int height, PixelFormat pixelFormat);
+		NativeImage(Memory^ memory, unsigned char* origin, int width, int pitch, int height, PixelFormat pixelFormat);
+	internal:
+		unsigned char* getPointer();
+	public:
+
+		NativeImage(int width, int height, PixelFormat pixelFormat);
+		NativeImage(int width, int pitch, int height, PixelFormat pixelFormat);
+		~NativeImage();
+
+		int getWidth();
+		int getHeight();
+		int getPitch();
+		PixelFormat getPixelFormat();
+		int getSize();
+		IntPtr getData();
+		bool isView();
+
+		NativeImage^ getSubImage(int x, int y, int width, int height);
+		void copyFrom(array<Byte>^ src, int srcPitch);
+		void copyTo(array<Byte>^ dst, int dstPitch);
+		array<Byte>^ toArray();
+	};
+}
@@ -399,10 +399,12 @@ namespace turbojpegCLI
 		/// image with the given width, height, and level of chrominance subsampling.</returns>
 		static int bufSize(int width, int height, SubsamplingOption jpegSubsamp)
 		{
-			unsigned long retval = tjBufSize(width, height, (int)jpegSubsamp);
-			if (retval == -1)
-				throw gcnew TJException(getSystemString(tjGetErrorStr()));
-			return retval;
+			// tjBufSize() can only fail on arguments checked here, so its error never has
+			// to be read back from the process-wide tjGetErrorStr().
+			if (width < 1 || height < 1)
+				throw gcnew ArgumentException("Invalid argument in bufSize()");
+			checkSubsampling(jpegSubsamp);
+			return (int)tjBufSize(width, height, (int)jpegSubsamp);
 		}
 
 		/// <summary>
@@ -418,7 +420,7 @@ namespace turbojpegCLI
 			tjscalingfactor *sf;
 			sf = tjGetScalingFactors(&n);
 			if (sf == nullptr || n == 0)
-				throw gcnew TJException(getSystemString(tjGetErrorStr()));
+				throw gcnew TJException("Could not get the scaling factors");
 
 			array<TJScalingFactor^>^ sfManaged = gcnew array<TJScalingFactor^>(n);
 
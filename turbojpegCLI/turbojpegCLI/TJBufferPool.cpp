@@ -0,0 +1,298 @@
+#include "TJBufferPool.h"
+using namespace System::Threading;
+
+namespace turbojpegCLI
+{
+	TJPooledBuffer::TJPooledBuffer(TJBufferPool^ pool, array<Byte>^ buffer)
+	{
+		this->pool = pool;
+		this->buffer = buffer;
+	}
+
+	/// <summary>
+	/// Gives the buffer back to the pool.  Don't use the buffer after this.
+	/// If you use a C# using() block, you won't need to call this.
+	/// </summary>
+	TJPooledBuffer::~TJPooledBuffer()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (buffer == nullptr)
+			return;
+		pool->release(buffer);
+		buffer = nullptr;
+	}
+
+	/// <summary>
+	/// Returns the rented buffer.
+	/// </summary>
+	array<Byte>^ TJPooledBuffer::getBuffer()
+	{
+		if (buffer == nullptr)
+			throw gcnew ObjectDisposedException("TJPooledBuffer");
+		return buffer;
+	}
+
+	/// <summary>
+	/// Returns the length of the rented buffer.
+	/// </summary>
+	int TJPooledBuffer::getLength()
+	{
+		return getBuffer()->Length;
+	}
+
+	/// <summary>
+	/// Constructs a TJBufferPool which keeps up to 256 MB, and up to 8 buffers of each length.
+	/// </summary>
+	TJBufferPool::TJBufferPool()
+	{
+		Initialize(256LL * 1024 * 1024, 8);
+	}
+
+	/// <summary>
+	/// Constructs a TJBufferPool.
+	/// </summary>
+	/// <param name="maxRetainedBytes">The most bytes the pool keeps.  Buffers given back
+	/// beyond this are left to the garbage collector.</param>
+	/// <param name="maxBuffersPerSize">The most buffers of any one length the pool keeps.</param>
+	TJBufferPool::TJBufferPool(long long maxRetainedBytes, int maxBuffersPerSize)
+	{
+		if (maxRetainedBytes < 0 || maxBuffersPerSize < 0)
+			throw gcnew ArgumentException("Invalid argument in TJBufferPool()");
+		Initialize(maxRetainedBytes, maxBuffersPerSize);
+	}
+
+	/// <summary>
+	/// Returns a pool shared by the whole process, with the default limits.
+	/// </summary>
+	TJBufferPool^ TJBufferPool::getShared()
+	{
+		return shared;
+	}
+
+	/// <summary>
+	/// Returns a buffer of exactly the given length, from the pool if it has one and
+	/// otherwise newly allocated.  The contents of a pooled buffer are whatever its last
+	/// user left in it.
+	/// </summary>
+	/// <param name="length">The length of the buffer, in bytes.</param>
+	array<Byte>^ TJBufferPool::rent(int length)
+	{
+		if (length < 0)
+			throw gcnew ArgumentException("Invalid argument in rent()");
+		Monitor::Enter(sync);
+		try
+		{
+			Bucket^ bucket;
+			if (buckets->TryGetValue(length, bucket) && bucket->buffers->Count > 0)
+			{
+				bucket->lastUsed = Environment::TickCount;
+				retainedBytes -= length;
+				hits++;
+				return bucket->buffers->Pop();
+			}
+			misses++;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+		return gcnew array<Byte>(length);
+	}
+
+	/// <summary>
+	/// Rents a buffer of exactly the given length, wrapped so that disposing the wrapper
+	/// gives the buffer back.
+	/// </summary>
+	/// <param name="length">The length of the buffer, in bytes.</param>
+	TJPooledBuffer^ TJBufferPool::rentScoped(int length)
+	{
+		return gcnew TJPooledBuffer(this, rent(length));
+	}
+
+	/// <summary>
+	/// <para>Gives a buffer back to the pool so it can be rented again.  The buffer doesn't
+	/// have to have come from the pool.  Don't use the buffer after this, and don't give the
+	/// same buffer back twice.</para>
+	/// <para>If the pool is full, the buffer is left to the garbage collector.</para>
+	/// </summary>
+	/// <param name="buffer">The buffer to give back.  Null is ignored.</param>
+	void TJBufferPool::release(array<Byte>^ buffer)
+	{
+		if (buffer == nullptr)
+			return;
+		int length = buffer->Length;
+		Monitor::Enter(sync);
+		try
+		{
+			int now = Environment::TickCount;
+			if (now - lastTrim > idleTimeout)
+				trimIdle(now);
+			Bucket^ bucket;
+			if (!buckets->TryGetValue(length, bucket))
+			{
+				bucket = gcnew Bucket();
+				bucket->buffers = gcnew Stack<array<Byte>^>();
+				buckets->Add(length, bucket);
+			}
+			bucket->lastUsed = now;
+			if (bucket->buffers->Count >= maxBuffersPerSize || retainedBytes + length > maxRetainedBytes)
+			{
+				discarded++;
+				return;
+			}
+			bucket->buffers->Push(buffer);
+			retainedBytes += length;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	long long TJBufferPool::trimIdle(int now)
+	{
+		long long freed = 0;
+		List<int>^ idle = gcnew List<int>();
+		for each (KeyValuePair<int, Bucket^> pair in buckets)
+		{
+			if (now - pair.Value->lastUsed > idleTimeout)
+				idle->Add(pair.Key);
+		}
+		for each (int length in idle)
+		{
+			Bucket^ bucket = buckets[length];
+			freed += (long long)length * bucket->buffers->Count;
+			discarded += bucket->buffers->Count;
+			buckets->Remove(length);
+		}
+		retainedBytes -= freed;
+		lastTrim = now;
+		return freed;
+	}
+
+	/// <summary>
+	/// Drops the buffers of every length which has not been rented or given back for
+	/// getIdleTimeout() milliseconds.  release() does this on its own every getIdleTimeout()
+	/// milliseconds, so calling this is only needed to free memory sooner.
+	/// </summary>
+	/// <returns>the number of bytes dropped</returns>
+	long long TJBufferPool::trim()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return trimIdle(Environment::TickCount);
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Drops every buffer the pool holds.
+	/// </summary>
+	void TJBufferPool::clear()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			for each (KeyValuePair<int, Bucket^> pair in buckets)
+				discarded += pair.Value->buffers->Count;
+			buckets->Clear();
+			retainedBytes = 0;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Sets the most bytes the pool keeps.  Default value if unset: 256 MB
+	/// </summary>
+	void TJBufferPool::setMaxRetainedBytes(long long maxRetainedBytes)
+	{
+		if (maxRetainedBytes < 0)
+			throw gcnew ArgumentException("Invalid argument in setMaxRetainedBytes()");
+		this->maxRetainedBytes = maxRetainedBytes;
+	}
+
+	/// <summary>
+	/// Gets the most bytes the pool keeps.
+	/// </summary>
+	long long TJBufferPool::getMaxRetainedBytes()
+	{
+		return maxRetainedBytes;
+	}
+
+	/// <summary>
+	/// Sets the most buffers of any one length the pool keeps.  Default value if unset: 8
+	/// </summary>
+	void TJBufferPool::setMaxBuffersPerSize(int maxBuffersPerSize)
+	{
+		if (maxBuffersPerSize < 0)
+			throw gcnew ArgumentException("Invalid argument in setMaxBuffersPerSize()");
+		this->maxBuffersPerSize = maxBuffersPerSize;
+	}
+
+	/// <summary>
+	/// Gets the most buffers of any one length the pool keeps.
+	/// </summary>
+	int TJBufferPool::getMaxBuffersPerSize()
+	{
+		return maxBuffersPerSize;
+	}
+
+	/// <summary>
+	/// Sets how long, in milliseconds, buffers of a length which is not being used are kept.
+	/// Default value if unset: 60000
+	/// </summary>
+	void TJBufferPool::setIdleTimeout(int milliseconds)
+	{
+		if (milliseconds < 0)
+			throw gcnew ArgumentException("Invalid argument in setIdleTimeout()");
+		idleTimeout = milliseconds;
+	}
+
+	/// <summary>
+	/// Gets how long, in milliseconds, buffers of a length which is not being used are kept.
+	/// </summary>
+	int TJBufferPool::getIdleTimeout()
+	{
+		return idleTimeout;
+	}
+
+	/// <summary>
+	/// Returns the number of calls to rent() which were served from the pool.
+	/// </summary>
+	long long TJBufferPool::getHits()
+	{
+		return hits;
+	}
+
+	/// <summary>
+	/// Returns the number of calls to rent() which had to allocate a new buffer.
+	/// </summary>
+	long long TJBufferPool::getMisses()
+	{
+		return misses;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes of the buffers the pool currently holds.
+	/// </summary>
+	long long TJBufferPool::getRetainedBytes()
+	{
+		return retainedBytes;
+	}
+
+	/// <summary>
+	/// Returns the number of buffers given back which the pool did not keep, or dropped
+	/// later, because of its limits or trim().
+	/// </summary>
+	long long TJBufferPool::getDiscarded()
+	{
+		return discarded;
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+using namespace System;
+using namespace System::Collections::Generic;
+namespace turbojpegCLI
+{
+	ref class TJBufferPool;
+
+	/// <summary>
+	/// A buffer rented from a TJBufferPool which goes back to the pool when it is disposed,
+	/// so it can be used in a C# using() block.
+	/// </summary>
+	public ref class TJPooledBuffer
+	{
+	private:
+		TJBufferPool^ pool;
+		array<Byte>^ buffer;
+	internal:
+		TJPooledBuffer(TJBufferPool^ pool, array<Byte>^ buffer);
+	public:
+		~TJPooledBuffer();
+		array<Byte>^ getBuffer();
+		int getLength();
+	};
+
+	/// <summary>
+	/// <para>Keeps byte arrays which are no longer needed so they can be handed out again,
+	/// instead of allocating a new array for every frame.  Full-frame pixel buffers and
+	/// compression buffers are larger than 85000 bytes, so each new one is allocated on the
+	/// Large Object Heap, which is only collected by full (gen2) garbage collections and is
+	/// not compacted.  Renting them from a pool keeps the same few arrays in use instead.</para>
+	/// <para>Buffers are kept in buckets by exact length, so a rented buffer always has the
+	/// length that was asked for; a stream of same-sized frames uses a single bucket.</para>
+	/// <para>Pass a pool to TJDecompressor.setBufferPool() or TJCompressor.setBufferPool()
+	/// and the overloads which return a new array rent it from the pool.  Give each array back
+	/// with release() when you are done with it.  Arrays which are never given back are
+	/// simply collected by the garbage collector.</para>
+	/// <para>The pool keeps at most getMaxRetainedBytes() bytes and getMaxBuffersPerSize()
+	/// buffers of each length.  Buckets which have not been used for getIdleTimeout()
+	/// milliseconds are dropped by trim(), which release() calls periodically.</para>
+	/// <para>Instances are thread safe.</para>
+	/// </summary>
+	public ref class TJBufferPool
+	{
+	private:
+		ref class Bucket
+		{
+		public:
+			Stack<array<Byte>^>^ buffers;
+			int lastUsed;
+		};
+
+		static TJBufferPool^ shared;
+		Object^ sync;
+		Dictionary<int, Bucket^>^ buckets;
+		long long maxRetainedBytes;
+		int maxBuffersPerSize;
+		int idleTimeout;
+		int lastTrim;
+		long long retainedBytes;
+		long long hits;
+		long long misses;
+		long long discarded;
+
+		void Initialize(long long maxRetainedBytes, int maxBuffersPerSize)
+		{
+			sync = gcnew Object();
+			buckets = gcnew Dictionary<int, Bucket^>();
+			this->maxRetainedBytes = maxRetainedBytes;
+			this->maxBuffersPerSize = maxBuffersPerSize;
+			idleTimeout = 60000;
+			lastTrim = Environment::TickCount;
+			retainedBytes = 0;
+			hits = 0;
+			misses = 0;
+			discarded = 0;
+		}
+
+		long long trimIdle(int now);
+		static TJBufferPool()
+		{
+			shared = gcnew TJBufferPool();
+		}
+	public:
+
+		TJBufferPool();
+		TJBufferPool(long long maxRetainedBytes, int maxBuffersPerSize);
+
+		static TJBufferPool^ getShared();
+
+		array<Byte>^ rent(int length);
+		TJPooledBuffer^ rentScoped(int length);
+		void release(array<Byte>^ buffer);
+		long long trim();
+		void clear();
+
+		void setMaxRetainedBytes(long long maxRetainedBytes);
+		long long getMaxRetainedBytes();
+		void setMaxBuffersPerSize(int maxBuffersPerSize);
+		int getMaxBuffersPerSize();
+		void setIdleTimeout(int milliseconds);
+		int getIdleTimeout();
+
+		long long getHits();
+		long long getMisses();
+		long long getRetainedBytes();
+		long long getDiscarded();
+	};
+}
@@ -29,8 +29,7 @@ namespace turbojpegCLI
 	TJCompressor::!TJCompressor()
 	{
 		// This is the Finalizer, for disposing of unmanaged data.  Managed data should not be disposed here, because managed classes may have already been garbage collected by the time this runs.
-		if (handle != 0 && tjDestroy(handle) == -1)
-			throw gcnew TJException(getSystemString(tjGetErrorStr()));
+		tjcliDestroyEncoder(handle);
 		handle = 0;
 	}
 
@@ -121,6 +120,22 @@ namespace turbojpegCLI
 		setSourceImage(srcImage, x, y, width, pitch, height, pixelFormat);
 	}
 
+	/// <summary>
+	/// <para>Create a TurboJPEG compressor instance and associate the uncompressed
+	/// source image stored in <code>srcImage</code> with the newly created
+	/// instance.</para>
+	/// <para>The default SubsamplingOption will be SubsamplingOption.SAMP_420.</para>
+	/// <para>The default JPEG Quality will be 80 (range: 1 to 100)</para>
+	/// </summary>
+	///
+	/// <param name="srcImage">image containing RGB, grayscale, or CMYK pixels to
+	/// be compressed.  This image is not modified.</param>
+	TJCompressor::TJCompressor(NativeImage^ srcImage)
+	{
+		Initialize();
+		setSourceImage(srcImage);
+	}
+
 
 	/// <summary>
 	/// <para>Associate an uncompressed RGB image with this compressor instance.</para>
@@ -193,16 +208,12 @@ namespace turbojpegCLI
 	/// <param name="pixelFormat">pixel format of the source image (one of the PixelFormat enum values)</param>
 	void TJCompressor::setSourceImage(array<Byte>^ srcImage, int x, int y, int width, int pitch, int height, PixelFormat pixelFormat)
 	{
-		if (handle == 0)
-		{
-			handle = tjInitCompress();
-			if (handle == nullptr)
-				throw gcnew TJException(getSystemString(tjGetErrorStr()));
-		}
+		getHandle();
 		TJ::checkPixelFormat(pixelFormat);
 		if (srcImage == nullptr || x < 0 || y < 0 || width < 1 || height < 1 || pitch < 0)
 			throw gcnew ArgumentException("Invalid argument in setSourceImage()");
 		srcBuf = srcImage;
+		srcNativeImage = nullptr;
 		srcWidth = width;
 		if (pitch == 0)
 			srcPitch = width * TJ::getPixelSize(pixelFormat);
@@ -214,6 +225,31 @@ namespace turbojpegCLI
 		srcY = y;
 	}
 
+	/// <summary>
+	/// <para>Associate an uncompressed RGB, grayscale, or CMYK source image held in
+	/// unmanaged memory with this compressor instance.  The pixels are read straight from
+	/// the image when compressing, without pinning or copying.  Pass a view from
+	/// NativeImage.getSubImage() to compress part of a larger image.</para>
+	/// <para>The image must not be disposed while it is associated with this instance.</para>
+	/// </summary>
+	///
+	/// <param name="srcImage">image containing RGB, grayscale, or CMYK pixels to
+	/// be compressed.  This image is not modified.</param>
+	void TJCompressor::setSourceImage(NativeImage^ srcImage)
+	{
+		getHandle();
+		if (srcImage == nullptr)
+			throw gcnew ArgumentException("Invalid argument in setSourceImage()");
+		srcBuf = nullptr;
+		srcNativeImage = srcImage;
+		srcWidth = srcImage->getWidth();
+		srcPitch = srcImage->getPitch();
+		srcHeight = srcImage->getHeight();
+		srcPixelFormat = srcImage->getPixelFormat();
+		srcX = 0;
+		srcY = 0;
+	}
+
 	/// <summary>
 	/// Set the level of chrominance subsampling for subsequent compress/encode
 	/// operations.  When pixels are converted from RGB to YCbCr (see
@@ -279,15 +315,22 @@ namespace turbojpegCLI
 	/// <param name="dstBuf">buffer that will receive the JPEG image.  Use
 	/// TJ.bufSize() to determine the maximum size for this buffer based on
 	/// the source image's width and height and the desired level of chrominance
-	/// subsampling. Although it is unlikely, libjpeg-turbo may replace this 
-	/// buffer so it must be passed by reference.</param>
+	/// subsampling.  If predictive sizing is enabled (see setPredictiveSizing()), the
+	/// buffer may be smaller, and if the image does not fit, it is replaced with a new
+	/// array of exactly the size of the image.  Otherwise it is never replaced.</param>
 	///
 	/// <param name="flags">the bitwise OR of one or more of the Flag enum values</param>
 	void TJCompressor::compress(array<Byte>^ %dstBuf, Flag flags)
 	{
-		if (dstBuf == nullptr || (int)flags < 0)
-			throw gcnew Exception("Invalid argument in compress()");
-		if (srcBuf == nullptr)
+		compressImage(dstBuf, flags, false);
+	}
+
+	/// <summary>
+	/// Checks the source image and compression settings, and returns the pitch of the source image.
+	/// </summary>
+	int TJCompressor::checkCompressSource()
+	{
+		if (srcBuf == nullptr && srcNativeImage == nullptr)
 			throw gcnew Exception(NO_ASSOC_ERROR);
 		if (jpegQuality < 0)
 			throw gcnew Exception("JPEG Quality not set");
@@ -298,29 +341,65 @@ namespace turbojpegCLI
 
 		int actualPitch = (srcPitch == 0) ? srcWidth * tjPixelSize[(int)srcPixelFormat] : srcPitch;
 		int arraySize = (srcY + srcHeight - 1) * actualPitch + (srcX + srcWidth) * tjPixelSize[(int)srcPixelFormat];
-		if (srcBuf->Length < arraySize)
+		if (srcBuf != nullptr && srcBuf->Length < arraySize)
 			throw gcnew Exception("Source buffer is not large enough");
+		return actualPitch;
+	}
 
-		unsigned long jpegSize = TJ::bufSize(srcWidth, srcHeight, subsamp);
-		if (dstBuf->Length < (int)jpegSize)
+	void TJCompressor::compressImage(array<Byte>^ %dstBuf, Flag flags, bool abbreviated)
+	{
+		if (dstBuf == nullptr || (int)flags < 0)
+			throw gcnew Exception("Invalid argument in compress()");
+		int actualPitch = checkCompressSource();
+
+		int worstCaseSize = TJ::bufSize(srcWidth, srcHeight, subsamp);
+		unsigned long jpegSize = worstCaseSize;
+		if (!predictiveSizing && dstBuf->Length < worstCaseSize)
+			throw gcnew Exception("Destination buffer is not large enough");
+		if (dstBuf->Length < 1)
 			throw gcnew Exception("Destination buffer is not large enough");
 
-		pin_ptr<Byte> pinnedInput = &srcBuf[0];
+		// A NativeImage is already in unmanaged memory, so only a managed source is pinned.
+		pin_ptr<Byte> pinnedInput = nullptr;
+		if (srcBuf != nullptr)
+			pinnedInput = &srcBuf[0];
 		pin_ptr<Byte> pinnedOutput = &dstBuf[0];
-		unsigned char* outputBuf = pinnedOutput;
 		// I am not sure what this is for, but it does not seem to be needed.
 		//if (ProcessSystemProperties() < 0)
 		//	throw gcnew Exception("Setting system properties failed");
 
-		if (tjCompress2(handle, &pinnedInput[srcY * actualPitch + srcX * tjPixelSize[(int)srcPixelFormat]], srcWidth, srcPitch, srcHeight, (int)srcPixelFormat, &outputBuf, &jpegSize, (int)subsamp, jpegQuality, (int)flags | TJFLAG_NOREALLOC)
-			== -1)
-			throw gcnew TJException("tjCompress2 failed");
-		// outputBuf may be pointing at a new char* now.  If it is, we need to make sure dstBuf gets updated.
-		if (outputBuf != pinnedOutput)
+		const unsigned char* srcPixels = srcBuf == nullptr
+			? srcNativeImage->getPointer()
+			: &pinnedInput[srcY * actualPitch + srcX * tjPixelSize[(int)srcPixelFormat]];
+		if (predictiveSizing)
 		{
-			dstBuf = gcnew array<Byte>((int)jpegSize);
-			System::Runtime::InteropServices::Marshal::Copy((IntPtr)outputBuf, dstBuf, 0, (int)jpegSize);
+			// Whatever doesn't fit in dstBuf spills into the handle's overflow buffer, and the
+			// two parts are joined afterwards, so the image is never compressed twice.
+			int dstLength = dstBuf->Length;
+			if (tjcliCompressOverflow(handle, srcPixels, srcWidth, srcPitch, srcHeight, (int)srcPixelFormat, (int)subsamp, jpegQuality, (int)flags, abbreviated ? 1 : 0, pinnedOutput, (unsigned long)dstLength, &jpegSize) == -1)
+				throw gcnew TJException(&handle->jerr);
+			predictedCompressions++;
+			if ((int)jpegSize > dstLength)
+			{
+				overflowCount++;
+				array<Byte>^ grown = gcnew array<Byte>((int)jpegSize);
+				Buffer::BlockCopy(dstBuf, 0, grown, 0, dstLength);
+				System::Runtime::InteropServices::Marshal::Copy(IntPtr(handle->overflowDest.overflow), grown, dstLength, (int)jpegSize - dstLength);
+				dstBuf = grown;
+			}
+			if (dstBuf->Length < worstCaseSize)
+				bytesSaved += worstCaseSize - dstBuf->Length;
+			compressedSize = jpegSize;
+			updatePrediction(compressedSize);
+			return;
 		}
+
+		// The image is written straight into dstBuf, which TJ.bufSize() bytes are always enough for.
+		int result = abbreviated
+			? tjcliCompressAbbreviated(handle, srcPixels, srcWidth, srcPitch, srcHeight, (int)srcPixelFormat, (int)subsamp, jpegQuality, (int)flags, pinnedOutput, &jpegSize)
+			: tjcliCompressPixels(handle, srcPixels, srcWidth, srcPitch, srcHeight, (int)srcPixelFormat, (int)subsamp, jpegQuality, (int)flags, pinnedOutput, &jpegSize);
+		if (result == -1)
+			throw gcnew TJException(&handle->jerr);
 		compressedSize = jpegSize;
 	}
 
@@ -339,8 +418,20 @@ namespace turbojpegCLI
 	array<Byte>^ TJCompressor::compress(Flag flags)
 	{
 		checkSourceImage();
-		array<Byte>^ buf = gcnew array<Byte>(TJ::bufSize(srcWidth, srcHeight, subsamp));
-		compress(buf, flags);
+		array<Byte>^ buf = allocBuffer(getPredictedBufferSize());
+		array<Byte>^ rented = buf;
+		bool compressed = false;
+		try
+		{
+			compress(buf, flags);
+			compressed = true;
+		}
+		finally
+		{
+			// The rented buffer goes back to the pool unless it is the one handed out.
+			if (!compressed || buf != rented)
+				releaseBuffer(rented);
+		}
 		return buf;
 	}
 
@@ -375,12 +466,26 @@ namespace turbojpegCLI
 	array<Byte>^ TJCompressor::compressToExactSize(Flag flags)
 	{
 		checkSourceImage();
-		array<Byte>^ buf = gcnew array<Byte>(TJ::bufSize(srcWidth, srcHeight, subsamp));
-		compress(buf, flags);
+		// The first buffer is only scratch space here, so it goes back to the pool once the
+		// data has been copied out.  If it overflowed, the replacement already has the exact size.
+		array<Byte>^ buf = allocBuffer(getPredictedBufferSize());
+		array<Byte>^ rented = buf;
+		bool compressed = false;
+		try
+		{
+			compress(buf, flags);
+			compressed = true;
+		}
+		finally
+		{
+			if (!compressed || buf != rented)
+				releaseBuffer(rented);
+		}
 		if (buf->Length == compressedSize)
 			return buf;
 		array<Byte>^ exactSizeBuf = gcnew array<Byte>(compressedSize);
 		Array::Copy(buf, exactSizeBuf, compressedSize);
+		releaseBuffer(buf);
 		return exactSizeBuf;
 	}
 
@@ -400,6 +505,205 @@ namespace turbojpegCLI
 		return compressToExactSize(Flag::NONE);
 	}
 
+	/// <summary>
+	/// Compress the uncompressed source image associated with this compressor
+	/// instance and write the JPEG image to a stream.  The image is written in chunks
+	/// (see setStreamChunkSize()) from a buffer reused by every call, as the entropy
+	/// coder produces them, so the whole image is never held in memory and the first
+	/// bytes reach the stream before compression has finished.  Use
+	/// getCompressedSize() to obtain the number of bytes written.
+	/// </summary>
+	///
+	/// <param name="stream">a writable stream that will receive the JPEG image.  If
+	/// writing to it throws, compression stops and an IOException is thrown whose inner
+	/// exception is the original one, and the stream holds an incomplete image.</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of the Flag enum values</param>
+	void TJCompressor::compress(Stream^ stream, Flag flags)
+	{
+		compressToStream(stream, flags, false);
+	}
+
+	void TJCompressor::compressToStream(Stream^ stream, Flag flags, bool abbreviated)
+	{
+		if (stream == nullptr || !stream->CanWrite || (int)flags < 0)
+			throw gcnew ArgumentException("Invalid argument in compress()");
+		int actualPitch = checkCompressSource();
+
+		if (streamChunk == nullptr || streamChunk->Length != streamChunkSize)
+			streamChunk = gcnew array<Byte>(streamChunkSize);
+		if (writeChunkCallback == nullptr)
+		{
+			// The delegate lives as long as this instance, so the function pointer stays valid.
+			writeChunkCallback = gcnew TJWriteChunkCallback(this, &TJCompressor::writeChunk);
+			writeChunkFunc = (tjcli_write_func)System::Runtime::InteropServices::Marshal::GetFunctionPointerForDelegate(writeChunkCallback).ToPointer();
+		}
+
+		pin_ptr<Byte> pinnedInput = nullptr;
+		if (srcBuf != nullptr)
+			pinnedInput = &srcBuf[0];
+		pin_ptr<Byte> pinnedChunk = &streamChunk[0];
+		const unsigned char* srcPixels = srcBuf == nullptr
+			? srcNativeImage->getPointer()
+			: &pinnedInput[srcY * actualPitch + srcX * tjPixelSize[(int)srcPixelFormat]];
+
+		unsigned long long jpegSize = 0;
+		int result = -1;
+		outputStream = stream;
+		streamError = nullptr;
+		try
+		{
+			result = tjcliCompressStream(handle, srcPixels, srcWidth, srcPitch, srcHeight, (int)srcPixelFormat, (int)subsamp, jpegQuality, (int)flags, abbreviated ? 1 : 0, pinnedChunk, streamChunk->Length, writeChunkFunc, &jpegSize);
+		}
+		finally
+		{
+			outputStream = nullptr;
+		}
+		if (result == -1)
+		{
+			if (streamError != nullptr)
+			{
+				Exception^ inner = streamError;
+				streamError = nullptr;
+				throw gcnew IOException("Writing the JPEG image to the stream failed", inner);
+			}
+			throw gcnew TJException(&handle->jerr);
+		}
+		// The whole image has already been written, but getCompressedSize() cannot report it.
+		if (jpegSize > (unsigned long long)Int32::MaxValue)
+			throw gcnew TJException("The JPEG image of " + jpegSize + " bytes is too large for getCompressedSize()");
+		compressedSize = (int)jpegSize;
+	}
+
+	/// <summary>
+	/// Writes one chunk from streamChunk, which data points to, to the output stream.  An
+	/// exception must not unwind through libjpeg, so it is kept and rethrown afterwards.
+	/// </summary>
+	int TJCompressor::writeChunk(IntPtr data, int size)
+	{
+		try
+		{
+			outputStream->Write(streamChunk, 0, size);
+			return 0;
+		}
+		catch (Exception^ ex)
+		{
+			streamError = ex;
+			return -1;
+		}
+	}
+
+	/// <summary>
+	/// Sets the size of the chunks in which compress(Stream, Flag) writes to the stream.
+	/// Smaller chunks get the first bytes out sooner, and larger ones mean fewer calls to
+	/// Stream.Write().
+	/// <para>Default value if unset: 16384</para>
+	/// </summary>
+	void TJCompressor::setStreamChunkSize(int size)
+	{
+		if (size < 1)
+			throw gcnew ArgumentException("Invalid argument in setStreamChunkSize()");
+		streamChunkSize = size;
+	}
+
+	/// <summary>
+	/// Gets the size of the chunks in which compress(Stream, Flag) writes to the stream.
+	/// </summary>
+	int TJCompressor::getStreamChunkSize()
+	{
+		return streamChunkSize;
+	}
+
+
+	/// <summary>
+	/// <para>Return a tables-only JPEG datastream holding the quantization and Huffman
+	/// tables for the current JPEG quality.  Every JPEG image normally repeats these
+	/// tables, which take several hundred bytes.  In a stream of images with the same
+	/// quality, send this datastream once, then send images compressed with
+	/// compressAbbreviated(), which leave the tables out.</para>
+	/// <para>The receiver passes the datastream to TJDecompressor.setTables() once,
+	/// after which its TJDecompressor decompresses the abbreviated images like any other.
+	/// The same tables serve every subsampling option and pixel format, but a new
+	/// datastream is needed if the quality changes.</para>
+	/// </summary>
+	///
+	/// <returns>a buffer containing the tables-only datastream.  The length of this
+	/// buffer is equal to the size of the datastream.</returns>
+	array<Byte>^ TJCompressor::compressTables()
+	{
+		tjcli_encoder* enc = getHandle();
+		unsigned char* tables;
+		unsigned long tablesSize;
+		if (tjcliWriteTables(enc, jpegQuality, &tables, &tablesSize) == -1)
+			throw gcnew TJException(&enc->jerr);
+		array<Byte>^ buf = gcnew array<Byte>((int)tablesSize);
+		System::Runtime::InteropServices::Marshal::Copy((IntPtr)tables, buf, 0, (int)tablesSize);
+		tablesQuality = jpegQuality;
+		return buf;
+	}
+
+	/// <summary>
+	/// Compress the uncompressed source image associated with this compressor
+	/// instance to an abbreviated JPEG image, which leaves out the quantization and
+	/// Huffman tables, and output it to the given destination buffer.  Only a
+	/// TJDecompressor which has been given the output of compressTables() with
+	/// TJDecompressor.setTables() can decompress it.  compressTables() must have been
+	/// called since the JPEG quality was last changed.
+	/// </summary>
+	///
+	/// <param name="dstBuf">buffer that will receive the JPEG image.  Use
+	/// TJ.bufSize() to determine the maximum size for this buffer, as for compress().</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of the Flag enum values</param>
+	void TJCompressor::compressAbbreviated(array<Byte>^ %dstBuf, Flag flags)
+	{
+		if (tablesQuality != jpegQuality)
+			throw gcnew Exception("compressTables() has not been called for the current JPEG quality");
+		compressImage(dstBuf, flags, true);
+	}
+
+	/// <summary>
+	/// Compress the uncompressed source image associated with this compressor
+	/// instance to an abbreviated JPEG image (see the other overload) and return a
+	/// buffer containing it.  The length of this buffer will not be equal to the size
+	/// of the JPEG image.  Use getCompressedSize() to obtain the size of the JPEG image.
+	/// </summary>
+	///
+	/// <param name="flags">the bitwise OR of one or more of the Flag enum values</param>
+	///
+	/// <returns>a buffer containing an abbreviated JPEG image.</returns>
+	array<Byte>^ TJCompressor::compressAbbreviated(Flag flags)
+	{
+		checkSourceImage();
+		array<Byte>^ buf = allocBuffer(getPredictedBufferSize());
+		array<Byte>^ rented = buf;
+		bool compressed = false;
+		try
+		{
+			compressAbbreviated(buf, flags);
+			compressed = true;
+		}
+		finally
+		{
+			if (!compressed || buf != rented)
+				releaseBuffer(rented);
+		}
+		return buf;
+	}
+
+	/// <summary>
+	/// Compress the uncompressed source image associated with this compressor instance to
+	/// an abbreviated JPEG image, like compressAbbreviated(dstBuf, flags), and write it to
+	/// a stream in chunks, like compress(Stream, Flag).
+	/// </summary>
+	///
+	/// <param name="stream">a writable stream that will receive the JPEG image</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of the Flag enum values</param>
+	void TJCompressor::compressAbbreviated(Stream^ stream, Flag flags)
+	{
+		compressToStream(stream, flags, true);
+	}
 
 	/// <summary>
 	/// Returns the size of the image (in bytes) generated by the most recent
@@ -413,6 +717,182 @@ namespace turbojpegCLI
 		return compressedSize;
 	}
 
+	/// <summary>
+	/// Returns the number of warnings libjpeg issued during the most recent compress
+	/// operation of this instance.
+	/// </summary>
+	int TJCompressor::getWarningCount()
+	{
+		return handle == nullptr ? 0 : (int)handle->jerr.pub.num_warnings;
+	}
+
+	/// <summary>
+	/// Returns the text of the first warning libjpeg issued during the most recent
+	/// compress operation of this instance, or null if there were none.
+	/// </summary>
+	String^ TJCompressor::getWarningMessage()
+	{
+		if (handle == nullptr || handle->jerr.pub.num_warnings == 0)
+			return nullptr;
+		return getSystemString(handle->jerr.warning);
+	}
+
+	/// <summary>
+	/// Returns the counters of the arena this instance allocates libjpeg's working memory
+	/// from.  All zero until the first compress operation.
+	/// </summary>
+	TJMemoryStats TJCompressor::getMemoryStats()
+	{
+		if (handle == nullptr)
+			return TJMemoryStats();
+		return TJMemoryStats::fromHandle((j_common_ptr)&handle->cinfo);
+	}
+
+	/// <summary>
+	/// Sets the pool which compress(Flag) and compressAbbreviated(Flag) rent their buffer
+	/// from, and which compressToExactSize() uses for its scratch buffer.  Give each buffer
+	/// returned by compress(Flag) or compressAbbreviated(Flag) back with
+	/// TJBufferPool.release() when you are done with it.
+	/// Default value if unset: null (a new array is allocated every time)
+	/// </summary>
+	void TJCompressor::setBufferPool(TJBufferPool^ pool)
+	{
+		bufferPool = pool;
+	}
+
+	/// <summary>
+	/// Gets the pool which compress(Flag) and compressAbbreviated(Flag) rent their buffer from, or null.
+	/// </summary>
+	TJBufferPool^ TJCompressor::getBufferPool()
+	{
+		return bufferPool;
+	}
+
+	array<Byte>^ TJCompressor::allocBuffer(int length)
+	{
+		if (bufferPool == nullptr)
+			return gcnew array<Byte>(length);
+		return bufferPool->rent(length);
+	}
+
+	void TJCompressor::releaseBuffer(array<Byte>^ buffer)
+	{
+		if (bufferPool != nullptr)
+			bufferPool->release(buffer);
+	}
+
+	/// <summary>
+	/// <para>Sets whether the compress methods which allocate their own buffer size it from
+	/// the sizes of recent images instead of for the worst case (TJ.bufSize()), which is
+	/// several times larger than a typical image.  The prediction is the recent number of
+	/// bytes per pixel, plus 25% headroom, rounded up to 16 KB so that similar frames use
+	/// buffers of the same length (and the same TJBufferPool bucket).  It follows increases
+	/// at once and decreases gradually, and starts over when the quality or subsampling
+	/// changes.</para>
+	/// <para>If an image does not fit, compression carries on into an overflow buffer and
+	/// the result is joined into a new array of exactly the image's size.  The image is
+	/// never compressed twice.</para>
+	/// <para>This also lets compress(dstBuf, flags) accept a buffer smaller than TJ.bufSize().</para>
+	/// <para>Default value if unset: false</para>
+	/// </summary>
+	void TJCompressor::setPredictiveSizing(bool enabled)
+	{
+		predictiveSizing = enabled;
+	}
+
+	/// <summary>
+	/// Gets whether predictive sizing is enabled.
+	/// </summary>
+	bool TJCompressor::getPredictiveSizing()
+	{
+		return predictiveSizing;
+	}
+
+	/// <summary>
+	/// Returns the size of the buffer the compress methods would allocate for the current
+	/// source image: the predicted size if predictive sizing is enabled, otherwise
+	/// TJ.bufSize().
+	/// </summary>
+	int TJCompressor::getPredictedBufferSize()
+	{
+		checkSourceImage();
+		int worstCaseSize = TJ::bufSize(srcWidth, srcHeight, subsamp);
+		if (!predictiveSizing)
+			return worstCaseSize;
+		if (jpegQuality != predictionQuality || subsamp != predictionSubsamp)
+			bytesPerPixel = -1;
+		// Without any history, assume a typical photo at moderate quality.
+		double perPixel = bytesPerPixel < 0 ? 0.5 : bytesPerPixel;
+		double predicted = perPixel * srcWidth * srcHeight * 1.25 + 2048;
+		if (predicted >= worstCaseSize)
+			return worstCaseSize;
+		int size = ((int)predicted + 16383) & ~16383;
+		return size < worstCaseSize ? size : worstCaseSize;
+	}
+
+	void TJCompressor::updatePrediction(int jpegSize)
+	{
+		if (jpegQuality != predictionQuality || subsamp != predictionSubsamp)
+		{
+			bytesPerPixel = -1;
+			predictionQuality = jpegQuality;
+			predictionSubsamp = subsamp;
+		}
+		double observed = (double)jpegSize / ((double)srcWidth * srcHeight);
+		if (bytesPerPixel < 0 || observed > bytesPerPixel)
+			bytesPerPixel = observed;
+		else
+			bytesPerPixel = bytesPerPixel * 0.875 + observed * 0.125;
+	}
+
+	/// <summary>
+	/// Returns the number of predictively sized compressions whose image did not fit.
+	/// </summary>
+	long long TJCompressor::getOverflowCount()
+	{
+		return overflowCount;
+	}
+
+	/// <summary>
+	/// Returns the fraction (0 to 1) of predictively sized compressions whose image did not fit.
+	/// </summary>
+	double TJCompressor::getOverflowRate()
+	{
+		return predictedCompressions == 0 ? 0 : (double)overflowCount / predictedCompressions;
+	}
+
+	/// <summary>
+	/// Returns the total number of bytes by which the buffers of predictively sized
+	/// compressions were smaller than TJ.bufSize().
+	/// </summary>
+	long long TJCompressor::getBytesSaved()
+	{
+		return bytesSaved;
+	}
+
+	/// <summary>
+	/// Returns the libjpeg compressor, creating it the first time.
+	/// </summary>
+	tjcli_encoder* TJCompressor::getHandle()
+	{
+		if (handle == nullptr)
+		{
+			handle = tjcliInitEncoder();
+			if (handle == nullptr)
+				throw gcnew TJException("Unable to create a libjpeg compressor");
+		}
+		return handle;
+	}
+
+	/// <summary>
+	/// Sets or clears the flag which makes libjpeg's progress monitor abort the current (or
+	/// next) operation on this compressor.  This may be called from any thread.
+	/// </summary>
+	void TJCompressor::setCancelRequested(bool cancel)
+	{
+		getHandle()->progress.cancel = cancel ? 1 : 0;
+	}
+
 	void TJCompressor::checkSourceImage()
 	{
 		if (srcWidth < 1 || srcHeight < 1)
@@ -3,9 +3,20 @@
 #include "turbojpeg.h"
 #pragma warning( default : 4635 )
 #include "TJ.h"
+#include "jpegnative.h"
+#include "TJMemoryStats.h"
+#include "TJBufferPool.h"
+#include "NativeImage.h"
 using namespace System;
+using namespace System::IO;
 namespace turbojpegCLI
 {
+	/// <summary>
+	/// The native tjcli_write_func, which receives a chunk of a JPEG image written to a Stream.
+	/// </summary>
+	[System::Runtime::InteropServices::UnmanagedFunctionPointer(System::Runtime::InteropServices::CallingConvention::Cdecl)]
+	delegate int TJWriteChunkCallback(IntPtr data, int size);
+
 	/// <summary>
 	/// TurboJPEG compressor
 	/// </summary>
@@ -13,8 +24,9 @@ namespace turbojpegCLI
 	{
 	private:
 		String^ NO_ASSOC_ERROR;
-		tjhandle handle;
+		tjcli_encoder* handle;
 		array<Byte>^ srcBuf;
+		NativeImage^ srcNativeImage;
 		int srcWidth;
 		int srcHeight;
 		int srcX;
@@ -25,12 +37,28 @@ namespace turbojpegCLI
 		SubsamplingOption subsamp;
 		int jpegQuality;
 		int compressedSize;
+		int tablesQuality;
+		TJBufferPool^ bufferPool;
+		bool predictiveSizing;
+		double bytesPerPixel;
+		int predictionQuality;
+		SubsamplingOption predictionSubsamp;
+		long long predictedCompressions;
+		long long overflowCount;
+		long long bytesSaved;
+		int streamChunkSize;
+		array<Byte>^ streamChunk;
+		Stream^ outputStream;
+		Exception^ streamError;
+		TJWriteChunkCallback^ writeChunkCallback;
+		tjcli_write_func writeChunkFunc;
 		bool isDisposed;
 		!TJCompressor();
 		void Initialize()
 		{
 			NO_ASSOC_ERROR = "No source image is associated with this instance";
 			handle = 0;
+			srcNativeImage = nullptr;
 			srcWidth = 0;
 			srcHeight = 0;
 			srcX = -1;
@@ -41,21 +69,48 @@ namespace turbojpegCLI
 			subsamp = SubsamplingOption::SAMP_420;
 			jpegQuality = 80;
 			compressedSize = 0;
+			tablesQuality = -1;
+			bufferPool = nullptr;
+			predictiveSizing = false;
+			bytesPerPixel = -1;
+			predictionQuality = -1;
+			predictionSubsamp = (SubsamplingOption)-1;
+			predictedCompressions = 0;
+			overflowCount = 0;
+			bytesSaved = 0;
+			streamChunkSize = 16384;
+			streamChunk = nullptr;
+			outputStream = nullptr;
+			streamError = nullptr;
+			writeChunkCallback = nullptr;
+			writeChunkFunc = NULL;
 			isDisposed = false;
 		}
 
 		void checkSourceImage();
+		tjcli_encoder* getHandle();
+		array<Byte>^ allocBuffer(int length);
+		void releaseBuffer(array<Byte>^ buffer);
+		void updatePrediction(int jpegSize);
+		int checkCompressSource();
+		void compressImage(array<Byte>^ %dstBuf, Flag flags, bool abbreviated);
+		void compressToStream(Stream^ stream, Flag flags, bool abbreviated);
+		int writeChunk(IntPtr data, int size);
+	internal:
+		void setCancelRequested(bool cancel);
 	public:
 
 		TJCompressor();
 		TJCompressor(array<Byte>^ srcImage, int width, int height);
 		TJCompressor(array<Byte>^ srcImage, int width, int height, PixelFormat pixelFormat);
 		TJCompressor(array<Byte>^ srcImage, int x, int y, int width, int pitch, int height, PixelFormat pixelFormat);
+		TJCompressor(NativeImage^ srcImage);
 		~TJCompressor();
 
 		void setSourceImage(array<Byte>^ srcImage, int width, int height);
 		void setSourceImage(array<Byte>^ srcImage, int width, int height, PixelFormat pixelFormat);
 		void setSourceImage(array<Byte>^ srcImage, int x, int y, int width, int pitch, int height, PixelFormat pixelFormat);
+		void setSourceImage(NativeImage^ srcImage);
 
 		void setSubsamp(SubsamplingOption newSubsamp);
 		SubsamplingOption getSubsamp();
@@ -67,7 +122,27 @@ namespace turbojpegCLI
 		array<Byte>^ compressToExactSize(Flag flags);
 		array<Byte>^ compress();
 		array<Byte>^ compressToExactSize();
+		void compress(Stream^ stream, Flag flags);
+		void setStreamChunkSize(int size);
+		int getStreamChunkSize();
+
+		array<Byte>^ compressTables();
+		void compressAbbreviated(array<Byte>^ %dstBuf, Flag flags);
+		array<Byte>^ compressAbbreviated(Flag flags);
+		void compressAbbreviated(Stream^ stream, Flag flags);
 
 		int getCompressedSize();
+		int getWarningCount();
+		String^ getWarningMessage();
+		TJMemoryStats getMemoryStats();
+		void setBufferPool(TJBufferPool^ pool);
+		TJBufferPool^ getBufferPool();
+
+		void setPredictiveSizing(bool enabled);
+		bool getPredictiveSizing();
+		int getPredictedBufferSize();
+		long long getOverflowCount();
+		double getOverflowRate();
+		long long getBytesSaved();
 	};
 }
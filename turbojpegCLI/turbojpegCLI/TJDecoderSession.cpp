@@ -0,0 +1,311 @@
+#include "TJDecoderSession.h"
+#include "TJException.h"
+
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>Constructs a TJDecoderSession.  Pass each frame of a stream to decompress() in order.</para>
+	/// <para>By default frames are decoded to BGR at full size.</para>
+	/// </summary>
+	TJDecoderSession::TJDecoderSession()
+	{
+		Initialize();
+		getHandle();
+	}
+
+	/// <summary>
+	/// Call this when finished with the TJDecoderSession to free any native structures.
+	/// If you use a C# using() block, you won't need to call this.
+	/// </summary>
+	TJDecoderSession::~TJDecoderSession()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+
+		this->!TJDecoderSession();
+		isDisposed = true;
+	}
+	TJDecoderSession::!TJDecoderSession()
+	{
+		// This is the Finalizer, for disposing of unmanaged data.
+		tjcliDestroyDecoder(handle);
+		handle = 0;
+	}
+
+	tjcli_decoder* TJDecoderSession::getHandle()
+	{
+		if (handle == nullptr)
+		{
+			handle = tjcliInitDecoder();
+			if (handle == nullptr)
+				throw gcnew TJException("Unable to create a libjpeg decompressor");
+		}
+		return handle;
+	}
+
+	/// <summary>
+	/// Sets the pixel format frames are decoded to.  Default value if unset: BGR
+	/// </summary>
+	void TJDecoderSession::setPixelFormat(PixelFormat pixelFormat)
+	{
+		TJ::checkPixelFormat(pixelFormat);
+		if (pixelFormat != this->pixelFormat)
+			reset();
+		this->pixelFormat = pixelFormat;
+	}
+
+	/// <summary>
+	/// Gets the pixel format frames are decoded to.
+	/// </summary>
+	PixelFormat TJDecoderSession::getPixelFormat()
+	{
+		return pixelFormat;
+	}
+
+	/// <summary>
+	/// Sets the decompression flags.  Default value if unset: NONE
+	/// </summary>
+	void TJDecoderSession::setFlags(Flag flags)
+	{
+		if ((int)flags < 0)
+			throw gcnew ArgumentException("Invalid argument in setFlags()");
+		this->flags = flags;
+	}
+
+	/// <summary>
+	/// Gets the decompression flags.
+	/// </summary>
+	Flag TJDecoderSession::getFlags()
+	{
+		return flags;
+	}
+
+	/// <summary>
+	/// Sets the size frames should be scaled down to, as in TJDecompressor.decompress().  Pass 0
+	/// for either dimension to leave it unconstrained.  Default value if unset: 0, 0 (full size)
+	/// </summary>
+	void TJDecoderSession::setDesiredSize(int desiredWidth, int desiredHeight)
+	{
+		if (desiredWidth < 0 || desiredHeight < 0)
+			throw gcnew ArgumentException("Invalid argument in setDesiredSize()");
+		if (desiredWidth != this->desiredWidth || desiredHeight != this->desiredHeight)
+			reset();
+		this->desiredWidth = desiredWidth;
+		this->desiredHeight = desiredHeight;
+	}
+
+	/// <summary>
+	/// Loads the quantization and Huffman tables from a tables-only JPEG datastream, so that
+	/// the session can decompress a stream of abbreviated frames (see
+	/// TJCompressor.compressAbbreviated()).
+	/// </summary>
+	/// <param name="tables">A byte array containing a tables-only JPEG datastream.</param>
+	void TJDecoderSession::setTables(array<Byte>^ tables)
+	{
+		if (tables == nullptr || tables->Length < 1)
+			throw gcnew ArgumentException("Invalid argument in setTables()");
+		tjcli_decoder* dec = getHandle();
+		pin_ptr<Byte> pinnedTables = &tables[0];
+		if (tjcliReadTables(dec, pinnedTables, (unsigned long)tables->Length) == -1)
+			throw gcnew TJException(&dec->jerr);
+	}
+
+	/// <summary>
+	/// <para>Decompresses a frame.  Use getWidth(), getHeight() and getPitch() to interpret
+	/// the pixels.</para>
+	/// <para>The returned buffer belongs to this instance and is overwritten by the next
+	/// frame, so copy it if you need to keep it.  It is only replaced when the size of the
+	/// decoded frames changes.</para>
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	///
+	/// <param name="imageSize">The length of the image data in the array.</param>
+	///
+	/// <returns>the decoded pixels</returns>
+	array<Byte>^ TJDecoderSession::decompress(array<Byte>^ jpegImage, int imageSize)
+	{
+		if (jpegImage == nullptr || imageSize < 1)
+			throw gcnew ArgumentException("Invalid argument in decompress()");
+		if (jpegImage->Length < imageSize)
+			throw gcnew Exception("Source buffer is not large enough");
+
+		tjcli_decoder* dec = getHandle();
+		pin_ptr<Byte> pinnedJpegImage = &jpegImage[0];
+		unsigned long long hash = tjcliHashJpegHeader(pinnedJpegImage, (size_t)imageSize);
+		lastHeaderReused = hasHeader && hash != 0 && hash == headerHash;
+		if (lastHeaderReused)
+			headersReused++;
+		else
+		{
+			hasHeader = false;
+			long long start = Diagnostics::Stopwatch::GetTimestamp();
+			int w, h, s, c;
+			if (tjcliDecompressHeader3(dec, pinnedJpegImage, (unsigned long)imageSize, &w, &h, &s, &c) == -1)
+				throw gcnew TJException(&dec->jerr);
+			headerParseTicks += Diagnostics::Stopwatch::GetTimestamp() - start;
+			headersParsed++;
+
+			int scaledWidth, scaledHeight;
+			if (tjcliGetScaledSize(w, h, desiredWidth, desiredHeight, &scaledWidth, &scaledHeight) == -1)
+				throw gcnew Exception("Could not scale down to desired image dimensions");
+			int arraySize = TJMemoryBudget::checkBufferSize((long long)scaledWidth * TJ::getPixelSize(pixelFormat) * scaledHeight);
+			width = scaledWidth;
+			height = scaledHeight;
+			pitch = width * TJ::getPixelSize(pixelFormat);
+			frameBytes = arraySize + (long long)tjcliEstimateDecodeMemory(dec, w, h, scaledWidth, scaledHeight);
+			subsamp = (SubsamplingOption)s;
+			colorspace = (Colorspace)c;
+			headerHash = hash;
+		}
+
+		// The buffer is counted too, so the budget is checked before it is allocated.
+		TJMemoryBudget^ budget = TJMemoryBudget::getShared();
+		budget->reserve(frameBytes, false);
+		try
+		{
+			if (!lastHeaderReused)
+			{
+				if (pixels == nullptr || pixels->Length != pitch * height)
+					pixels = gcnew array<Byte>(pitch * height);
+				hasHeader = headerHash != 0;
+			}
+			pin_ptr<Byte> pinnedPixels = &pixels[0];
+			if (tjcliDecompressPixels(dec, pinnedJpegImage, (unsigned long)imageSize, pinnedPixels, desiredWidth, pitch, desiredHeight, (int)pixelFormat, (int)flags) == -1)
+			{
+				hasHeader = false;
+				throw gcnew TJException(&dec->jerr);
+			}
+		}
+		finally
+		{
+			budget->release(frameBytes);
+		}
+		framesDecoded++;
+		return pixels;
+	}
+
+	/// <summary>
+	/// <para>Decompresses a frame.  Use getWidth(), getHeight() and getPitch() to interpret
+	/// the pixels.</para>
+	/// <para>The returned buffer belongs to this instance and is overwritten by the next
+	/// frame, so copy it if you need to keep it.</para>
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	///
+	/// <returns>the decoded pixels</returns>
+	array<Byte>^ TJDecoderSession::decompress(array<Byte>^ jpegImage)
+	{
+		if (jpegImage == nullptr)
+			throw gcnew ArgumentException("Invalid argument in decompress()");
+		return decompress(jpegImage, jpegImage->Length);
+	}
+
+	/// <summary>
+	/// Forgets the headers of the previous frame, so the next frame's headers are parsed.
+	/// </summary>
+	void TJDecoderSession::reset()
+	{
+		hasHeader = false;
+		lastHeaderReused = false;
+	}
+
+	/// <summary>
+	/// Returns the width of the decoded pixels.
+	/// </summary>
+	int TJDecoderSession::getWidth()
+	{
+		if (pixels == nullptr)
+			throw gcnew Exception("No frames have been decoded by this instance");
+		return width;
+	}
+
+	/// <summary>
+	/// Returns the height of the decoded pixels.
+	/// </summary>
+	int TJDecoderSession::getHeight()
+	{
+		if (pixels == nullptr)
+			throw gcnew Exception("No frames have been decoded by this instance");
+		return height;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes per row of the decoded pixels.
+	/// </summary>
+	int TJDecoderSession::getPitch()
+	{
+		if (pixels == nullptr)
+			throw gcnew Exception("No frames have been decoded by this instance");
+		return pitch;
+	}
+
+	/// <summary>
+	/// Returns the level of chrominance subsampling of the most recent frame.
+	/// </summary>
+	SubsamplingOption TJDecoderSession::getSubsamp()
+	{
+		if (pixels == nullptr)
+			throw gcnew Exception("No frames have been decoded by this instance");
+		return subsamp;
+	}
+
+	/// <summary>
+	/// Returns the colorspace of the most recent frame.
+	/// </summary>
+	Colorspace TJDecoderSession::getColorspace()
+	{
+		if (pixels == nullptr)
+			throw gcnew Exception("No frames have been decoded by this instance");
+		return colorspace;
+	}
+
+	/// <summary>
+	/// Returns true if the most recent frame had the same headers as the one before it, so
+	/// they were not parsed separately.
+	/// </summary>
+	bool TJDecoderSession::wasHeaderReused()
+	{
+		return lastHeaderReused;
+	}
+
+	/// <summary>
+	/// Returns the number of frames decoded.
+	/// </summary>
+	long long TJDecoderSession::getFramesDecoded()
+	{
+		return framesDecoded;
+	}
+
+	/// <summary>
+	/// Returns the number of frames whose headers matched the previous frame's.
+	/// </summary>
+	long long TJDecoderSession::getHeadersReused()
+	{
+		return headersReused;
+	}
+
+	/// <summary>
+	/// Returns an estimate, in milliseconds, of the setup time saved so far: the number of
+	/// frames whose headers were reused times the measured average time to parse headers.
+	/// </summary>
+	double TJDecoderSession::getSetupTimeSaved()
+	{
+		if (headersParsed == 0)
+			return 0;
+		double ticksPerParse = (double)headerParseTicks / headersParsed;
+		return headersReused * ticksPerParse * 1000.0 / Diagnostics::Stopwatch::Frequency;
+	}
+
+	/// <summary>
+	/// Returns the counters of the arena this session allocates libjpeg's working memory
+	/// from.  Because frames of the same size need the same memory, after the first frame
+	/// nearly every allocation should be avoided.
+	/// </summary>
+	TJMemoryStats TJDecoderSession::getMemoryStats()
+	{
+		return TJMemoryStats::fromHandle((j_common_ptr)&getHandle()->cinfo);
+	}
+}
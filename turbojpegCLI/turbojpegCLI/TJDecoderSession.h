@@ -0,0 +1,99 @@
+#pragma once
+#include "TJ.h"
+#include "jpegnative.h"
+#include "mjpegnative.h"
+#include "TJMemoryStats.h"
+#include "TJMemoryBudget.h"
+using namespace System;
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>Decompresses the frames of a stream whose frames usually share the same
+	/// dimensions and tables, as camera streams do.  The headers of each frame (everything
+	/// up to the first scan, apart from metadata) are hashed, and while the hash is
+	/// unchanged the dimensions, subsampling and output buffer of the previous frame are
+	/// reused, so each frame is parsed once instead of twice as with
+	/// TJDecompressor.setSourceImage() followed by decompress().  The libjpeg handle, and
+	/// the tables it holds, are kept for the life of the session.</para>
+	/// <para>Each frame reserves its estimated memory from TJMemoryBudget.getShared()
+	/// while it is decoded.</para>
+	/// <para>Instances are not thread safe; use one per stream.</para>
+	/// </summary>
+	public ref class TJDecoderSession
+	{
+	private:
+		tjcli_decoder* handle;
+		array<Byte>^ pixels;
+		unsigned long long headerHash;
+		bool hasHeader;
+		int width;
+		int height;
+		int pitch;
+		long long frameBytes;
+		SubsamplingOption subsamp;
+		Colorspace colorspace;
+		PixelFormat pixelFormat;
+		Flag flags;
+		int desiredWidth;
+		int desiredHeight;
+		bool lastHeaderReused;
+		long long framesDecoded;
+		long long headersParsed;
+		long long headersReused;
+		long long headerParseTicks;
+		bool isDisposed;
+		!TJDecoderSession();
+
+		void Initialize()
+		{
+			handle = 0;
+			headerHash = 0;
+			hasHeader = false;
+			width = 0;
+			height = 0;
+			pitch = 0;
+			frameBytes = 0;
+			subsamp = (SubsamplingOption)-1;
+			colorspace = (Colorspace)-1;
+			pixelFormat = PixelFormat::BGR;
+			flags = Flag::NONE;
+			desiredWidth = 0;
+			desiredHeight = 0;
+			lastHeaderReused = false;
+			framesDecoded = 0;
+			headersParsed = 0;
+			headersReused = 0;
+			headerParseTicks = 0;
+			isDisposed = false;
+		}
+
+		tjcli_decoder* getHandle();
+	public:
+
+		TJDecoderSession();
+		~TJDecoderSession();
+
+		void setPixelFormat(PixelFormat pixelFormat);
+		PixelFormat getPixelFormat();
+		void setFlags(Flag flags);
+		Flag getFlags();
+		void setDesiredSize(int desiredWidth, int desiredHeight);
+		void setTables(array<Byte>^ tables);
+
+		array<Byte>^ decompress(array<Byte>^ jpegImage, int imageSize);
+		array<Byte>^ decompress(array<Byte>^ jpegImage);
+		void reset();
+
+		int getWidth();
+		int getHeight();
+		int getPitch();
+		SubsamplingOption getSubsamp();
+		Colorspace getColorspace();
+
+		bool wasHeaderReused();
+		long long getFramesDecoded();
+		long long getHeadersReused();
+		double getSetupTimeSaved();
+		TJMemoryStats getMemoryStats();
+	};
+}
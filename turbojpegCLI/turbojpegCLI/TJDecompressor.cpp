@@ -10,9 +10,7 @@ namespace turbojpegCLI
 	TJDecompressor::TJDecompressor()
 	{
 		Initialize();
-		handle = tjInitDecompress();
-		if (handle == nullptr)
-			throw gcnew TJException(getSystemString(tjGetErrorStr()));
+		getJpegHandle();
 	}
 	/// <summary>
 	/// Constructs a TJDecompressor which is responsible for decompressing a jpeg image.
@@ -21,9 +19,7 @@ namespace turbojpegCLI
 	TJDecompressor::TJDecompressor(array<Byte>^ jpegImage)
 	{
 		Initialize();
-		handle = tjInitDecompress();
-		if (handle == nullptr)
-			throw gcnew TJException(getSystemString(tjGetErrorStr()));
+		getJpegHandle();
 		setSourceImage(jpegImage, jpegImage->Length);
 	}
 	/// <summary>
@@ -34,9 +30,7 @@ namespace turbojpegCLI
 	TJDecompressor::TJDecompressor(array<Byte>^ jpegImage, int imageSize)
 	{
 		Initialize();
-		handle = tjInitDecompress();
-		if (handle == nullptr)
-			throw gcnew TJException(getSystemString(tjGetErrorStr()));
+		getJpegHandle();
 		setSourceImage(jpegImage, imageSize);
 	}
 
@@ -49,7 +43,8 @@ namespace turbojpegCLI
 		// This method appears as "Dispose()" in C#.
 		if (isDisposed)
 			return;
-		// We would dispose of managed data here, if we had any that needed disposing.
+		// The file mapping is managed, so it is closed here rather than in the finalizer.
+		releaseSource();
 
 		this->!TJDecompressor();
 		isDisposed = true;
@@ -57,9 +52,35 @@ namespace turbojpegCLI
 	TJDecompressor::!TJDecompressor()
 	{
 		// This is the Finalizer, for disposing of unmanaged data.  Managed data should not be disposed here, because managed classes may have already been garbage collected by the time this runs.
-		if (handle != 0 && tjDestroy(handle) == -1)
-			throw gcnew TJException(getSystemString(tjGetErrorStr()));
-		handle = 0;
+		if (streamChunkPin.IsAllocated)
+			streamChunkPin.Free();
+		tjcliDestroyDecoder(jpegHandle);
+		jpegHandle = 0;
+	}
+
+	/// <summary>
+	/// Returns the libjpeg decompressor, creating it the first time.  Its error context
+	/// belongs to this instance, so unlike tjGetErrorStr() its messages can not be mixed
+	/// up with those of decompressors on other threads.
+	/// </summary>
+	tjcli_decoder* TJDecompressor::getJpegHandle()
+	{
+		if (jpegHandle == nullptr)
+		{
+			jpegHandle = tjcliInitDecoder();
+			if (jpegHandle == nullptr)
+				throw gcnew TJException("Unable to create a libjpeg decompressor");
+		}
+		return jpegHandle;
+	}
+
+	/// <summary>
+	/// Sets or clears the flag which makes libjpeg's progress monitor abort the current (or
+	/// next) operation on this decompressor.  This may be called from any thread.
+	/// </summary>
+	void TJDecompressor::setCancelRequested(bool cancel)
+	{
+		getJpegHandle()->progress.cancel = cancel ? 1 : 0;
 	}
 
 	/// <summary>
@@ -73,6 +94,7 @@ namespace turbojpegCLI
 	{
 		if (jpegImage == nullptr || imageSize < 1)
 			throw gcnew ArgumentException("Invalid argument in setSourceImage()");
+		releaseSource();
 		jpegBuf = jpegImage;
 		jpegBufSize = imageSize;
 
@@ -86,8 +108,245 @@ namespace turbojpegCLI
 		pin_ptr<SubsamplingOption> s = &jpegSubsamp;
 		pin_ptr<Colorspace> c = &jpegColorspace;
 
-		if (tjDecompressHeader3(handle, pinnedJpegImage, (unsigned long)imageSize, w, h, (int*)s, (int*)c) == -1)
-			throw gcnew TJException("tjDecompressHeader3 failed");
+		tjcli_decoder* dec = getJpegHandle();
+		if (tjcliDecompressHeader3(dec, pinnedJpegImage, (unsigned long)imageSize, w, h, (int*)s, (int*)c) == -1)
+			throw gcnew TJException(&dec->jerr);
+	}
+	/// <summary>
+	/// Associate the JPEG image which starts at the current position of a stream with this
+	/// decompressor instance.  Only the header is read now.  Each decompress operation
+	/// then seeks back to where the image starts and reads it in chunks (see
+	/// setStreamChunkSize()) as the decoder needs them, so the image is never held in
+	/// memory all at once and decoding starts before it has all been read.  The stream
+	/// is not closed by this instance, and must not be used elsewhere while it is the
+	/// source.  For a stream which can not seek, such as a network stream, use
+	/// TJIncrementalDecoder.
+	/// </summary>
+	/// <param name="stream">A readable, seekable stream positioned at a JPEG image.</param>
+	void TJDecompressor::setSourceImage(Stream^ stream)
+	{
+		if (stream == nullptr || !stream->CanRead || !stream->CanSeek)
+			throw gcnew ArgumentException("Invalid argument in setSourceImage()");
+		releaseSource();
+		tjcli_decoder* dec = getJpegHandle();
+		if (streamChunk == nullptr || streamChunk->Length != streamChunkSize)
+			streamChunk = gcnew array<Byte>(streamChunkSize);
+		if (readChunkCallback == nullptr)
+		{
+			// The delegate lives as long as this instance, so the function pointer stays valid.
+			readChunkCallback = gcnew TJReadChunkCallback(this, &TJDecompressor::readChunk);
+			readChunkFunc = (tjcli_read_func)Marshal::GetFunctionPointerForDelegate(readChunkCallback).ToPointer();
+		}
+		// The chunk stays pinned while the stream is the source, because the decoder holds on to it.
+		streamChunkPin = GCHandle::Alloc(streamChunk, GCHandleType::Pinned);
+		tjcliSetReadSource(dec, (unsigned char*)streamChunkPin.AddrOfPinnedObject().ToPointer(), streamChunk->Length, readChunkFunc);
+		srcStream = stream;
+		srcStreamStart = stream->Position;
+		long long length = stream->Length - srcStreamStart;
+		readHeader(NULL, length > Int32::MaxValue ? Int32::MaxValue : (int)length);
+	}
+	/// <summary>
+	/// Associate a JPEG file with this decompressor instance.  The file is memory-mapped
+	/// and decompressed straight from the mapping, so it is never copied into an array,
+	/// and only the parts the decoder touches are read from disk.  The file is opened for
+	/// reading and can be read, but not written, by others until another source image is
+	/// set or this instance is disposed.  Dispose of this instance when finished, so the
+	/// file is unmapped promptly.
+	/// </summary>
+	/// <param name="path">The path of a JPEG file.</param>
+	void TJDecompressor::setSourceFile(String^ path)
+	{
+		if (path == nullptr)
+			throw gcnew ArgumentException("Invalid argument in setSourceFile()");
+		releaseSource();
+		FileStream^ file = gcnew FileStream(path, FileMode::Open, FileAccess::Read, FileShare::Read);
+		try
+		{
+			if (file->Length < 1 || file->Length > Int32::MaxValue)
+				throw gcnew ArgumentException("Invalid argument in setSourceFile()");
+			mappedFile = MemoryMappedFile::CreateFromFile(file, nullptr, 0, MemoryMappedFileAccess::Read, nullptr, HandleInheritability::None, false);
+		}
+		catch (Exception^)
+		{
+			delete file;
+			throw;
+		}
+		int imageSize = (int)file->Length;
+		mappedView = mappedFile->CreateViewAccessor(0, 0, MemoryMappedFileAccess::Read);
+		Byte* pointer = nullptr;
+		mappedView->SafeMemoryMappedViewHandle->AcquirePointer(pointer);
+		mappedData = pointer;
+		readHeader(mappedData, imageSize);
+	}
+	/// <summary>
+	/// Creates a decompressor for a JPEG file, which is memory-mapped instead of being read
+	/// into an array.  See setSourceFile().
+	/// </summary>
+	/// <param name="path">The path of a JPEG file.</param>
+	TJDecompressor^ TJDecompressor::fromFile(String^ path)
+	{
+		TJDecompressor^ decompressor = gcnew TJDecompressor();
+		try
+		{
+			decompressor->setSourceFile(path);
+		}
+		catch (Exception^)
+		{
+			delete decompressor;
+			throw;
+		}
+		return decompressor;
+	}
+	/// <summary>
+	/// Sets the size of the chunks in which an image is read from a stream (see
+	/// setSourceImage(Stream)).  This takes effect with the next stream set.
+	/// <para>Default value if unset: 65536</para>
+	/// </summary>
+	void TJDecompressor::setStreamChunkSize(int size)
+	{
+		if (size < 1)
+			throw gcnew ArgumentException("Invalid argument in setStreamChunkSize()");
+		streamChunkSize = size;
+	}
+	/// <summary>
+	/// Gets the size of the chunks in which an image is read from a stream.
+	/// </summary>
+	int TJDecompressor::getStreamChunkSize()
+	{
+		return streamChunkSize;
+	}
+
+	/// <summary>
+	/// Reads the header of the stream or mapped source image.
+	/// </summary>
+	void TJDecompressor::readHeader(const unsigned char* jpegData, int imageSize)
+	{
+		jpegBufSize = imageSize;
+		pin_ptr<int> w = &jpegWidth, h = &jpegHeight;
+		pin_ptr<SubsamplingOption> s = &jpegSubsamp;
+		pin_ptr<Colorspace> c = &jpegColorspace;
+		tjcli_decoder* dec = getJpegHandle();
+		const unsigned char* input = jpegData != NULL ? jpegData : beginRead();
+		if (tjcliDecompressHeader3(dec, input, (unsigned long)imageSize, w, h, (int*)s, (int*)c) == -1)
+			throw sourceError(dec);
+	}
+	/// <summary>
+	/// Detaches the current source image, closing the file mapping if there is one.
+	/// </summary>
+	void TJDecompressor::releaseSource()
+	{
+		if (srcStream != nullptr)
+		{
+			tjcliSetReadSource(jpegHandle, NULL, 0, NULL);
+			streamChunkPin.Free();
+			srcStream = nullptr;
+		}
+		if (mappedView != nullptr)
+		{
+			mappedData = NULL;
+			mappedView->SafeMemoryMappedViewHandle->ReleasePointer();
+			delete mappedView;
+			mappedView = nullptr;
+		}
+		if (mappedFile != nullptr)
+		{
+			delete mappedFile;
+			mappedFile = nullptr;
+		}
+		jpegBuf = nullptr;
+		jpegBufSize = 0;
+	}
+	/// <summary>
+	/// Returns what to pass the native functions when the source is not an array: the
+	/// mapped file, or NULL to read through the stream, which is rewound to the image.
+	/// </summary>
+	const unsigned char* TJDecompressor::beginRead()
+	{
+		if (srcStream != nullptr)
+		{
+			srcStream->Position = srcStreamStart;
+			streamError = nullptr;
+		}
+		return mappedData;
+	}
+	/// <summary>
+	/// Returns the exception for a failed native call, which is an IOException if reading
+	/// the stream failed.
+	/// </summary>
+	Exception^ TJDecompressor::sourceError(tjcli_decoder* dec)
+	{
+		if (streamError != nullptr)
+		{
+			Exception^ inner = streamError;
+			streamError = nullptr;
+			return gcnew IOException("Reading the JPEG image from the stream failed", inner);
+		}
+		return gcnew TJException(&dec->jerr);
+	}
+	/// <summary>
+	/// Reads one chunk from the stream into streamChunk, which buffer points to.  An
+	/// exception must not unwind through libjpeg, so it is kept and rethrown afterwards.
+	/// </summary>
+	int TJDecompressor::readChunk(IntPtr buffer, int size)
+	{
+		try
+		{
+			return srcStream->Read(streamChunk, 0, size);
+		}
+		catch (Exception^ ex)
+		{
+			streamError = ex;
+			return -1;
+		}
+	}
+	/// <summary>
+	/// Load the quantization and Huffman tables from a tables-only JPEG datastream, as
+	/// returned by TJCompressor.compressTables().  This instance can then decompress
+	/// abbreviated images (see TJCompressor.compressAbbreviated()), which leave the
+	/// tables out, for as long as it exists.  Tables in any complete JPEG image
+	/// decompressed later replace these ones.
+	/// </summary>
+	/// <param name="tables">A byte array containing a tables-only JPEG datastream.</param>
+	void TJDecompressor::setTables(array<Byte>^ tables)
+	{
+		if (tables == nullptr || tables->Length < 1)
+			throw gcnew ArgumentException("Invalid argument in setTables()");
+		tjcli_decoder* dec = getJpegHandle();
+		pin_ptr<Byte> pinnedTables = &tables[0];
+		if (tjcliReadTables(dec, pinnedTables, (unsigned long)tables->Length) == -1)
+			throw gcnew TJException(&dec->jerr);
+	}
+	/// <summary>
+	/// Like setSourceImage(), but returns false instead of throwing an exception if the
+	/// JPEG header cannot be read, for streams where corrupt images are routine.  On
+	/// failure, no image is associated with this instance.
+	/// </summary>
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	/// <param name="imageSize">The length of the image data in the array.</param>
+	/// <returns>true if the header was read</returns>
+	bool TJDecompressor::trySetSourceImage(array<Byte>^ jpegImage, int imageSize)
+	{
+		if (jpegImage == nullptr || imageSize < 1 || jpegImage->Length < imageSize)
+			throw gcnew ArgumentException("Invalid argument in trySetSourceImage()");
+		releaseSource();
+
+		pin_ptr<Byte> pinnedJpegImage = &jpegImage[0];
+		int w, h, s, c;
+		if (tjcliDecompressHeader3(getJpegHandle(), pinnedJpegImage, (unsigned long)imageSize, &w, &h, &s, &c) == -1)
+		{
+			jpegBuf = nullptr;
+			jpegBufSize = 0;
+			jpegWidth = 0;
+			jpegHeight = 0;
+			return false;
+		}
+		jpegBuf = jpegImage;
+		jpegBufSize = imageSize;
+		jpegWidth = w;
+		jpegHeight = h;
+		jpegSubsamp = (SubsamplingOption)s;
+		jpegColorspace = (Colorspace)c;
+		return true;
 	}
 	/// <summary>
 	/// Gets the width in pixels of the last image assigned to this instance. You may call this any time after setting the source image.
@@ -147,6 +406,181 @@ namespace turbojpegCLI
 		return jpegBufSize;
 	}
 	/// <summary>
+	/// Returns the number of warnings libjpeg issued during the most recent operation
+	/// of this instance.  Warnings are usually about corrupt or truncated data which
+	/// libjpeg decoded around, so a decompression can succeed with warnings.
+	/// </summary>
+	int TJDecompressor::getWarningCount()
+	{
+		return (int)getJpegHandle()->jerr.pub.num_warnings;
+	}
+	/// <summary>
+	/// Returns the text of the first warning libjpeg issued during the most recent
+	/// operation of this instance, or null if there were none.
+	/// </summary>
+	String^ TJDecompressor::getWarningMessage()
+	{
+		tjcli_decoder* dec = getJpegHandle();
+		return dec->jerr.pub.num_warnings > 0 ? getSystemString(dec->jerr.warning) : nullptr;
+	}
+	/// <summary>
+	/// Returns the counters of the arena this instance allocates libjpeg's working memory from.
+	/// </summary>
+	TJMemoryStats TJDecompressor::getMemoryStats()
+	{
+		return TJMemoryStats::fromHandle((j_common_ptr)&getJpegHandle()->cinfo);
+	}
+	/// <summary>
+	/// Sets the pool which the decompress methods that return a new buffer rent it from.
+	/// Give each buffer back with TJBufferPool.release() when you are done with it.
+	/// Default value if unset: null (a new array is allocated every time)
+	/// </summary>
+	void TJDecompressor::setBufferPool(TJBufferPool^ pool)
+	{
+		bufferPool = pool;
+	}
+	/// <summary>
+	/// Gets the pool which the decompress methods that return a new buffer rent it from, or null.
+	/// </summary>
+	TJBufferPool^ TJDecompressor::getBufferPool()
+	{
+		return bufferPool;
+	}
+	array<Byte>^ TJDecompressor::allocBuffer(int length)
+	{
+		if (bufferPool == nullptr)
+			return gcnew array<Byte>(length);
+		return bufferPool->rent(length);
+	}
+	/// <summary>
+	/// Sets the memory budget which decompressions reserve their estimated memory from.
+	/// Default value if unset: null (TJMemoryBudget.getShared())
+	/// </summary>
+	void TJDecompressor::setMemoryBudget(TJMemoryBudget^ budget)
+	{
+		memoryBudget = budget;
+	}
+	/// <summary>
+	/// Gets the memory budget which decompressions reserve their estimated memory from.
+	/// </summary>
+	TJMemoryBudget^ TJDecompressor::getMemoryBudget()
+	{
+		return memoryBudget != nullptr ? memoryBudget : TJMemoryBudget::getShared();
+	}
+	/// <summary>
+	/// Returns an estimate, from the JPEG header alone, of the bytes that decompressing the
+	/// source image to a new buffer would take: the buffer itself plus libjpeg's working
+	/// memory, which for a progressive image includes the coefficients of the whole image.
+	/// This is what the decompress methods reserve from the memory budget.
+	/// </summary>
+	///
+	/// <param name="desiredWidth">desired width (in pixels) of the decompressed image, as in
+	/// decompress(), or 0 for the width of the JPEG image</param>
+	///
+	/// <param name="desiredHeight">desired height (in pixels) of the decompressed image, as in
+	/// decompress(), or 0 for the height of the JPEG image</param>
+	///
+	/// <param name="pixelFormat">pixel format of the decompressed image</param>
+	long long TJDecompressor::getMemoryEstimate(int desiredWidth, int desiredHeight, PixelFormat pixelFormat)
+	{
+		TJ::checkPixelFormat(pixelFormat);
+		int width = getScaledWidth(desiredWidth, desiredHeight);
+		int height = getScaledHeight(desiredWidth, desiredHeight);
+		return estimateMemory(width, height, (long long)width * height * tjPixelSize[(int)pixelFormat]);
+	}
+	long long TJDecompressor::estimateMemory(int scaledWidth, int scaledHeight, long long outputBytes)
+	{
+		return (long long)tjcliEstimateDecodeMemory(getJpegHandle(), jpegWidth, jpegHeight, scaledWidth, scaledHeight) + outputBytes;
+	}
+	/// <summary>
+	/// Reserves the estimated memory of a decompression from the budget, waiting or
+	/// throwing as the budget decides.  Returns false, reserving nothing, when a method
+	/// which already holds the reservation calls another.
+	/// </summary>
+	bool TJDecompressor::admit(int desiredWidth, int desiredHeight, long long outputBytes)
+	{
+		if (reservedFrom != nullptr)
+			return false;
+		int width, height;
+		if (tjcliGetScaledSize(jpegWidth, jpegHeight, desiredWidth, desiredHeight, &width, &height) == -1)
+		{
+			// The decompression will fail anyway; the smallest scale is enough to get there.
+			width = (jpegWidth + 7) / 8;
+			height = (jpegHeight + 7) / 8;
+		}
+		TJMemoryBudget^ budget = getMemoryBudget();
+		long long bytes = estimateMemory(width, height, outputBytes);
+		budget->reserve(bytes, false);
+		reservedFrom = budget;
+		reservedBytes = bytes;
+		return true;
+	}
+	/// <summary>
+	/// Like admit(), for a decompression to a new buffer of width x height (already scaled)
+	/// whose size the caller lets vary.  If the image is larger than the whole budget, the
+	/// width and height are reduced to the largest DCT scale that fits.
+	/// </summary>
+	bool TJDecompressor::admitToFit(int% width, int% height, int pixelSize)
+	{
+		if (reservedFrom != nullptr)
+			return false;
+		TJMemoryBudget^ budget = getMemoryBudget();
+		long long bytes = estimateMemory(width, height, (long long)width * height * pixelSize);
+		bool downscaled = false;
+		if (!budget->fitsLimit(bytes) && budget->getDownscaleToFit())
+		{
+			for (int num = 2 * 8; num >= 1; num--)
+			{
+				int w = (jpegWidth * num + 7) / 8;
+				int h = (jpegHeight * num + 7) / 8;
+				if (w >= width && h >= height)
+					continue;
+				long long scaledBytes = estimateMemory(w, h, (long long)w * h * pixelSize);
+				if (budget->fitsLimit(scaledBytes))
+				{
+					width = w;
+					height = h;
+					bytes = scaledBytes;
+					downscaled = true;
+					break;
+				}
+			}
+		}
+		budget->reserve(bytes, downscaled);
+		reservedFrom = budget;
+		reservedBytes = bytes;
+		return true;
+	}
+	void TJDecompressor::releaseReservation()
+	{
+		reservedFrom->release(reservedBytes);
+		reservedFrom = nullptr;
+		reservedBytes = 0;
+	}
+	/// <summary>
+	/// Decompresses to a new buffer of width x height (already scaled), or smaller if the
+	/// memory budget requires, and returns the size used in width and height.
+	/// </summary>
+	array<Byte>^ TJDecompressor::decompressToFit(int% width, int% height, PixelFormat pixelFormat, Flag flags)
+	{
+		if (jpegBufSize < 1)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		TJ::checkPixelFormat(pixelFormat);
+		int pixelSize = tjPixelSize[(int)pixelFormat];
+		bool admitted = admitToFit(width, height, pixelSize);
+		try
+		{
+			array<Byte>^ dstBuf = gcnew array<Byte>(TJMemoryBudget::checkBufferSize((long long)width * pixelSize * height));
+			decompress(dstBuf, 0, 0, width, 0, height, pixelFormat, flags);
+			return dstBuf;
+		}
+		finally
+		{
+			if (admitted)
+				releaseReservation();
+		}
+	}
+	/// <summary>
 	/// Returns the width of the largest scaled-down image that the TurboJPEG
 	/// decompressor can generate without exceeding the desired image width and
 	/// height.
@@ -298,26 +732,39 @@ namespace turbojpegCLI
 	/// the turbojpegCLI.Flag enum values</param>
 	void TJDecompressor::decompress(array<Byte>^ dstBuf, int x, int y, int desiredWidth, int pitch, int desiredHeight, PixelFormat pixelFormat, Flag flags)
 	{
-		if (jpegBuf == nullptr)
+		if (jpegBufSize < 1)
 			throw gcnew Exception(NO_ASSOC_ERROR);
 		TJ::checkPixelFormat(pixelFormat);
 		if (dstBuf == nullptr || x < 0 || y < 0 || pitch < 0 || (int)flags < 0)
 			throw gcnew Exception("Invalid argument in decompress()");
 
-		if (jpegBuf->Length < jpegBufSize)
+		if (jpegBuf != nullptr && jpegBuf->Length < jpegBufSize)
 			throw gcnew Exception("Source buffer is not large enough");
 
-		int actualPitch = (pitch == 0) ? desiredWidth * tjPixelSize[(int)pixelFormat] : pitch;
-		int arraySize = (y + desiredHeight - 1) * actualPitch + (x + desiredWidth) * tjPixelSize[(int)pixelFormat];
+		long long actualPitch = (pitch == 0) ? (long long)desiredWidth * tjPixelSize[(int)pixelFormat] : pitch;
+		long long arraySize = ((long long)y + desiredHeight - 1) * actualPitch + ((long long)x + desiredWidth) * tjPixelSize[(int)pixelFormat];
 
 		if (dstBuf->Length < arraySize)
 			throw gcnew Exception("Destination buffer is not large enough");
 
-		pin_ptr<Byte> pinnedInput = &jpegBuf[0];
-		pin_ptr<Byte> pinnedOutput = &dstBuf[0];
+		tjcli_decoder* dec = getJpegHandle();
+		bool admitted = admit(desiredWidth, desiredHeight, 0);
+		try
+		{
+			pin_ptr<Byte> pinnedInput = nullptr;
+			if (jpegBuf != nullptr)
+				pinnedInput = &jpegBuf[0];
+			const unsigned char* input = jpegBuf != nullptr ? pinnedInput : beginRead();
+			pin_ptr<Byte> pinnedOutput = &dstBuf[0];
 
-		if (tjDecompress2(handle, pinnedInput, (unsigned long)jpegBufSize, &pinnedOutput[y*actualPitch + x*tjPixelSize[(int)pixelFormat]], desiredWidth, pitch, desiredHeight, (int)pixelFormat, (int)flags) == -1)
-			throw gcnew TJException("tjDecompress2 failed");
+			if (tjcliDecompressPixels(dec, input, (unsigned long)jpegBufSize, &pinnedOutput[(int)(y * actualPitch) + x * tjPixelSize[(int)pixelFormat]], desiredWidth, pitch, desiredHeight, (int)pixelFormat, (int)flags) == -1)
+				throw sourceError(dec);
+		}
+		finally
+		{
+			if (admitted)
+				releaseReservation();
+		}
 	}
 	/// <summary>
 	/// Decompress the JPEG source image or decode the YUV source image associated
@@ -421,23 +868,33 @@ namespace turbojpegCLI
 	/// the turbojpegCLI.Flag enum values</param>
 	array<Byte>^ TJDecompressor::decompress(int desiredWidth, int pitch, int desiredHeight, PixelFormat pixelFormat, Flag flags)
 	{
-		if (jpegBuf == nullptr)
+		if (jpegBufSize < 1)
 			throw gcnew Exception(NO_ASSOC_ERROR);
 		TJ::checkPixelFormat(pixelFormat);
 		if (pitch < 0 || desiredWidth < 0 || desiredHeight < 0 || (int)flags < 0)
 			throw gcnew Exception("Invalid argument in decompress()");
 
-		if (jpegBuf->Length < jpegBufSize)
+		if (jpegBuf != nullptr && jpegBuf->Length < jpegBufSize)
 			throw gcnew Exception("Source buffer is not large enough");
 
-		int actualPitch = (pitch == 0) ? desiredWidth * tjPixelSize[(int)pixelFormat] : pitch;
-		int arraySize = (desiredHeight - 1) * actualPitch + (desiredWidth) * tjPixelSize[(int)pixelFormat];
+		long long actualPitch = (pitch == 0) ? (long long)desiredWidth * tjPixelSize[(int)pixelFormat] : pitch;
+		int arraySize = TJMemoryBudget::checkBufferSize((desiredHeight - 1) * actualPitch + (long long)desiredWidth * tjPixelSize[(int)pixelFormat]);
 
-		array<Byte>^ dstBuf = gcnew array<Byte>(arraySize);
+		// The buffer is counted too, so the budget is checked before it is allocated.
+		bool admitted = admit(desiredWidth, desiredHeight, arraySize);
+		try
+		{
+			array<Byte>^ dstBuf = allocBuffer(arraySize);
 
-		decompress(dstBuf, 0, 0, desiredWidth, pitch, desiredHeight, pixelFormat, flags);
+			decompress(dstBuf, 0, 0, desiredWidth, pitch, desiredHeight, pixelFormat, flags);
 
-		return dstBuf;
+			return dstBuf;
+		}
+		finally
+		{
+			if (admitted)
+				releaseReservation();
+		}
 	}
 
 	/// <summary>
@@ -465,4 +922,474 @@ namespace turbojpegCLI
 	{
 		return decompress(jpegWidth, jpegWidth * tjPixelSize[(int)PixelFormat::RGB], jpegHeight, PixelFormat::RGB, Flag::NONE);
 	}
+
+	/// <summary>
+	/// Decompress the JPEG source image associated with this decompressor instance
+	/// straight into a NativeImage, in its pixel format.  The image is scaled down to the
+	/// largest size which fits within the NativeImage (see getScaledWidth() and
+	/// getScaledHeight()) and written to its top-left corner.  Pass a view from
+	/// NativeImage.getSubImage() to decompress into part of a larger image.
+	/// </summary>
+	///
+	/// <param name="dstImage">image that will receive the decompressed pixels</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of
+	/// the turbojpegCLI.Flag enum values</param>
+	void TJDecompressor::decompress(NativeImage^ dstImage, Flag flags)
+	{
+		if (jpegBufSize < 1)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		if (dstImage == nullptr || (int)flags < 0)
+			throw gcnew ArgumentException("Invalid argument in decompress()");
+		if (jpegBuf != nullptr && jpegBuf->Length < jpegBufSize)
+			throw gcnew Exception("Source buffer is not large enough");
+
+		tjcli_decoder* dec = getJpegHandle();
+		unsigned char* pixels = dstImage->getPointer();
+		bool admitted = admit(dstImage->getWidth(), dstImage->getHeight(), 0);
+		try
+		{
+			pin_ptr<Byte> pinnedInput = nullptr;
+			if (jpegBuf != nullptr)
+				pinnedInput = &jpegBuf[0];
+			const unsigned char* input = jpegBuf != nullptr ? pinnedInput : beginRead();
+			if (tjcliDecompressPixels(dec, input, (unsigned long)jpegBufSize, pixels, dstImage->getWidth(), dstImage->getPitch(), dstImage->getHeight(), (int)dstImage->getPixelFormat(), (int)flags) == -1)
+				throw sourceError(dec);
+		}
+		finally
+		{
+			if (admitted)
+				releaseReservation();
+		}
+	}
+
+	/// <summary>
+	/// Decompress the JPEG source image associated with this decompressor instance into a
+	/// new NativeImage of the scaled size.  Dispose the image when finished with it.
+	/// </summary>
+	///
+	/// <param name="desiredWidth">desired width (in pixels) of the decompressed image, as in
+	/// decompress().  Setting this to 0 is the same as setting it to the width of the JPEG
+	/// image.</param>
+	///
+	/// <param name="desiredHeight">desired height (in pixels) of the decompressed image, as in
+	/// decompress().  Setting this to 0 is the same as setting it to the height of the JPEG
+	/// image.</param>
+	///
+	/// <param name="pixelFormat">pixel format of the decompressed image (one of
+	/// the turbojpegCLI.PixelFormat enum values)</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of
+	/// the turbojpegCLI.Flag enum values</param>
+	NativeImage^ TJDecompressor::decompressToNativeImage(int desiredWidth, int desiredHeight, PixelFormat pixelFormat, Flag flags)
+	{
+		TJ::checkPixelFormat(pixelFormat);
+		int width = getScaledWidth(desiredWidth, desiredHeight);
+		int height = getScaledHeight(desiredWidth, desiredHeight);
+		bool admitted = admitToFit(width, height, tjPixelSize[(int)pixelFormat]);
+		try
+		{
+			NativeImage^ image = gcnew NativeImage(width, height, pixelFormat);
+			try
+			{
+				decompress(image, flags);
+			}
+			catch (Exception^)
+			{
+				delete image;
+				throw;
+			}
+			return image;
+		}
+		finally
+		{
+			if (admitted)
+				releaseReservation();
+		}
+	}
+
+	/// <summary>
+	/// <para>Decompress the JPEG source image associated with this decompressor instance,
+	/// like decompress(), but report problems in the returned status instead of throwing
+	/// an exception.  This is meant for streams such as network cameras, where corrupt and
+	/// truncated frames are routine and exceptions would be too expensive.</para>
+	/// <para>Corrupt data does not stop the decode: libjpeg skips to the next restart marker
+	/// and carries on, and a truncated image is finished with gray, so a damaged frame still
+	/// produces a full image.  If a fatal error stops the decode part way, the rows decoded
+	/// before it are left in the destination buffer.  Invalid arguments still throw.</para>
+	/// </summary>
+	///
+	/// <param name="dstBuf">buffer that will receive the decompressed image.  This should
+	/// normally be <code>pitch * scaledHeight</code> bytes in size, where
+	/// <code>scaledHeight</code> can be determined by calling getScaledHeight().  However,
+	/// the buffer may also be larger, in which case the <code>x</code>, <code>y</code>,
+	/// and <code>pitch</code> parameters can be used to specify the region into which the
+	/// image should be decompressed.</param>
+	///
+	/// <param name="x">x offset (in pixels) of the region in the destination image into
+	/// which the image should be decompressed. Usually you want this to be 0.</param>
+	///
+	/// <param name="y">y offset (in pixels) of the region in the destination image into
+	/// which the image should be decompressed. Usually you want this to be 0.</param>
+	///
+	/// <param name="desiredWidth">desired width (in pixels) of the decompressed image, as
+	/// in decompress().  Setting this to 0 is the same as setting it to the width of the
+	/// JPEG image.</param>
+	///
+	/// <param name="pitch">bytes per line of the destination image.  Setting this
+	/// parameter to 0 is the equivalent of setting it to
+	/// <code>scaledWidth * TJ.getPixelSize(pixelFormat)</code>.</param>
+	///
+	/// <param name="desiredHeight">desired height (in pixels) of the decompressed image,
+	/// as in decompress().  Setting this to 0 is the same as setting it to the height of
+	/// the JPEG image.</param>
+	///
+	/// <param name="pixelFormat">pixel format of the decompressed image (one of
+	/// the turbojpegCLI.PixelFormat enum values)</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of
+	/// the turbojpegCLI.Flag enum values.  BOTTOMUP, FASTUPSAMPLE, FASTDCT and
+	/// ACCURATEDCT are honored.</param>
+	///
+	/// <returns>how the decode went</returns>
+	TJDecompressStatus TJDecompressor::tryDecompress(array<Byte>^ dstBuf, int x, int y, int desiredWidth, int pitch, int desiredHeight, PixelFormat pixelFormat, Flag flags)
+	{
+		if (jpegBufSize < 1)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		TJ::checkPixelFormat(pixelFormat);
+		if (dstBuf == nullptr || x < 0 || y < 0 || pitch < 0 || (int)flags < 0)
+			throw gcnew Exception("Invalid argument in tryDecompress()");
+
+		if (jpegBuf != nullptr && jpegBuf->Length < jpegBufSize)
+			throw gcnew Exception("Source buffer is not large enough");
+
+		int scaledWidth, scaledHeight;
+		if (tjcliGetScaledSize(jpegWidth, jpegHeight, desiredWidth, desiredHeight, &scaledWidth, &scaledHeight) == -1)
+			return failedStatus("Could not scale down to desired image dimensions");
+		long long actualPitch = (pitch == 0) ? (long long)scaledWidth * tjPixelSize[(int)pixelFormat] : pitch;
+		long long arraySize = ((long long)y + scaledHeight - 1) * actualPitch + ((long long)x + scaledWidth) * tjPixelSize[(int)pixelFormat];
+
+		if (dstBuf->Length < arraySize)
+			throw gcnew Exception("Destination buffer is not large enough");
+
+		tjcli_decoder* dec = getJpegHandle();
+		tjcli_decode_status nativeStatus;
+		int result = -1;
+		bool admitted;
+		try
+		{
+			admitted = admit(desiredWidth, desiredHeight, 0);
+		}
+		catch (TJException^ ex)
+		{
+			// The budget rejected the image or timed out, which is reported like any failure.
+			return failedStatus(ex->Message);
+		}
+		try
+		{
+			pin_ptr<Byte> pinnedInput = nullptr;
+			if (jpegBuf != nullptr)
+				pinnedInput = &jpegBuf[0];
+			const unsigned char* input = jpegBuf != nullptr ? pinnedInput : beginRead();
+			pin_ptr<Byte> pinnedOutput = &dstBuf[0];
+
+			result = tjcliTryDecompress(dec, input, (unsigned long)jpegBufSize, &pinnedOutput[(int)(y * actualPitch) + x * tjPixelSize[(int)pixelFormat]], desiredWidth, (int)actualPitch, desiredHeight, (int)pixelFormat, (int)flags, &nativeStatus);
+		}
+		finally
+		{
+			if (admitted)
+				releaseReservation();
+		}
+
+		TJDecompressStatus status;
+		status.succeeded = result != -1;
+		status.rowsDecoded = nativeStatus.rowsDecoded;
+		status.warningCount = nativeStatus.warnings;
+		status.corruptMcuCount = nativeStatus.corruptMcus;
+		status.errorMessage = nullptr;
+		if (result == -1)
+			status.errorMessage = streamError != nullptr ? streamError->Message : getSystemString(tjcliGetErrorStr(dec));
+		streamError = nullptr;
+		status.warningMessage = nativeStatus.warnings > 0 ? getSystemString(dec->jerr.warning) : nullptr;
+		return status;
+	}
+
+	/// <summary>
+	/// Decompress the JPEG source image associated with this decompressor instance to its
+	/// native resolution, like decompress(), but report problems in the returned status
+	/// instead of throwing an exception.  See the other overload for details.
+	/// </summary>
+	///
+	/// <param name="dstBuf">buffer that will receive the decompressed image.  This should
+	/// be at least <code>width * height * TJ.getPixelSize(pixelFormat)</code> bytes in size.</param>
+	///
+	/// <param name="pixelFormat">pixel format of the decompressed image (one of
+	/// the turbojpegCLI.PixelFormat enum values)</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of
+	/// the turbojpegCLI.Flag enum values</param>
+	///
+	/// <returns>how the decode went</returns>
+	TJDecompressStatus TJDecompressor::tryDecompress(array<Byte>^ dstBuf, PixelFormat pixelFormat, Flag flags)
+	{
+		return tryDecompress(dstBuf, 0, 0, 0, 0, 0, pixelFormat, flags);
+	}
+
+	TJDecompressStatus TJDecompressor::failedStatus(String^ message)
+	{
+		TJDecompressStatus status;
+		status.succeeded = false;
+		status.rowsDecoded = 0;
+		status.warningCount = 0;
+		status.corruptMcuCount = 0;
+		status.errorMessage = message;
+		status.warningMessage = nullptr;
+		return status;
+	}
+
+	/// <summary>
+	/// Decompress only the luma (Y) plane of the JPEG source image associated with
+	/// this decompressor instance, producing an 8-bit grayscale image.  Unlike
+	/// decompressing with <code>PixelFormat.GRAY</code>, this skips the chroma IDCT,
+	/// upsampling and color conversion entirely, and the IDCT writes rows of Y
+	/// directly into the destination buffer.  The source image must be a YCbCr or
+	/// grayscale JPEG image (RGB images are converted to grayscale instead).  CMYK
+	/// images are not supported and cause a TJException.  The image is always decompressed to its native resolution.
+	/// </summary>
+	///
+	/// <param name="dstBuf">buffer that will receive the luma plane.  This should
+	/// normally be <code>pitch * jpegHeight</code> bytes in size, but may also be
+	/// larger, in which case the <code>x</code>, <code>y</code>, and
+	/// <code>pitch</code> parameters can be used to specify the region into which
+	/// the luma plane should be decompressed.</param>
+	///
+	/// <param name="x">x offset (in pixels) of the region in the destination image into
+	/// which the luma plane should be decompressed. Usually you want this to be 0.</param>
+	///
+	/// <param name="y">y offset (in pixels) of the region in the destination image into
+	/// which the luma plane should be decompressed. Usually you want this to be 0.</param>
+	///
+	/// <param name="pitch">bytes per line of the destination image.  Setting this
+	/// parameter to 0 is the equivalent of setting it to the width of the JPEG image.
+	/// A pitch which leaves room for the width to be rounded up to a multiple of 8 (16
+	/// for horizontally subsampled images) is slightly faster, because no row has to be
+	/// copied.</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of
+	/// the turbojpegCLI.Flag enum values.  BOTTOMUP, FASTDCT and ACCURATEDCT are
+	/// honored.</param>
+	void TJDecompressor::decompressLuma(array<Byte>^ dstBuf, int x, int y, int pitch, Flag flags)
+	{
+		if (jpegBufSize < 1)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		if (dstBuf == nullptr || x < 0 || y < 0 || pitch < 0 || (pitch > 0 && pitch < jpegWidth) || (int)flags < 0)
+			throw gcnew Exception("Invalid argument in decompressLuma()");
+
+		if (jpegBuf != nullptr && jpegBuf->Length < jpegBufSize)
+			throw gcnew Exception("Source buffer is not large enough");
+
+		int actualPitch = (pitch == 0) ? jpegWidth : pitch;
+		long long offset = (long long)y * actualPitch + x;
+		long long arraySize = offset + (long long)(jpegHeight - 1) * actualPitch + jpegWidth;
+
+		if (dstBuf->Length < arraySize)
+			throw gcnew Exception("Destination buffer is not large enough");
+
+		tjcli_decoder* dec = getJpegHandle();
+		bool admitted = admit(0, 0, 0);
+		try
+		{
+			pin_ptr<Byte> pinnedInput = nullptr;
+			if (jpegBuf != nullptr)
+				pinnedInput = &jpegBuf[0];
+			const unsigned char* input = jpegBuf != nullptr ? pinnedInput : beginRead();
+			pin_ptr<Byte> pinnedOutput = &dstBuf[0];
+
+			if (tjcliDecompressLuma(dec, input, (unsigned long)jpegBufSize, &pinnedOutput[(int)offset], x, actualPitch, (size_t)(dstBuf->Length - offset), (int)flags) == -1)
+				throw sourceError(dec);
+		}
+		finally
+		{
+			if (admitted)
+				releaseReservation();
+		}
+	}
+	/// <summary>
+	/// Decompress only the luma (Y) plane of the JPEG source image associated with
+	/// this decompressor instance into an unpadded grayscale image
+	/// (<code>jpegWidth * jpegHeight</code> bytes).  See
+	/// decompressLuma(array&lt;Byte&gt;^, int, int, int, Flag).
+	/// </summary>
+	///
+	/// <param name="dstBuf">buffer that will receive the luma plane.</param>
+	void TJDecompressor::decompressLuma(array<Byte>^ dstBuf)
+	{
+		decompressLuma(dstBuf, 0, 0, 0, Flag::NONE);
+	}
+
+	/// <summary>
+	/// Decompress only the luma (Y) plane of the JPEG source image associated with
+	/// this decompressor instance and return a new buffer containing it, as an
+	/// unpadded grayscale image.  See decompressLuma(array&lt;Byte&gt;^, int, int, int, Flag).
+	/// </summary>
+	///
+	/// <param name="flags">the bitwise OR of one or more of
+	/// the turbojpegCLI.Flag enum values</param>
+	array<Byte>^ TJDecompressor::decompressLuma(Flag flags)
+	{
+		if (jpegBufSize < 1)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		int arraySize = TJMemoryBudget::checkBufferSize((long long)jpegWidth * jpegHeight);
+		bool admitted = admit(0, 0, arraySize);
+		try
+		{
+			array<Byte>^ dstBuf = allocBuffer(arraySize);
+			decompressLuma(dstBuf, 0, 0, 0, flags);
+			return dstBuf;
+		}
+		finally
+		{
+			if (admitted)
+				releaseReservation();
+		}
+	}
+
+	/// <summary>
+	/// Decompress only the luma (Y) plane of the JPEG source image associated with
+	/// this decompressor instance and return a new buffer containing it, as an
+	/// unpadded grayscale image.
+	/// </summary>
+	array<Byte>^ TJDecompressor::decompressLuma()
+	{
+		return decompressLuma(Flag::NONE);
+	}
+
+	/// <summary>
+	/// <para>Decompress a rough preview of the progressive JPEG source image associated with
+	/// this decompressor instance, using only its first <code>maxScans</code> scans and/or
+	/// its first <code>maxBytes</code> bytes.  The remaining scans are never decoded, so a
+	/// preview costs a fraction of a full decompression.  The first scan of a typical
+	/// progressive image holds the average color of every 8x8 block, which is all that is
+	/// needed for a thumbnail at 1/8 scale.</para>
+	/// <para>Images which are not progressive are decompressed in full (with the requested
+	/// scaling), and the limits are ignored.</para>
+	/// </summary>
+	///
+	/// <param name="dstBuf">buffer that will receive the preview.  This should normally
+	/// be <code>pitch * scaledHeight</code> bytes in size, where <code>scaledHeight</code>
+	/// can be determined by calling getScaledHeight().  However, the buffer may also be
+	/// larger, in which case the <code>x</code>, <code>y</code>, and <code>pitch</code>
+	/// parameters can be used to specify the region into which the preview should be
+	/// decompressed.</param>
+	///
+	/// <param name="x">x offset (in pixels) of the region in the destination image into
+	/// which the preview should be decompressed. Usually you want this to be 0.</param>
+	///
+	/// <param name="y">y offset (in pixels) of the region in the destination image into
+	/// which the preview should be decompressed. Usually you want this to be 0.</param>
+	///
+	/// <param name="desiredWidth">desired width (in pixels) of the preview, as in
+	/// decompress().  Setting this to 0 is the same as setting it to the width of the
+	/// JPEG image.</param>
+	///
+	/// <param name="pitch">bytes per line of the destination image.  Setting this
+	/// parameter to 0 is the equivalent of setting it to
+	/// <code>scaledWidth * TJ.getPixelSize(pixelFormat)</code>.</param>
+	///
+	/// <param name="desiredHeight">desired height (in pixels) of the preview, as in
+	/// decompress().  Setting this to 0 is the same as setting it to the height of the
+	/// JPEG image.</param>
+	///
+	/// <param name="pixelFormat">pixel format of the preview (one of
+	/// the turbojpegCLI.PixelFormat enum values)</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of
+	/// the turbojpegCLI.Flag enum values.  BOTTOMUP, FASTUPSAMPLE, FASTDCT and
+	/// ACCURATEDCT are honored.</param>
+	///
+	/// <param name="maxScans">the number of scans to use, or 0 for no limit</param>
+	///
+	/// <param name="maxBytes">the number of bytes of the image to use, or 0 for no limit.
+	/// A scan which is cut short by this limit is shown as far as it goes.</param>
+	///
+	/// <returns>the number of scans the preview was made from</returns>
+	int TJDecompressor::decompressPreview(array<Byte>^ dstBuf, int x, int y, int desiredWidth, int pitch, int desiredHeight, PixelFormat pixelFormat, Flag flags, int maxScans, int maxBytes)
+	{
+		if (jpegBufSize < 1)
+			throw gcnew Exception(NO_ASSOC_ERROR);
+		TJ::checkPixelFormat(pixelFormat);
+		if (dstBuf == nullptr || x < 0 || y < 0 || pitch < 0 || maxScans < 0 || maxBytes < 0 || (int)flags < 0)
+			throw gcnew Exception("Invalid argument in decompressPreview()");
+
+		if (jpegBuf != nullptr && jpegBuf->Length < jpegBufSize)
+			throw gcnew Exception("Source buffer is not large enough");
+
+		int scaledWidth = getScaledWidth(desiredWidth, desiredHeight);
+		int scaledHeight = getScaledHeight(desiredWidth, desiredHeight);
+		long long actualPitch = (pitch == 0) ? (long long)scaledWidth * tjPixelSize[(int)pixelFormat] : pitch;
+		long long arraySize = ((long long)y + scaledHeight - 1) * actualPitch + ((long long)x + scaledWidth) * tjPixelSize[(int)pixelFormat];
+
+		if (dstBuf->Length < arraySize)
+			throw gcnew Exception("Destination buffer is not large enough");
+
+		tjcli_decoder* dec = getJpegHandle();
+		int scansUsed;
+		bool admitted = admit(desiredWidth, desiredHeight, 0);
+		try
+		{
+			pin_ptr<Byte> pinnedInput = nullptr;
+			if (jpegBuf != nullptr)
+				pinnedInput = &jpegBuf[0];
+			const unsigned char* input = jpegBuf != nullptr ? pinnedInput : beginRead();
+			pin_ptr<Byte> pinnedOutput = &dstBuf[0];
+
+			if (tjcliDecompressPreview(dec, input, (unsigned long)jpegBufSize, &pinnedOutput[(int)(y * actualPitch) + x * tjPixelSize[(int)pixelFormat]], desiredWidth, (int)actualPitch, desiredHeight, (int)pixelFormat, (int)flags, maxScans, (unsigned long)maxBytes, &scansUsed) == -1)
+				throw sourceError(dec);
+		}
+		finally
+		{
+			if (admitted)
+				releaseReservation();
+		}
+		return scansUsed;
+	}
+
+	/// <summary>
+	/// Decompress a rough preview of the progressive JPEG source image associated with
+	/// this decompressor instance, using only its first <code>maxScans</code> scans, and
+	/// return a new buffer containing the preview.  Images which are not progressive are
+	/// decompressed in full.
+	/// </summary>
+	///
+	/// <param name="desiredWidth">desired width (in pixels) of the preview, as in
+	/// decompress().  Setting this to 0 is the same as setting it to the width of the
+	/// JPEG image.</param>
+	///
+	/// <param name="desiredHeight">desired height (in pixels) of the preview, as in
+	/// decompress().  Setting this to 0 is the same as setting it to the height of the
+	/// JPEG image.</param>
+	///
+	/// <param name="pixelFormat">pixel format of the preview (one of
+	/// the turbojpegCLI.PixelFormat enum values)</param>
+	///
+	/// <param name="maxScans">the number of scans to use, or 0 for no limit</param>
+	array<Byte>^ TJDecompressor::decompressPreview(int desiredWidth, int desiredHeight, PixelFormat pixelFormat, int maxScans)
+	{
+		TJ::checkPixelFormat(pixelFormat);
+		int scaledWidth = getScaledWidth(desiredWidth, desiredHeight);
+		int scaledHeight = getScaledHeight(desiredWidth, desiredHeight);
+		int arraySize = TJMemoryBudget::checkBufferSize((long long)scaledWidth * scaledHeight * tjPixelSize[(int)pixelFormat]);
+		bool admitted = admit(desiredWidth, desiredHeight, arraySize);
+		try
+		{
+			array<Byte>^ dstBuf = allocBuffer(arraySize);
+			decompressPreview(dstBuf, 0, 0, desiredWidth, 0, desiredHeight, pixelFormat, Flag::NONE, maxScans, 0);
+			return dstBuf;
+		}
+		finally
+		{
+			if (admitted)
+				releaseReservation();
+		}
+	}
 }
\ No newline at end of file
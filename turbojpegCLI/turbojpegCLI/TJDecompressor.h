@@ -3,9 +3,58 @@
 #include "turbojpeg.h"
 #pragma warning( default : 4635 )
 #include "TJ.h"
+#include "jpegnative.h"
+#include "TJMemoryStats.h"
+#include "TJBufferPool.h"
+#include "TJMemoryBudget.h"
+#include "NativeImage.h"
 using namespace System;
+using namespace System::IO;
+using namespace System::IO::MemoryMappedFiles;
+using namespace System::Runtime::InteropServices;
 namespace turbojpegCLI
 {
+	/// <summary>
+	/// The native tjcli_read_func, which reads a chunk of a JPEG image from a Stream.
+	/// </summary>
+	[UnmanagedFunctionPointer(CallingConvention::Cdecl)]
+	delegate int TJReadChunkCallback(IntPtr buffer, int size);
+
+	/// <summary>
+	/// The outcome of TJDecompressor.tryDecompress().
+	/// </summary>
+	public value struct TJDecompressStatus
+	{
+		/// <summary>
+		/// True if every row was decoded.  Corrupt data does not make this false, because
+		/// libjpeg decodes around it; check corruptMcuCount to see whether the image is intact.
+		/// </summary>
+		bool succeeded;
+		/// <summary>
+		/// The number of rows of the destination image which were decoded (counted from the
+		/// bottom if the BOTTOMUP flag was set).
+		/// </summary>
+		int rowsDecoded;
+		/// <summary>
+		/// The number of warnings libjpeg issued, mostly about corrupt or truncated data.
+		/// </summary>
+		int warningCount;
+		/// <summary>
+		/// An estimate of the number of MCUs (blocks of 8x8 to 16x16 pixels) which were lost to
+		/// corrupt or missing data and appear as flat gray.  This is measured from the start of
+		/// the MCU row where each problem was found to the restart marker where decoding resumed.
+		/// </summary>
+		long long corruptMcuCount;
+		/// <summary>
+		/// The error which stopped the decode, or null if it ran to the end.
+		/// </summary>
+		String^ errorMessage;
+		/// <summary>
+		/// The text of the first warning, or null if there were none.
+		/// </summary>
+		String^ warningMessage;
+	};
+
 	/// <summary>
 	/// TurboJPEG decompressor
 	/// </summary>
@@ -13,27 +62,72 @@ namespace turbojpegCLI
 	{
 	private:
 		String^ NO_ASSOC_ERROR;
-		tjhandle handle;
+		tjcli_decoder* jpegHandle;
 		array<Byte>^ jpegBuf;
 		int jpegBufSize;
 		int jpegWidth;
 		int jpegHeight;
 		SubsamplingOption jpegSubsamp;
 		Colorspace jpegColorspace;
+		TJBufferPool^ bufferPool;
+		TJMemoryBudget^ memoryBudget;
+		TJMemoryBudget^ reservedFrom;
+		long long reservedBytes;
+		Stream^ srcStream;
+		long long srcStreamStart;
+		int streamChunkSize;
+		array<Byte>^ streamChunk;
+		GCHandle streamChunkPin;
+		Exception^ streamError;
+		TJReadChunkCallback^ readChunkCallback;
+		tjcli_read_func readChunkFunc;
+		MemoryMappedFile^ mappedFile;
+		MemoryMappedViewAccessor^ mappedView;
+		unsigned char* mappedData;
 		bool isDisposed;
 		!TJDecompressor();
 
 		void Initialize()
 		{
 			NO_ASSOC_ERROR = "No JPEG image is associated with this instance";
-			handle = 0;
+			jpegHandle = 0;
 			jpegBufSize = 0;
 			jpegWidth = 0;
 			jpegHeight = 0;
 			jpegSubsamp = (SubsamplingOption)-1;
 			jpegColorspace = (Colorspace)-1;
+			bufferPool = nullptr;
+			memoryBudget = nullptr;
+			reservedFrom = nullptr;
+			reservedBytes = 0;
+			srcStream = nullptr;
+			srcStreamStart = 0;
+			streamChunkSize = 65536;
+			streamChunk = nullptr;
+			streamError = nullptr;
+			readChunkCallback = nullptr;
+			readChunkFunc = NULL;
+			mappedFile = nullptr;
+			mappedView = nullptr;
+			mappedData = NULL;
 			isDisposed = false;
 		}
+
+		tjcli_decoder* getJpegHandle();
+		array<Byte>^ allocBuffer(int length);
+		void readHeader(const unsigned char* jpegData, int imageSize);
+		void releaseSource();
+		const unsigned char* beginRead();
+		Exception^ sourceError(tjcli_decoder* dec);
+		static TJDecompressStatus failedStatus(String^ message);
+		int readChunk(IntPtr buffer, int size);
+		long long estimateMemory(int scaledWidth, int scaledHeight, long long outputBytes);
+		bool admitToFit(int% width, int% height, int pixelSize);
+	internal:
+		bool admit(int desiredWidth, int desiredHeight, long long outputBytes);
+		void releaseReservation();
+		void setCancelRequested(bool cancel);
+		array<Byte>^ decompressToFit(int% width, int% height, PixelFormat pixelFormat, Flag flags);
 	public:
 
 		TJDecompressor();
@@ -42,6 +136,13 @@ namespace turbojpegCLI
 		~TJDecompressor();
 
 		void setSourceImage(array<Byte>^ jpegImage, int imageSize);
+		bool trySetSourceImage(array<Byte>^ jpegImage, int imageSize);
+		void setSourceImage(Stream^ stream);
+		void setSourceFile(String^ path);
+		static TJDecompressor^ fromFile(String^ path);
+		void setStreamChunkSize(int size);
+		int getStreamChunkSize();
+		void setTables(array<Byte>^ tables);
 
 		int getWidth();
 		int getHeight();
@@ -49,6 +150,14 @@ namespace turbojpegCLI
 		Colorspace getColorspace();
 		array<Byte>^ getJPEGBuf();
 		int getJPEGSize();
+		int getWarningCount();
+		String^ getWarningMessage();
+		TJMemoryStats getMemoryStats();
+		void setBufferPool(TJBufferPool^ pool);
+		TJBufferPool^ getBufferPool();
+		void setMemoryBudget(TJMemoryBudget^ budget);
+		TJMemoryBudget^ getMemoryBudget();
+		long long getMemoryEstimate(int desiredWidth, int desiredHeight, PixelFormat pixelFormat);
 
 		int getScaledWidth(int desiredWidth, int desiredHeight);
 		int getScaledHeight(int desiredWidth, int desiredHeight);
@@ -60,5 +169,19 @@ namespace turbojpegCLI
 		array<Byte>^ decompress(int desiredWidth, int pitch, int desiredHeight, PixelFormat pixelFormat, Flag flags);
 		array<Byte>^ decompress(PixelFormat pixelFormat, Flag flags);
 		array<Byte>^ decompress();
+
+		void decompress(NativeImage^ dstImage, Flag flags);
+		NativeImage^ decompressToNativeImage(int desiredWidth, int desiredHeight, PixelFormat pixelFormat, Flag flags);
+
+		TJDecompressStatus tryDecompress(array<Byte>^ dstBuf, int x, int y, int desiredWidth, int pitch, int desiredHeight, PixelFormat pixelFormat, Flag flags);
+		TJDecompressStatus tryDecompress(array<Byte>^ dstBuf, PixelFormat pixelFormat, Flag flags);
+
+		void decompressLuma(array<Byte>^ dstBuf, int x, int y, int pitch, Flag flags);
+		void decompressLuma(array<Byte>^ dstBuf);
+		array<Byte>^ decompressLuma(Flag flags);
+		array<Byte>^ decompressLuma();
+
+		int decompressPreview(array<Byte>^ dstBuf, int x, int y, int desiredWidth, int pitch, int desiredHeight, PixelFormat pixelFormat, Flag flags, int maxScans, int maxBytes);
+		array<Byte>^ decompressPreview(int desiredWidth, int desiredHeight, PixelFormat pixelFormat, int maxScans);
 	};
 }
@@ -1,10 +1,24 @@
 #pragma once
+#include "jpegnative.h"
+#include "stringconvert.h"
 using namespace System;
 
 namespace turbojpegCLI
 {
 	public ref class TJException : public Exception
 	{
+	private:
+		String^ phase;
+		int warningCount;
+		String^ warningMessage;
+
+		static String^ getMessage(const tjcli_error_mgr* err)
+		{
+			String^ msg = getSystemString(err->message);
+			if (err->phase == nullptr)
+				return msg;
+			return msg + " (while " + getSystemString(err->phase) + ")";
+		}
 	public:
 		TJException() : Exception()
 		{
@@ -12,5 +26,39 @@ namespace turbojpegCLI
 		TJException(String^ msg) : Exception(msg)
 		{
 		}
+
+		/// <summary>
+		/// Returns the step of the operation which failed, such as "reading the JPEG header"
+		/// or "decompressing", or null if it is not known.
+		/// </summary>
+		String^ getPhase()
+		{
+			return phase;
+		}
+		/// <summary>
+		/// Returns the number of warnings libjpeg issued during the failed operation.
+		/// </summary>
+		int getWarningCount()
+		{
+			return warningCount;
+		}
+		/// <summary>
+		/// Returns the text of the first warning issued during the failed operation, or null.
+		/// </summary>
+		String^ getWarningMessage()
+		{
+			return warningMessage;
+		}
+	internal:
+		/// <summary>
+		/// Creates an exception from the error context of a libjpeg handle.  The context
+		/// belongs to the handle, so this is correct no matter what other threads are doing.
+		/// </summary>
+		TJException(const tjcli_error_mgr* err) : Exception(getMessage(err))
+		{
+			phase = err->phase == nullptr ? nullptr : getSystemString(err->phase);
+			warningCount = (int)err->pub.num_warnings;
+			warningMessage = err->pub.num_warnings > 0 ? getSystemString(err->warning) : nullptr;
+		}
 	};
 }
@@ -0,0 +1,357 @@
+#include "TJFrameSkipper.h"
+#include "TJException.h"
+
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>Constructs a TJFrameSkipper.  Pass each frame of a stream to decompress() in order.
+	/// Use one instance per stream.</para>
+	/// <para>By default frames are decoded to BGR at full size, and only exact matches are skipped.</para>
+	/// </summary>
+	TJFrameSkipper::TJFrameSkipper()
+	{
+		Initialize();
+		decompressor = gcnew TJDecompressor();
+	}
+
+	/// <summary>
+	/// Call this when finished with the TJFrameSkipper to free any native structures.
+	/// If you use a C# using() block, you won't need to call this.
+	/// </summary>
+	TJFrameSkipper::~TJFrameSkipper()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+
+		this->!TJFrameSkipper();
+		delete decompressor;
+		isDisposed = true;
+	}
+	TJFrameSkipper::!TJFrameSkipper()
+	{
+		// This is the Finalizer, for disposing of unmanaged data.
+		tjcliDestroyDecoder(handle);
+		handle = 0;
+	}
+
+	/// <summary>
+	/// Sets the pixel format frames are decoded to.  Changing this discards the last decoded
+	/// frame, so the next frame is always decoded.  Default value if unset: BGR
+	/// </summary>
+	void TJFrameSkipper::setPixelFormat(PixelFormat pixelFormat)
+	{
+		if ((int)pixelFormat < 0 || (int)pixelFormat >= TJ::NUMPF)
+			throw gcnew ArgumentException("Invalid argument in setPixelFormat()");
+		if (pixelFormat != this->pixelFormat)
+			reset();
+		this->pixelFormat = pixelFormat;
+	}
+
+	/// <summary>
+	/// Gets the pixel format frames are decoded to.
+	/// </summary>
+	PixelFormat TJFrameSkipper::getPixelFormat()
+	{
+		return pixelFormat;
+	}
+
+	/// <summary>
+	/// Sets the decompression flags.  Changing this discards the last decoded frame, so the
+	/// next frame is always decoded.  Default value if unset: NONE
+	/// </summary>
+	void TJFrameSkipper::setFlags(Flag flags)
+	{
+		if (flags != this->flags)
+			reset();
+		this->flags = flags;
+	}
+
+	/// <summary>
+	/// Gets the decompression flags.
+	/// </summary>
+	Flag TJFrameSkipper::getFlags()
+	{
+		return flags;
+	}
+
+	/// <summary>
+	/// Sets the size frames should be scaled down to, as in TJDecompressor.decompress().  Pass 0
+	/// for either dimension to leave it unconstrained.  Changing this discards the last decoded
+	/// frame, so the next frame is always decoded.  Default value if unset: 0, 0 (full size)
+	/// </summary>
+	void TJFrameSkipper::setDesiredSize(int desiredWidth, int desiredHeight)
+	{
+		if (desiredWidth < 0 || desiredHeight < 0)
+			throw gcnew ArgumentException("Invalid argument in setDesiredSize()");
+		if (desiredWidth != this->desiredWidth || desiredHeight != this->desiredHeight)
+			reset();
+		this->desiredWidth = desiredWidth;
+		this->desiredHeight = desiredHeight;
+	}
+
+	/// <summary>
+	/// <para>Sets the threshold for skipping frames which are nearly identical to the last
+	/// decoded frame.  A frame is skipped if the average brightness of every 8x8 luma block
+	/// differs from the last decoded frame by less than this many 8-bit luma levels.  0
+	/// disables near-match skipping, so only exact matches are skipped.</para>
+	/// <para>Near-match checks entropy decode each frame that is not an exact match, which
+	/// costs a substantial fraction of a full decode, so this pays off only when most frames are
+	/// skipped.  Because frames are compared with the last decoded frame rather than the
+	/// previous frame, slow changes accumulate until a frame is decoded.</para>
+	/// <para>Default value if unset: 0</para>
+	/// </summary>
+	void TJFrameSkipper::setNearMatchThreshold(float threshold)
+	{
+		if (threshold < 0)
+			throw gcnew ArgumentException("Invalid argument in setNearMatchThreshold()");
+		if (threshold != nearMatchThreshold)
+			reset();
+		nearMatchThreshold = threshold;
+	}
+
+	/// <summary>
+	/// Gets the threshold for skipping nearly identical frames.
+	/// </summary>
+	float TJFrameSkipper::getNearMatchThreshold()
+	{
+		return nearMatchThreshold;
+	}
+
+	/// <summary>
+	/// Reads the DC coefficient of every luma block into features.  Returns false if the frame
+	/// cannot be entropy decoded, in which case it is decoded normally (and fails there).
+	/// </summary>
+	bool TJFrameSkipper::readFeatures(array<Byte>^ jpegImage, int imageSize, int* blocksWide, int* blocksHigh)
+	{
+		if (handle == 0)
+		{
+			handle = tjcliInitDecoder();
+			if (handle == nullptr)
+				throw gcnew TJException("Unable to create a libjpeg decompressor");
+		}
+		pin_ptr<Byte> pinnedJpegImage = &jpegImage[0];
+		// Reading the coefficients keeps every block of the image in memory, so that is
+		// reserved from the budget first, from the header's dimensions.
+		int jpegWidth, jpegHeight;
+		if (tjcliDecompressHeader(handle, pinnedJpegImage, (unsigned long)imageSize, &jpegWidth, &jpegHeight) == -1)
+			return false;
+		long long blocks = (long long)((jpegWidth + DCTSIZE - 1) / DCTSIZE) * ((jpegHeight + DCTSIZE - 1) / DCTSIZE);
+		long long bytes = blocks * (DCTSIZE2 * sizeof(JCOEF) * handle->cinfo.num_components + sizeof(float));
+		TJMemoryBudget^ budget = decompressor->getMemoryBudget();
+		budget->reserve(bytes, false);
+		try
+		{
+			if (tjcliReadCoefficients(handle, pinnedJpegImage, (unsigned long)imageSize) == -1
+				|| tjcliGetBlockDimensions(handle, 0, blocksWide, blocksHigh) == -1)
+				return false;
+			int numBlocks = *blocksWide * *blocksHigh;
+			if (features == nullptr || features->Length != numBlocks)
+				features = gcnew array<float>(numBlocks);
+			pin_ptr<float> pinnedFeatures = &features[0];
+			return tjcliGetLumaFeatures(handle, 0, pinnedFeatures) != -1;
+		}
+		finally
+		{
+			budget->release(bytes);
+		}
+	}
+
+	/// <summary>
+	/// <para>Decompresses a frame, or returns the last decoded frame's pixels if this frame
+	/// shows the same image (see wasLastFrameSkipped()).  Use getWidth(), getHeight() and
+	/// getPitch() to interpret the pixels.</para>
+	/// <para>The returned buffer belongs to this instance and is overwritten by the next frame
+	/// that is decoded, so copy it if you need to keep it.</para>
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	///
+	/// <param name="imageSize">The length of the image data in the array.</param>
+	///
+	/// <returns>the decoded pixels</returns>
+	array<Byte>^ TJFrameSkipper::decompress(array<Byte>^ jpegImage, int imageSize)
+	{
+		if (jpegImage == nullptr || imageSize < 1)
+			throw gcnew ArgumentException("Invalid argument in decompress()");
+		if (jpegImage->Length < imageSize)
+			throw gcnew Exception("Source buffer is not large enough");
+
+		framesProcessed++;
+		unsigned long long hash;
+		{
+			pin_ptr<Byte> pinnedJpegImage = &jpegImage[0];
+			hash = tjcliHashJpeg(pinnedJpegImage, (size_t)imageSize);
+		}
+		if (hasReference && hash == referenceHash)
+		{
+			exactMatches++;
+			lastFrameSkipped = true;
+			return pixels;
+		}
+
+		bool haveFeatures = false;
+		int blocksWide = 0, blocksHigh = 0;
+		if (nearMatchThreshold > 0)
+		{
+			haveFeatures = readFeatures(jpegImage, imageSize, &blocksWide, &blocksHigh);
+			if (haveFeatures && hasReference && referenceFeatures != nullptr
+				&& blocksWide == referenceBlocksWide && blocksHigh == referenceBlocksHigh)
+			{
+				bool nearMatch = true;
+				for (int i = 0; i < features->Length; i++)
+				{
+					if (Math::Abs(features[i] - referenceFeatures[i]) >= nearMatchThreshold)
+					{
+						nearMatch = false;
+						break;
+					}
+				}
+				if (nearMatch)
+				{
+					nearMatches++;
+					lastFrameSkipped = true;
+					return pixels;
+				}
+			}
+		}
+
+		hasReference = false;
+		decompressor->setSourceImage(jpegImage, imageSize);
+		width = decompressor->getScaledWidth(desiredWidth, desiredHeight);
+		height = decompressor->getScaledHeight(desiredWidth, desiredHeight);
+		int arraySize = TJMemoryBudget::checkBufferSize((long long)width * TJ::getPixelSize(pixelFormat) * height);
+		pitch = width * TJ::getPixelSize(pixelFormat);
+		// The buffer is counted in the decompressor's reservation, which decompress() then
+		// shares, so the budget is checked before the buffer is allocated.
+		bool admitted = decompressor->admit(desiredWidth, desiredHeight, arraySize);
+		try
+		{
+			if (pixels == nullptr || pixels->Length != arraySize)
+				pixels = gcnew array<Byte>(arraySize);
+			decompressor->decompress(pixels, 0, 0, desiredWidth, pitch, desiredHeight, pixelFormat, flags);
+		}
+		finally
+		{
+			if (admitted)
+				decompressor->releaseReservation();
+		}
+
+		referenceHash = hash;
+		if (haveFeatures)
+		{
+			// Swap rather than copy; the old reference becomes the next feature buffer.
+			array<float>^ tmp = referenceFeatures;
+			referenceFeatures = features;
+			features = tmp;
+			referenceBlocksWide = blocksWide;
+			referenceBlocksHigh = blocksHigh;
+		}
+		else
+			referenceFeatures = nullptr;
+		hasReference = true;
+		lastFrameSkipped = false;
+		return pixels;
+	}
+
+	/// <summary>
+	/// <para>Decompresses a frame, or returns the last decoded frame's pixels if this frame
+	/// shows the same image (see wasLastFrameSkipped()).  Use getWidth(), getHeight() and
+	/// getPitch() to interpret the pixels.</para>
+	/// <para>The returned buffer belongs to this instance and is overwritten by the next frame
+	/// that is decoded, so copy it if you need to keep it.</para>
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	///
+	/// <returns>the decoded pixels</returns>
+	array<Byte>^ TJFrameSkipper::decompress(array<Byte>^ jpegImage)
+	{
+		if (jpegImage == nullptr)
+			throw gcnew ArgumentException("Invalid argument in decompress()");
+		return decompress(jpegImage, jpegImage->Length);
+	}
+
+	/// <summary>
+	/// Discards the last decoded frame, so the next frame passed to decompress() is always decoded.
+	/// </summary>
+	void TJFrameSkipper::reset()
+	{
+		hasReference = false;
+		referenceFeatures = nullptr;
+		lastFrameSkipped = false;
+	}
+
+	/// <summary>
+	/// Returns true if the most recent call to decompress() returned the previous pixels
+	/// instead of decoding.
+	/// </summary>
+	bool TJFrameSkipper::wasLastFrameSkipped()
+	{
+		return lastFrameSkipped;
+	}
+
+	/// <summary>
+	/// Returns the width of the decoded pixels.
+	/// </summary>
+	int TJFrameSkipper::getWidth()
+	{
+		if (pixels == nullptr)
+			throw gcnew Exception("No frames have been decoded by this instance");
+		return width;
+	}
+
+	/// <summary>
+	/// Returns the height of the decoded pixels.
+	/// </summary>
+	int TJFrameSkipper::getHeight()
+	{
+		if (pixels == nullptr)
+			throw gcnew Exception("No frames have been decoded by this instance");
+		return height;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes per row of the decoded pixels.
+	/// </summary>
+	int TJFrameSkipper::getPitch()
+	{
+		if (pixels == nullptr)
+			throw gcnew Exception("No frames have been decoded by this instance");
+		return pitch;
+	}
+
+	/// <summary>
+	/// Returns the number of frames passed to decompress().
+	/// </summary>
+	long long TJFrameSkipper::getFramesProcessed()
+	{
+		return framesProcessed;
+	}
+
+	/// <summary>
+	/// Returns the number of frames that were not decoded because they matched the last
+	/// decoded frame, exactly or nearly.
+	/// </summary>
+	long long TJFrameSkipper::getDecodesAvoided()
+	{
+		return exactMatches + nearMatches;
+	}
+
+	/// <summary>
+	/// Returns the number of frames skipped because their image data hashed the same as the
+	/// last decoded frame.
+	/// </summary>
+	long long TJFrameSkipper::getExactMatches()
+	{
+		return exactMatches;
+	}
+
+	/// <summary>
+	/// Returns the number of frames skipped by the near-match threshold.
+	/// </summary>
+	long long TJFrameSkipper::getNearMatches()
+	{
+		return nearMatches;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "TJ.h"
+#include "TJDecompressor.h"
+#include "jpegnative.h"
+#include "mjpegnative.h"
+using namespace System;
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>Decompresses the frames of a stream, skipping the decode when a frame shows
+	/// the same image as the last decoded frame.  Each frame's image data is hashed (which
+	/// costs a tiny fraction of a decode), and on a match the previously decoded pixels are
+	/// returned as is.  Frames that differ only in metadata, such as an EXIF timestamp,
+	/// still match.</para>
+	/// <para>Optionally, frames whose 8x8 block averages are all within a threshold of the
+	/// last decoded frame are also skipped, which catches static scenes that the encoder
+	/// produces slightly different bytes for each time.</para>
+	/// <para>Decoding a frame, and reading its coefficients for the near-match test,
+	/// reserves the estimated memory from the decompressor's TJMemoryBudget (the shared
+	/// budget) first, so a frame whose header claims a huge image is rejected with a
+	/// TJException.</para>
+	/// </summary>
+	public ref class TJFrameSkipper
+	{
+	private:
+		TJDecompressor^ decompressor;
+		tjcli_decoder* handle;
+		array<Byte>^ pixels;
+		array<float>^ features;
+		array<float>^ referenceFeatures;
+		int referenceBlocksWide;
+		int referenceBlocksHigh;
+		unsigned long long referenceHash;
+		bool hasReference;
+		int width;
+		int height;
+		int pitch;
+		PixelFormat pixelFormat;
+		Flag flags;
+		int desiredWidth;
+		int desiredHeight;
+		float nearMatchThreshold;
+		bool lastFrameSkipped;
+		long long framesProcessed;
+		long long exactMatches;
+		long long nearMatches;
+		bool isDisposed;
+		!TJFrameSkipper();
+
+		void Initialize()
+		{
+			handle = 0;
+			referenceBlocksWide = 0;
+			referenceBlocksHigh = 0;
+			referenceHash = 0;
+			hasReference = false;
+			width = 0;
+			height = 0;
+			pitch = 0;
+			pixelFormat = PixelFormat::BGR;
+			flags = Flag::NONE;
+			desiredWidth = 0;
+			desiredHeight = 0;
+			nearMatchThreshold = 0;
+			lastFrameSkipped = false;
+			framesProcessed = 0;
+			exactMatches = 0;
+			nearMatches = 0;
+			isDisposed = false;
+		}
+
+		bool readFeatures(array<Byte>^ jpegImage, int imageSize, int* blocksWide, int* blocksHigh);
+	public:
+
+		TJFrameSkipper();
+		~TJFrameSkipper();
+
+		void setPixelFormat(PixelFormat pixelFormat);
+		PixelFormat getPixelFormat();
+		void setFlags(Flag flags);
+		Flag getFlags();
+		void setDesiredSize(int desiredWidth, int desiredHeight);
+		void setNearMatchThreshold(float threshold);
+		float getNearMatchThreshold();
+
+		array<Byte>^ decompress(array<Byte>^ jpegImage, int imageSize);
+		array<Byte>^ decompress(array<Byte>^ jpegImage);
+		void reset();
+
+		bool wasLastFrameSkipped();
+		int getWidth();
+		int getHeight();
+		int getPitch();
+		long long getFramesProcessed();
+		long long getDecodesAvoided();
+		long long getExactMatches();
+		long long getNearMatches();
+	};
+}
@@ -0,0 +1,200 @@
+#include "TJHashIndex.h"
+#include "TJPerceptualHash.h"
+
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// Constructs an empty TJHashIndex.
+	/// </summary>
+	TJHashIndex::TJHashIndex()
+	{
+		hashes = gcnew List<UInt64>();
+		indexedCount = -1;
+	}
+
+	/// <summary>
+	/// Constructs an empty TJHashIndex with room for <code>capacity</code> hashes before it needs to grow.
+	/// </summary>
+	TJHashIndex::TJHashIndex(int capacity)
+	{
+		if (capacity < 0)
+			throw gcnew ArgumentException("Invalid argument in TJHashIndex()");
+		hashes = gcnew List<UInt64>(capacity);
+		indexedCount = -1;
+	}
+
+	/// <summary>
+	/// Adds a hash to the index.
+	/// </summary>
+	///
+	/// <returns>the position of the new entry.  Positions are assigned sequentially from 0 in
+	/// the order hashes are added, and are what the lookup methods return.</returns>
+	int TJHashIndex::add(UInt64 hash)
+	{
+		hashes->Add(hash);
+		return hashes->Count - 1;
+	}
+
+	/// <summary>
+	/// Adds several hashes to the index, such as the result of TJPerceptualHash.computeHashes().
+	/// The first one is assigned position getCount() (as it was before this call), and so on.
+	/// </summary>
+	void TJHashIndex::addRange(array<UInt64>^ newHashes)
+	{
+		if (newHashes == nullptr)
+			throw gcnew ArgumentException("Invalid argument in addRange()");
+		hashes->AddRange(newHashes);
+	}
+
+	/// <summary>
+	/// Returns the number of hashes in the index.
+	/// </summary>
+	int TJHashIndex::getCount()
+	{
+		return hashes->Count;
+	}
+
+	/// <summary>
+	/// Returns the hash stored at the given position.
+	/// </summary>
+	UInt64 TJHashIndex::getHash(int index)
+	{
+		if (index < 0 || index >= hashes->Count)
+			throw gcnew ArgumentException("Invalid argument in getHash()");
+		return hashes[index];
+	}
+
+	/// <summary>
+	/// Removes all hashes from the index.
+	/// </summary>
+	void TJHashIndex::clear()
+	{
+		hashes->Clear();
+		bucketStart = nullptr;
+		bucketEntries = nullptr;
+		indexedCount = -1;
+	}
+
+	/// <summary>
+	/// Finds every hash in the index within <code>maxDistance</code> bits of the given hash.
+	/// </summary>
+	///
+	/// <param name="hash">the hash to look up</param>
+	///
+	/// <param name="maxDistance">the largest Hamming distance to accept (0 to 64).  Near
+	/// duplicates typically lie within 6 to 10 bits of each other.</param>
+	///
+	/// <returns>the positions of the matching entries, in ascending order</returns>
+	List<int>^ TJHashIndex::findNear(UInt64 hash, int maxDistance)
+	{
+		if (maxDistance < 0 || maxDistance > 64)
+			throw gcnew ArgumentException("Invalid argument in findNear()");
+		List<int>^ results = gcnew List<int>();
+		int maxChunkDistance = maxDistance / NUM_CHUNKS;
+		if (maxChunkDistance > 2)
+		{
+			// Enumerating chunk variants would cost more than looking at every entry.
+			for (int i = 0; i < hashes->Count; i++)
+				if (TJPerceptualHash::hammingDistance(hash, hashes[i]) <= maxDistance)
+					results->Add(i);
+			return results;
+		}
+		if (indexedCount != hashes->Count)
+			buildTables();
+		for (int c = 0; c < NUM_CHUNKS; c++)
+			probeVariants(hash, c, chunkOf(hash, c), 0, maxChunkDistance, maxDistance, maxChunkDistance, results);
+		results->Sort();
+		return results;
+	}
+
+	/// <summary>
+	/// Finds the hash in the index closest to the given hash.
+	/// </summary>
+	///
+	/// <param name="hash">the hash to look up</param>
+	///
+	/// <param name="maxDistance">the largest Hamming distance to accept (0 to 64)</param>
+	///
+	/// <returns>the position of the closest entry (the lowest position if there is a tie), or
+	/// -1 if no entry is within <code>maxDistance</code> bits.</returns>
+	int TJHashIndex::findNearest(UInt64 hash, int maxDistance)
+	{
+		List<int>^ candidates = findNear(hash, maxDistance);
+		int best = -1, bestDistance = Int32::MaxValue;
+		for (int i = 0; i < candidates->Count; i++)
+		{
+			int distance = TJPerceptualHash::hammingDistance(hash, hashes[candidates[i]]);
+			if (distance < bestDistance)
+			{
+				best = candidates[i];
+				bestDistance = distance;
+			}
+		}
+		return best;
+	}
+
+	void TJHashIndex::buildTables()
+	{
+		// One counting sort per chunk position: bucketEntries[c] holds the positions of all
+		// entries, grouped by the value of chunk c, and bucketStart[c][v] is where the
+		// group for value v begins.
+		int n = hashes->Count;
+		bucketStart = gcnew array<array<int>^>(NUM_CHUNKS);
+		bucketEntries = gcnew array<array<int>^>(NUM_CHUNKS);
+		array<int>^ next = gcnew array<int>(CHUNK_VALUES);
+		for (int c = 0; c < NUM_CHUNKS; c++)
+		{
+			array<int>^ start = gcnew array<int>(CHUNK_VALUES + 1);
+			for (int i = 0; i < n; i++)
+				start[chunkOf(hashes[i], c) + 1]++;
+			for (int v = 0; v < CHUNK_VALUES; v++)
+				start[v + 1] += start[v];
+			Array::Copy(start, next, CHUNK_VALUES);
+			array<int>^ entries = gcnew array<int>(n);
+			for (int i = 0; i < n; i++)
+				entries[next[chunkOf(hashes[i], c)]++] = i;
+			bucketStart[c] = start;
+			bucketEntries[c] = entries;
+		}
+		indexedCount = n;
+	}
+
+	int TJHashIndex::chunkOf(UInt64 hash, int chunk)
+	{
+		return (int)((hash >> (16 * chunk)) & 0xFFFF);
+	}
+
+	int TJHashIndex::chunkDistance(UInt64 hash1, UInt64 hash2, int chunk)
+	{
+		return TJPerceptualHash::hammingDistance((UInt64)chunkOf(hash1, chunk), (UInt64)chunkOf(hash2, chunk));
+	}
+
+	void TJHashIndex::probeVariants(UInt64 hash, int chunk, int value, int firstBit, int flipsLeft, int maxDistance, int maxChunkDistance, List<int>^ results)
+	{
+		// Visits every chunk value within flipsLeft bits of value exactly once.
+		probe(hash, chunk, value, maxDistance, maxChunkDistance, results);
+		if (flipsLeft == 0)
+			return;
+		for (int bit = firstBit; bit < 16; bit++)
+			probeVariants(hash, chunk, value ^ (1 << bit), bit + 1, flipsLeft - 1, maxDistance, maxChunkDistance, results);
+	}
+
+	void TJHashIndex::probe(UInt64 hash, int chunk, int value, int maxDistance, int maxChunkDistance, List<int>^ results)
+	{
+		array<int>^ start = bucketStart[chunk];
+		array<int>^ entries = bucketEntries[chunk];
+		for (int e = start[value]; e < start[value + 1]; e++)
+		{
+			int i = entries[e];
+			UInt64 candidate = hashes[i];
+			if (TJPerceptualHash::hammingDistance(hash, candidate) > maxDistance)
+				continue;
+			// A candidate that is also close in an earlier chunk was already reported there.
+			bool reported = false;
+			for (int c = 0; c < chunk && !reported; c++)
+				reported = chunkDistance(hash, candidate, c) <= maxChunkDistance;
+			if (!reported)
+				results->Add(i);
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+using namespace System;
+using namespace System::Collections::Generic;
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>An index of 64-bit perceptual hashes which finds all hashes within a given
+	/// Hamming distance of a query without comparing against every entry.</para>
+	/// <para>This uses multi-index hashing: each hash is split into four 16-bit chunks,
+	/// and each chunk position has its own lookup table.  Two hashes within distance d of
+	/// each other must have at least one chunk within distance d / 4, so only entries
+	/// sharing a nearby chunk value are examined.  Lookups are very fast for distances up
+	/// to 11; larger distances fall back to a linear scan.</para>
+	/// <para>The tables are rebuilt on the first lookup after entries are added, so add
+	/// entries in bulk before querying.  Instances are not thread safe for concurrent
+	/// modification, but concurrent lookups are safe once the tables are built.</para>
+	/// </summary>
+	public ref class TJHashIndex
+	{
+	private:
+		static const int NUM_CHUNKS = 4;
+		static const int CHUNK_VALUES = 65536;
+		List<UInt64>^ hashes;
+		array<array<int>^>^ bucketStart;
+		array<array<int>^>^ bucketEntries;
+		int indexedCount;
+
+		void buildTables();
+		static int chunkOf(UInt64 hash, int chunk);
+		static int chunkDistance(UInt64 hash1, UInt64 hash2, int chunk);
+		void probe(UInt64 hash, int chunk, int value, int maxDistance, int maxChunkDistance, List<int>^ results);
+		void probeVariants(UInt64 hash, int chunk, int value, int firstBit, int flipsLeft, int maxDistance, int maxChunkDistance, List<int>^ results);
+	public:
+
+		TJHashIndex();
+		TJHashIndex(int capacity);
+
+		int add(UInt64 hash);
+		void addRange(array<UInt64>^ newHashes);
+		int getCount();
+		UInt64 getHash(int index);
+		void clear();
+
+		List<int>^ findNear(UInt64 hash, int maxDistance);
+		int findNearest(UInt64 hash, int maxDistance);
+	};
+}
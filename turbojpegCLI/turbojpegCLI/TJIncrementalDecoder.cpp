@@ -0,0 +1,321 @@
+#include "TJIncrementalDecoder.h"
+#include "TJException.h"
+
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>Constructs a TJIncrementalDecoder ready to receive an image.  Call reset() before
+	/// each further image.</para>
+	/// <para>By default images are decoded to BGR at full size, with progressive passes enabled.</para>
+	/// </summary>
+	TJIncrementalDecoder::TJIncrementalDecoder()
+	{
+		Initialize();
+		handle = tjcliInitIncremental();
+		if (handle == nullptr)
+			throw gcnew TJException("Unable to create a libjpeg decompressor");
+	}
+
+	/// <summary>
+	/// Call this when finished with the TJIncrementalDecoder to free any native structures.
+	/// If you use a C# using() block, you won't need to call this.
+	/// </summary>
+	TJIncrementalDecoder::~TJIncrementalDecoder()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+
+		this->!TJIncrementalDecoder();
+		releaseReservation();
+		isDisposed = true;
+	}
+	TJIncrementalDecoder::!TJIncrementalDecoder()
+	{
+		// This is the Finalizer, for disposing of unmanaged data.
+		tjcliDestroyIncremental(handle);
+		handle = 0;
+	}
+
+	/// <summary>
+	/// Sets the pixel format images are decoded to.  This takes effect at the next image.
+	/// Default value if unset: BGR
+	/// </summary>
+	void TJIncrementalDecoder::setPixelFormat(PixelFormat pixelFormat)
+	{
+		if ((int)pixelFormat < 0 || (int)pixelFormat >= TJ::NUMPF)
+			throw gcnew ArgumentException("Invalid argument in setPixelFormat()");
+		this->pixelFormat = pixelFormat;
+	}
+
+	/// <summary>
+	/// Gets the pixel format images are decoded to.
+	/// </summary>
+	PixelFormat TJIncrementalDecoder::getPixelFormat()
+	{
+		return pixelFormat;
+	}
+
+	/// <summary>
+	/// Sets the decompression flags.  This takes effect at the next image.  Default value if unset: NONE
+	/// </summary>
+	void TJIncrementalDecoder::setFlags(Flag flags)
+	{
+		this->flags = flags;
+	}
+
+	/// <summary>
+	/// Gets the decompression flags.
+	/// </summary>
+	Flag TJIncrementalDecoder::getFlags()
+	{
+		return flags;
+	}
+
+	/// <summary>
+	/// Sets the size images should be scaled down to, as in TJDecompressor.decompress().  Pass 0
+	/// for either dimension to leave it unconstrained.  This takes effect at the next image.
+	/// Default value if unset: 0, 0 (full size)
+	/// </summary>
+	void TJIncrementalDecoder::setDesiredSize(int desiredWidth, int desiredHeight)
+	{
+		if (desiredWidth < 0 || desiredHeight < 0)
+			throw gcnew ArgumentException("Invalid argument in setDesiredSize()");
+		this->desiredWidth = desiredWidth;
+		this->desiredHeight = desiredHeight;
+	}
+
+	/// <summary>
+	/// <para>Sets whether progressive images are output as a series of passes while their data
+	/// arrives.  Each pass decodes the whole image, so if previews are not needed, disabling
+	/// this saves that work; the image then appears in one go once all of its data has
+	/// arrived.  This takes effect at the next image.</para>
+	/// <para>Default value if unset: true</para>
+	/// </summary>
+	void TJIncrementalDecoder::setProgressivePasses(bool progressivePasses)
+	{
+		this->progressivePasses = progressivePasses;
+	}
+
+	/// <summary>
+	/// Gets whether progressive images are output as a series of passes.
+	/// </summary>
+	bool TJIncrementalDecoder::getProgressivePasses()
+	{
+		return progressivePasses;
+	}
+
+	void TJIncrementalDecoder::start()
+	{
+		if (tjcliIncrementalStart(handle, desiredWidth, desiredHeight, (int)pixelFormat, (int)flags, progressivePasses ? 1 : 0) == -1)
+			throw gcnew TJException(&handle->dec->jerr);
+		releaseReservation();
+		pixels = nullptr;
+		pitch = 0;
+		started = true;
+	}
+
+	void TJIncrementalDecoder::allocatePixels()
+	{
+		// The header came from the network, so the size is checked and the memory reserved
+		// before the buffer is allocated.
+		int width = handle->status.width, height = handle->status.height;
+		int arraySize = TJMemoryBudget::checkBufferSize((long long)width * tjcliPixelSize[handle->pixelFormat] * height);
+		jpeg_decompress_struct* cinfo = &handle->dec->cinfo;
+		long long bytes = arraySize + (long long)tjcliEstimateDecodeMemory(handle->dec, (int)cinfo->image_width, (int)cinfo->image_height, width, height);
+		TJMemoryBudget^ budget = TJMemoryBudget::getShared();
+		budget->reserve(bytes, false);
+		reservedFrom = budget;
+		reservedBytes = bytes;
+		pitch = width * tjcliPixelSize[handle->pixelFormat];
+		pixels = gcnew array<Byte>(arraySize);
+	}
+
+	void TJIncrementalDecoder::releaseReservation()
+	{
+		if (reservedFrom == nullptr)
+			return;
+		reservedFrom->release(reservedBytes);
+		reservedFrom = nullptr;
+		reservedBytes = 0;
+	}
+
+	/// <summary>
+	/// Discards the current image, so the next call to feed() begins a new image.
+	/// </summary>
+	void TJIncrementalDecoder::reset()
+	{
+		started = false;
+		releaseReservation();
+		pixels = nullptr;
+		pitch = 0;
+	}
+
+	bool TJIncrementalDecoder::decode(const unsigned char* data, size_t size, bool endOfData)
+	{
+		if (!started)
+			start();
+		int rows = handle->status.rowsDecoded;
+		int passes = handle->status.passesCompleted;
+		if (tjcliIncrementalFeed(handle, data, size, endOfData ? 1 : 0) == -1)
+			throw gcnew TJException(&handle->dec->jerr);
+		if (pixels == nullptr)
+		{
+			// The pixel buffer can only be allocated once the header has been read.
+			if (tjcliIncrementalDecode(handle, 0, 0) == -1)
+				throw gcnew TJException(&handle->dec->jerr);
+			if (handle->status.headerReady)
+				allocatePixels();
+		}
+		if (pixels != nullptr)
+		{
+			pin_ptr<Byte> pinnedPixels = &pixels[0];
+			if (tjcliIncrementalDecode(handle, pinnedPixels, pitch) == -1)
+				throw gcnew TJException(&handle->dec->jerr);
+			// libjpeg's memory is freed once the image is complete.
+			if (handle->status.complete)
+				releaseReservation();
+		}
+		return handle->status.rowsDecoded != rows || handle->status.passesCompleted != passes;
+	}
+
+	/// <summary>
+	/// Passes the next piece of the image's data to the decoder, which decodes as much as
+	/// the data received so far allows.  The data is copied, so the array can be reused.
+	/// </summary>
+	///
+	/// <param name="data">buffer containing the next piece of the JPEG image</param>
+	///
+	/// <param name="offset">index of the first byte of the piece in data</param>
+	///
+	/// <param name="count">number of bytes in the piece</param>
+	///
+	/// <returns>true if more of the image can be displayed: new rows were decoded or a
+	/// progressive pass was completed</returns>
+	bool TJIncrementalDecoder::feed(array<Byte>^ data, int offset, int count)
+	{
+		if (data == nullptr || offset < 0 || count < 0 || offset > data->Length - count)
+			throw gcnew ArgumentException("Invalid argument in feed()");
+		if (count == 0)
+			return decode(0, 0, false);
+		pin_ptr<Byte> pinnedData = &data[offset];
+		return decode(pinnedData, (size_t)count, false);
+	}
+
+	/// <summary>
+	/// Passes the next piece of the image's data to the decoder, which decodes as much as
+	/// the data received so far allows.  The data is copied, so the array can be reused.
+	/// </summary>
+	///
+	/// <param name="data">buffer containing the next piece of the JPEG image</param>
+	///
+	/// <returns>true if more of the image can be displayed: new rows were decoded or a
+	/// progressive pass was completed</returns>
+	bool TJIncrementalDecoder::feed(array<Byte>^ data)
+	{
+		if (data == nullptr)
+			throw gcnew ArgumentException("Invalid argument in feed()");
+		return feed(data, 0, data->Length);
+	}
+
+	/// <summary>
+	/// Signals that no more data will arrive.  If the image is not complete (the transfer was
+	/// cut short), the rest of it is decoded from the data received, as libjpeg does for a
+	/// truncated file, and isComplete() becomes true.
+	/// </summary>
+	///
+	/// <returns>true if more of the image can be displayed</returns>
+	bool TJIncrementalDecoder::finish()
+	{
+		if (started && handle->status.complete)
+			return false;
+		return decode(0, 0, true);
+	}
+
+	/// <summary>
+	/// Returns true once the image header has been received, after which the size of the
+	/// image and the pixel buffer are available.
+	/// </summary>
+	bool TJIncrementalDecoder::isHeaderReady()
+	{
+		return started && handle->status.headerReady != 0;
+	}
+
+	/// <summary>
+	/// Returns the width of the decoded image.
+	/// </summary>
+	int TJIncrementalDecoder::getWidth()
+	{
+		if (!isHeaderReady())
+			throw gcnew Exception("The image header has not been received");
+		return handle->status.width;
+	}
+
+	/// <summary>
+	/// Returns the height of the decoded image.
+	/// </summary>
+	int TJIncrementalDecoder::getHeight()
+	{
+		if (!isHeaderReady())
+			throw gcnew Exception("The image header has not been received");
+		return handle->status.height;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes per row in the pixel buffer.
+	/// </summary>
+	int TJIncrementalDecoder::getPitch()
+	{
+		if (!isHeaderReady())
+			throw gcnew Exception("The image header has not been received");
+		return pitch;
+	}
+
+	/// <summary>
+	/// Returns true if the image is progressive (or otherwise has multiple scans).
+	/// </summary>
+	bool TJIncrementalDecoder::isProgressive()
+	{
+		if (!isHeaderReady())
+			throw gcnew Exception("The image header has not been received");
+		return handle->status.progressive != 0;
+	}
+
+	/// <summary>
+	/// Returns the number of rows of the pixel buffer which hold decoded pixels.  For a
+	/// baseline image these are the top rows (the bottom rows if the BOTTOMUP flag is set);
+	/// for a progressive image this is the full height once the first pass is complete.
+	/// </summary>
+	int TJIncrementalDecoder::getRowsDecoded()
+	{
+		return started ? handle->status.rowsDecoded : 0;
+	}
+
+	/// <summary>
+	/// Returns the number of passes output so far.  A progressive image gets a pass whenever
+	/// one or more new scans have been received; a baseline image gets one pass when all of
+	/// its rows have been decoded.
+	/// </summary>
+	int TJIncrementalDecoder::getPassesCompleted()
+	{
+		return started ? handle->status.passesCompleted : 0;
+	}
+
+	/// <summary>
+	/// Returns true when the whole image has been decoded.
+	/// </summary>
+	bool TJIncrementalDecoder::isComplete()
+	{
+		return started && handle->status.complete != 0;
+	}
+
+	/// <summary>
+	/// Returns the pixel buffer, in which decoded rows appear as data is fed (see
+	/// getRowsDecoded()), or null before the header has been received.  The buffer belongs to
+	/// this instance until reset() is called; it is not reused for the next image.
+	/// </summary>
+	array<Byte>^ TJIncrementalDecoder::getPixels()
+	{
+		return pixels;
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "TJ.h"
+#include "TJMemoryBudget.h"
+#include "jpegnative.h"
+using namespace System;
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>Decompresses a JPEG image while its data is still arriving, such as over a slow
+	/// network link, so it can be displayed before the transfer completes.  Each piece of data
+	/// passed to feed() is decoded as far as it allows, and decoding resumes where it stopped
+	/// when the next piece arrives; nothing is decoded twice.</para>
+	/// <para>Baseline images fill in from the top, one row of MCUs at a time (see
+	/// getRowsDecoded()).  Progressive images are output as a series of passes which each
+	/// cover the whole image and get sharper as more scans arrive (see getPassesCompleted()).</para>
+	/// <para>Once the header has arrived, the image reserves its estimated memory from
+	/// TJMemoryBudget.getShared() until it is complete or reset() is called, so a header
+	/// claiming a huge image is rejected with a TJException before the buffer is allocated.</para>
+	/// </summary>
+	public ref class TJIncrementalDecoder
+	{
+	private:
+		tjcli_incremental* handle;
+		array<Byte>^ pixels;
+		int pitch;
+		PixelFormat pixelFormat;
+		Flag flags;
+		int desiredWidth;
+		int desiredHeight;
+		bool progressivePasses;
+		bool started;
+		TJMemoryBudget^ reservedFrom;
+		long long reservedBytes;
+		bool isDisposed;
+		!TJIncrementalDecoder();
+
+		void Initialize()
+		{
+			handle = 0;
+			pitch = 0;
+			pixelFormat = PixelFormat::BGR;
+			flags = Flag::NONE;
+			desiredWidth = 0;
+			desiredHeight = 0;
+			progressivePasses = true;
+			started = false;
+			reservedFrom = nullptr;
+			reservedBytes = 0;
+			isDisposed = false;
+		}
+
+		void start();
+		void allocatePixels();
+		void releaseReservation();
+		bool decode(const unsigned char* data, size_t size, bool endOfData);
+	public:
+
+		TJIncrementalDecoder();
+		~TJIncrementalDecoder();
+
+		void setPixelFormat(PixelFormat pixelFormat);
+		PixelFormat getPixelFormat();
+		void setFlags(Flag flags);
+		Flag getFlags();
+		void setDesiredSize(int desiredWidth, int desiredHeight);
+		void setProgressivePasses(bool progressivePasses);
+		bool getProgressivePasses();
+
+		void reset();
+		bool feed(array<Byte>^ data, int offset, int count);
+		bool feed(array<Byte>^ data);
+		bool finish();
+
+		bool isHeaderReady();
+		int getWidth();
+		int getHeight();
+		int getPitch();
+		bool isProgressive();
+		int getRowsDecoded();
+		int getPassesCompleted();
+		bool isComplete();
+		array<Byte>^ getPixels();
+	};
+}
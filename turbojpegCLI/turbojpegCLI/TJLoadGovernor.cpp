@@ -0,0 +1,448 @@
+#include "TJLoadGovernor.h"
+using namespace System::Diagnostics;
+using namespace System::Threading;
+
+namespace turbojpegCLI
+{
+	LoadLevelChangedEventArgs::LoadLevelChangedEventArgs(DateTime time, int previousLevel, int level, double latencyBefore, double serviceTimeBefore)
+	{
+		this->time = time;
+		this->previousLevel = previousLevel;
+		this->level = level;
+		this->latencyBefore = latencyBefore;
+		this->serviceTimeBefore = serviceTimeBefore;
+		latencyAfter = 0;
+		serviceTimeAfter = 0;
+	}
+
+	void LoadLevelChangedEventArgs::setEffect(double latencyAfter, double serviceTimeAfter)
+	{
+		this->latencyAfter = latencyAfter;
+		this->serviceTimeAfter = serviceTimeAfter;
+	}
+
+	/// <summary>
+	/// Returns the time of the change.
+	/// </summary>
+	DateTime LoadLevelChangedEventArgs::getTime()
+	{
+		return time;
+	}
+
+	/// <summary>
+	/// Returns the level before the change.
+	/// </summary>
+	int LoadLevelChangedEventArgs::getPreviousLevel()
+	{
+		return previousLevel;
+	}
+
+	/// <summary>
+	/// Returns the level after the change.
+	/// </summary>
+	int LoadLevelChangedEventArgs::getLevel()
+	{
+		return level;
+	}
+
+	/// <summary>
+	/// Returns the average queue latency, in milliseconds, in the interval which caused the
+	/// change.
+	/// </summary>
+	double LoadLevelChangedEventArgs::getLatencyBefore()
+	{
+		return latencyBefore;
+	}
+
+	/// <summary>
+	/// Returns the average time per frame, in milliseconds, in the interval which caused
+	/// the change, or 0 if none was reported.
+	/// </summary>
+	double LoadLevelChangedEventArgs::getServiceTimeBefore()
+	{
+		return serviceTimeBefore;
+	}
+
+	/// <summary>
+	/// Returns the average queue latency, in milliseconds, in the interval after the change.
+	/// </summary>
+	double LoadLevelChangedEventArgs::getLatencyAfter()
+	{
+		return latencyAfter;
+	}
+
+	/// <summary>
+	/// Returns the average time per frame, in milliseconds, in the interval after the
+	/// change, or 0 if none was reported.
+	/// </summary>
+	double LoadLevelChangedEventArgs::getServiceTimeAfter()
+	{
+		return serviceTimeAfter;
+	}
+
+	/// <summary>
+	/// Returns a one-line description of the change and its effect, suitable for a log.
+	/// </summary>
+	String^ LoadLevelChangedEventArgs::ToString()
+	{
+		return "Load level " + previousLevel + " -> " + level
+			+ ": queue latency " + latencyBefore.ToString("0.0") + " ms -> " + latencyAfter.ToString("0.0") + " ms"
+			+ ", time per frame " + serviceTimeBefore.ToString("0.0") + " ms -> " + serviceTimeAfter.ToString("0.0") + " ms";
+	}
+
+	/// <summary>
+	/// Constructs a TJLoadGovernor with a latency target of 100 milliseconds.
+	/// </summary>
+	TJLoadGovernor::TJLoadGovernor()
+	{
+		Initialize();
+	}
+
+	/// <summary>
+	/// Constructs a TJLoadGovernor with the given latency target in milliseconds.
+	/// </summary>
+	TJLoadGovernor::TJLoadGovernor(int latencyTarget)
+	{
+		Initialize();
+		setLatencyTarget(latencyTarget);
+	}
+
+	/// <summary>
+	/// Sets the average queue latency, in milliseconds, which the governor tries to stay
+	/// under.
+	/// Default value if unset: 100
+	/// </summary>
+	void TJLoadGovernor::setLatencyTarget(int milliseconds)
+	{
+		if (milliseconds < 1)
+			throw gcnew ArgumentException("Invalid argument in setLatencyTarget()");
+		latencyTarget = milliseconds;
+	}
+
+	/// <summary>
+	/// Gets the latency target in milliseconds.
+	/// </summary>
+	int TJLoadGovernor::getLatencyTarget()
+	{
+		return latencyTarget;
+	}
+
+	/// <summary>
+	/// Sets how often, in milliseconds, the average latency is compared with the target.
+	/// This is also the least time between two level changes.
+	/// Default value if unset: 1000
+	/// </summary>
+	void TJLoadGovernor::setEvaluationInterval(int milliseconds)
+	{
+		if (milliseconds < 1)
+			throw gcnew ArgumentException("Invalid argument in setEvaluationInterval()");
+		evaluationInterval = milliseconds;
+	}
+
+	/// <summary>
+	/// Gets the evaluation interval in milliseconds.
+	/// </summary>
+	int TJLoadGovernor::getEvaluationInterval()
+	{
+		return evaluationInterval;
+	}
+
+	/// <summary>
+	/// Sets how many intervals in a row the latency must stay below half of the target
+	/// before the level goes down.  Stepping down slower than up keeps the level from
+	/// flapping at the edge of saturation.
+	/// Default value if unset: 3
+	/// </summary>
+	void TJLoadGovernor::setStepDownIntervals(int intervals)
+	{
+		if (intervals < 1)
+			throw gcnew ArgumentException("Invalid argument in setStepDownIntervals()");
+		stepDownIntervals = intervals;
+	}
+
+	/// <summary>
+	/// Gets how many intervals below half of the target it takes to go down a level.
+	/// </summary>
+	int TJLoadGovernor::getStepDownIntervals()
+	{
+		return stepDownIntervals;
+	}
+
+	/// <summary>
+	/// Sets the highest level the governor may reach, from 0 (never degrade) to 4.  Use 2
+	/// to keep the output size and quality unchanged.
+	/// Default value if unset: 4
+	/// </summary>
+	void TJLoadGovernor::setMaxLevel(int level)
+	{
+		if (level < 0 || level > 4)
+			throw gcnew ArgumentException("Invalid argument in setMaxLevel()");
+		maxLevel = level;
+	}
+
+	/// <summary>
+	/// Gets the highest level the governor may reach.
+	/// </summary>
+	int TJLoadGovernor::getMaxLevel()
+	{
+		return maxLevel;
+	}
+
+	/// <summary>
+	/// Sets how much the JPEG quality is lowered at level 3 (and twice as much at level 4).
+	/// Default value if unset: 15
+	/// </summary>
+	void TJLoadGovernor::setQualityStep(int step)
+	{
+		if (step < 0 || step > 99)
+			throw gcnew ArgumentException("Invalid argument in setQualityStep()");
+		qualityStep = step;
+	}
+
+	/// <summary>
+	/// Gets how much the JPEG quality is lowered at level 3.
+	/// </summary>
+	int TJLoadGovernor::getQualityStep()
+	{
+		return qualityStep;
+	}
+
+	/// <summary>
+	/// Sets the JPEG quality below which the governor never goes.  A requested quality
+	/// already lower than this is left alone.
+	/// Default value if unset: 30
+	/// </summary>
+	void TJLoadGovernor::setMinQuality(int quality)
+	{
+		if (quality < 1 || quality > 100)
+			throw gcnew ArgumentException("Invalid argument in setMinQuality()");
+		minQuality = quality;
+	}
+
+	/// <summary>
+	/// Gets the JPEG quality below which the governor never goes.
+	/// </summary>
+	int TJLoadGovernor::getMinQuality()
+	{
+		return minQuality;
+	}
+
+	/// <summary>
+	/// Reports how long, in milliseconds, a frame waited in a queue before work on it began.
+	/// </summary>
+	void TJLoadGovernor::recordLatency(double milliseconds)
+	{
+		if (milliseconds < 0)
+			throw gcnew ArgumentException("Invalid argument in recordLatency()");
+		List<LoadLevelChangedEventArgs^>^ changes;
+		Monitor::Enter(sync);
+		try
+		{
+			// The intervals which have ended are closed first, so the sample counts in the
+			// interval it was reported in.
+			changes = evaluate(Stopwatch::GetTimestamp());
+			latencySamples++;
+			totalLatency += milliseconds;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+		raise(changes);
+	}
+
+	/// <summary>
+	/// Reports how long, in milliseconds, the work on a frame took.  This is optional, and
+	/// only used to show the effect of level changes.
+	/// </summary>
+	void TJLoadGovernor::recordServiceTime(double milliseconds)
+	{
+		if (milliseconds < 0)
+			throw gcnew ArgumentException("Invalid argument in recordServiceTime()");
+		List<LoadLevelChangedEventArgs^>^ changes;
+		Monitor::Enter(sync);
+		try
+		{
+			// The intervals which have ended are closed first, so the sample counts in the
+			// interval it was reported in.
+			changes = evaluate(Stopwatch::GetTimestamp());
+			serviceSamples++;
+			totalServiceTime += milliseconds;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+		raise(changes);
+	}
+
+	List<LoadLevelChangedEventArgs^>^ TJLoadGovernor::evaluate(long long now)
+	{
+		if (windowStart == 0)
+			windowStart = now;
+		long long interval = (long long)evaluationInterval * Stopwatch::Frequency / 1000;
+		if (now - windowStart < interval)
+			return nullptr;
+		List<LoadLevelChangedEventArgs^>^ completed = gcnew List<LoadLevelChangedEventArgs^>();
+		closeInterval(latencySamples > 0, latencySamples == 0 ? 0 : totalLatency / latencySamples, serviceSamples == 0 ? 0 : totalServiceTime / serviceSamples, completed);
+
+		// Every further interval which has passed had no frames at all, so it was below
+		// the target.  Without these the level would stay up for as long as the load is
+		// gone.  Once the level is 0 and the last change has been measured, more of them
+		// change nothing.
+		long long idle = (now - windowStart) / interval - 1;
+		for (long long i = 0; i < idle && (level > 0 || pending != nullptr); i++)
+			closeInterval(false, 0, 0, completed);
+
+		windowStart = now;
+		latencySamples = 0;
+		totalLatency = 0;
+		serviceSamples = 0;
+		totalServiceTime = 0;
+		return completed;
+	}
+
+	void TJLoadGovernor::closeInterval(bool sampled, double latency, double serviceTime, List<LoadLevelChangedEventArgs^>^ completed)
+	{
+		// The interval which just ended is the first one at the previous change's level.
+		if (pending != nullptr)
+		{
+			pending->setEffect(latency, serviceTime);
+			if (history->Count == HISTORY_SIZE)
+				history->RemoveAt(0);
+			history->Add(pending);
+			completed->Add(pending);
+			pending = nullptr;
+		}
+
+		int newLevel = level;
+		if (sampled && latency > latencyTarget)
+		{
+			intervalsBelow = 0;
+			if (level < maxLevel)
+				newLevel = level + 1;
+		}
+		else if (latency < latencyTarget / 2.0)
+		{
+			if (++intervalsBelow >= stepDownIntervals && level > 0)
+			{
+				newLevel = level - 1;
+				intervalsBelow = 0;
+			}
+		}
+		else
+			intervalsBelow = 0;
+		if (newLevel > maxLevel)
+			newLevel = maxLevel;
+		if (newLevel != level)
+		{
+			pending = gcnew LoadLevelChangedEventArgs(DateTime::Now, level, newLevel, latency, serviceTime);
+			level = newLevel;
+			levelChanges++;
+		}
+	}
+
+	void TJLoadGovernor::raise(List<LoadLevelChangedEventArgs^>^ changes)
+	{
+		if (changes == nullptr)
+			return;
+		for each (LoadLevelChangedEventArgs^ change in changes)
+			LevelChanged(this, change);
+	}
+
+	int TJLoadGovernor::currentLevel()
+	{
+		// Catch up on the intervals which ended since the last report, so the level also
+		// comes down while no frames are reported at all.
+		List<LoadLevelChangedEventArgs^>^ changes;
+		Monitor::Enter(sync);
+		try
+		{
+			changes = evaluate(Stopwatch::GetTimestamp());
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+		raise(changes);
+		return level;
+	}
+
+	/// <summary>
+	/// Returns the current level, from 0 to getMaxLevel().
+	/// </summary>
+	int TJLoadGovernor::getLevel()
+	{
+		return currentLevel();
+	}
+
+	/// <summary>
+	/// Returns the flags to decompress with at the current level.
+	/// </summary>
+	Flag TJLoadGovernor::getDecompressFlags(Flag flags)
+	{
+		int current = currentLevel();
+		if (current >= 1)
+			flags = (Flag)((int)flags | (int)Flag::FASTDCT);
+		if (current >= 2)
+			flags = (Flag)((int)flags | (int)Flag::FASTUPSAMPLE);
+		return flags;
+	}
+
+	/// <summary>
+	/// Returns the flags to compress with at the current level.
+	/// </summary>
+	Flag TJLoadGovernor::getCompressFlags(Flag flags)
+	{
+		if (currentLevel() >= 1)
+			flags = (Flag)((int)flags | (int)Flag::FASTDCT);
+		return flags;
+	}
+
+	/// <summary>
+	/// Returns how much smaller than requested images should be decoded at the current
+	/// level: 1, 2 or 4.  The IDCT does the scaling, so a smaller image is also faster.
+	/// </summary>
+	int TJLoadGovernor::getScaleDivisor()
+	{
+		int current = currentLevel();
+		return current >= 4 ? 4 : current == 3 ? 2 : 1;
+	}
+
+	/// <summary>
+	/// Returns the JPEG quality to compress with at the current level, in place of the
+	/// requested one.
+	/// </summary>
+	int TJLoadGovernor::getQuality(int quality)
+	{
+		int current = currentLevel();
+		if (current < 3)
+			return quality;
+		int lowered = quality - qualityStep * (current - 2);
+		return Math::Max(lowered, Math::Min(quality, minQuality));
+	}
+
+	/// <summary>
+	/// Returns the number of times the level has changed.
+	/// </summary>
+	long long TJLoadGovernor::getLevelChanges()
+	{
+		return levelChanges;
+	}
+
+	/// <summary>
+	/// Returns the most recent level changes whose effect has been measured, oldest first.
+	/// </summary>
+	array<LoadLevelChangedEventArgs^>^ TJLoadGovernor::getHistory()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return history->ToArray();
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+}
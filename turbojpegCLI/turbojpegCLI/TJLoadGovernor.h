@@ -0,0 +1,138 @@
+#pragma once
+#include "TJ.h"
+using namespace System;
+using namespace System::Collections::Generic;
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>Describes a change of a TJLoadGovernor's level and its measured effect: the
+	/// average queue latency and time per frame in the evaluation interval that caused the
+	/// change, and in the interval after it.</para>
+	/// </summary>
+	public ref class LoadLevelChangedEventArgs : EventArgs
+	{
+	private:
+		DateTime time;
+		int previousLevel;
+		int level;
+		double latencyBefore;
+		double serviceTimeBefore;
+		double latencyAfter;
+		double serviceTimeAfter;
+	internal:
+		LoadLevelChangedEventArgs(DateTime time, int previousLevel, int level, double latencyBefore, double serviceTimeBefore);
+		void setEffect(double latencyAfter, double serviceTimeAfter);
+	public:
+		DateTime getTime();
+		int getPreviousLevel();
+		int getLevel();
+		double getLatencyBefore();
+		double getServiceTimeBefore();
+		double getLatencyAfter();
+		double getServiceTimeAfter();
+		virtual String^ ToString() override;
+	};
+
+	/// <summary>
+	/// <para>Holds queue latency near a target when the machine is saturated, by trading
+	/// image quality for speed one step at a time:</para>
+	/// <para>Level 0: no change.</para>
+	/// <para>Level 1: Flag.FASTDCT.</para>
+	/// <para>Level 2: Flag.FASTDCT and Flag.FASTUPSAMPLE.</para>
+	/// <para>Level 3: as level 2, and images are decoded at up to 1/2 scale by the IDCT and
+	/// encoded at a lower quality.</para>
+	/// <para>Level 4: as level 3, with 1/4 scale and a quality lower still.</para>
+	/// <para>Report each frame's queue latency with recordLatency() (a TJStreamScheduler
+	/// does this itself once given the governor).  At the end of every evaluation interval
+	/// the average latency is compared with the target: above it, the level goes up by one;
+	/// below half of it for getStepDownIntervals() intervals in a row, the level goes down
+	/// by one.  An interval in which no frame was reported counts as below, so the level
+	/// comes back down once the load stops; the governor catches up on such intervals
+	/// whenever a latency is reported or the level is read.  Each change is logged with
+	/// its measured effect, which is known one interval later, and is then raised as
+	/// LevelChanged and kept in getHistory().</para>
+	/// <para>Instances are thread safe.</para>
+	/// </summary>
+	public ref class TJLoadGovernor
+	{
+	private:
+		static const int HISTORY_SIZE = 64;
+		Object^ sync;
+		int level;
+		int maxLevel;
+		int latencyTarget;
+		int evaluationInterval;
+		int stepDownIntervals;
+		int qualityStep;
+		int minQuality;
+		long long windowStart;
+		long long latencySamples;
+		double totalLatency;
+		long long serviceSamples;
+		double totalServiceTime;
+		int intervalsBelow;
+		LoadLevelChangedEventArgs^ pending;
+		List<LoadLevelChangedEventArgs^>^ history;
+		long long levelChanges;
+
+		void Initialize()
+		{
+			sync = gcnew Object();
+			level = 0;
+			maxLevel = 4;
+			latencyTarget = 100;
+			evaluationInterval = 1000;
+			stepDownIntervals = 3;
+			qualityStep = 15;
+			minQuality = 30;
+			windowStart = 0;
+			latencySamples = 0;
+			totalLatency = 0;
+			serviceSamples = 0;
+			totalServiceTime = 0;
+			intervalsBelow = 0;
+			pending = nullptr;
+			history = gcnew List<LoadLevelChangedEventArgs^>();
+			levelChanges = 0;
+		}
+
+		List<LoadLevelChangedEventArgs^>^ evaluate(long long now);
+		void closeInterval(bool sampled, double latency, double serviceTime, List<LoadLevelChangedEventArgs^>^ completed);
+		void raise(List<LoadLevelChangedEventArgs^>^ changes);
+		int currentLevel();
+	public:
+		TJLoadGovernor();
+		TJLoadGovernor(int latencyTarget);
+
+		/// <summary>
+		/// Raised when the effect of a level change has been measured, one evaluation
+		/// interval after the change.  Raised on the thread which reported a latency or
+		/// read the level.
+		/// </summary>
+		event EventHandler<LoadLevelChangedEventArgs^>^ LevelChanged;
+
+		void setLatencyTarget(int milliseconds);
+		int getLatencyTarget();
+		void setEvaluationInterval(int milliseconds);
+		int getEvaluationInterval();
+		void setStepDownIntervals(int intervals);
+		int getStepDownIntervals();
+		void setMaxLevel(int level);
+		int getMaxLevel();
+		void setQualityStep(int step);
+		int getQualityStep();
+		void setMinQuality(int quality);
+		int getMinQuality();
+
+		void recordLatency(double milliseconds);
+		void recordServiceTime(double milliseconds);
+
+		int getLevel();
+		Flag getDecompressFlags(Flag flags);
+		Flag getCompressFlags(Flag flags);
+		int getScaleDivisor();
+		int getQuality(int quality);
+		long long getLevelChanges();
+		array<LoadLevelChangedEventArgs^>^ getHistory();
+	};
+}
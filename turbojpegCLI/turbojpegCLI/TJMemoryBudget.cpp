@@ -0,0 +1,319 @@
+#include "TJMemoryBudget.h"
+#include "TJException.h"
+using namespace System::Diagnostics;
+using namespace System::Threading;
+
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// Constructs a TJMemoryBudget with no limit.
+	/// </summary>
+	TJMemoryBudget::TJMemoryBudget()
+	{
+		Initialize();
+	}
+
+	/// <summary>
+	/// Constructs a TJMemoryBudget with the given limit in bytes.
+	/// </summary>
+	TJMemoryBudget::TJMemoryBudget(long long limit)
+	{
+		Initialize();
+		setLimit(limit);
+	}
+
+	/// <summary>
+	/// Returns the budget shared by the whole process, which every TJDecompressor uses
+	/// unless given another one.  It is created the first time it is asked for.
+	/// </summary>
+	TJMemoryBudget^ TJMemoryBudget::getShared()
+	{
+		Monitor::Enter(sharedSync);
+		try
+		{
+			if (shared == nullptr)
+				shared = gcnew TJMemoryBudget();
+			return shared;
+		}
+		finally
+		{
+			Monitor::Exit(sharedSync);
+		}
+	}
+
+	/// <summary>
+	/// Sets the most bytes which may be reserved at once, or 0 for no limit.  Lowering the
+	/// limit does not affect reservations already made.
+	/// Default value if unset: 0
+	/// </summary>
+	void TJMemoryBudget::setLimit(long long bytes)
+	{
+		if (bytes < 0)
+			throw gcnew ArgumentException("Invalid argument in setLimit()");
+		Monitor::Enter(sync);
+		limit = bytes;
+		// Waiting images may fit now, or may have become too large to ever fit.
+		Monitor::PulseAll(sync);
+		Monitor::Exit(sync);
+	}
+
+	/// <summary>
+	/// Gets the most bytes which may be reserved at once, or 0 if there is no limit.
+	/// </summary>
+	long long TJMemoryBudget::getLimit()
+	{
+		return Interlocked::Read(limit);
+	}
+
+	/// <summary>
+	/// Sets how long, in milliseconds, an image may wait for memory before it is rejected
+	/// with a TJException, or -1 to wait as long as it takes.
+	/// Default value if unset: -1
+	/// </summary>
+	void TJMemoryBudget::setWaitTimeout(int milliseconds)
+	{
+		if (milliseconds < -1)
+			throw gcnew ArgumentException("Invalid argument in setWaitTimeout()");
+		Monitor::Enter(sync);
+		waitTimeout = milliseconds;
+		Monitor::Exit(sync);
+	}
+
+	/// <summary>
+	/// Gets how long an image may wait for memory, or -1 if there is no timeout.
+	/// </summary>
+	int TJMemoryBudget::getWaitTimeout()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return waitTimeout;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Sets whether an image which is larger than the whole budget is decoded at a smaller
+	/// DCT scale which fits, where the caller allows it, rather than rejected.
+	/// Default value if unset: true
+	/// </summary>
+	void TJMemoryBudget::setDownscaleToFit(bool downscale)
+	{
+		downscaleToFit = downscale;
+	}
+
+	/// <summary>
+	/// Gets whether images larger than the whole budget are downscaled to fit.
+	/// </summary>
+	bool TJMemoryBudget::getDownscaleToFit()
+	{
+		return downscaleToFit;
+	}
+
+	/// <summary>
+	/// Returns the length of an output array of the given size, or throws a TJException if
+	/// an array can not be that large.
+	/// </summary>
+	int TJMemoryBudget::checkBufferSize(long long length)
+	{
+		if (length > Int32::MaxValue)
+			throw gcnew TJException("The decompressed image of " + length + " bytes is too large for an array");
+		return (int)length;
+	}
+
+	bool TJMemoryBudget::fitsLimit(long long bytes)
+	{
+		long long current = Interlocked::Read(limit);
+		return current == 0 || bytes <= current;
+	}
+
+	void TJMemoryBudget::take(long long bytes)
+	{
+		reservedBytes += bytes;
+		if (reservedBytes > peakReservedBytes)
+			peakReservedBytes = reservedBytes;
+		reservationCount++;
+		jobsAdmitted++;
+	}
+
+	Exception^ TJMemoryBudget::reject(long long bytes)
+	{
+		jobsRejected++;
+		return gcnew TJException("The image needs an estimated " + bytes + " bytes, more than the memory budget of " + limit + " bytes");
+	}
+
+	void TJMemoryBudget::reserve(long long bytes, bool downscaled)
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			if (!fitsLimit(bytes))
+				throw reject(bytes);
+			// Images are admitted in turn, so a large one is not overtaken forever by small ones.
+			if (waiters->Count == 0 && (limit == 0 || reservedBytes + bytes <= limit))
+			{
+				take(bytes);
+				if (downscaled)
+					jobsDownscaled++;
+				return;
+			}
+			jobsQueued++;
+			LinkedListNode<Object^>^ node = waiters->AddLast(gcnew Object());
+			try
+			{
+				// Read once, as the lock is given up while waiting.
+				int timeout = waitTimeout;
+				long long deadline = Stopwatch::GetTimestamp() + (long long)timeout * Stopwatch::Frequency / 1000;
+				while (waiters->First != node || (limit != 0 && reservedBytes + bytes > limit))
+				{
+					if (!fitsLimit(bytes))
+						throw reject(bytes);
+					int wait = Timeout::Infinite;
+					if (timeout >= 0)
+					{
+						long long remaining = (deadline - Stopwatch::GetTimestamp()) * 1000 / Stopwatch::Frequency;
+						if (remaining <= 0)
+						{
+							jobsRejected++;
+							throw gcnew TJException("Timed out waiting for " + bytes + " bytes of the memory budget");
+						}
+						wait = (int)remaining;
+					}
+					Monitor::Wait(sync, wait);
+				}
+				take(bytes);
+				if (downscaled)
+					jobsDownscaled++;
+			}
+			finally
+			{
+				waiters->Remove(node);
+				// Let the next waiter check whether it fits now.
+				Monitor::PulseAll(sync);
+			}
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	void TJMemoryBudget::release(long long bytes)
+	{
+		Monitor::Enter(sync);
+		reservedBytes -= bytes;
+		reservationCount--;
+		Monitor::PulseAll(sync);
+		Monitor::Exit(sync);
+	}
+
+	/// <summary>
+	/// Returns the number of bytes currently reserved by decompressions in progress.
+	/// </summary>
+	long long TJMemoryBudget::getReservedBytes()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return reservedBytes;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Returns the most bytes which were reserved at once.
+	/// </summary>
+	long long TJMemoryBudget::getPeakReservedBytes()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return peakReservedBytes;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Starts measuring getPeakReservedBytes() again from the current reservations.
+	/// </summary>
+	void TJMemoryBudget::resetPeakReservedBytes()
+	{
+		Monitor::Enter(sync);
+		peakReservedBytes = reservedBytes;
+		Monitor::Exit(sync);
+	}
+
+	/// <summary>
+	/// Returns the number of decompressions currently holding a reservation.
+	/// </summary>
+	int TJMemoryBudget::getReservationCount()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return reservationCount;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Returns the number of decompressions waiting for memory.
+	/// </summary>
+	int TJMemoryBudget::getWaitingCount()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return waiters->Count;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Returns the number of decompressions which were admitted, at once or after waiting.
+	/// </summary>
+	long long TJMemoryBudget::getJobsAdmitted()
+	{
+		return Interlocked::Read(jobsAdmitted);
+	}
+
+	/// <summary>
+	/// Returns the number of decompressions which had to wait for memory.
+	/// </summary>
+	long long TJMemoryBudget::getJobsQueued()
+	{
+		return Interlocked::Read(jobsQueued);
+	}
+
+	/// <summary>
+	/// Returns the number of decompressions which were scaled down to fit in the budget.
+	/// </summary>
+	long long TJMemoryBudget::getJobsDownscaled()
+	{
+		return Interlocked::Read(jobsDownscaled);
+	}
+
+	/// <summary>
+	/// Returns the number of decompressions which were rejected, because they could not
+	/// fit in the budget or timed out waiting.
+	/// </summary>
+	long long TJMemoryBudget::getJobsRejected()
+	{
+		return Interlocked::Read(jobsRejected);
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+using namespace System;
+using namespace System::Collections::Generic;
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>A limit on the memory which decompressions may use at once, so that a few huge
+	/// or malicious images (a header can claim 65500 x 65500 pixels) can not exhaust the
+	/// process.  Before decompressing, a TJDecompressor estimates from the JPEG header how
+	/// much the output buffer and libjpeg's working memory will take, and reserves that
+	/// much from its budget until the decompression is done.</para>
+	/// <para>An image which fits in what is left of the budget is admitted at once.  One
+	/// which fits in the budget but not in what is left waits, in turn with the other
+	/// waiting images, until enough has been released (or until the wait timeout).  One
+	/// which is larger than the whole budget is decoded at the largest DCT scale that fits,
+	/// where the caller lets the output size vary (decompressToNativeImage(), TJWorkerPool,
+	/// TJStreamScheduler), and is rejected with a TJException otherwise.
+	/// TJScheduler.decompressBatch() and TJTensorDecoder reserve memory for each image as
+	/// it starts decoding.</para>
+	/// <para>Every TJDecompressor uses the shared budget unless given another one.  The
+	/// shared budget has no limit until setLimit() is called, but still keeps count of the
+	/// reservations.</para>
+	/// <para>Instances are thread safe.</para>
+	/// </summary>
+	public ref class TJMemoryBudget
+	{
+	private:
+		static Object^ sharedSync;
+		static TJMemoryBudget^ shared;
+		Object^ sync;
+		long long limit;
+		long long reservedBytes;
+		long long peakReservedBytes;
+		int reservationCount;
+		int waitTimeout;
+		bool downscaleToFit;
+		LinkedList<Object^>^ waiters;
+		long long jobsAdmitted;
+		long long jobsQueued;
+		long long jobsDownscaled;
+		long long jobsRejected;
+
+		void Initialize()
+		{
+			sync = gcnew Object();
+			limit = 0;
+			reservedBytes = 0;
+			peakReservedBytes = 0;
+			reservationCount = 0;
+			waitTimeout = -1;
+			downscaleToFit = true;
+			waiters = gcnew LinkedList<Object^>();
+			jobsAdmitted = 0;
+			jobsQueued = 0;
+			jobsDownscaled = 0;
+			jobsRejected = 0;
+		}
+
+		void take(long long bytes);
+		Exception^ reject(long long bytes);
+		static TJMemoryBudget()
+		{
+			sharedSync = gcnew Object();
+		}
+	internal:
+		static int checkBufferSize(long long length);
+		bool fitsLimit(long long bytes);
+		void reserve(long long bytes, bool downscaled);
+		void release(long long bytes);
+	public:
+		TJMemoryBudget();
+		TJMemoryBudget(long long limit);
+		static TJMemoryBudget^ getShared();
+
+		void setLimit(long long bytes);
+		long long getLimit();
+		void setWaitTimeout(int milliseconds);
+		int getWaitTimeout();
+		void setDownscaleToFit(bool downscale);
+		bool getDownscaleToFit();
+
+		long long getReservedBytes();
+		long long getPeakReservedBytes();
+		void resetPeakReservedBytes();
+		int getReservationCount();
+		int getWaitingCount();
+		long long getJobsAdmitted();
+		long long getJobsQueued();
+		long long getJobsDownscaled();
+		long long getJobsRejected();
+	};
+}
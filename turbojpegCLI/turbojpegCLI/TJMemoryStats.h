@@ -0,0 +1,52 @@
+#pragma once
+#include "arenanative.h"
+using namespace System;
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>Counters of the arena which a compressor or decompressor allocates libjpeg's
+	/// working memory from.  The arena keeps the memory of each image for the next one instead
+	/// of freeing it, so once a handle has seen the largest image of a stream it stops calling
+	/// the heap altogether.</para>
+	/// <para>The counters cover the life of the instance.</para>
+	/// </summary>
+	public value struct TJMemoryStats
+	{
+		/// <summary>
+		/// The number of bytes of native memory the arena currently holds.
+		/// </summary>
+		long long bytesReserved;
+		/// <summary>
+		/// The most bytes that were in use at once.
+		/// </summary>
+		long long peakUsage;
+		/// <summary>
+		/// The number of allocations libjpeg asked for.
+		/// </summary>
+		long long allocationRequests;
+		/// <summary>
+		/// The number of allocations which were served from memory kept from an earlier image,
+		/// rather than from the heap.
+		/// </summary>
+		long long allocationsAvoided;
+		/// <summary>
+		/// The number of times the arena allocated memory from the heap.
+		/// </summary>
+		long long heapAllocations;
+
+	internal:
+		static TJMemoryStats fromHandle(j_common_ptr cinfo)
+		{
+			tjcli_arena_stats stats;
+			TJMemoryStats result;
+			if (tjcliGetArenaStats(cinfo, &stats) == -1)
+				return result;
+			result.bytesReserved = (long long)stats.bytesReserved;
+			result.peakUsage = (long long)stats.peakUsage;
+			result.allocationRequests = (long long)stats.allocationRequests;
+			result.allocationsAvoided = (long long)stats.allocationsAvoided;
+			result.heapAllocations = (long long)stats.heapAllocations;
+			return result;
+		}
+	};
+}
@@ -0,0 +1,524 @@
+#include "TJMjpegStream.h"
+#include "TJException.h"
+using namespace System::Runtime::InteropServices;
+
+namespace turbojpegCLI
+{
+	MjpegFrameEventArgs::MjpegFrameEventArgs(array<Byte>^ pixels, int width, int height, int pitch, PixelFormat pixelFormat, long long frameNumber, int jpegSize)
+	{
+		this->pixels = pixels;
+		this->width = width;
+		this->height = height;
+		this->pitch = pitch;
+		this->pixelFormat = pixelFormat;
+		this->frameNumber = frameNumber;
+		this->jpegSize = jpegSize;
+	}
+
+	/// <summary>
+	/// Returns the decoded pixels.  The buffer is reused for the next frame, so it is only
+	/// valid until the event handler returns.  Copy it if you need to keep the image.
+	/// </summary>
+	array<Byte>^ MjpegFrameEventArgs::getPixels()
+	{
+		return pixels;
+	}
+
+	/// <summary>
+	/// Returns the width of the decoded image.
+	/// </summary>
+	int MjpegFrameEventArgs::getWidth()
+	{
+		return width;
+	}
+
+	/// <summary>
+	/// Returns the height of the decoded image.
+	/// </summary>
+	int MjpegFrameEventArgs::getHeight()
+	{
+		return height;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes per row in the pixel buffer.
+	/// </summary>
+	int MjpegFrameEventArgs::getPitch()
+	{
+		return pitch;
+	}
+
+	/// <summary>
+	/// Returns the pixel format of the pixel buffer.
+	/// </summary>
+	PixelFormat MjpegFrameEventArgs::getPixelFormat()
+	{
+		return pixelFormat;
+	}
+
+	/// <summary>
+	/// Returns the position of this frame in the stream, starting at 1.  Gaps in the
+	/// numbering are frames which were dropped or could not be decoded.
+	/// </summary>
+	long long MjpegFrameEventArgs::getFrameNumber()
+	{
+		return frameNumber;
+	}
+
+	/// <summary>
+	/// Returns the size of the JPEG image in bytes.
+	/// </summary>
+	int MjpegFrameEventArgs::getJpegSize()
+	{
+		return jpegSize;
+	}
+
+	/// <summary>
+	/// <para>Constructs a TJMjpegStream and starts its worker thread.  Feed it with push(),
+	/// run() or replayFile(), and handle FrameDecoded.</para>
+	/// <para>By default frames are decoded to BGR at full size, and frames larger than 16 MB
+	/// are discarded as corrupt.</para>
+	/// </summary>
+	TJMjpegStream::TJMjpegStream()
+	{
+		Initialize();
+		pixels = gcnew array<Byte>(0);
+		parser = tjcliInitMjpegParser(16 * 1024 * 1024);
+		if (parser == nullptr)
+			throw gcnew OutOfMemoryException();
+		handle = tjcliInitDecoder();
+		if (handle == nullptr)
+			throw gcnew TJException("Unable to create a libjpeg decompressor");
+		frames = gcnew FrameQueue(this);
+		worker = gcnew Thread(gcnew ThreadStart(frames, &FrameQueue::workerLoop));
+		worker->IsBackground = true;
+		worker->Name = "TJMjpegStream decoder";
+		worker->Start();
+	}
+
+	/// <summary>
+	/// Call this when finished with the TJMjpegStream to stop the worker thread and free any
+	/// native structures.  If you use a C# using() block, you won't need to call this.
+	/// </summary>
+	TJMjpegStream::~TJMjpegStream()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+
+		stop();
+		this->!TJMjpegStream();
+		isDisposed = true;
+	}
+	TJMjpegStream::!TJMjpegStream()
+	{
+		// This is the Finalizer, for disposing of unmanaged data.  The worker only holds a
+		// strong reference while it decodes, so here it is idle and just has to be told to
+		// exit.
+		if (frames != nullptr)
+			frames->stop();
+		tjcliDestroyMjpegParser(parser);
+		parser = 0;
+		tjcliDestroyDecoder(handle);
+		handle = 0;
+	}
+
+	/// <summary>
+	/// Sets the pixel format frames are decoded to.  Default value if unset: BGR
+	/// </summary>
+	void TJMjpegStream::setPixelFormat(PixelFormat pixelFormat)
+	{
+		if ((int)pixelFormat < 0 || (int)pixelFormat >= TJ::NUMPF)
+			throw gcnew ArgumentException("Invalid argument in setPixelFormat()");
+		this->pixelFormat = pixelFormat;
+	}
+
+	/// <summary>
+	/// Gets the pixel format frames are decoded to.
+	/// </summary>
+	PixelFormat TJMjpegStream::getPixelFormat()
+	{
+		return pixelFormat;
+	}
+
+	/// <summary>
+	/// Sets the decompression flags (such as FASTDCT, FASTUPSAMPLE or BOTTOMUP).  Default value if unset: NONE
+	/// </summary>
+	void TJMjpegStream::setFlags(Flag flags)
+	{
+		this->flags = flags;
+	}
+
+	/// <summary>
+	/// Gets the decompression flags.
+	/// </summary>
+	Flag TJMjpegStream::getFlags()
+	{
+		return flags;
+	}
+
+	/// <summary>
+	/// Sets the size frames should be scaled down to, as in TJDecompressor.decompress().
+	/// Each frame is decoded at the largest scaling factor which fits within this size.
+	/// The scaling is done by the IDCT, so this is much cheaper than decoding at full size.  Pass 0
+	/// for either dimension to leave it unconstrained.  Default value if unset: 0, 0 (full size)
+	/// </summary>
+	void TJMjpegStream::setDesiredSize(int desiredWidth, int desiredHeight)
+	{
+		if (desiredWidth < 0 || desiredHeight < 0)
+			throw gcnew ArgumentException("Invalid argument in setDesiredSize()");
+		this->desiredWidth = desiredWidth;
+		this->desiredHeight = desiredHeight;
+	}
+
+	/// <summary>
+	/// Sets the largest frame, in bytes, the stream will buffer.  A frame which grows larger
+	/// (usually because its EOI marker was lost) is discarded as corrupt.  Call this from the
+	/// thread that pushes data.  Default value if unset: 16777216
+	/// </summary>
+	void TJMjpegStream::setMaxFrameSize(int maxFrameSize)
+	{
+		if (maxFrameSize < 4)
+			throw gcnew ArgumentException("Invalid argument in setMaxFrameSize()");
+		parser->maxFrameSize = (size_t)maxFrameSize;
+	}
+
+	/// <summary>
+	/// Gets the largest frame, in bytes, the stream will buffer.
+	/// </summary>
+	int TJMjpegStream::getMaxFrameSize()
+	{
+		return (int)parser->maxFrameSize;
+	}
+
+	TJMjpegStream::FrameQueue::FrameQueue(TJMjpegStream^ stream)
+	{
+		owner = gcnew WeakReference(stream);
+		sync = gcnew Object();
+		stopping = false;
+		busy = false;
+		pendingFrame = gcnew array<Byte>(0);
+		pendingSize = 0;
+		pendingNumber = 0;
+		hasPending = false;
+		workFrame = gcnew array<Byte>(0);
+		framesReceived = 0;
+		framesDropped = 0;
+	}
+
+	/// <summary>
+	/// Hands a frame to the worker, replacing any frame it has not taken yet.
+	/// </summary>
+	void TJMjpegStream::FrameQueue::queue(const unsigned char* frame, size_t frameSize)
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			framesReceived++;
+			if (hasPending)
+				framesDropped++;
+			if (pendingFrame->Length < (int)frameSize)
+				pendingFrame = gcnew array<Byte>((int)frameSize);
+			Marshal::Copy(IntPtr((void*)frame), pendingFrame, 0, (int)frameSize);
+			pendingSize = (int)frameSize;
+			pendingNumber = framesReceived;
+			hasPending = true;
+			Monitor::PulseAll(sync);
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	void TJMjpegStream::FrameQueue::stop()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			stopping = true;
+			Monitor::PulseAll(sync);
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// <para>Adds bytes received from the camera or file.  The bytes may be split anywhere;
+	/// partial frames are kept until the rest arrives.  Each complete frame is handed to
+	/// the worker thread, and this returns without waiting for it to be decoded.</para>
+	/// <para>Call this from one thread at a time.</para>
+	/// </summary>
+	///
+	/// <param name="data">buffer containing the received bytes</param>
+	///
+	/// <param name="offset">index of the first received byte in data</param>
+	///
+	/// <param name="count">number of received bytes</param>
+	///
+	/// <returns>the number of complete frames found</returns>
+	int TJMjpegStream::push(array<Byte>^ data, int offset, int count)
+	{
+		if (parser == 0)
+			throw gcnew ObjectDisposedException("TJMjpegStream");
+		if (data == nullptr || offset < 0 || count < 0 || offset > data->Length - count)
+			throw gcnew ArgumentException("Invalid argument in push()");
+		if (count == 0)
+			return 0;
+		{
+			pin_ptr<Byte> pinnedData = &data[offset];
+			if (tjcliMjpegPush(parser, pinnedData, (size_t)count) == -1)
+				throw gcnew TJException(gcnew String(tjcliGetErrorStr(parser)));
+		}
+		int found = 0;
+		const unsigned char* frame;
+		size_t frameSize;
+		while (tjcliMjpegNextFrame(parser, &frame, &frameSize) == 1)
+		{
+			frames->queue(frame, frameSize);
+			found++;
+		}
+		return found;
+	}
+
+	/// <summary>
+	/// Reads the stream (for example an HTTP response stream from a camera) until it ends or
+	/// stop() is called, pushing everything that is read.
+	/// </summary>
+	///
+	/// <param name="stream">the Motion-JPEG stream to read</param>
+	void TJMjpegStream::run(Stream^ stream)
+	{
+		if (stream == nullptr)
+			throw gcnew ArgumentException("Invalid argument in run()");
+		array<Byte>^ buffer = gcnew array<Byte>(65536);
+		int read;
+		while (!frames->stopping && (read = stream->Read(buffer, 0, buffer->Length)) > 0)
+			push(buffer, 0, read);
+	}
+
+	/// <summary>
+	/// Replays a recorded Motion-JPEG file (such as concatenated JPEG images) as if it came
+	/// from a live camera, which is useful for testing.  Returns when the whole file has been
+	/// pushed or stop() is called.
+	/// </summary>
+	///
+	/// <param name="path">the file to replay</param>
+	///
+	/// <param name="framesPerSecond">the rate to deliver frames at, or 0 to push the file
+	/// as fast as possible</param>
+	void TJMjpegStream::replayFile(String^ path, double framesPerSecond)
+	{
+		if (path == nullptr || framesPerSecond < 0)
+			throw gcnew ArgumentException("Invalid argument in replayFile()");
+		array<Byte>^ data = File::ReadAllBytes(path);
+		System::Diagnostics::Stopwatch^ sw = System::Diagnostics::Stopwatch::StartNew();
+		long long framesPushed = 0;
+		const int chunkSize = 4096;
+		for (int offset = 0; offset < data->Length && !frames->stopping; offset += chunkSize)
+		{
+			framesPushed += push(data, offset, Math::Min(chunkSize, data->Length - offset));
+			if (framesPerSecond > 0)
+			{
+				long long dueMs = (long long)(framesPushed * 1000 / framesPerSecond);
+				long long waitMs = dueMs - sw->ElapsedMilliseconds;
+				if (waitMs > 0)
+					Thread::Sleep((int)waitMs);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Blocks until the worker has decoded (or dropped) every frame pushed so far.
+	/// Do not call this from a FrameDecoded handler.
+	/// </summary>
+	void TJMjpegStream::flush()
+	{
+		Monitor::Enter(frames->sync);
+		try
+		{
+			while ((frames->hasPending || frames->busy) && !frames->stopping)
+				Monitor::Wait(frames->sync);
+		}
+		finally
+		{
+			Monitor::Exit(frames->sync);
+		}
+	}
+
+	/// <summary>
+	/// Stops the worker thread, discarding any frame that is waiting to be decoded, and makes
+	/// run() and replayFile() return.  Frames cannot be decoded after this is called.
+	/// </summary>
+	void TJMjpegStream::stop()
+	{
+		frames->stop();
+		if (worker != nullptr && Thread::CurrentThread != worker)
+			worker->Join();
+	}
+
+	void TJMjpegStream::FrameQueue::workerLoop()
+	{
+		for (;;)
+		{
+			int jpegSize;
+			long long frameNumber;
+			Monitor::Enter(sync);
+			try
+			{
+				busy = false;
+				Monitor::PulseAll(sync);
+				while (!hasPending && !stopping)
+					Monitor::Wait(sync);
+				if (stopping)
+					return;
+				// Swap buffers so the pusher can fill the other one while this frame decodes.
+				array<Byte>^ frame = pendingFrame;
+				pendingFrame = workFrame;
+				workFrame = frame;
+				jpegSize = pendingSize;
+				frameNumber = pendingNumber;
+				hasPending = false;
+				busy = true;
+			}
+			finally
+			{
+				Monitor::Exit(sync);
+			}
+			if (!decodeWorkFrame(jpegSize, frameNumber))
+			{
+				stop();
+				return;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Decodes the frame just taken, or returns false if the stream has been collected.
+	/// The strong reference to the stream lives only in this call, not across the wait.
+	/// </summary>
+	bool TJMjpegStream::FrameQueue::decodeWorkFrame(int jpegSize, long long frameNumber)
+	{
+		TJMjpegStream^ stream = safe_cast<TJMjpegStream^>(owner->Target);
+		if (stream == nullptr)
+			return false;
+		try
+		{
+			stream->decodeFrame(workFrame, jpegSize, frameNumber);
+		}
+		catch (Exception^ ex)
+		{
+			// Nothing may escape the worker thread, or the process would be terminated.
+			stream->framesFailed++;
+			stream->lastError = ex->Message;
+		}
+		return true;
+	}
+
+	void TJMjpegStream::decodeFrame(array<Byte>^ frame, int jpegSize, long long frameNumber)
+	{
+		int width, height, pitch;
+		{
+			pin_ptr<Byte> pinnedFrame = &frame[0];
+			int jpegWidth, jpegHeight;
+			if (tjcliDecompressHeader(handle, pinnedFrame, (unsigned long)jpegSize, &jpegWidth, &jpegHeight) == -1)
+			{
+				framesFailed++;
+				lastError = (gcnew TJException(&handle->jerr))->Message;
+				return;
+			}
+			if (tjcliGetScaledSize(jpegWidth, jpegHeight, desiredWidth, desiredHeight, &width, &height) == -1)
+			{
+				framesFailed++;
+				lastError = "Could not scale down to desired image dimensions";
+				return;
+			}
+			// The header comes from the camera, so the size is checked and the memory
+			// reserved before the pixel buffer is grown.
+			int arraySize = TJMemoryBudget::checkBufferSize((long long)width * TJ::getPixelSize(pixelFormat) * height);
+			pitch = width * TJ::getPixelSize(pixelFormat);
+			TJMemoryBudget^ budget = TJMemoryBudget::getShared();
+			long long bytes = arraySize + (long long)tjcliEstimateDecodeMemory(handle, jpegWidth, jpegHeight, width, height);
+			budget->reserve(bytes, false);
+			try
+			{
+				if (pixels->Length < arraySize)
+					pixels = gcnew array<Byte>(arraySize);
+				pin_ptr<Byte> pinnedPixels = &pixels[0];
+				if (tjcliDecompressPixels(handle, pinnedFrame, (unsigned long)jpegSize, pinnedPixels, desiredWidth, pitch, desiredHeight, (int)pixelFormat, (int)flags) == -1)
+				{
+					framesFailed++;
+					lastError = (gcnew TJException(&handle->jerr))->Message;
+					return;
+				}
+			}
+			finally
+			{
+				budget->release(bytes);
+			}
+		}
+		framesDecoded++;
+		try
+		{
+			FrameDecoded(this, gcnew MjpegFrameEventArgs(pixels, width, height, pitch, pixelFormat, frameNumber, jpegSize));
+		}
+		catch (Exception^ ex)
+		{
+			// The frame was decoded, so it still counts; the handler's failure is reported
+			// through getLastError().
+			lastError = "A FrameDecoded handler threw " + ex->GetType()->Name + ": " + ex->Message;
+		}
+	}
+
+	/// <summary>
+	/// Returns the number of complete frames found in the stream.
+	/// </summary>
+	long long TJMjpegStream::getFramesReceived()
+	{
+		return frames->framesReceived;
+	}
+
+	/// <summary>
+	/// Returns the number of frames decoded successfully.
+	/// </summary>
+	long long TJMjpegStream::getFramesDecoded()
+	{
+		return framesDecoded;
+	}
+
+	/// <summary>
+	/// Returns the number of frames which were replaced by a newer frame before the worker
+	/// could decode them.
+	/// </summary>
+	long long TJMjpegStream::getFramesDropped()
+	{
+		return frames->framesDropped;
+	}
+
+	/// <summary>
+	/// Returns the number of complete frames which could not be decoded.  See getLastError().
+	/// </summary>
+	long long TJMjpegStream::getFramesFailed()
+	{
+		return framesFailed;
+	}
+
+	/// <summary>
+	/// Returns the number of incomplete or oversized frames which were discarded by the parser.
+	/// </summary>
+	long long TJMjpegStream::getCorruptFrames()
+	{
+		return (long long)parser->corruptFrames;
+	}
+
+	/// <summary>
+	/// Returns the reason the most recent frame could not be decoded, or the exception
+	/// most recently thrown by a FrameDecoded handler, or null.
+	/// </summary>
+	String^ TJMjpegStream::getLastError()
+	{
+		return lastError;
+	}
+}
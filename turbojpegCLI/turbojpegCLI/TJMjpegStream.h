@@ -0,0 +1,139 @@
+#pragma once
+#include "TJ.h"
+#include "TJMemoryBudget.h"
+#include "jpegnative.h"
+#include "mjpegnative.h"
+using namespace System;
+using namespace System::IO;
+using namespace System::Threading;
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// Describes a frame decoded by a TJMjpegStream.
+	/// </summary>
+	public ref class MjpegFrameEventArgs : EventArgs
+	{
+	private:
+		array<Byte>^ pixels;
+		int width;
+		int height;
+		int pitch;
+		PixelFormat pixelFormat;
+		long long frameNumber;
+		int jpegSize;
+	internal:
+		MjpegFrameEventArgs(array<Byte>^ pixels, int width, int height, int pitch, PixelFormat pixelFormat, long long frameNumber, int jpegSize);
+	public:
+		array<Byte>^ getPixels();
+		int getWidth();
+		int getHeight();
+		int getPitch();
+		PixelFormat getPixelFormat();
+		long long getFrameNumber();
+		int getJpegSize();
+	};
+
+	/// <summary>
+	/// <para>Splits a Motion-JPEG byte stream (raw concatenated JPEG images, or a
+	/// multipart/x-mixed-replace HTTP body) into frames and decodes them on a dedicated
+	/// worker thread, raising FrameDecoded for each one.  The decompressor and the frame
+	/// and pixel buffers are reused, so a steady stream decodes without allocating.</para>
+	/// <para>Only the newest frame waits for the worker.  If another frame arrives before
+	/// the worker has taken it, the waiting frame is dropped (see getFramesDropped()), so
+	/// latency stays bounded when decoding cannot keep up with the camera.</para>
+	/// <para>Each frame reserves its estimated memory from TJMemoryBudget.getShared()
+	/// while it is decoded, so a camera can not exhaust the process by sending a huge
+	/// header; a frame the budget rejects counts as failed.</para>
+	/// </summary>
+	public ref class TJMjpegStream
+	{
+	private:
+		/// <summary>
+		/// The frame waiting for the worker thread and the buffers it swaps.  The worker
+		/// thread holds only this and a weak reference to the stream, so a stream which is
+		/// never disposed can still be finalized.
+		/// </summary>
+		ref class FrameQueue
+		{
+		public:
+			WeakReference^ owner;
+			Object^ sync;
+			bool stopping;
+			bool busy;
+			array<Byte>^ pendingFrame;
+			int pendingSize;
+			long long pendingNumber;
+			bool hasPending;
+			array<Byte>^ workFrame;
+			long long framesReceived;
+			long long framesDropped;
+
+			FrameQueue(TJMjpegStream^ stream);
+			void queue(const unsigned char* frame, size_t frameSize);
+			void stop();
+			void workerLoop();
+			bool decodeWorkFrame(int jpegSize, long long frameNumber);
+		};
+
+		tjcli_mjpeg_parser* parser;
+		tjcli_decoder* handle;
+		FrameQueue^ frames;
+		Thread^ worker;
+		array<Byte>^ pixels;
+		PixelFormat pixelFormat;
+		Flag flags;
+		int desiredWidth;
+		int desiredHeight;
+		long long framesDecoded;
+		long long framesFailed;
+		String^ lastError;
+		bool isDisposed;
+		!TJMjpegStream();
+
+		void Initialize()
+		{
+			parser = 0;
+			handle = 0;
+			pixelFormat = PixelFormat::BGR;
+			flags = Flag::NONE;
+			desiredWidth = 0;
+			desiredHeight = 0;
+			framesDecoded = 0;
+			framesFailed = 0;
+			isDisposed = false;
+		}
+
+		void decodeFrame(array<Byte>^ frame, int jpegSize, long long frameNumber);
+	public:
+
+		TJMjpegStream();
+		~TJMjpegStream();
+
+		/// <summary>
+		/// Raised on the worker thread for each decoded frame.  An exception thrown by a
+		/// handler is caught, and its message is returned by getLastError().
+		/// </summary>
+		event EventHandler<MjpegFrameEventArgs^>^ FrameDecoded;
+
+		void setPixelFormat(PixelFormat pixelFormat);
+		PixelFormat getPixelFormat();
+		void setFlags(Flag flags);
+		Flag getFlags();
+		void setDesiredSize(int desiredWidth, int desiredHeight);
+		void setMaxFrameSize(int maxFrameSize);
+		int getMaxFrameSize();
+
+		int push(array<Byte>^ data, int offset, int count);
+		void run(Stream^ stream);
+		void replayFile(String^ path, double framesPerSecond);
+		void flush();
+		void stop();
+
+		long long getFramesReceived();
+		long long getFramesDecoded();
+		long long getFramesDropped();
+		long long getFramesFailed();
+		long long getCorruptFrames();
+		String^ getLastError();
+	};
+}
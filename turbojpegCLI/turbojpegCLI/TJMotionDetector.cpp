@@ -0,0 +1,237 @@
+#include "TJMotionDetector.h"
+#include "TJException.h"
+
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// <para>Constructs a TJMotionDetector.  Pass each frame of a stream to processFrame() in order.
+	/// Use one instance per stream.</para>
+	/// <para>The default block threshold is 12 and the default number of AC coefficients is 0 (DC only).</para>
+	/// </summary>
+	TJMotionDetector::TJMotionDetector()
+	{
+		Initialize();
+		handle = tjcliInitDecoder();
+		if (handle == nullptr)
+			throw gcnew TJException("Unable to create a libjpeg decompressor");
+	}
+
+	/// <summary>
+	/// Call this when finished with the TJMotionDetector to free any native structures.
+	/// If you use a C# using() block, you won't need to call this.
+	/// </summary>
+	TJMotionDetector::~TJMotionDetector()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+
+		this->!TJMotionDetector();
+		isDisposed = true;
+	}
+	TJMotionDetector::!TJMotionDetector()
+	{
+		// This is the Finalizer, for disposing of unmanaged data.
+		tjcliDestroyDecoder(handle);
+		handle = 0;
+	}
+
+	/// <summary>
+	/// Sets the amount a block must change by to be considered changed.  The difference
+	/// between two blocks is the sum of the absolute differences of the compared
+	/// coefficients, scaled so that the DC term is measured in 8-bit luma levels
+	/// (a block whose mean brightness changes from 100 to 112 has a difference of 12).
+	/// </summary>
+	///
+	/// <param name="threshold">the block threshold (must be &gt;= 0)</param>
+	void TJMotionDetector::setBlockThreshold(float threshold)
+	{
+		if (threshold < 0)
+			throw gcnew ArgumentException("Invalid argument in setBlockThreshold()");
+		blockThreshold = threshold;
+	}
+
+	/// <summary>
+	/// Gets the amount a block must change by to be considered changed.  Default value if unset: 12
+	/// </summary>
+	float TJMotionDetector::getBlockThreshold()
+	{
+		return blockThreshold;
+	}
+
+	/// <summary>
+	/// <para>Sets how many low frequency AC coefficients (in zigzag order) are compared in
+	/// addition to the DC coefficient.  0 compares average block brightness only, which
+	/// is the cheapest option.  A small number such as 2 or 5 also detects motion that
+	/// moves edges around without changing the average brightness of a block.</para>
+	/// <para>Changing this discards the previous frame.</para>
+	/// </summary>
+	///
+	/// <param name="count">number of AC coefficients to compare (0 to 63)</param>
+	void TJMotionDetector::setNumACCoefficients(int count)
+	{
+		if (count < 0 || count >= DCTSIZE2)
+			throw gcnew ArgumentException("Invalid argument in setNumACCoefficients()");
+		if (count != numAC)
+			reset();
+		numAC = count;
+	}
+
+	/// <summary>
+	/// Gets how many low frequency AC coefficients are compared in addition to the DC coefficient.
+	/// Default value if unset: 0
+	/// </summary>
+	int TJMotionDetector::getNumACCoefficients()
+	{
+		return numAC;
+	}
+
+	/// <summary>
+	/// <para>Compares the given frame with the previous frame passed to this method, updating
+	/// the change map and returning the motion score.</para>
+	/// <para>The first frame, and any frame whose dimensions differ from the previous frame,
+	/// has no reference to compare against and gets a score of 0.</para>
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	///
+	/// <param name="imageSize">The length of the image data in the array.</param>
+	///
+	/// <returns>the fraction of blocks which changed (0 to 1)</returns>
+	float TJMotionDetector::processFrame(array<Byte>^ jpegImage, int imageSize)
+	{
+		if (jpegImage == nullptr || imageSize < 1)
+			throw gcnew ArgumentException("Invalid argument in processFrame()");
+		if (jpegImage->Length < imageSize)
+			throw gcnew Exception("Source buffer is not large enough");
+
+		int w, h;
+		{
+			pin_ptr<Byte> pinnedJpegImage = &jpegImage[0];
+			if (tjcliReadCoefficients(handle, pinnedJpegImage, (unsigned long)imageSize) == -1
+				|| tjcliGetBlockDimensions(handle, 0, &w, &h) == -1)
+				throw gcnew TJException(&handle->jerr);
+		}
+
+		int numBlocks = w * h;
+		int stride = 1 + numAC;
+		if (w != blocksWide || h != blocksHigh || features == nullptr || features->Length != numBlocks * stride)
+		{
+			blocksWide = w;
+			blocksHigh = h;
+			features = gcnew array<float>(numBlocks * stride);
+			previousFeatures = gcnew array<float>(numBlocks * stride);
+			changeMap = gcnew array<Byte>(numBlocks);
+			hasPreviousFrame = false;
+		}
+
+		{
+			pin_ptr<float> pinnedFeatures = &features[0];
+			if (tjcliGetLumaFeatures(handle, numAC, pinnedFeatures) == -1)
+				throw gcnew TJException(&handle->jerr);
+		}
+
+		changedBlocks = 0;
+		if (hasPreviousFrame)
+		{
+			for (int b = 0, i = 0; b < numBlocks; b++)
+			{
+				float diff = 0;
+				for (int k = 0; k < stride; k++, i++)
+					diff += Math::Abs(features[i] - previousFeatures[i]);
+				if (diff > blockThreshold)
+				{
+					changeMap[b] = 1;
+					changedBlocks++;
+				}
+				else
+					changeMap[b] = 0;
+			}
+		}
+		else
+			Array::Clear(changeMap, 0, numBlocks);
+
+		// Swap rather than copy; the old reference frame becomes the next output buffer.
+		array<float>^ tmp = previousFeatures;
+		previousFeatures = features;
+		features = tmp;
+		hasPreviousFrame = true;
+
+		score = numBlocks > 0 ? (float)changedBlocks / numBlocks : 0;
+		return score;
+	}
+
+	/// <summary>
+	/// <para>Compares the given frame with the previous frame passed to this method, updating
+	/// the change map and returning the motion score.</para>
+	/// <para>The first frame, and any frame whose dimensions differ from the previous frame,
+	/// has no reference to compare against and gets a score of 0.</para>
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	///
+	/// <returns>the fraction of blocks which changed (0 to 1)</returns>
+	float TJMotionDetector::processFrame(array<Byte>^ jpegImage)
+	{
+		if (jpegImage == nullptr)
+			throw gcnew ArgumentException("Invalid argument in processFrame()");
+		return processFrame(jpegImage, jpegImage->Length);
+	}
+
+	/// <summary>
+	/// Discards the previous frame, so the next frame passed to processFrame() becomes the new reference.
+	/// </summary>
+	void TJMotionDetector::reset()
+	{
+		hasPreviousFrame = false;
+		changedBlocks = 0;
+		score = 0;
+		if (changeMap != nullptr)
+			Array::Clear(changeMap, 0, changeMap->Length);
+	}
+
+	/// <summary>
+	/// Returns the score computed by the most recent call to processFrame(): the fraction of blocks which changed (0 to 1).
+	/// </summary>
+	float TJMotionDetector::getScore()
+	{
+		return score;
+	}
+
+	/// <summary>
+	/// Returns the number of blocks which changed in the most recent call to processFrame().
+	/// </summary>
+	int TJMotionDetector::getChangedBlockCount()
+	{
+		return changedBlocks;
+	}
+
+	/// <summary>
+	/// Returns the block-level change map computed by the most recent call to processFrame().
+	/// There is one byte per 8x8 luma block, in raster order (getBlocksWide() bytes per row),
+	/// which is 1 if the block changed and 0 otherwise.  The same array is reused by
+	/// subsequent frames of the same size, so copy it if you need to keep it.
+	/// </summary>
+	array<Byte>^ TJMotionDetector::getChangeMap()
+	{
+		if (changeMap == nullptr)
+			throw gcnew Exception("No frames have been processed by this instance");
+		return changeMap;
+	}
+
+	/// <summary>
+	/// Returns the width of the change map, in 8x8 luma blocks.
+	/// </summary>
+	int TJMotionDetector::getBlocksWide()
+	{
+		return blocksWide;
+	}
+
+	/// <summary>
+	/// Returns the height of the change map, in 8x8 luma blocks.
+	/// </summary>
+	int TJMotionDetector::getBlocksHigh()
+	{
+		return blocksHigh;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "TJ.h"
+#include "jpegnative.h"
+using namespace System;
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// Compressed-domain motion detector.  Each frame is only entropy decoded, and the
+	/// luma DC coefficient (plus optionally a few low frequency AC coefficients) of every
+	/// 8x8 block is compared against the previous frame.  No IDCT, upsampling or color
+	/// conversion is performed, which makes this far cheaper than decompressing frames
+	/// and differencing the pixels.
+	/// </summary>
+	public ref class TJMotionDetector
+	{
+	private:
+		tjcli_decoder* handle;
+		array<float>^ features;
+		array<float>^ previousFeatures;
+		array<Byte>^ changeMap;
+		int blocksWide;
+		int blocksHigh;
+		int numAC;
+		float blockThreshold;
+		int changedBlocks;
+		float score;
+		bool hasPreviousFrame;
+		bool isDisposed;
+		!TJMotionDetector();
+
+		void Initialize()
+		{
+			handle = 0;
+			blocksWide = 0;
+			blocksHigh = 0;
+			numAC = 0;
+			blockThreshold = 12.0f;
+			changedBlocks = 0;
+			score = 0;
+			hasPreviousFrame = false;
+			isDisposed = false;
+		}
+	public:
+
+		TJMotionDetector();
+		~TJMotionDetector();
+
+		void setBlockThreshold(float threshold);
+		float getBlockThreshold();
+		void setNumACCoefficients(int count);
+		int getNumACCoefficients();
+
+		float processFrame(array<Byte>^ jpegImage, int imageSize);
+		float processFrame(array<Byte>^ jpegImage);
+		void reset();
+
+		float getScore();
+		int getChangedBlockCount();
+		array<Byte>^ getChangeMap();
+		int getBlocksWide();
+		int getBlocksHigh();
+	};
+}
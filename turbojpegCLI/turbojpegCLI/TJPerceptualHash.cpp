@@ -0,0 +1,254 @@
+#include "TJPerceptualHash.h"
+#include "TJException.h"
+
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// Constructs a TJPerceptualHash.  An instance reuses its native decompressor and
+	/// buffers for every image, so it is cheapest to hash many images with one instance.
+	/// Instances are not thread safe; use one per thread.
+	/// </summary>
+	TJPerceptualHash::TJPerceptualHash()
+	{
+		Initialize();
+		handle = tjcliInitDecoder();
+		if (handle == nullptr)
+			throw gcnew TJException("Unable to create a libjpeg decompressor");
+	}
+
+	/// <summary>
+	/// Call this when finished with the TJPerceptualHash to free any native structures.
+	/// If you use a C# using() block, you won't need to call this.
+	/// </summary>
+	TJPerceptualHash::~TJPerceptualHash()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+
+		this->!TJPerceptualHash();
+		isDisposed = true;
+	}
+	TJPerceptualHash::!TJPerceptualHash()
+	{
+		// This is the Finalizer, for disposing of unmanaged data.
+		tjcliDestroyDecoder(handle);
+		handle = 0;
+	}
+
+	/// <summary>
+	/// Computes the perceptual hash of a JPEG image.  Only the entropy coded data is
+	/// decoded; no pixels are produced.
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	///
+	/// <param name="imageSize">The length of the image data in the array.</param>
+	///
+	/// <param name="type">the kind of hash to compute</param>
+	///
+	/// <returns>the 64-bit hash.  Compare hashes with hammingDistance().</returns>
+	UInt64 TJPerceptualHash::computeHash(array<Byte>^ jpegImage, int imageSize, PerceptualHashType type)
+	{
+		if (jpegImage == nullptr || imageSize < 1)
+			throw gcnew ArgumentException("Invalid argument in computeHash()");
+		if (jpegImage->Length < imageSize)
+			throw gcnew Exception("Source buffer is not large enough");
+		if (type != PerceptualHashType::PHASH && type != PerceptualHashType::DHASH)
+			throw gcnew ArgumentException("Invalid hash type");
+
+		int w, h;
+		{
+			pin_ptr<Byte> pinnedJpegImage = &jpegImage[0];
+			if (tjcliReadCoefficients(handle, pinnedJpegImage, (unsigned long)imageSize) == -1
+				|| tjcliGetBlockDimensions(handle, 0, &w, &h) == -1)
+				throw gcnew TJException(&handle->jerr);
+		}
+		if (dcBuf == nullptr || dcBuf->Length < w * h)
+			dcBuf = gcnew array<float>(w * h);
+		{
+			pin_ptr<float> pinnedDC = &dcBuf[0];
+			if (tjcliGetLumaFeatures(handle, 0, pinnedDC) == -1)
+				throw gcnew TJException(&handle->jerr);
+		}
+
+		if (type == PerceptualHashType::PHASH)
+			return pHash(dcBuf, w, h);
+		return dHash(dcBuf, w, h);
+	}
+
+	/// <summary>
+	/// Computes the perceptual hash of a JPEG image.  Only the entropy coded data is
+	/// decoded; no pixels are produced.
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	///
+	/// <param name="type">the kind of hash to compute</param>
+	///
+	/// <returns>the 64-bit hash.  Compare hashes with hammingDistance().</returns>
+	UInt64 TJPerceptualHash::computeHash(array<Byte>^ jpegImage, PerceptualHashType type)
+	{
+		if (jpegImage == nullptr)
+			throw gcnew ArgumentException("Invalid argument in computeHash()");
+		return computeHash(jpegImage, jpegImage->Length, type);
+	}
+
+	/// <summary>
+	/// Computes the perceptual hashes of a batch of JPEG images, reusing the same native
+	/// decompressor and buffers for each one.
+	/// </summary>
+	///
+	/// <param name="jpegImages">the JPEG images to hash.  Each array must contain exactly one JPEG image.</param>
+	///
+	/// <param name="type">the kind of hash to compute</param>
+	///
+	/// <param name="succeeded">if not null, this must be at least as long as
+	/// <code>jpegImages</code>.  Images that fail to decode then get a hash of 0 and a
+	/// <code>false</code> entry in this array instead of aborting the batch with an
+	/// exception.</param>
+	///
+	/// <returns>one hash per image, in the same order as <code>jpegImages</code>.</returns>
+	array<UInt64>^ TJPerceptualHash::computeHashes(array<array<Byte>^>^ jpegImages, PerceptualHashType type, array<bool>^ succeeded)
+	{
+		if (jpegImages == nullptr || (succeeded != nullptr && succeeded->Length < jpegImages->Length))
+			throw gcnew ArgumentException("Invalid argument in computeHashes()");
+		array<UInt64>^ hashes = gcnew array<UInt64>(jpegImages->Length);
+		for (int i = 0; i < jpegImages->Length; i++)
+		{
+			if (succeeded == nullptr)
+			{
+				hashes[i] = computeHash(jpegImages[i], type);
+				continue;
+			}
+			try
+			{
+				hashes[i] = computeHash(jpegImages[i], type);
+				succeeded[i] = true;
+			}
+			catch (Exception^)
+			{
+				hashes[i] = 0;
+				succeeded[i] = false;
+			}
+		}
+		return hashes;
+	}
+
+	/// <summary>
+	/// Computes the perceptual hashes of a batch of JPEG images, reusing the same native
+	/// decompressor and buffers for each one.  An exception is thrown if any image fails
+	/// to decode.
+	/// </summary>
+	///
+	/// <param name="jpegImages">the JPEG images to hash.  Each array must contain exactly one JPEG image.</param>
+	///
+	/// <param name="type">the kind of hash to compute</param>
+	///
+	/// <returns>one hash per image, in the same order as <code>jpegImages</code>.</returns>
+	array<UInt64>^ TJPerceptualHash::computeHashes(array<array<Byte>^>^ jpegImages, PerceptualHashType type)
+	{
+		return computeHashes(jpegImages, type, nullptr);
+	}
+
+	/// <summary>
+	/// Returns the number of bits which differ between two hashes (0 to 64).  Hashes of
+	/// the same picture typically differ by fewer than 10 bits.
+	/// </summary>
+	int TJPerceptualHash::hammingDistance(UInt64 hash1, UInt64 hash2)
+	{
+		UInt64 x = hash1 ^ hash2;
+		x = x - ((x >> 1) & 0x5555555555555555ULL);
+		x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+		x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+		return (int)((x * 0x0101010101010101ULL) >> 56);
+	}
+
+	/// <summary>
+	/// Resizes a grid of values by area averaging, so each destination cell is the mean of
+	/// the source area it covers.  This works for both reduction and enlargement.
+	/// </summary>
+	void TJPerceptualHash::resample(array<float>^ src, int srcWidth, int srcHeight, array<double>^ dst, int dstWidth, int dstHeight)
+	{
+		array<double>^ tmp = gcnew array<double>(srcHeight * dstWidth);
+		double scale = (double)srcWidth / dstWidth;
+		for (int x = 0; x < dstWidth; x++)
+		{
+			double start = x * scale, end = start + scale;
+			int first = (int)start, last = Math::Min((int)Math::Ceiling(end), srcWidth);
+			for (int y = 0; y < srcHeight; y++)
+			{
+				double sum = 0;
+				for (int i = first; i < last; i++)
+					sum += src[y * srcWidth + i] * (Math::Min(end, (double)(i + 1)) - Math::Max(start, (double)i));
+				tmp[y * dstWidth + x] = sum / scale;
+			}
+		}
+		scale = (double)srcHeight / dstHeight;
+		for (int y = 0; y < dstHeight; y++)
+		{
+			double start = y * scale, end = start + scale;
+			int first = (int)start, last = Math::Min((int)Math::Ceiling(end), srcHeight);
+			for (int x = 0; x < dstWidth; x++)
+			{
+				double sum = 0;
+				for (int i = first; i < last; i++)
+					sum += tmp[i * dstWidth + x] * (Math::Min(end, (double)(i + 1)) - Math::Max(start, (double)i));
+				dst[y * dstWidth + x] = sum / scale;
+			}
+		}
+	}
+
+	UInt64 TJPerceptualHash::pHash(array<float>^ dc, int width, int height)
+	{
+		const int size = 32, lowFreq = 8;
+		array<double>^ img = gcnew array<double>(size * size);
+		resample(dc, width, height, img, size, size);
+
+		// Only the lowFreq x lowFreq lowest frequencies of the 2-D DCT are needed, so
+		// compute them separably: rows first, then columns.
+		array<double>^ basis = gcnew array<double>(lowFreq * size);
+		for (int u = 0; u < lowFreq; u++)
+			for (int x = 0; x < size; x++)
+				basis[u * size + x] = Math::Cos((2 * x + 1) * u * Math::PI / (2 * size));
+		array<double>^ rows = gcnew array<double>(size * lowFreq);
+		for (int y = 0; y < size; y++)
+			for (int u = 0; u < lowFreq; u++)
+			{
+				double sum = 0;
+				for (int x = 0; x < size; x++)
+					sum += img[y * size + x] * basis[u * size + x];
+				rows[y * lowFreq + u] = sum;
+			}
+		array<double>^ coefs = gcnew array<double>(lowFreq * lowFreq);
+		for (int v = 0; v < lowFreq; v++)
+			for (int u = 0; u < lowFreq; u++)
+			{
+				double sum = 0;
+				for (int y = 0; y < size; y++)
+					sum += rows[y * lowFreq + u] * basis[v * size + y];
+				coefs[v * lowFreq + u] = sum;
+			}
+
+		array<double>^ sorted = (array<double>^)coefs->Clone();
+		Array::Sort(sorted);
+		double median = (sorted[31] + sorted[32]) / 2;
+		UInt64 hash = 0;
+		for (int i = 0; i < 64; i++)
+			if (coefs[i] > median)
+				hash |= 1ULL << i;
+		return hash;
+	}
+
+	UInt64 TJPerceptualHash::dHash(array<float>^ dc, int width, int height)
+	{
+		array<double>^ img = gcnew array<double>(9 * 8);
+		resample(dc, width, height, img, 9, 8);
+		UInt64 hash = 0;
+		for (int y = 0; y < 8; y++)
+			for (int x = 0; x < 8; x++)
+				if (img[y * 9 + x] < img[y * 9 + x + 1])
+					hash |= 1ULL << (y * 8 + x);
+		return hash;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "TJ.h"
+#include "jpegnative.h"
+using namespace System;
+namespace turbojpegCLI
+{
+	public enum class PerceptualHashType
+	{
+		/// <summary>
+		/// DCT based perceptual hash.  The luma image is reduced to 32x32, and each of the
+		/// 64 lowest frequency terms of its DCT is compared against their median.  Robust
+		/// against rescaling, recompression and small brightness or contrast changes.
+		/// </summary>
+		PHASH = 0,
+		/// <summary>
+		/// Difference hash.  The luma image is reduced to 9x8, and each pixel is compared
+		/// against its right neighbor.  Slightly cheaper than PHASH and more sensitive to
+		/// small edits.
+		/// </summary>
+		DHASH = 1
+	};
+
+	/// <summary>
+	/// Computes 64-bit perceptual hashes of JPEG images directly from the luma DC
+	/// coefficients.  The DC coefficient of each 8x8 block is that block's average
+	/// brightness, so the DC coefficients already form a 1/8 scale thumbnail and no IDCT,
+	/// color conversion or pixel resize is required.  Use TJHashIndex to look up near
+	/// duplicates among the resulting hashes.
+	/// </summary>
+	public ref class TJPerceptualHash
+	{
+	private:
+		tjcli_decoder* handle;
+		array<float>^ dcBuf;
+		bool isDisposed;
+		!TJPerceptualHash();
+
+		void Initialize()
+		{
+			handle = 0;
+			isDisposed = false;
+		}
+
+		static void resample(array<float>^ src, int srcWidth, int srcHeight, array<double>^ dst, int dstWidth, int dstHeight);
+		static UInt64 pHash(array<float>^ dc, int width, int height);
+		static UInt64 dHash(array<float>^ dc, int width, int height);
+	public:
+
+		TJPerceptualHash();
+		~TJPerceptualHash();
+
+		UInt64 computeHash(array<Byte>^ jpegImage, int imageSize, PerceptualHashType type);
+		UInt64 computeHash(array<Byte>^ jpegImage, PerceptualHashType type);
+		array<UInt64>^ computeHashes(array<array<Byte>^>^ jpegImages, PerceptualHashType type, array<bool>^ succeeded);
+		array<UInt64>^ computeHashes(array<array<Byte>^>^ jpegImages, PerceptualHashType type);
+
+		static int hammingDistance(UInt64 hash1, UInt64 hash2);
+	};
+}
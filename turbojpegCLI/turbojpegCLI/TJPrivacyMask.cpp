@@ -0,0 +1,227 @@
+#include "TJPrivacyMask.h"
+#include "TJException.h"
+
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// Constructs a TJPrivacyMask with no regions.  Add regions with addRegion(), then
+	/// pass each image to apply().  One instance can mask any number of images, which
+	/// is the fastest way to process every frame of a recording.
+	/// </summary>
+	TJPrivacyMask::TJPrivacyMask()
+	{
+		Initialize();
+		regions = gcnew List<int>();
+		handle = tjcliInitDecoder();
+		if (handle == nullptr)
+			throw gcnew TJException("Unable to create a libjpeg decompressor");
+		encoder = tjcliInitEncoder();
+		if (encoder == nullptr)
+		{
+			tjcliDestroyDecoder(handle);
+			handle = 0;
+			throw gcnew TJException("Unable to create a libjpeg compressor");
+		}
+	}
+
+	/// <summary>
+	/// Call this when finished with the TJPrivacyMask to free any native structures.
+	/// If you use a C# using() block, you won't need to call this.
+	/// </summary>
+	TJPrivacyMask::~TJPrivacyMask()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+
+		this->!TJPrivacyMask();
+		isDisposed = true;
+	}
+	TJPrivacyMask::!TJPrivacyMask()
+	{
+		// This is the Finalizer, for disposing of unmanaged data.
+		tjcliDestroyDecoder(handle);
+		handle = 0;
+		tjcliDestroyEncoder(encoder);
+		encoder = 0;
+	}
+
+	/// <summary>
+	/// Adds a rectangle to be masked in every image passed to apply().  The rectangle
+	/// is enlarged to whole MCUs, and any part of it outside an image is ignored.
+	/// </summary>
+	///
+	/// <param name="x">the left edge of the rectangle, in pixels</param>
+	///
+	/// <param name="y">the top edge of the rectangle, in pixels</param>
+	///
+	/// <param name="width">the width of the rectangle, in pixels</param>
+	///
+	/// <param name="height">the height of the rectangle, in pixels</param>
+	void TJPrivacyMask::addRegion(int x, int y, int width, int height)
+	{
+		if (x < 0 || y < 0 || width < 1 || height < 1)
+			throw gcnew ArgumentException("Invalid argument in addRegion()");
+		regions->Add(x);
+		regions->Add(y);
+		regions->Add(width);
+		regions->Add(height);
+	}
+
+	/// <summary>
+	/// Removes all regions.
+	/// </summary>
+	void TJPrivacyMask::clearRegions()
+	{
+		regions->Clear();
+	}
+
+	/// <summary>
+	/// Returns the number of regions which have been added.
+	/// </summary>
+	int TJPrivacyMask::getRegionCount()
+	{
+		return regions->Count / 4;
+	}
+
+	/// <summary>
+	/// Sets how masked blocks are obscured.  Default value if unset: PIXELATE
+	/// </summary>
+	void TJPrivacyMask::setMode(PrivacyMaskMode mode)
+	{
+		if (mode != PrivacyMaskMode::PIXELATE && mode != PrivacyMaskMode::FLAT)
+			throw gcnew ArgumentException("Invalid argument in setMode()");
+		this->mode = mode;
+	}
+
+	/// <summary>
+	/// Gets how masked blocks are obscured.  Default value if unset: PIXELATE
+	/// </summary>
+	PrivacyMaskMode TJPrivacyMask::getMode()
+	{
+		return mode;
+	}
+
+	/// <summary>
+	/// Sets whether optimal Huffman tables are computed for each output image.  This
+	/// makes the output slightly smaller but takes an extra pass over the
+	/// coefficients.  Progressive images are always optimized.  Default value if unset: false
+	/// </summary>
+	void TJPrivacyMask::setOptimizeCoding(bool optimize)
+	{
+		optimizeCoding = optimize;
+	}
+
+	/// <summary>
+	/// Gets whether optimal Huffman tables are computed for each output image.  Default value if unset: false
+	/// </summary>
+	bool TJPrivacyMask::getOptimizeCoding()
+	{
+		return optimizeCoding;
+	}
+
+	/// <summary>
+	/// Sets whether APPn and COM markers (EXIF, ICC profiles, comments, etc.) are copied
+	/// to the output images.  An EXIF thumbnail is copied as-is and is not masked, so only
+	/// enable this if the source images are known not to carry thumbnails.  Default value if unset: false
+	/// </summary>
+	void TJPrivacyMask::setCopyMarkers(bool copy)
+	{
+		copyMarkers = copy;
+	}
+
+	/// <summary>
+	/// Gets whether APPn and COM markers are copied to the output images.  Default value if unset: false
+	/// </summary>
+	bool TJPrivacyMask::getCopyMarkers()
+	{
+		return copyMarkers;
+	}
+
+	void TJPrivacyMask::mask(array<Byte>^ jpegImage, int imageSize)
+	{
+		if (jpegImage == nullptr || imageSize < 1)
+			throw gcnew ArgumentException("Invalid argument in apply()");
+		if (jpegImage->Length < imageSize)
+			throw gcnew Exception("Source buffer is not large enough");
+
+		if (tjcliSetSaveMarkers(handle, copyMarkers ? 1 : 0) == -1)
+			throw gcnew TJException(&handle->jerr);
+		{
+			pin_ptr<Byte> pinnedJpegImage = &jpegImage[0];
+			if (tjcliReadCoefficients(handle, pinnedJpegImage, (unsigned long)imageSize) == -1)
+				throw gcnew TJException(&handle->jerr);
+		}
+		int flat = mode == PrivacyMaskMode::FLAT ? 1 : 0;
+		for (int i = 0; i < regions->Count; i += 4)
+			if (tjcliMaskRegion(handle, regions[i], regions[i + 1], regions[i + 2], regions[i + 3], flat) == -1)
+				throw gcnew TJException(&handle->jerr);
+	}
+
+	/// <summary>
+	/// Masks all regions of a JPEG image.
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	///
+	/// <param name="imageSize">The length of the image data in the array.</param>
+	///
+	/// <returns>the masked JPEG image</returns>
+	array<Byte>^ TJPrivacyMask::apply(array<Byte>^ jpegImage, int imageSize)
+	{
+		array<Byte>^ dstBuf = nullptr;
+		apply(jpegImage, imageSize, dstBuf);
+		return dstBuf;
+	}
+
+	/// <summary>
+	/// Masks all regions of a JPEG image.
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	///
+	/// <returns>the masked JPEG image</returns>
+	array<Byte>^ TJPrivacyMask::apply(array<Byte>^ jpegImage)
+	{
+		if (jpegImage == nullptr)
+			throw gcnew ArgumentException("Invalid argument in apply()");
+		return apply(jpegImage, jpegImage->Length);
+	}
+
+	/// <summary>
+	/// Masks all regions of a JPEG image into a caller-supplied buffer.  This avoids an
+	/// allocation per image when processing a stream of frames.
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing compressed jpeg image data.</param>
+	///
+	/// <param name="imageSize">The length of the image data in the array.</param>
+	///
+	/// <param name="dstBuf">buffer which will receive the masked JPEG image.  If it is
+	/// null or too small, it is replaced with a new, larger buffer.  The size of the
+	/// image is given by getOutputSize().</param>
+	void TJPrivacyMask::apply(array<Byte>^ jpegImage, int imageSize, array<Byte>^% dstBuf)
+	{
+		mask(jpegImage, imageSize);
+		unsigned char* jpegBuf;
+		unsigned long jpegSize;
+		if (tjcliWriteCoefficients(handle, encoder, optimizeCoding ? 1 : 0, copyMarkers ? 1 : 0, &jpegBuf, &jpegSize) == -1)
+			throw gcnew TJException(&encoder->jerr);
+		if (dstBuf == nullptr || dstBuf->Length < (int)jpegSize)
+			dstBuf = gcnew array<Byte>((int)jpegSize);
+		if (jpegSize > 0)
+		{
+			pin_ptr<Byte> pinnedDst = &dstBuf[0];
+			memcpy(pinnedDst, jpegBuf, jpegSize);
+		}
+		outputSize = (int)jpegSize;
+	}
+
+	/// <summary>
+	/// Returns the size of the image produced by the most recent apply() call.
+	/// </summary>
+	int TJPrivacyMask::getOutputSize()
+	{
+		return outputSize;
+	}
+}
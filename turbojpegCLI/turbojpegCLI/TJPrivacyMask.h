@@ -0,0 +1,78 @@
+#pragma once
+#include "TJ.h"
+#include "jpegnative.h"
+using namespace System;
+using namespace System::Collections::Generic;
+namespace turbojpegCLI
+{
+	public enum class PrivacyMaskMode
+	{
+		/// <summary>
+		/// The AC coefficients of each masked block are zeroed, so every 8x8 block
+		/// (16x16 for subsampled chroma) becomes a flat square of its average color.
+		/// </summary>
+		PIXELATE = 0,
+		/// <summary>
+		/// Every masked block is replaced with the average color of the whole
+		/// masked rectangle, leaving no detail at all.
+		/// </summary>
+		FLAT = 1
+	};
+
+	/// <summary>
+	/// <para>Masks rectangular regions of JPEG images (privacy zones) by editing their DCT
+	/// coefficients and re-entropy-coding the result.  The image is never decoded to
+	/// pixels or requantized, so this is far faster than a decompress, pixelate and
+	/// recompress round trip, and every block outside the masked regions is preserved
+	/// exactly.</para>
+	/// <para>Regions are specified in pixels and are enlarged outward to the image's MCU
+	/// grid (8x8 to 16x16 pixels depending on chroma subsampling).</para>
+	/// <para>Instances are not thread safe; use one per thread.</para>
+	/// </summary>
+	public ref class TJPrivacyMask
+	{
+	private:
+		tjcli_decoder* handle;
+		tjcli_encoder* encoder;
+		List<int>^ regions;
+		PrivacyMaskMode mode;
+		bool optimizeCoding;
+		bool copyMarkers;
+		int outputSize;
+		bool isDisposed;
+		!TJPrivacyMask();
+
+		void Initialize()
+		{
+			handle = 0;
+			encoder = 0;
+			mode = PrivacyMaskMode::PIXELATE;
+			optimizeCoding = false;
+			copyMarkers = false;
+			outputSize = 0;
+			isDisposed = false;
+		}
+
+		void mask(array<Byte>^ jpegImage, int imageSize);
+	public:
+
+		TJPrivacyMask();
+		~TJPrivacyMask();
+
+		void addRegion(int x, int y, int width, int height);
+		void clearRegions();
+		int getRegionCount();
+
+		void setMode(PrivacyMaskMode mode);
+		PrivacyMaskMode getMode();
+		void setOptimizeCoding(bool optimize);
+		bool getOptimizeCoding();
+		void setCopyMarkers(bool copy);
+		bool getCopyMarkers();
+
+		array<Byte>^ apply(array<Byte>^ jpegImage, int imageSize);
+		array<Byte>^ apply(array<Byte>^ jpegImage);
+		void apply(array<Byte>^ jpegImage, int imageSize, array<Byte>^% dstBuf);
+		int getOutputSize();
+	};
+}
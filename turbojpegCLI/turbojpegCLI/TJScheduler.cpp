@@ -0,0 +1,308 @@
+#include "TJScheduler.h"
+#include "TJException.h"
+using namespace System::Threading;
+
+namespace turbojpegCLI
+{
+	TJBatchAdmission::TJBatchAdmission(TJMemoryBudget^ budget, int count, PixelFormat pixelFormat)
+	{
+		this->budget = budget;
+		this->pixelFormat = pixelFormat;
+		results = gcnew array<TJDecompressResult^>(count);
+		pins = gcnew array<GCHandle>(count);
+		reserved = gcnew array<long long>(count);
+		errors = gcnew array<Exception^>(count);
+		admitCallback = gcnew TJAdmitJobCallback(this, &TJBatchAdmission::admit);
+		releaseCallback = gcnew TJReleaseJobCallback(this, &TJBatchAdmission::release);
+	}
+
+	/// <summary>
+	/// Fills in the native hooks.  The caller must keep this object alive until the jobs
+	/// are done.
+	/// </summary>
+	void TJBatchAdmission::getHooks(tjcli_job_admission* hooks)
+	{
+		hooks->admit = (tjcli_admit_func)Marshal::GetFunctionPointerForDelegate(admitCallback).ToPointer();
+		hooks->release = (tjcli_release_func)Marshal::GetFunctionPointerForDelegate(releaseCallback).ToPointer();
+	}
+
+	int TJBatchAdmission::admit(int index, int width, int height, unsigned long long bytes, IntPtr dstBuf)
+	{
+		// Called on a worker thread.  Each job only touches its own slots.
+		try
+		{
+			if (bytes > (unsigned long long)Int64::MaxValue)
+				throw gcnew TJException("The image needs an estimated " + bytes + " bytes, more than can be reserved");
+			long long outputBytes = 0;
+			if (dstBuf != IntPtr::Zero)
+			{
+				outputBytes = (long long)width * TJ::getPixelSize(pixelFormat) * height;
+				if (outputBytes > Int32::MaxValue)
+					throw gcnew TJException("The decompressed image of " + width + " x " + height + " pixels is too large for an array");
+			}
+			budget->reserve((long long)bytes, false);
+			reserved[index] = (long long)bytes;
+			if (dstBuf != IntPtr::Zero)
+			{
+				array<Byte>^ pixels = gcnew array<Byte>((int)outputBytes);
+				pins[index] = GCHandle::Alloc(pixels, GCHandleType::Pinned);
+				results[index] = gcnew TJDecompressResult(pixels, width, height, width * TJ::getPixelSize(pixelFormat), pixelFormat);
+				*(unsigned char**)dstBuf.ToPointer() = (unsigned char*)pins[index].AddrOfPinnedObject().ToPointer();
+			}
+			return 0;
+		}
+		catch (Exception^ ex)
+		{
+			errors[index] = ex;
+			release(index);
+			return -1;
+		}
+	}
+
+	void TJBatchAdmission::release(int index)
+	{
+		if (pins[index].IsAllocated)
+			pins[index].Free();
+		if (reserved[index] != 0)
+		{
+			budget->release(reserved[index]);
+			reserved[index] = 0;
+		}
+	}
+
+	TJDecompressResult^ TJBatchAdmission::getResult(int index)
+	{
+		return results[index];
+	}
+
+	/// <summary>
+	/// Returns the exception which kept a job from being admitted, or null.
+	/// </summary>
+	Exception^ TJBatchAdmission::getError(int index)
+	{
+		return errors[index];
+	}
+
+	/// <summary>
+	/// Releases whatever is still held, in case the jobs did not all run.
+	/// </summary>
+	void TJBatchAdmission::releaseAll()
+	{
+		for (int i = 0; i < reserved->Length; i++)
+			release(i);
+	}
+
+	/// <summary>
+	/// Constructs a TJScheduler with one worker thread per processor.
+	/// </summary>
+	TJScheduler::TJScheduler()
+	{
+		Initialize();
+		handle = tjcliInitScheduler(0);
+		if (handle == 0)
+			throw gcnew TJException("Unable to start the scheduler's worker threads");
+	}
+
+	/// <summary>
+	/// Constructs a TJScheduler with the given number of worker threads.
+	/// </summary>
+	TJScheduler::TJScheduler(int workerCount)
+	{
+		Initialize();
+		if (workerCount < 1)
+			throw gcnew ArgumentException("Invalid argument in TJScheduler()");
+		handle = tjcliInitScheduler(workerCount);
+		if (handle == 0)
+			throw gcnew TJException("Unable to start the scheduler's worker threads");
+	}
+
+	/// <summary>
+	/// Call this when finished with the TJScheduler to stop its worker threads and free
+	/// their handles.  No batch may be running on it.  If you use a C# using() block, you
+	/// won't need to call this.
+	/// </summary>
+	TJScheduler::~TJScheduler()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+
+		this->!TJScheduler();
+		isDisposed = true;
+	}
+	TJScheduler::!TJScheduler()
+	{
+		// This is the Finalizer, for disposing of unmanaged data.
+		if (handle != 0)
+			tjcliDestroyScheduler(handle);
+		handle = 0;
+	}
+
+	/// <summary>
+	/// Returns a scheduler shared by the whole process, with one worker thread per
+	/// processor.  It is created the first time it is asked for, and must not be disposed.
+	/// </summary>
+	TJScheduler^ TJScheduler::getShared()
+	{
+		Monitor::Enter(sharedSync);
+		try
+		{
+			if (shared == nullptr)
+				shared = gcnew TJScheduler();
+			return shared;
+		}
+		finally
+		{
+			Monitor::Exit(sharedSync);
+		}
+	}
+
+	tjcli_scheduler* TJScheduler::getHandle()
+	{
+		if (handle == 0)
+			throw gcnew ObjectDisposedException("TJScheduler");
+		return handle;
+	}
+
+	/// <summary>
+	/// Returns the number of worker threads.
+	/// </summary>
+	int TJScheduler::getWorkerCount()
+	{
+		tjcli_scheduler_stats stats;
+		tjcliGetSchedulerStats(getHandle(), &stats);
+		return stats.workerCount;
+	}
+
+	/// <summary>
+	/// Returns the number of NUMA nodes the workers are spread over (1 if the system is
+	/// not NUMA).
+	/// </summary>
+	int TJScheduler::getNumaNodeCount()
+	{
+		tjcli_scheduler_stats stats;
+		tjcliGetSchedulerStats(getHandle(), &stats);
+		return stats.numaNodeCount;
+	}
+
+	/// <summary>
+	/// Returns the number of jobs (usually one per image) the workers have run.
+	/// </summary>
+	long long TJScheduler::getJobsRun()
+	{
+		tjcli_scheduler_stats stats;
+		tjcliGetSchedulerStats(getHandle(), &stats);
+		return (long long)stats.jobsRun;
+	}
+
+	/// <summary>
+	/// Returns the number of jobs a worker took from another worker's queue.
+	/// </summary>
+	long long TJScheduler::getJobsStolen()
+	{
+		tjcli_scheduler_stats stats;
+		tjcliGetSchedulerStats(getHandle(), &stats);
+		return (long long)stats.jobsStolen;
+	}
+
+	/// <summary>
+	/// Returns the number of jobs a worker took from a worker on another NUMA node.
+	/// </summary>
+	long long TJScheduler::getJobsStolenRemote()
+	{
+		tjcli_scheduler_stats stats;
+		tjcliGetSchedulerStats(getHandle(), &stats);
+		return (long long)stats.jobsStolenRemote;
+	}
+
+	/// <summary>
+	/// <para>Decompresses a batch of JPEG images in parallel on the worker threads, and
+	/// waits until all of them are done.  The images may have different sizes.</para>
+	/// <para>Each image reserves its estimated memory from TJMemoryBudget.getShared() when
+	/// it starts on a worker, and its output array is only allocated once it has been
+	/// admitted, so a batch larger than the budget is decoded a few images at a time.</para>
+	/// </summary>
+	///
+	/// <param name="jpegImages">the JPEG images.  Each array must contain exactly one JPEG image.</param>
+	///
+	/// <param name="desiredWidth">desired width (in pixels) of each decompressed image, or 0
+	/// for the width of the JPEG image.  Each image is scaled by the IDCT to the largest
+	/// supported size which fits within the desired width and height.</param>
+	///
+	/// <param name="desiredHeight">desired height (in pixels) of each decompressed image, or
+	/// 0 for the height of the JPEG image</param>
+	///
+	/// <param name="pixelFormat">pixel format of the decompressed images</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of the Flag enum values</param>
+	///
+	/// <returns>one TJDecompressResult per image, in the same order as <code>jpegImages</code></returns>
+	array<TJDecompressResult^>^ TJScheduler::decompressBatch(array<array<Byte>^>^ jpegImages, int desiredWidth, int desiredHeight, PixelFormat pixelFormat, Flag flags)
+	{
+		if (jpegImages == nullptr || desiredWidth < 0 || desiredHeight < 0 || (int)flags < 0)
+			throw gcnew ArgumentException("Invalid argument in decompressBatch()");
+		TJ::checkPixelFormat(pixelFormat);
+		int count = jpegImages->Length;
+		array<TJDecompressResult^>^ results = gcnew array<TJDecompressResult^>(count);
+		if (count == 0)
+			return results;
+		tjcli_scheduler* sched = getHandle();
+		array<GCHandle>^ pins = gcnew array<GCHandle>(count);
+		tjcli_decompress_job* jobs = (tjcli_decompress_job*)calloc(count, sizeof(tjcli_decompress_job));
+		TJBatchAdmission^ admission = gcnew TJBatchAdmission(TJMemoryBudget::getShared(), count, pixelFormat);
+		try
+		{
+			if (jobs == nullptr)
+				throw gcnew OutOfMemoryException();
+			// The headers are read by the jobs, with the workers' own decoders.
+			tjcli_job_admission hooks;
+			admission->getHooks(&hooks);
+			for (int i = 0; i < count; i++)
+			{
+				array<Byte>^ jpegImage = jpegImages[i];
+				if (jpegImage == nullptr || jpegImage->Length < 1)
+					throw gcnew ArgumentException("Invalid argument in decompressBatch()");
+				pins[i] = GCHandle::Alloc(jpegImage, GCHandleType::Pinned);
+				tjcli_decompress_job* job = &jobs[i];
+				job->pub.func = tjcliRunDecompressJob;
+				job->jpegBuf = (const unsigned char*)pins[i].AddrOfPinnedObject().ToPointer();
+				job->jpegSize = (unsigned long)jpegImage->Length;
+				job->desiredWidth = desiredWidth;
+				job->desiredHeight = desiredHeight;
+				job->pixelFormat = (int)pixelFormat;
+				job->flags = (int)flags;
+				job->index = i;
+				job->admission = &hooks;
+			}
+			tjcli_job_group group;
+			tjcliRunJobs(sched, &group, &jobs[0].pub, sizeof(tjcli_decompress_job), count, count);
+			for (int i = 0; i < count; i++)
+			{
+				if (admission->getError(i) != nullptr)
+					throw admission->getError(i);
+				if (jobs[i].status == -1)
+					throw gcnew TJException("Image " + i + ": " + getSystemString(jobs[i].message));
+				results[i] = admission->getResult(i);
+			}
+		}
+		finally
+		{
+			for (int i = 0; i < pins->Length; i++)
+			{
+				if (pins[i].IsAllocated)
+					pins[i].Free();
+			}
+			free(jobs);
+			admission->releaseAll();
+		}
+		return results;
+	}
+
+	/// <summary>
+	/// Decompresses a batch of JPEG images at full size, in parallel on the worker threads.
+	/// </summary>
+	array<TJDecompressResult^>^ TJScheduler::decompressBatch(array<array<Byte>^>^ jpegImages, PixelFormat pixelFormat, Flag flags)
+	{
+		return decompressBatch(jpegImages, 0, 0, pixelFormat, flags);
+	}
+}
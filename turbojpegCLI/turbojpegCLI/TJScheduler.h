@@ -0,0 +1,91 @@
+#pragma once
+#include "TJ.h"
+#include "TJWorkerPool.h"
+#include "TJMemoryBudget.h"
+#include "schedulernative.h"
+using namespace System;
+using namespace System::Runtime::InteropServices;
+namespace turbojpegCLI
+{
+	[UnmanagedFunctionPointer(CallingConvention::Cdecl)]
+	delegate int TJAdmitJobCallback(int index, int width, int height, unsigned long long bytes, IntPtr dstBuf);
+	[UnmanagedFunctionPointer(CallingConvention::Cdecl)]
+	delegate void TJReleaseJobCallback(int index);
+
+	/// <summary>
+	/// Admits the jobs of one batch to a memory budget one at a time, as each starts on a
+	/// worker, and allocates a job's output array once it is admitted.  An exception can
+	/// not pass through the native worker, so it is kept in getError() for the caller.
+	/// </summary>
+	ref class TJBatchAdmission
+	{
+	private:
+		TJMemoryBudget^ budget;
+		PixelFormat pixelFormat;
+		array<TJDecompressResult^>^ results;
+		array<GCHandle>^ pins;
+		array<long long>^ reserved;
+		array<Exception^>^ errors;
+		TJAdmitJobCallback^ admitCallback;
+		TJReleaseJobCallback^ releaseCallback;
+
+		int admit(int index, int width, int height, unsigned long long bytes, IntPtr dstBuf);
+		void release(int index);
+	internal:
+		TJBatchAdmission(TJMemoryBudget^ budget, int count, PixelFormat pixelFormat);
+		void getHooks(tjcli_job_admission* hooks);
+		TJDecompressResult^ getResult(int index);
+		Exception^ getError(int index);
+		void releaseAll();
+	};
+
+	/// <summary>
+	/// <para>A pool of native worker threads which the batch APIs (decompressBatch() and
+	/// TJTensorDecoder.decodeBatch()) share, instead of each starting threads of their
+	/// own.  Every worker keeps its own libjpeg handles from one job to the next and has
+	/// its own queue of jobs; a worker whose queue is empty takes the oldest job from
+	/// another worker's queue, so a batch of images of very different sizes still keeps
+	/// every worker busy until the end.</para>
+	/// <para>On NUMA systems the workers are spread over the nodes in proportion to their
+	/// processors, bound to their node, and steal from workers on the same node first.</para>
+	/// <para>Instances are thread safe, and any number of threads may run batches on the
+	/// same scheduler at once.</para>
+	/// </summary>
+	public ref class TJScheduler
+	{
+	private:
+		static Object^ sharedSync;
+		static TJScheduler^ shared;
+		tjcli_scheduler* handle;
+		bool isDisposed;
+		!TJScheduler();
+
+		void Initialize()
+		{
+			handle = 0;
+			isDisposed = false;
+		}
+
+		static TJScheduler()
+		{
+			sharedSync = gcnew Object();
+		}
+	internal:
+		tjcli_scheduler* getHandle();
+	public:
+
+		TJScheduler();
+		TJScheduler(int workerCount);
+		~TJScheduler();
+		static TJScheduler^ getShared();
+
+		int getWorkerCount();
+		int getNumaNodeCount();
+		long long getJobsRun();
+		long long getJobsStolen();
+		long long getJobsStolenRemote();
+
+		array<TJDecompressResult^>^ decompressBatch(array<array<Byte>^>^ jpegImages, int desiredWidth, int desiredHeight, PixelFormat pixelFormat, Flag flags);
+		array<TJDecompressResult^>^ decompressBatch(array<array<Byte>^>^ jpegImages, PixelFormat pixelFormat, Flag flags);
+	};
+}
@@ -0,0 +1,678 @@
+#include "TJStreamScheduler.h"
+using namespace System::Diagnostics;
+using namespace System::Threading;
+
+namespace turbojpegCLI
+{
+	void TJStreamJob::onDone(Task^ task)
+	{
+		stream->owner->finish(this, task);
+	}
+
+	Task^ TJStreamDecompressJob::start(TJWorkerPool^ pool)
+	{
+		if (governor == nullptr)
+			return pool->decompressAsync(jpegImage, imageSize, desiredWidth, desiredHeight, pixelFormat, flags, CancellationToken::None);
+		return pool->decompressAsync(jpegImage, imageSize, desiredWidth, desiredHeight, governor->getScaleDivisor(), pixelFormat, governor->getDecompressFlags(flags), CancellationToken::None);
+	}
+
+	void TJStreamDecompressJob::complete(Task^ task)
+	{
+		Task<TJDecompressResult^>^ result = safe_cast<Task<TJDecompressResult^>^>(task);
+		if (result->IsCanceled)
+			completion->TrySetCanceled();
+		else if (result->IsFaulted)
+			completion->TrySetException(result->Exception->InnerExceptions);
+		else
+			completion->TrySetResult(result->Result);
+	}
+
+	Task^ TJStreamCompressJob::start(TJWorkerPool^ pool)
+	{
+		if (governor == nullptr)
+			return pool->compressAsync(srcImage, width, pitch, height, pixelFormat, subsamp, quality, flags, CancellationToken::None);
+		return pool->compressAsync(srcImage, width, pitch, height, pixelFormat, subsamp, governor->getQuality(quality), governor->getCompressFlags(flags), CancellationToken::None);
+	}
+
+	void TJStreamCompressJob::complete(Task^ task)
+	{
+		Task<array<Byte>^>^ result = safe_cast<Task<array<Byte>^>^>(task);
+		if (result->IsCanceled)
+			completion->TrySetCanceled();
+		else if (result->IsFaulted)
+			completion->TrySetException(result->Exception->InnerExceptions);
+		else
+			completion->TrySetResult(result->Result);
+	}
+
+	TJScheduledStream::TJScheduledStream(TJStreamScheduler^ owner, Object^ sync, String^ name, int weight, bool interactive)
+	{
+		this->owner = owner;
+		this->sync = sync;
+		this->name = name;
+		this->weight = weight;
+		this->interactive = interactive;
+		deadline = 0;
+		deadlinePolicy = DeadlinePolicy::DROP;
+		removed = false;
+		jobs = gcnew Queue<TJStreamJob^>();
+		virtualTime = 0;
+		averageServiceTicks = 0;
+		framesSubmitted = 0;
+		framesCompleted = 0;
+		framesFailed = 0;
+		framesDropped = 0;
+		framesCoalesced = 0;
+		latencySamples = 0;
+		totalLatencyTicks = 0;
+		maxLatencyTicks = 0;
+	}
+
+	/// <summary>
+	/// Returns the name the stream was added with.
+	/// </summary>
+	String^ TJScheduledStream::getName()
+	{
+		return name;
+	}
+
+	/// <summary>
+	/// Returns true for the scheduler's interactive lane.
+	/// </summary>
+	bool TJScheduledStream::isInteractive()
+	{
+		return interactive;
+	}
+
+	/// <summary>
+	/// Sets the stream's share of the workers relative to the other streams: a stream of
+	/// weight 2 gets twice the decode time of a stream of weight 1 when both have frames
+	/// waiting.  The interactive lane ignores this.
+	/// </summary>
+	void TJScheduledStream::setWeight(int weight)
+	{
+		if (weight < 1)
+			throw gcnew ArgumentException("Invalid argument in setWeight()");
+		Monitor::Enter(sync);
+		this->weight = weight;
+		Monitor::Exit(sync);
+	}
+
+	/// <summary>
+	/// Gets the stream's weight.
+	/// </summary>
+	int TJScheduledStream::getWeight()
+	{
+		return weight;
+	}
+
+	/// <summary>
+	/// Sets the longest time, in milliseconds, that a frame may wait in the queue before the
+	/// deadline policy applies to it, or 0 for no deadline.
+	/// Default value if unset: 0
+	/// </summary>
+	void TJScheduledStream::setDeadline(int milliseconds)
+	{
+		if (milliseconds < 0)
+			throw gcnew ArgumentException("Invalid argument in setDeadline()");
+		Monitor::Enter(sync);
+		deadline = milliseconds;
+		Monitor::Exit(sync);
+	}
+
+	/// <summary>
+	/// Gets the deadline in milliseconds, or 0 if there is none.
+	/// </summary>
+	int TJScheduledStream::getDeadline()
+	{
+		return deadline;
+	}
+
+	/// <summary>
+	/// Sets what happens to frames that miss the deadline.
+	/// Default value if unset: DROP
+	/// </summary>
+	void TJScheduledStream::setDeadlinePolicy(DeadlinePolicy policy)
+	{
+		if (policy != DeadlinePolicy::DROP && policy != DeadlinePolicy::COALESCE)
+			throw gcnew ArgumentException("Invalid argument in setDeadlinePolicy()");
+		Monitor::Enter(sync);
+		deadlinePolicy = policy;
+		Monitor::Exit(sync);
+	}
+
+	/// <summary>
+	/// Gets what happens to frames that miss the deadline.
+	/// </summary>
+	DeadlinePolicy TJScheduledStream::getDeadlinePolicy()
+	{
+		return deadlinePolicy;
+	}
+
+	/// <summary>
+	/// Returns the number of frames waiting in the stream's queue.
+	/// </summary>
+	int TJScheduledStream::getQueueDepth()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return jobs->Count;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Returns the number of frames submitted to the stream.
+	/// </summary>
+	long long TJScheduledStream::getFramesSubmitted()
+	{
+		return Interlocked::Read(framesSubmitted);
+	}
+
+	/// <summary>
+	/// Returns the number of frames which were processed successfully.
+	/// </summary>
+	long long TJScheduledStream::getFramesCompleted()
+	{
+		return Interlocked::Read(framesCompleted);
+	}
+
+	/// <summary>
+	/// Returns the number of frames which failed, usually because they were corrupt.
+	/// </summary>
+	long long TJScheduledStream::getFramesFailed()
+	{
+		return Interlocked::Read(framesFailed);
+	}
+
+	/// <summary>
+	/// Returns the number of frames dropped because they missed the deadline under the DROP
+	/// policy, or because the stream was removed or the scheduler disposed.
+	/// </summary>
+	long long TJScheduledStream::getFramesDropped()
+	{
+		return Interlocked::Read(framesDropped);
+	}
+
+	/// <summary>
+	/// Returns the number of frames dropped in favour of a newer frame under the COALESCE
+	/// policy.
+	/// </summary>
+	long long TJScheduledStream::getFramesCoalesced()
+	{
+		return Interlocked::Read(framesCoalesced);
+	}
+
+	/// <summary>
+	/// Returns the average time, in milliseconds, from submitting a frame to its Task
+	/// completing.
+	/// </summary>
+	double TJScheduledStream::getAverageLatency()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return latencySamples == 0 ? 0 : (double)totalLatencyTicks * 1000 / Stopwatch::Frequency / latencySamples;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Returns the longest time, in milliseconds, from submitting a frame to its Task
+	/// completing.
+	/// </summary>
+	double TJScheduledStream::getMaxLatency()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return (double)maxLatencyTicks * 1000 / Stopwatch::Frequency;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Starts measuring getAverageLatency() and getMaxLatency() again.
+	/// </summary>
+	void TJScheduledStream::resetLatency()
+	{
+		Monitor::Enter(sync);
+		latencySamples = 0;
+		totalLatencyTicks = 0;
+		maxLatencyTicks = 0;
+		Monitor::Exit(sync);
+	}
+
+	/// <summary>
+	/// Constructs a TJStreamScheduler with its own TJWorkerPool of one worker per processor.
+	/// </summary>
+	TJStreamScheduler::TJStreamScheduler()
+	{
+		Initialize();
+		pool = gcnew TJWorkerPool();
+		ownsPool = true;
+		maxInFlight = pool->getThreadCount();
+	}
+
+	/// <summary>
+	/// Constructs a TJStreamScheduler which runs its jobs on the given pool.  The pool is
+	/// not disposed with the scheduler.
+	/// </summary>
+	TJStreamScheduler::TJStreamScheduler(TJWorkerPool^ pool)
+	{
+		Initialize();
+		if (pool == nullptr)
+			throw gcnew ArgumentException("Invalid argument in TJStreamScheduler()");
+		this->pool = pool;
+		maxInFlight = pool->getThreadCount();
+	}
+
+	/// <summary>
+	/// Call this when finished with the TJStreamScheduler.  Waiting frames are dropped, and
+	/// the pool is disposed if the scheduler created it.  If you use a C# using() block, you
+	/// won't need to call this.
+	/// </summary>
+	TJStreamScheduler::~TJStreamScheduler()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+		List<TJStreamJob^>^ dropped = gcnew List<TJStreamJob^>();
+		Monitor::Enter(sync);
+		try
+		{
+			isDisposed = true;
+			streams->Add(interactiveLane);
+			for each (TJScheduledStream^ stream in streams)
+			{
+				stream->framesDropped += stream->jobs->Count;
+				dropped->AddRange(stream->jobs);
+				stream->jobs->Clear();
+			}
+			streams->Clear();
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+		for each (TJStreamJob^ job in dropped)
+			job->drop();
+		if (ownsPool)
+			delete pool;
+	}
+
+	/// <summary>
+	/// Adds a stream with the given weight (see TJScheduledStream.setWeight()).
+	/// </summary>
+	TJScheduledStream^ TJStreamScheduler::addStream(String^ name, int weight)
+	{
+		if (weight < 1)
+			throw gcnew ArgumentException("Invalid argument in addStream()");
+		Monitor::Enter(sync);
+		try
+		{
+			if (isDisposed)
+				throw gcnew ObjectDisposedException("TJStreamScheduler");
+			TJScheduledStream^ stream = gcnew TJScheduledStream(this, sync, name, weight, false);
+			// A new stream starts level with the others, not with a credit of everything so far.
+			stream->virtualTime = virtualTime;
+			streams->Add(stream);
+			return stream;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Removes a stream.  Its waiting frames are dropped, and frames already running finish.
+	/// </summary>
+	void TJStreamScheduler::removeStream(TJScheduledStream^ stream)
+	{
+		if (stream == nullptr || stream->owner != this || stream->interactive)
+			throw gcnew ArgumentException("Invalid argument in removeStream()");
+		array<TJStreamJob^>^ dropped;
+		Monitor::Enter(sync);
+		try
+		{
+			streams->Remove(stream);
+			stream->removed = true;
+			stream->framesDropped += stream->jobs->Count;
+			dropped = stream->jobs->ToArray();
+			stream->jobs->Clear();
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+		for each (TJStreamJob^ job in dropped)
+			job->drop();
+	}
+
+	/// <summary>
+	/// Returns the interactive lane, whose jobs run before those of any stream.  Use it for
+	/// requests a user is waiting for, such as snapshots.
+	/// </summary>
+	TJScheduledStream^ TJStreamScheduler::getInteractiveLane()
+	{
+		return interactiveLane;
+	}
+
+	/// <summary>
+	/// Returns the streams which have been added and not removed (not including the
+	/// interactive lane).
+	/// </summary>
+	array<TJScheduledStream^>^ TJStreamScheduler::getStreams()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return streams->ToArray();
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Sets the most jobs handed to the pool at once.  Jobs in the pool's queue can no longer
+	/// be reordered, so this should not be much more than the pool's thread count.
+	/// Default value if unset: the pool's thread count
+	/// </summary>
+	void TJStreamScheduler::setMaxInFlight(int jobs)
+	{
+		if (jobs < 1)
+			throw gcnew ArgumentException("Invalid argument in setMaxInFlight()");
+		Monitor::Enter(sync);
+		maxInFlight = jobs;
+		Monitor::Exit(sync);
+		dispatch();
+	}
+
+	/// <summary>
+	/// Gets the most jobs handed to the pool at once.
+	/// </summary>
+	int TJStreamScheduler::getMaxInFlight()
+	{
+		return maxInFlight;
+	}
+
+	/// <summary>
+	/// Sets the load governor which degrades the streams' frames when their queue latency
+	/// is over its target, or null for none.  The scheduler reports every frame's wait to
+	/// it.  Interactive jobs count towards the latency, but always run at full quality.
+	/// Default value if unset: null
+	/// </summary>
+	void TJStreamScheduler::setLoadGovernor(TJLoadGovernor^ governor)
+	{
+		Monitor::Enter(sync);
+		this->governor = governor;
+		Monitor::Exit(sync);
+	}
+
+	/// <summary>
+	/// Gets the load governor, or null if there is none.
+	/// </summary>
+	TJLoadGovernor^ TJStreamScheduler::getLoadGovernor()
+	{
+		return governor;
+	}
+
+	/// <summary>
+	/// <para>Queues a JPEG image on a stream, to be decompressed by the pool when the
+	/// stream's turn comes.</para>
+	/// </summary>
+	///
+	/// <param name="stream">the stream, or the interactive lane</param>
+	///
+	/// <param name="jpegImage">buffer containing the JPEG image</param>
+	///
+	/// <param name="imageSize">size of the JPEG image in bytes</param>
+	///
+	/// <param name="desiredWidth">desired width (in pixels) of the decompressed image, or 0
+	/// for the width of the JPEG image</param>
+	///
+	/// <param name="desiredHeight">desired height (in pixels) of the decompressed image, or 0
+	/// for the height of the JPEG image</param>
+	///
+	/// <param name="pixelFormat">pixel format of the decompressed image</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of the Flag enum values</param>
+	///
+	/// <returns>a Task which completes with the decompressed image, or is cancelled if the
+	/// frame is dropped</returns>
+	Task<TJDecompressResult^>^ TJStreamScheduler::decompressAsync(TJScheduledStream^ stream, array<Byte>^ jpegImage, int imageSize, int desiredWidth, int desiredHeight, PixelFormat pixelFormat, Flag flags)
+	{
+		if (jpegImage == nullptr || imageSize < 1 || jpegImage->Length < imageSize || desiredWidth < 0 || desiredHeight < 0 || (int)flags < 0)
+			throw gcnew ArgumentException("Invalid argument in decompressAsync()");
+		TJ::checkPixelFormat(pixelFormat);
+		TJStreamDecompressJob^ job = gcnew TJStreamDecompressJob();
+		job->completion = gcnew TaskCompletionSource<TJDecompressResult^>(TaskCreationOptions::RunContinuationsAsynchronously);
+		job->jpegImage = jpegImage;
+		job->imageSize = imageSize;
+		job->desiredWidth = desiredWidth;
+		job->desiredHeight = desiredHeight;
+		job->pixelFormat = pixelFormat;
+		job->flags = flags;
+		submit(stream, job);
+		return job->completion->Task;
+	}
+
+	/// <summary>
+	/// Queues a JPEG image on a stream, to be decompressed at full size.
+	/// </summary>
+	Task<TJDecompressResult^>^ TJStreamScheduler::decompressAsync(TJScheduledStream^ stream, array<Byte>^ jpegImage, PixelFormat pixelFormat, Flag flags)
+	{
+		if (jpegImage == nullptr)
+			throw gcnew ArgumentException("Invalid argument in decompressAsync()");
+		return decompressAsync(stream, jpegImage, jpegImage->Length, 0, 0, pixelFormat, flags);
+	}
+
+	/// <summary>
+	/// <para>Queues an image on a stream, to be compressed by the pool when the stream's
+	/// turn comes.  The arguments are those of TJWorkerPool.compressAsync().</para>
+	/// </summary>
+	///
+	/// <returns>a Task which completes with the JPEG image, or is cancelled if the frame is
+	/// dropped</returns>
+	Task<array<Byte>^>^ TJStreamScheduler::compressAsync(TJScheduledStream^ stream, array<Byte>^ srcImage, int width, int pitch, int height, PixelFormat pixelFormat, SubsamplingOption subsamp, int quality, Flag flags)
+	{
+		if (srcImage == nullptr || width < 1 || pitch < 0 || height < 1 || quality < 1 || quality > 100 || (int)flags < 0)
+			throw gcnew ArgumentException("Invalid argument in compressAsync()");
+		TJ::checkPixelFormat(pixelFormat);
+		TJ::checkSubsampling(subsamp);
+		TJStreamCompressJob^ job = gcnew TJStreamCompressJob();
+		job->completion = gcnew TaskCompletionSource<array<Byte>^>(TaskCreationOptions::RunContinuationsAsynchronously);
+		job->srcImage = srcImage;
+		job->width = width;
+		job->pitch = pitch;
+		job->height = height;
+		job->pixelFormat = pixelFormat;
+		job->subsamp = subsamp;
+		job->quality = quality;
+		job->flags = flags;
+		submit(stream, job);
+		return job->completion->Task;
+	}
+
+	void TJStreamScheduler::submit(TJScheduledStream^ stream, TJStreamJob^ job)
+	{
+		if (stream == nullptr || stream->owner != this)
+			throw gcnew ArgumentException("Invalid argument in TJStreamScheduler");
+		job->stream = stream;
+		Monitor::Enter(sync);
+		try
+		{
+			if (isDisposed)
+				throw gcnew ObjectDisposedException("TJStreamScheduler");
+			if (stream->removed)
+				throw gcnew ArgumentException("The stream has been removed");
+			// A stream which was idle must not bank the time it did not use.
+			if (stream->jobs->Count == 0 && stream->virtualTime < virtualTime)
+				stream->virtualTime = virtualTime;
+			job->submittedAt = Stopwatch::GetTimestamp();
+			stream->jobs->Enqueue(job);
+			stream->framesSubmitted++;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+		dispatch();
+	}
+
+	void TJStreamScheduler::applyDeadline(TJScheduledStream^ stream, long long now, List<TJStreamJob^>^ dropped)
+	{
+		if (stream->deadline == 0 || stream->jobs->Count == 0)
+			return;
+		long long limit = (long long)stream->deadline * Stopwatch::Frequency / 1000;
+		if (stream->deadlinePolicy == DeadlinePolicy::COALESCE)
+		{
+			if (now - stream->jobs->Peek()->submittedAt <= limit)
+				return;
+			while (stream->jobs->Count > 1)
+			{
+				dropped->Add(stream->jobs->Dequeue());
+				stream->framesCoalesced++;
+			}
+		}
+		else
+		{
+			while (stream->jobs->Count > 0 && now - stream->jobs->Peek()->submittedAt > limit)
+			{
+				dropped->Add(stream->jobs->Dequeue());
+				stream->framesDropped++;
+			}
+		}
+	}
+
+	TJStreamJob^ TJStreamScheduler::next(long long now, List<TJStreamJob^>^ dropped)
+	{
+		applyDeadline(interactiveLane, now, dropped);
+		if (interactiveLane->jobs->Count > 0)
+			return interactiveLane->jobs->Dequeue();
+		for (;;)
+		{
+			// Weighted fair queuing: the stream with the least decode time per unit of weight
+			// goes next, and the time it is expected to take is charged to it now.
+			TJScheduledStream^ best = nullptr;
+			for each (TJScheduledStream^ stream in streams)
+			{
+				if (stream->jobs->Count > 0 && (best == nullptr || stream->virtualTime < best->virtualTime))
+					best = stream;
+			}
+			if (best == nullptr)
+				return nullptr;
+			applyDeadline(best, now, dropped);
+			if (best->jobs->Count == 0)
+				continue;
+			TJStreamJob^ job = best->jobs->Dequeue();
+			virtualTime = best->virtualTime;
+			job->charge = best->averageServiceTicks / best->weight;
+			best->virtualTime += job->charge;
+			return job;
+		}
+	}
+
+	void TJStreamScheduler::dispatch()
+	{
+		List<TJStreamJob^>^ dropped = gcnew List<TJStreamJob^>();
+		List<TJStreamJob^>^ started = gcnew List<TJStreamJob^>();
+		TJLoadGovernor^ currentGovernor;
+		long long now = Stopwatch::GetTimestamp();
+		Monitor::Enter(sync);
+		try
+		{
+			currentGovernor = governor;
+			while (!isDisposed && inFlight < maxInFlight)
+			{
+				TJStreamJob^ job = next(now, dropped);
+				if (job == nullptr)
+					break;
+				job->startedAt = now;
+				job->governor = job->stream->interactive ? nullptr : currentGovernor;
+				inFlight++;
+				started->Add(job);
+			}
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+		// Tasks are completed and jobs started outside the lock, since both can run callers'
+		// continuations.
+		for each (TJStreamJob^ job in dropped)
+		{
+			job->drop();
+			if (currentGovernor != nullptr)
+				currentGovernor->recordLatency((double)(now - job->submittedAt) * 1000 / Stopwatch::Frequency);
+		}
+		if (currentGovernor != nullptr)
+		{
+			for each (TJStreamJob^ job in started)
+				currentGovernor->recordLatency((double)(now - job->submittedAt) * 1000 / Stopwatch::Frequency);
+		}
+		for each (TJStreamJob^ job in started)
+		{
+			Task^ task;
+			try
+			{
+				task = job->start(pool);
+			}
+			catch (Exception^ ex)
+			{
+				job->fail(ex);
+				finish(job, nullptr);
+				continue;
+			}
+			task->ContinueWith(gcnew Action<Task^>(job, &TJStreamJob::onDone), TaskContinuationOptions::ExecuteSynchronously);
+		}
+	}
+
+	void TJStreamScheduler::finish(TJStreamJob^ job, Task^ task)
+	{
+		long long now = Stopwatch::GetTimestamp();
+		TJScheduledStream^ stream = job->stream;
+		Monitor::Enter(sync);
+		try
+		{
+			inFlight--;
+			// Replace the charge made in next() with the time the job really took, and move
+			// the stream's estimate towards it.
+			double service = (double)(now - job->startedAt);
+			if (!stream->interactive)
+				stream->virtualTime += service / stream->weight - job->charge;
+			stream->averageServiceTicks = stream->averageServiceTicks == 0 ? service : stream->averageServiceTicks * 0.875 + service * 0.125;
+			if (task != nullptr && task->Status == TaskStatus::RanToCompletion)
+				stream->framesCompleted++;
+			else
+				stream->framesFailed++;
+			long long latency = now - job->submittedAt;
+			stream->latencySamples++;
+			stream->totalLatencyTicks += latency;
+			if (latency > stream->maxLatencyTicks)
+				stream->maxLatencyTicks = latency;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+		if (job->governor != nullptr)
+			job->governor->recordServiceTime((double)(now - job->startedAt) * 1000 / Stopwatch::Frequency);
+		if (task != nullptr)
+			job->complete(task);
+		dispatch();
+	}
+}
@@ -0,0 +1,202 @@
+#pragma once
+#include "TJ.h"
+#include "TJWorkerPool.h"
+#include "TJLoadGovernor.h"
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Threading::Tasks;
+namespace turbojpegCLI
+{
+	public enum class DeadlinePolicy
+	{
+		/// <summary>
+		/// Frames which have waited longer than the deadline are dropped, and the oldest frame
+		/// still within it runs.
+		/// </summary>
+		DROP = 0,
+		/// <summary>
+		/// Once the oldest waiting frame has missed the deadline, every waiting frame but the
+		/// newest is dropped, and the newest runs even if it is late too.  Use this when only
+		/// the latest picture matters, as with a live view.
+		/// </summary>
+		COALESCE = 1
+	};
+
+	ref class TJStreamScheduler;
+	ref class TJScheduledStream;
+
+	ref class TJStreamJob abstract
+	{
+	public:
+		TJScheduledStream^ stream;
+		long long submittedAt;
+		long long startedAt;
+		double charge;
+		TJLoadGovernor^ governor;
+
+		virtual Task^ start(TJWorkerPool^ pool) abstract;
+		virtual void complete(Task^ task) abstract;
+		virtual void fail(Exception^ ex) abstract;
+		virtual void drop() abstract;
+		void onDone(Task^ task);
+	};
+
+	ref class TJStreamDecompressJob : TJStreamJob
+	{
+	public:
+		TaskCompletionSource<TJDecompressResult^>^ completion;
+		array<Byte>^ jpegImage;
+		int imageSize;
+		int desiredWidth;
+		int desiredHeight;
+		PixelFormat pixelFormat;
+		Flag flags;
+
+		virtual Task^ start(TJWorkerPool^ pool) override;
+		virtual void complete(Task^ task) override;
+		virtual void fail(Exception^ ex) override { completion->TrySetException(ex); }
+		virtual void drop() override { completion->TrySetCanceled(); }
+	};
+
+	ref class TJStreamCompressJob : TJStreamJob
+	{
+	public:
+		TaskCompletionSource<array<Byte>^>^ completion;
+		array<Byte>^ srcImage;
+		int width;
+		int pitch;
+		int height;
+		PixelFormat pixelFormat;
+		SubsamplingOption subsamp;
+		int quality;
+		Flag flags;
+
+		virtual Task^ start(TJWorkerPool^ pool) override;
+		virtual void complete(Task^ task) override;
+		virtual void fail(Exception^ ex) override { completion->TrySetException(ex); }
+		virtual void drop() override { completion->TrySetCanceled(); }
+	};
+
+	/// <summary>
+	/// <para>One source of work for a TJStreamScheduler, such as a camera, with its own
+	/// queue, weight, deadline and counters.  Create these with
+	/// TJStreamScheduler.addStream().</para>
+	/// <para>Latency is measured from submission to completion, and covers the frames
+	/// which completed or failed (not the dropped ones).</para>
+	/// </summary>
+	public ref class TJScheduledStream
+	{
+	internal:
+		TJStreamScheduler^ owner;
+		Object^ sync;
+		String^ name;
+		int weight;
+		int deadline;
+		DeadlinePolicy deadlinePolicy;
+		bool interactive;
+		bool removed;
+		Queue<TJStreamJob^>^ jobs;
+		double virtualTime;
+		double averageServiceTicks;
+		long long framesSubmitted;
+		long long framesCompleted;
+		long long framesFailed;
+		long long framesDropped;
+		long long framesCoalesced;
+		long long latencySamples;
+		long long totalLatencyTicks;
+		long long maxLatencyTicks;
+
+		TJScheduledStream(TJStreamScheduler^ owner, Object^ sync, String^ name, int weight, bool interactive);
+	public:
+		String^ getName();
+		bool isInteractive();
+		void setWeight(int weight);
+		int getWeight();
+		void setDeadline(int milliseconds);
+		int getDeadline();
+		void setDeadlinePolicy(DeadlinePolicy policy);
+		DeadlinePolicy getDeadlinePolicy();
+
+		int getQueueDepth();
+		long long getFramesSubmitted();
+		long long getFramesCompleted();
+		long long getFramesFailed();
+		long long getFramesDropped();
+		long long getFramesCoalesced();
+		double getAverageLatency();
+		double getMaxLatency();
+		void resetLatency();
+	};
+
+	/// <summary>
+	/// <para>Shares a TJWorkerPool between many streams of frames (typically cameras) and
+	/// interactive requests, so that a busy stream cannot starve quiet ones and a user's
+	/// request does not wait behind a backlog.</para>
+	/// <para>Frames wait in their stream's queue and are handed to the pool only as workers
+	/// become free.  Interactive jobs always go first.  Otherwise the next frame comes from
+	/// the stream that has received the least decode time in proportion to its weight
+	/// (weighted fair queuing, charged with each stream's measured time per frame).  A
+	/// stream with a deadline drops or coalesces frames that have waited too long, and the
+	/// Task of a dropped frame is cancelled.</para>
+	/// <para>Given a TJLoadGovernor, the scheduler reports every frame's wait to it and
+	/// applies its current level to the streams' frames, so while the scheduler is
+	/// overloaded they may be decoded with faster flags or at a smaller size, and encoded
+	/// at a lower quality.  Check the size of each TJDecompressResult.</para>
+	/// <para>Continuations on the returned Tasks run on the thread pool, never on the
+	/// scheduler's own threads, so a slow continuation can not hold up the other streams.</para>
+	/// <para>Instances are thread safe.</para>
+	/// </summary>
+	public ref class TJStreamScheduler
+	{
+	private:
+		Object^ sync;
+		TJWorkerPool^ pool;
+		bool ownsPool;
+		List<TJScheduledStream^>^ streams;
+		TJScheduledStream^ interactiveLane;
+		TJLoadGovernor^ governor;
+		int maxInFlight;
+		int inFlight;
+		double virtualTime;
+		bool isDisposed;
+
+		void Initialize()
+		{
+			sync = gcnew Object();
+			pool = nullptr;
+			ownsPool = false;
+			streams = gcnew List<TJScheduledStream^>();
+			interactiveLane = gcnew TJScheduledStream(this, sync, "interactive", 1, true);
+			governor = nullptr;
+			maxInFlight = 1;
+			inFlight = 0;
+			virtualTime = 0;
+			isDisposed = false;
+		}
+
+		void submit(TJScheduledStream^ stream, TJStreamJob^ job);
+		void dispatch();
+		TJStreamJob^ next(long long now, List<TJStreamJob^>^ dropped);
+		void applyDeadline(TJScheduledStream^ stream, long long now, List<TJStreamJob^>^ dropped);
+	internal:
+		void finish(TJStreamJob^ job, Task^ task);
+	public:
+		TJStreamScheduler();
+		TJStreamScheduler(TJWorkerPool^ pool);
+		~TJStreamScheduler();
+
+		TJScheduledStream^ addStream(String^ name, int weight);
+		void removeStream(TJScheduledStream^ stream);
+		TJScheduledStream^ getInteractiveLane();
+		array<TJScheduledStream^>^ getStreams();
+		void setMaxInFlight(int jobs);
+		int getMaxInFlight();
+		void setLoadGovernor(TJLoadGovernor^ governor);
+		TJLoadGovernor^ getLoadGovernor();
+
+		Task<TJDecompressResult^>^ decompressAsync(TJScheduledStream^ stream, array<Byte>^ jpegImage, int imageSize, int desiredWidth, int desiredHeight, PixelFormat pixelFormat, Flag flags);
+		Task<TJDecompressResult^>^ decompressAsync(TJScheduledStream^ stream, array<Byte>^ jpegImage, PixelFormat pixelFormat, Flag flags);
+		Task<array<Byte>^>^ compressAsync(TJScheduledStream^ stream, array<Byte>^ srcImage, int width, int pitch, int height, PixelFormat pixelFormat, SubsamplingOption subsamp, int quality, Flag flags);
+	};
+}
@@ -0,0 +1,503 @@
+#include "TJTensorDecoder.h"
+#include "TJException.h"
+using namespace System::Runtime::InteropServices;
+
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// Constructs a TJTensorDecoder which produces images of the given size.  By default
+	/// the output is RGB in NCHW layout, with values from 0 to 1 in float tensors, and
+	/// images are stretched to the full size.
+	/// </summary>
+	///
+	/// <param name="width">the width of each image in the tensor</param>
+	///
+	/// <param name="height">the height of each image in the tensor</param>
+	TJTensorDecoder::TJTensorDecoder(int width, int height)
+	{
+		Initialize();
+		if (width < 1 || height < 1)
+			throw gcnew ArgumentException("Invalid argument in TJTensorDecoder()");
+		this->width = width;
+		this->height = height;
+		mean = gcnew array<float>(3) { 0, 0, 0 };
+		stdDev = gcnew array<float>(3) { 1, 1, 1 };
+	}
+
+	/// <summary>
+	/// Call this when finished with the TJTensorDecoder to free any native structures.
+	/// If you use a C# using() block, you won't need to call this.
+	/// </summary>
+	TJTensorDecoder::~TJTensorDecoder()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+
+		this->!TJTensorDecoder();
+		isDisposed = true;
+	}
+	TJTensorDecoder::!TJTensorDecoder()
+	{
+		// This is the Finalizer, for disposing of unmanaged data.
+		if (context != 0)
+			tjcliDestroyTensorContext(context);
+		context = 0;
+	}
+
+	/// <summary>
+	/// Returns the width of each image in the tensor.
+	/// </summary>
+	int TJTensorDecoder::getWidth()
+	{
+		return width;
+	}
+
+	/// <summary>
+	/// Returns the height of each image in the tensor.
+	/// </summary>
+	int TJTensorDecoder::getHeight()
+	{
+		return height;
+	}
+
+	/// <summary>
+	/// Sets the memory layout of the tensor.  Default value if unset: NCHW
+	/// </summary>
+	void TJTensorDecoder::setLayout(TensorLayout layout)
+	{
+		if (layout != TensorLayout::NCHW && layout != TensorLayout::NHWC)
+			throw gcnew ArgumentException("Invalid argument in setLayout()");
+		this->layout = layout;
+	}
+
+	/// <summary>
+	/// Gets the memory layout of the tensor.  Default value if unset: NCHW
+	/// </summary>
+	TensorLayout TJTensorDecoder::getLayout()
+	{
+		return layout;
+	}
+
+	/// <summary>
+	/// Sets the channels and channel order of the tensor.  Must be PixelFormat.RGB,
+	/// PixelFormat.BGR or PixelFormat.GRAY (one channel).  Default value if unset: RGB
+	/// </summary>
+	void TJTensorDecoder::setPixelFormat(PixelFormat pixelFormat)
+	{
+		if (pixelFormat != PixelFormat::RGB && pixelFormat != PixelFormat::BGR && pixelFormat != PixelFormat::GRAY)
+			throw gcnew ArgumentException("Invalid argument in setPixelFormat()");
+		this->pixelFormat = pixelFormat;
+	}
+
+	/// <summary>
+	/// Gets the channels and channel order of the tensor.  Default value if unset: RGB
+	/// </summary>
+	PixelFormat TJTensorDecoder::getPixelFormat()
+	{
+		return pixelFormat;
+	}
+
+	/// <summary>
+	/// Sets the normalization applied to float tensors.  Each value is computed as
+	/// <code>(pixel / 255 - mean[c]) / stdDev[c]</code>, in the channel order of the
+	/// pixel format.  For example, the ImageNet statistics are mean = {0.485, 0.456, 0.406}
+	/// and stdDev = {0.229, 0.224, 0.225} for RGB.  Byte tensors are never normalized.
+	/// Default value if unset: mean 0 and stdDev 1, which gives values from 0 to 1.
+	/// </summary>
+	///
+	/// <param name="mean">the per-channel means (at least one value per channel)</param>
+	///
+	/// <param name="stdDev">the per-channel standard deviations (at least one nonzero value per channel)</param>
+	void TJTensorDecoder::setNormalization(array<float>^ mean, array<float>^ stdDev)
+	{
+		if (mean == nullptr || stdDev == nullptr || mean->Length < 1 || stdDev->Length < 1 || mean->Length > 3 || stdDev->Length > 3)
+			throw gcnew ArgumentException("Invalid argument in setNormalization()");
+		for (int c = 0; c < stdDev->Length; c++)
+			if (stdDev[c] == 0)
+				throw gcnew ArgumentException("Invalid argument in setNormalization()");
+		array<float>^ newMean = gcnew array<float>(3);
+		array<float>^ newStdDev = gcnew array<float>(3);
+		for (int c = 0; c < 3; c++)
+		{
+			newMean[c] = mean[Math::Min(c, mean->Length - 1)];
+			newStdDev[c] = stdDev[Math::Min(c, stdDev->Length - 1)];
+		}
+		this->mean = newMean;
+		this->stdDev = newStdDev;
+	}
+
+	/// <summary>
+	/// Sets whether images keep their aspect ratio.  If true, each image is scaled to
+	/// fit within the tensor size, centered, and the borders are filled with the padding
+	/// value.  If false, each image is stretched to the tensor size.  Default value if unset: false
+	/// </summary>
+	void TJTensorDecoder::setLetterbox(bool letterbox)
+	{
+		this->letterbox = letterbox;
+	}
+
+	/// <summary>
+	/// Gets whether images keep their aspect ratio.  Default value if unset: false
+	/// </summary>
+	bool TJTensorDecoder::getLetterbox()
+	{
+		return letterbox;
+	}
+
+	/// <summary>
+	/// Sets the pixel value (0 to 255, before normalization) used for letterbox borders
+	/// and for images that fail to decode.  Default value if unset: 0
+	/// </summary>
+	void TJTensorDecoder::setPaddingValue(Byte value)
+	{
+		paddingValue = value;
+	}
+
+	/// <summary>
+	/// Gets the pixel value used for letterbox borders and for images that fail to decode.  Default value if unset: 0
+	/// </summary>
+	Byte TJTensorDecoder::getPaddingValue()
+	{
+		return paddingValue;
+	}
+
+	/// <summary>
+	/// Sets the decompression flags.  FASTDCT, ACCURATEDCT and FASTUPSAMPLE are honored.
+	/// Default value if unset: NONE
+	/// </summary>
+	void TJTensorDecoder::setFlags(Flag flags)
+	{
+		if ((int)flags < 0)
+			throw gcnew ArgumentException("Invalid argument in setFlags()");
+		this->flags = flags;
+	}
+
+	/// <summary>
+	/// Gets the decompression flags.  Default value if unset: NONE
+	/// </summary>
+	Flag TJTensorDecoder::getFlags()
+	{
+		return flags;
+	}
+
+	/// <summary>
+	/// Sets the largest number of images decoded at once by decodeBatch().  With 1, the
+	/// batch is decoded on the calling thread.  The number is also limited by the
+	/// scheduler's worker count.
+	/// Default value if unset: the number of processors
+	/// </summary>
+	void TJTensorDecoder::setMaxDegreeOfParallelism(int threads)
+	{
+		if (threads < 1)
+			throw gcnew ArgumentException("Invalid argument in setMaxDegreeOfParallelism()");
+		maxDegreeOfParallelism = threads;
+	}
+
+	/// <summary>
+	/// Gets the largest number of images decoded at once by decodeBatch().
+	/// Default value if unset: the number of processors
+	/// </summary>
+	int TJTensorDecoder::getMaxDegreeOfParallelism()
+	{
+		return maxDegreeOfParallelism;
+	}
+
+	/// <summary>
+	/// Sets the scheduler whose worker threads decodeBatch() runs on, or null for
+	/// TJScheduler.getShared().
+	/// Default value if unset: null
+	/// </summary>
+	void TJTensorDecoder::setScheduler(TJScheduler^ scheduler)
+	{
+		this->scheduler = scheduler;
+	}
+
+	/// <summary>
+	/// Gets the scheduler whose worker threads decodeBatch() runs on.
+	/// </summary>
+	TJScheduler^ TJTensorDecoder::getScheduler()
+	{
+		return scheduler != nullptr ? scheduler : TJScheduler::getShared();
+	}
+
+	/// <summary>
+	/// Returns the number of elements in a tensor holding <code>batchSize</code> images
+	/// (batchSize * channels * height * width).  Throws an ArgumentException if that is
+	/// more than an array can hold.
+	/// </summary>
+	int TJTensorDecoder::getTensorLength(int batchSize)
+	{
+		if (batchSize < 0)
+			throw gcnew ArgumentException("Invalid argument in getTensorLength()");
+		long long length = (long long)batchSize * getChannels() * width * height;
+		if (length > Int32::MaxValue)
+			throw gcnew ArgumentException("Invalid argument in getTensorLength()");
+		return (int)length;
+	}
+
+	int TJTensorDecoder::getChannels()
+	{
+		return TJ::getPixelSize(pixelFormat);
+	}
+
+	void TJTensorDecoder::getParams(tjcli_tensor_params* params)
+	{
+		params->width = width;
+		params->height = height;
+		params->pixelFormat = (int)pixelFormat;
+		params->channels = getChannels();
+		params->nhwc = layout == TensorLayout::NHWC ? 1 : 0;
+		params->letterbox = letterbox ? 1 : 0;
+		params->flags = (int)flags;
+		params->padValue = paddingValue;
+		for (int c = 0; c < 3; c++)
+		{
+			params->scale[c] = 1.0f / (255.0f * stdDev[c]);
+			params->bias[c] = -mean[c] / stdDev[c];
+		}
+	}
+
+	tjcli_tensor_ctx* TJTensorDecoder::getContext()
+	{
+		if (context == 0)
+		{
+			context = tjcliInitTensorContext();
+			if (context == 0)
+				throw gcnew TJException("Unable to create a libjpeg decompressor");
+		}
+		return context;
+	}
+
+	TensorImageInfo TJTensorDecoder::getImageInfo(int status, const tjcli_tensor_info* info, const char* message)
+	{
+		TensorImageInfo result = TensorImageInfo();
+		if (status == -1)
+		{
+			result.errorMessage = getSystemString(message);
+			return result;
+		}
+		result.succeeded = true;
+		result.sourceWidth = info->srcWidth;
+		result.sourceHeight = info->srcHeight;
+		result.contentX = info->contentX;
+		result.contentY = info->contentY;
+		result.contentWidth = info->contentWidth;
+		result.contentHeight = info->contentHeight;
+		return result;
+	}
+
+	TensorImageInfo TJTensorDecoder::decodeOne(array<Byte>^ jpegImage, Byte* slot, bool isFloat)
+	{
+		tjcli_tensor_params params;
+		getParams(&params);
+		if (jpegImage == nullptr || jpegImage->Length < 1)
+		{
+			tjcliFillTensor(&params, slot, isFloat ? 1 : 0);
+			return getImageInfo(-1, nullptr, "No JPEG image data");
+		}
+		tjcli_tensor_ctx* ctx = getContext();
+		tjcli_tensor_info info;
+		int status;
+		TJMemoryBudget^ budget = TJMemoryBudget::getShared();
+		{
+			pin_ptr<Byte> pinnedJpegImage = &jpegImage[0];
+			long long bytes = (long long)tjcliEstimateTensorMemory(ctx, pinnedJpegImage, (unsigned long)jpegImage->Length, &params);
+			try
+			{
+				budget->reserve(bytes, false);
+			}
+			catch (TJException^ ex)
+			{
+				tjcliFillTensor(&params, slot, isFloat ? 1 : 0);
+				TensorImageInfo rejected = TensorImageInfo();
+				rejected.errorMessage = ex->Message;
+				return rejected;
+			}
+			try
+			{
+				status = tjcliDecodeToTensor(ctx, pinnedJpegImage, (unsigned long)jpegImage->Length, &params, slot, isFloat ? 1 : 0, &info);
+			}
+			finally
+			{
+				budget->release(bytes);
+			}
+		}
+		if (status == -1)
+			tjcliFillTensor(&params, slot, isFloat ? 1 : 0);
+		return getImageInfo(status, &info, tjcliGetErrorStr(ctx));
+	}
+
+	TensorImageInfo TJTensorDecoder::decode(array<Byte>^ jpegImage, Array^ tensor, int batchIndex, bool isFloat)
+	{
+		int slotLength = getTensorLength(1);
+		if (jpegImage == nullptr || batchIndex < 0 || (Int64)(batchIndex + 1) * slotLength > tensor->Length)
+			throw gcnew ArgumentException("Invalid argument in decode()");
+		GCHandle pinned = GCHandle::Alloc(tensor, GCHandleType::Pinned);
+		TensorImageInfo result = TensorImageInfo();
+		try
+		{
+			Byte* slot = (Byte*)pinned.AddrOfPinnedObject().ToPointer() + (size_t)batchIndex * slotLength * (isFloat ? sizeof(float) : 1);
+			result = decodeOne(jpegImage, slot, isFloat);
+		}
+		finally
+		{
+			pinned.Free();
+		}
+		if (!result.succeeded)
+			throw gcnew TJException(result.errorMessage);
+		return result;
+	}
+
+	/// <summary>
+	/// Decodes one JPEG image into one slot of a float tensor.
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing exactly one compressed jpeg image.</param>
+	///
+	/// <param name="tensor">the tensor, which must hold at least <code>getTensorLength(batchIndex + 1)</code> values</param>
+	///
+	/// <param name="batchIndex">the slot of the tensor to fill</param>
+	///
+	/// <returns>where the image was placed within the slot</returns>
+	TensorImageInfo TJTensorDecoder::decode(array<Byte>^ jpegImage, array<float>^ tensor, int batchIndex)
+	{
+		if (tensor == nullptr)
+			throw gcnew ArgumentException("Invalid argument in decode()");
+		return decode(jpegImage, tensor, batchIndex, true);
+	}
+
+	/// <summary>
+	/// Decodes one JPEG image into one slot of a byte tensor.
+	/// </summary>
+	///
+	/// <param name="jpegImage">A byte array containing exactly one compressed jpeg image.</param>
+	///
+	/// <param name="tensor">the tensor, which must hold at least <code>getTensorLength(batchIndex + 1)</code> values</param>
+	///
+	/// <param name="batchIndex">the slot of the tensor to fill</param>
+	///
+	/// <returns>where the image was placed within the slot</returns>
+	TensorImageInfo TJTensorDecoder::decode(array<Byte>^ jpegImage, array<Byte>^ tensor, int batchIndex)
+	{
+		if (tensor == nullptr)
+			throw gcnew ArgumentException("Invalid argument in decode()");
+		return decode(jpegImage, tensor, batchIndex, false);
+	}
+
+	array<TensorImageInfo>^ TJTensorDecoder::decodeBatch(array<array<Byte>^>^ jpegImages, Array^ tensor, bool isFloat)
+	{
+		if (jpegImages == nullptr || (Int64)jpegImages->Length * getTensorLength(1) > tensor->Length)
+			throw gcnew ArgumentException("Invalid argument in decodeBatch()");
+		int count = jpegImages->Length;
+		array<TensorImageInfo>^ info = gcnew array<TensorImageInfo>(count);
+		if (count == 0)
+			return info;
+		size_t slotBytes = (size_t)getTensorLength(1) * (isFloat ? sizeof(float) : 1);
+		tjcli_scheduler* sched = maxDegreeOfParallelism > 1 ? getScheduler()->getHandle() : 0;
+		GCHandle pinned = GCHandle::Alloc(tensor, GCHandleType::Pinned);
+		array<GCHandle>^ pins = nullptr;
+		tjcli_tensor_job* jobs = 0;
+		TJBatchAdmission^ admission = nullptr;
+		try
+		{
+			Byte* dst = (Byte*)pinned.AddrOfPinnedObject().ToPointer();
+			if (sched == 0)
+			{
+				for (int i = 0; i < count; i++)
+					info[i] = decodeOne(jpegImages[i], dst + i * slotBytes, isFloat);
+				return info;
+			}
+			// One job per image, decoded with the workers' own tensor contexts.  Each image
+			// reserves its memory from the budget when it starts on a worker.
+			tjcli_tensor_params params;
+			getParams(&params);
+			admission = gcnew TJBatchAdmission(TJMemoryBudget::getShared(), count, pixelFormat);
+			tjcli_job_admission hooks;
+			admission->getHooks(&hooks);
+			pins = gcnew array<GCHandle>(count);
+			jobs = (tjcli_tensor_job*)calloc(count, sizeof(tjcli_tensor_job));
+			if (jobs == 0)
+				throw gcnew OutOfMemoryException();
+			for (int i = 0; i < count; i++)
+			{
+				array<Byte>^ jpegImage = jpegImages[i];
+				tjcli_tensor_job* job = &jobs[i];
+				job->pub.func = tjcliRunTensorJob;
+				job->params = &params;
+				job->dst = dst + i * slotBytes;
+				job->isFloat = isFloat ? 1 : 0;
+				job->index = i;
+				job->admission = &hooks;
+				if (jpegImage != nullptr && jpegImage->Length > 0)
+				{
+					pins[i] = GCHandle::Alloc(jpegImage, GCHandleType::Pinned);
+					job->jpegBuf = (const unsigned char*)pins[i].AddrOfPinnedObject().ToPointer();
+					job->jpegSize = (unsigned long)jpegImage->Length;
+				}
+			}
+			tjcli_job_group group;
+			tjcliRunJobs(sched, &group, &jobs[0].pub, sizeof(tjcli_tensor_job), count, maxDegreeOfParallelism);
+			for (int i = 0; i < count; i++)
+			{
+				info[i] = getImageInfo(jobs[i].status, &jobs[i].info, jobs[i].message);
+				if (admission->getError(i) != nullptr)
+					info[i].errorMessage = admission->getError(i)->Message;
+			}
+		}
+		finally
+		{
+			if (pins != nullptr)
+			{
+				for (int i = 0; i < count; i++)
+				{
+					if (pins[i].IsAllocated)
+						pins[i].Free();
+				}
+			}
+			free(jobs);
+			if (admission != nullptr)
+				admission->releaseAll();
+			pinned.Free();
+		}
+		return info;
+	}
+
+	/// <summary>
+	/// Decodes a batch of JPEG images into a float tensor, in parallel.  Image i fills
+	/// slot i.  An image that fails to decode does not abort the batch; its slot is
+	/// filled with the padding value and its TensorImageInfo reports the failure.
+	/// </summary>
+	///
+	/// <param name="jpegImages">the JPEG images.  Each array must contain exactly one JPEG image.</param>
+	///
+	/// <param name="tensor">the tensor, which must hold at least <code>getTensorLength(jpegImages.Length)</code> values.
+	/// Allocate it once and reuse it for every batch.</param>
+	///
+	/// <returns>one TensorImageInfo per image, in the same order as <code>jpegImages</code></returns>
+	array<TensorImageInfo>^ TJTensorDecoder::decodeBatch(array<array<Byte>^>^ jpegImages, array<float>^ tensor)
+	{
+		if (tensor == nullptr)
+			throw gcnew ArgumentException("Invalid argument in decodeBatch()");
+		return decodeBatch(jpegImages, tensor, true);
+	}
+
+	/// <summary>
+	/// Decodes a batch of JPEG images into a byte tensor, in parallel.  Image i fills
+	/// slot i.  An image that fails to decode does not abort the batch; its slot is
+	/// filled with the padding value and its TensorImageInfo reports the failure.
+	/// </summary>
+	///
+	/// <param name="jpegImages">the JPEG images.  Each array must contain exactly one JPEG image.</param>
+	///
+	/// <param name="tensor">the tensor, which must hold at least <code>getTensorLength(jpegImages.Length)</code> values.
+	/// Allocate it once and reuse it for every batch.</param>
+	///
+	/// <returns>one TensorImageInfo per image, in the same order as <code>jpegImages</code></returns>
+	array<TensorImageInfo>^ TJTensorDecoder::decodeBatch(array<array<Byte>^>^ jpegImages, array<Byte>^ tensor)
+	{
+		if (tensor == nullptr)
+			throw gcnew ArgumentException("Invalid argument in decodeBatch()");
+		return decodeBatch(jpegImages, tensor, false);
+	}
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "TJ.h"
+#include "tensornative.h"
+#include "TJScheduler.h"
+using namespace System;
+namespace turbojpegCLI
+{
+	public enum class TensorLayout
+	{
+		/// <summary>
+		/// Batch, channel, height, width: each image is stored as one plane per channel.
+		/// </summary>
+		NCHW = 0,
+		/// <summary>
+		/// Batch, height, width, channel: each image is stored with interleaved channels.
+		/// </summary>
+		NHWC = 1
+	};
+
+	/// <summary>
+	/// Describes where a decoded image was placed within its tensor slot.  Use this to map
+	/// model outputs (such as bounding boxes) back to source image coordinates.
+	/// </summary>
+	public value struct TensorImageInfo
+	{
+		/// <summary>
+		/// True if the image was decoded.  If false, the slot was filled with the padding value.
+		/// </summary>
+		bool succeeded;
+		/// <summary>
+		/// The reason the image could not be decoded, or null.
+		/// </summary>
+		String^ errorMessage;
+		/// <summary>
+		/// The width of the JPEG image.
+		/// </summary>
+		int sourceWidth;
+		/// <summary>
+		/// The height of the JPEG image.
+		/// </summary>
+		int sourceHeight;
+		/// <summary>
+		/// The left edge of the image within the slot (nonzero only when letterboxing).
+		/// </summary>
+		int contentX;
+		/// <summary>
+		/// The top edge of the image within the slot (nonzero only when letterboxing).
+		/// </summary>
+		int contentY;
+		/// <summary>
+		/// The width the image was resized to.
+		/// </summary>
+		int contentWidth;
+		/// <summary>
+		/// The height the image was resized to.
+		/// </summary>
+		int contentHeight;
+	};
+
+	/// <summary>
+	/// <para>Decodes JPEG images directly into the input tensor of a machine learning
+	/// model, in NCHW or NHWC layout, as normalized float32 values or as bytes.  Resizing
+	/// (optionally letterboxed), normalization and the layout conversion are fused into a
+	/// single SIMD pass after decoding, and most of the downscaling is done for free by
+	/// the IDCT, so there is no intermediate RGB image or managed per-pixel loop.</para>
+	/// <para>Batches are decoded in parallel on a TJScheduler.  Each image reserves its
+	/// estimated memory from TJMemoryBudget.getShared() while it is decoded; one the
+	/// budget rejects fails like an image which can not be decoded.  Instances are not
+	/// thread safe; use one per thread.</para>
+	/// </summary>
+	public ref class TJTensorDecoder
+	{
+	private:
+		tjcli_tensor_ctx* context;
+		int width;
+		int height;
+		TensorLayout layout;
+		PixelFormat pixelFormat;
+		bool letterbox;
+		Byte paddingValue;
+		array<float>^ mean;
+		array<float>^ stdDev;
+		Flag flags;
+		int maxDegreeOfParallelism;
+		TJScheduler^ scheduler;
+		bool isDisposed;
+		!TJTensorDecoder();
+
+		void Initialize()
+		{
+			context = 0;
+			layout = TensorLayout::NCHW;
+			pixelFormat = PixelFormat::RGB;
+			letterbox = false;
+			paddingValue = 0;
+			flags = Flag::NONE;
+			maxDegreeOfParallelism = Environment::ProcessorCount;
+			scheduler = nullptr;
+			isDisposed = false;
+		}
+
+		int getChannels();
+		void getParams(tjcli_tensor_params* params);
+		tjcli_tensor_ctx* getContext();
+		static TensorImageInfo getImageInfo(int status, const tjcli_tensor_info* info, const char* message);
+		TensorImageInfo decodeOne(array<Byte>^ jpegImage, Byte* slot, bool isFloat);
+		array<TensorImageInfo>^ decodeBatch(array<array<Byte>^>^ jpegImages, Array^ tensor, bool isFloat);
+		TensorImageInfo decode(array<Byte>^ jpegImage, Array^ tensor, int batchIndex, bool isFloat);
+	public:
+
+		TJTensorDecoder(int width, int height);
+		~TJTensorDecoder();
+
+		int getWidth();
+		int getHeight();
+		void setLayout(TensorLayout layout);
+		TensorLayout getLayout();
+		void setPixelFormat(PixelFormat pixelFormat);
+		PixelFormat getPixelFormat();
+		void setNormalization(array<float>^ mean, array<float>^ stdDev);
+		void setLetterbox(bool letterbox);
+		bool getLetterbox();
+		void setPaddingValue(Byte value);
+		Byte getPaddingValue();
+		void setFlags(Flag flags);
+		Flag getFlags();
+		void setMaxDegreeOfParallelism(int threads);
+		int getMaxDegreeOfParallelism();
+		void setScheduler(TJScheduler^ scheduler);
+		TJScheduler^ getScheduler();
+
+		int getTensorLength(int batchSize);
+
+		TensorImageInfo decode(array<Byte>^ jpegImage, array<float>^ tensor, int batchIndex);
+		TensorImageInfo decode(array<Byte>^ jpegImage, array<Byte>^ tensor, int batchIndex);
+		array<TensorImageInfo>^ decodeBatch(array<array<Byte>^>^ jpegImages, array<float>^ tensor);
+		array<TensorImageInfo>^ decodeBatch(array<array<Byte>^>^ jpegImages, array<Byte>^ tensor);
+	};
+}
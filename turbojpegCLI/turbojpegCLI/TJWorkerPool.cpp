@@ -0,0 +1,543 @@
+#include "TJWorkerPool.h"
+using namespace System::Diagnostics;
+
+namespace turbojpegCLI
+{
+	TJDecompressResult::TJDecompressResult(array<Byte>^ pixels, int width, int height, int pitch, PixelFormat pixelFormat)
+	{
+		this->pixels = pixels;
+		this->width = width;
+		this->height = height;
+		this->pitch = pitch;
+		this->pixelFormat = pixelFormat;
+	}
+
+	/// <summary>
+	/// Returns the decompressed pixels.
+	/// </summary>
+	array<Byte>^ TJDecompressResult::getPixels()
+	{
+		return pixels;
+	}
+
+	/// <summary>
+	/// Returns the width of the decompressed image, which is scaled if a desired size was given.
+	/// </summary>
+	int TJDecompressResult::getWidth()
+	{
+		return width;
+	}
+
+	/// <summary>
+	/// Returns the height of the decompressed image, which is scaled if a desired size was given.
+	/// </summary>
+	int TJDecompressResult::getHeight()
+	{
+		return height;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes per row in the pixel buffer.
+	/// </summary>
+	int TJDecompressResult::getPitch()
+	{
+		return pitch;
+	}
+
+	/// <summary>
+	/// Returns the pixel format of the pixel buffer.
+	/// </summary>
+	PixelFormat TJDecompressResult::getPixelFormat()
+	{
+		return pixelFormat;
+	}
+
+	/// <summary>
+	/// Called when the job's token is cancelled.  A job which is still queued is completed as
+	/// cancelled at once (the worker skips it later), and a running job is stopped by its
+	/// worker's libjpeg progress monitor and completed by the worker.
+	/// </summary>
+	void TJWorkerPool::Job::onCancel()
+	{
+		bool queued = false;
+		Monitor::Enter(pool->sync);
+		try
+		{
+			if (state == JobState::QUEUED)
+			{
+				state = JobState::CANCELLED;
+				queued = true;
+			}
+			else if (state == JobState::RUNNING)
+			{
+				runningDecompressor->setCancelRequested(true);
+				runningCompressor->setCancelRequested(true);
+			}
+		}
+		finally
+		{
+			Monitor::Exit(pool->sync);
+		}
+		// Outside the lock, since the Task's continuations may run right here.
+		if (queued && trySetCanceled())
+			Interlocked::Increment(pool->jobsCancelled);
+	}
+
+	void TJWorkerPool::DecompressJob::run(TJDecompressor^ decomp, TJCompressor^ comp)
+	{
+		decomp->setSourceImage(jpegImage, imageSize);
+		int width = decomp->getScaledWidth(desiredWidth, desiredHeight);
+		int height = decomp->getScaledHeight(desiredWidth, desiredHeight);
+		if (scaleDivisor > 1)
+		{
+			// Let the IDCT shrink the image further, to the largest scale within 1/scaleDivisor.
+			int fitWidth = Math::Max(width / scaleDivisor, 1);
+			int fitHeight = Math::Max(height / scaleDivisor, 1);
+			width = decomp->getScaledWidth(fitWidth, fitHeight);
+			height = decomp->getScaledHeight(fitWidth, fitHeight);
+		}
+		// The memory budget may shrink the image further, so the result has the size used.
+		array<Byte>^ pixels = decomp->decompressToFit(width, height, pixelFormat, flags);
+		completion->TrySetResult(gcnew TJDecompressResult(pixels, width, height, width * TJ::getPixelSize(pixelFormat), pixelFormat));
+	}
+
+	void TJWorkerPool::CompressJob::run(TJDecompressor^ decomp, TJCompressor^ comp)
+	{
+		comp->setSourceImage(srcImage, 0, 0, width, pitch, height, pixelFormat);
+		comp->setSubsamp(subsamp);
+		comp->setJPEGQuality(quality);
+		completion->TrySetResult(comp->compressToExactSize(flags));
+	}
+
+	/// <summary>
+	/// Constructs a TJWorkerPool with one worker thread per processor.
+	/// </summary>
+	TJWorkerPool::TJWorkerPool()
+	{
+		Initialize();
+		start(Environment::ProcessorCount);
+	}
+
+	/// <summary>
+	/// Constructs a TJWorkerPool with the given number of worker threads.
+	/// </summary>
+	TJWorkerPool::TJWorkerPool(int threadCount)
+	{
+		if (threadCount < 1)
+			throw gcnew ArgumentException("Invalid argument in TJWorkerPool()");
+		Initialize();
+		start(threadCount);
+	}
+
+	/// <summary>
+	/// Call this when finished with the TJWorkerPool to stop the worker threads.  Jobs which
+	/// are still queued are cancelled, and running jobs are finished first.  If you use a C#
+	/// using() block, you won't need to call this.
+	/// </summary>
+	TJWorkerPool::~TJWorkerPool()
+	{
+		// This method appears as "Dispose()" in C#.
+		if (isDisposed)
+			return;
+		array<Job^>^ abandoned;
+		Monitor::Enter(sync);
+		try
+		{
+			stopping = true;
+			abandoned = queue->ToArray();
+			queue->Clear();
+			for each (Job^ job in abandoned)
+			{
+				if (job->state == JobState::QUEUED)
+					job->state = JobState::CANCELLED;
+			}
+			Monitor::PulseAll(sync);
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+		for each (Job^ job in abandoned)
+		{
+			// Jobs cancelled by their token were already completed and counted.
+			if (job->trySetCanceled())
+				Interlocked::Increment(jobsCancelled);
+			delete job->registration;
+		}
+		for each (Thread^ worker in workers)
+		{
+			if (Thread::CurrentThread != worker)
+				worker->Join();
+		}
+		isDisposed = true;
+	}
+
+	/// <summary>
+	/// Returns a pool shared by the whole process, with one worker thread per processor.  It
+	/// is created the first time it is asked for, and must not be disposed.
+	/// </summary>
+	TJWorkerPool^ TJWorkerPool::getShared()
+	{
+		Monitor::Enter(sharedSync);
+		try
+		{
+			if (shared == nullptr)
+				shared = gcnew TJWorkerPool();
+			return shared;
+		}
+		finally
+		{
+			Monitor::Exit(sharedSync);
+		}
+	}
+
+	void TJWorkerPool::start(int threadCount)
+	{
+		workers = gcnew array<Thread^>(threadCount);
+		for (int i = 0; i < threadCount; i++)
+		{
+			workers[i] = gcnew Thread(gcnew ThreadStart(this, &TJWorkerPool::workerLoop));
+			workers[i]->IsBackground = true;
+			workers[i]->Name = "TJWorkerPool worker " + (i + 1);
+			workers[i]->Start();
+		}
+	}
+
+	/// <summary>
+	/// <para>Queues a JPEG image to be decompressed by a worker thread.</para>
+	/// </summary>
+	///
+	/// <param name="jpegImage">buffer containing the JPEG image</param>
+	///
+	/// <param name="imageSize">size of the JPEG image in bytes</param>
+	///
+	/// <param name="desiredWidth">desired width (in pixels) of the decompressed image, or 0
+	/// for the width of the JPEG image.  The image is scaled down by the IDCT to the largest
+	/// supported size which fits within the desired width and height.</param>
+	///
+	/// <param name="desiredHeight">desired height (in pixels) of the decompressed image, or 0
+	/// for the height of the JPEG image</param>
+	///
+	/// <param name="pixelFormat">pixel format of the decompressed image</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of the Flag enum values</param>
+	///
+	/// <param name="cancellationToken">token which cancels the job, whether it is queued or running</param>
+	///
+	/// <returns>a Task which completes with the decompressed image, and faults with a
+	/// TJException if the image could not be decompressed</returns>
+	Task<TJDecompressResult^>^ TJWorkerPool::decompressAsync(array<Byte>^ jpegImage, int imageSize, int desiredWidth, int desiredHeight, PixelFormat pixelFormat, Flag flags, CancellationToken cancellationToken)
+	{
+		return decompressAsync(jpegImage, imageSize, desiredWidth, desiredHeight, 1, pixelFormat, flags, cancellationToken);
+	}
+
+	Task<TJDecompressResult^>^ TJWorkerPool::decompressAsync(array<Byte>^ jpegImage, int imageSize, int desiredWidth, int desiredHeight, int scaleDivisor, PixelFormat pixelFormat, Flag flags, CancellationToken cancellationToken)
+	{
+		if (jpegImage == nullptr || imageSize < 1 || jpegImage->Length < imageSize || desiredWidth < 0 || desiredHeight < 0 || scaleDivisor < 1 || (int)flags < 0)
+			throw gcnew ArgumentException("Invalid argument in decompressAsync()");
+		TJ::checkPixelFormat(pixelFormat);
+		DecompressJob^ job = gcnew DecompressJob();
+		job->completion = gcnew TaskCompletionSource<TJDecompressResult^>();
+		job->jpegImage = jpegImage;
+		job->imageSize = imageSize;
+		job->desiredWidth = desiredWidth;
+		job->desiredHeight = desiredHeight;
+		job->scaleDivisor = scaleDivisor;
+		job->pixelFormat = pixelFormat;
+		job->flags = flags;
+		job->token = cancellationToken;
+		submit(job);
+		return job->completion->Task;
+	}
+
+	/// <summary>
+	/// Queues a JPEG image to be decompressed at full size by a worker thread.
+	/// </summary>
+	Task<TJDecompressResult^>^ TJWorkerPool::decompressAsync(array<Byte>^ jpegImage, PixelFormat pixelFormat, Flag flags)
+	{
+		if (jpegImage == nullptr)
+			throw gcnew ArgumentException("Invalid argument in decompressAsync()");
+		return decompressAsync(jpegImage, jpegImage->Length, 0, 0, pixelFormat, flags, CancellationToken::None);
+	}
+
+	/// <summary>
+	/// <para>Queues an image to be compressed by a worker thread.</para>
+	/// </summary>
+	///
+	/// <param name="srcImage">buffer containing the uncompressed image</param>
+	///
+	/// <param name="width">width (in pixels) of the image</param>
+	///
+	/// <param name="pitch">bytes per row of the image, or 0 for unpadded rows</param>
+	///
+	/// <param name="height">height (in pixels) of the image</param>
+	///
+	/// <param name="pixelFormat">pixel format of the image</param>
+	///
+	/// <param name="subsamp">the level of chrominance subsampling to use</param>
+	///
+	/// <param name="quality">the JPEG image quality level (1 to 100)</param>
+	///
+	/// <param name="flags">the bitwise OR of one or more of the Flag enum values</param>
+	///
+	/// <param name="cancellationToken">token which cancels the job, whether it is queued or running</param>
+	///
+	/// <returns>a Task which completes with the JPEG image, in an array of exactly its size</returns>
+	Task<array<Byte>^>^ TJWorkerPool::compressAsync(array<Byte>^ srcImage, int width, int pitch, int height, PixelFormat pixelFormat, SubsamplingOption subsamp, int quality, Flag flags, CancellationToken cancellationToken)
+	{
+		if (srcImage == nullptr || width < 1 || pitch < 0 || height < 1 || quality < 1 || quality > 100 || (int)flags < 0)
+			throw gcnew ArgumentException("Invalid argument in compressAsync()");
+		TJ::checkPixelFormat(pixelFormat);
+		TJ::checkSubsampling(subsamp);
+		CompressJob^ job = gcnew CompressJob();
+		job->completion = gcnew TaskCompletionSource<array<Byte>^>();
+		job->srcImage = srcImage;
+		job->width = width;
+		job->pitch = pitch;
+		job->height = height;
+		job->pixelFormat = pixelFormat;
+		job->subsamp = subsamp;
+		job->quality = quality;
+		job->flags = flags;
+		job->token = cancellationToken;
+		submit(job);
+		return job->completion->Task;
+	}
+
+	/// <summary>
+	/// Queues an image with unpadded rows to be compressed by a worker thread, with 4:2:0
+	/// subsampling.
+	/// </summary>
+	Task<array<Byte>^>^ TJWorkerPool::compressAsync(array<Byte>^ srcImage, int width, int height, PixelFormat pixelFormat, int quality)
+	{
+		return compressAsync(srcImage, width, 0, height, pixelFormat, SubsamplingOption::SAMP_420, quality, Flag::NONE, CancellationToken::None);
+	}
+
+	void TJWorkerPool::submit(Job^ job)
+	{
+		job->pool = this;
+		job->state = JobState::QUEUED;
+		if (job->token.IsCancellationRequested)
+		{
+			job->trySetCanceled();
+			Interlocked::Increment(jobsCancelled);
+			return;
+		}
+		if (job->token.CanBeCanceled)
+			job->registration = safe_cast<IDisposable^>(job->token.Register(gcnew Action(job, &Job::onCancel)));
+		bool rejected = false;
+		Monitor::Enter(sync);
+		try
+		{
+			rejected = stopping;
+			if (!rejected)
+			{
+				job->queuedAt = Stopwatch::GetTimestamp();
+				queue->Enqueue(job);
+				jobsSubmitted++;
+				if (queue->Count > peakQueueDepth)
+					peakQueueDepth = queue->Count;
+				Monitor::Pulse(sync);
+			}
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+		if (rejected)
+		{
+			// Disposing the registration waits for a running onCancel, which takes the
+			// lock, so it is only done once the lock is released.
+			delete job->registration;
+			throw gcnew ObjectDisposedException("TJWorkerPool");
+		}
+	}
+
+	void TJWorkerPool::workerLoop()
+	{
+		TJDecompressor^ decomp = gcnew TJDecompressor();
+		TJCompressor^ comp = gcnew TJCompressor();
+		try
+		{
+			for (;;)
+			{
+				Job^ job = nullptr;
+				Monitor::Enter(sync);
+				try
+				{
+					while (queue->Count == 0 && !stopping)
+						Monitor::Wait(sync);
+					if (queue->Count > 0)
+					{
+						job = queue->Dequeue();
+						busyWorkers++;
+						jobsStarted++;
+						totalQueueTicks += Stopwatch::GetTimestamp() - job->queuedAt;
+						// A job cancelled while it was queued has already been completed.
+						if (job->state == JobState::QUEUED)
+						{
+							decomp->setCancelRequested(false);
+							comp->setCancelRequested(false);
+							job->runningDecompressor = decomp;
+							job->runningCompressor = comp;
+							job->state = JobState::RUNNING;
+						}
+					}
+				}
+				finally
+				{
+					Monitor::Exit(sync);
+				}
+				if (job == nullptr)
+					break;
+				try
+				{
+					runJob(job, decomp, comp);
+				}
+				finally
+				{
+					Monitor::Enter(sync);
+					busyWorkers--;
+					Monitor::Exit(sync);
+				}
+			}
+		}
+		finally
+		{
+			delete decomp;
+			delete comp;
+		}
+	}
+
+	void TJWorkerPool::runJob(Job^ job, TJDecompressor^ decomp, TJCompressor^ comp)
+	{
+		if (job->state == JobState::RUNNING)
+		{
+			try
+			{
+				job->run(decomp, comp);
+				Interlocked::Increment(jobsCompleted);
+			}
+			catch (Exception^ ex)
+			{
+				if (job->token.IsCancellationRequested)
+				{
+					if (job->trySetCanceled())
+						Interlocked::Increment(jobsCancelled);
+				}
+				else
+				{
+					job->trySetException(ex);
+					Interlocked::Increment(jobsFailed);
+				}
+			}
+			Monitor::Enter(sync);
+			job->state = JobState::DONE;
+			job->runningDecompressor = nullptr;
+			job->runningCompressor = nullptr;
+			Monitor::Exit(sync);
+		}
+		delete job->registration;
+	}
+
+	/// <summary>
+	/// Returns the number of worker threads.
+	/// </summary>
+	int TJWorkerPool::getThreadCount()
+	{
+		return workers->Length;
+	}
+
+	/// <summary>
+	/// Returns the number of jobs waiting for a worker, including cancelled jobs which have
+	/// not been reached yet.
+	/// </summary>
+	int TJWorkerPool::getQueueDepth()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return queue->Count;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+
+	/// <summary>
+	/// Returns the largest number of jobs which have been waiting at once, since the pool was
+	/// created or resetPeakQueueDepth() was called.
+	/// </summary>
+	int TJWorkerPool::getPeakQueueDepth()
+	{
+		return peakQueueDepth;
+	}
+
+	/// <summary>
+	/// Starts measuring getPeakQueueDepth() again from the current queue depth.
+	/// </summary>
+	void TJWorkerPool::resetPeakQueueDepth()
+	{
+		Monitor::Enter(sync);
+		peakQueueDepth = queue->Count;
+		Monitor::Exit(sync);
+	}
+
+	/// <summary>
+	/// Returns the number of workers which are running a job.
+	/// </summary>
+	int TJWorkerPool::getBusyWorkers()
+	{
+		return busyWorkers;
+	}
+
+	/// <summary>
+	/// Returns the number of jobs which have been queued.
+	/// </summary>
+	long long TJWorkerPool::getJobsSubmitted()
+	{
+		return Interlocked::Read(jobsSubmitted);
+	}
+
+	/// <summary>
+	/// Returns the number of jobs which completed successfully.
+	/// </summary>
+	long long TJWorkerPool::getJobsCompleted()
+	{
+		return Interlocked::Read(jobsCompleted);
+	}
+
+	/// <summary>
+	/// Returns the number of jobs which were cancelled, whether queued or running.
+	/// </summary>
+	long long TJWorkerPool::getJobsCancelled()
+	{
+		return Interlocked::Read(jobsCancelled);
+	}
+
+	/// <summary>
+	/// Returns the number of jobs which failed, usually because an image was corrupt.
+	/// </summary>
+	long long TJWorkerPool::getJobsFailed()
+	{
+		return Interlocked::Read(jobsFailed);
+	}
+
+	/// <summary>
+	/// Returns the average time, in milliseconds, that jobs waited in the queue before a worker
+	/// started them.
+	/// </summary>
+	double TJWorkerPool::getAverageQueueTime()
+	{
+		Monitor::Enter(sync);
+		try
+		{
+			return jobsStarted == 0 ? 0 : (double)totalQueueTicks * 1000 / Stopwatch::Frequency / jobsStarted;
+		}
+		finally
+		{
+			Monitor::Exit(sync);
+		}
+	}
+}
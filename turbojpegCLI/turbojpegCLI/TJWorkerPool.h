@@ -0,0 +1,177 @@
+#pragma once
+#include "TJ.h"
+#include "TJDecompressor.h"
+#include "TJCompressor.h"
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Threading;
+using namespace System::Threading::Tasks;
+namespace turbojpegCLI
+{
+	/// <summary>
+	/// An image decompressed by TJWorkerPool.decompressAsync().
+	/// </summary>
+	public ref class TJDecompressResult
+	{
+	private:
+		array<Byte>^ pixels;
+		int width;
+		int height;
+		int pitch;
+		PixelFormat pixelFormat;
+	internal:
+		TJDecompressResult(array<Byte>^ pixels, int width, int height, int pitch, PixelFormat pixelFormat);
+	public:
+		array<Byte>^ getPixels();
+		int getWidth();
+		int getHeight();
+		int getPitch();
+		PixelFormat getPixelFormat();
+	};
+
+	/// <summary>
+	/// <para>Runs compression and decompression on a fixed set of dedicated worker threads,
+	/// each with its own TJDecompressor and TJCompressor (and so its own libjpeg handles),
+	/// and reports completion through a Task.  The calling thread, such as an ASP.NET
+	/// request thread, is free while the image is processed, and unlike Task.Run() no
+	/// thread pool thread is blocked in libjpeg either.</para>
+	/// <para>Jobs are queued and run in the order they were submitted.  A job whose
+	/// CancellationToken is cancelled while it waits is never run, and one which is running
+	/// stops at the next group of rows.  Either way its Task is cancelled.</para>
+	/// <para>The arrays passed in are used by a worker thread until the Task completes, so
+	/// do not modify them before then.  Tasks are completed on the worker threads.</para>
+	/// <para>Instances are thread safe.</para>
+	/// </summary>
+	public ref class TJWorkerPool
+	{
+	private:
+		/// <summary>
+		/// Where a job is.  Changed only under the pool's lock, so a job is either cancelled
+		/// while queued or run, never both.
+		/// </summary>
+		enum class JobState
+		{
+			QUEUED,
+			RUNNING,
+			CANCELLED,
+			DONE
+		};
+
+		ref class Job abstract
+		{
+		public:
+			TJWorkerPool^ pool;
+			CancellationToken token;
+			IDisposable^ registration;
+			JobState state;
+			TJDecompressor^ runningDecompressor;
+			TJCompressor^ runningCompressor;
+			long long queuedAt;
+
+			virtual void run(TJDecompressor^ decomp, TJCompressor^ comp) abstract;
+			virtual bool trySetCanceled() abstract;
+			virtual bool trySetException(Exception^ ex) abstract;
+			void onCancel();
+		};
+
+		ref class DecompressJob : Job
+		{
+		public:
+			TaskCompletionSource<TJDecompressResult^>^ completion;
+			array<Byte>^ jpegImage;
+			int imageSize;
+			int desiredWidth;
+			int desiredHeight;
+			int scaleDivisor;
+			PixelFormat pixelFormat;
+			Flag flags;
+
+			virtual void run(TJDecompressor^ decomp, TJCompressor^ comp) override;
+			virtual bool trySetCanceled() override { return completion->TrySetCanceled(); }
+			virtual bool trySetException(Exception^ ex) override { return completion->TrySetException(ex); }
+		};
+
+		ref class CompressJob : Job
+		{
+		public:
+			TaskCompletionSource<array<Byte>^>^ completion;
+			array<Byte>^ srcImage;
+			int width;
+			int pitch;
+			int height;
+			PixelFormat pixelFormat;
+			SubsamplingOption subsamp;
+			int quality;
+			Flag flags;
+
+			virtual void run(TJDecompressor^ decomp, TJCompressor^ comp) override;
+			virtual bool trySetCanceled() override { return completion->TrySetCanceled(); }
+			virtual bool trySetException(Exception^ ex) override { return completion->TrySetException(ex); }
+		};
+
+		static Object^ sharedSync;
+		static TJWorkerPool^ shared;
+		Object^ sync;
+		Queue<Job^>^ queue;
+		array<Thread^>^ workers;
+		bool stopping;
+		int busyWorkers;
+		int peakQueueDepth;
+		long long jobsSubmitted;
+		long long jobsCompleted;
+		long long jobsCancelled;
+		long long jobsFailed;
+		long long jobsStarted;
+		long long totalQueueTicks;
+		bool isDisposed;
+
+		void Initialize()
+		{
+			sync = gcnew Object();
+			queue = gcnew Queue<Job^>();
+			workers = nullptr;
+			stopping = false;
+			busyWorkers = 0;
+			peakQueueDepth = 0;
+			jobsSubmitted = 0;
+			jobsCompleted = 0;
+			jobsCancelled = 0;
+			jobsFailed = 0;
+			jobsStarted = 0;
+			totalQueueTicks = 0;
+			isDisposed = false;
+		}
+
+		void start(int threadCount);
+		void submit(Job^ job);
+		void workerLoop();
+		void runJob(Job^ job, TJDecompressor^ decomp, TJCompressor^ comp);
+		static TJWorkerPool()
+		{
+			sharedSync = gcnew Object();
+		}
+	internal:
+		Task<TJDecompressResult^>^ decompressAsync(array<Byte>^ jpegImage, int imageSize, int desiredWidth, int desiredHeight, int scaleDivisor, PixelFormat pixelFormat, Flag flags, CancellationToken cancellationToken);
+	public:
+		TJWorkerPool();
+		TJWorkerPool(int threadCount);
+		~TJWorkerPool();
+		static TJWorkerPool^ getShared();
+
+		Task<TJDecompressResult^>^ decompressAsync(array<Byte>^ jpegImage, int imageSize, int desiredWidth, int desiredHeight, PixelFormat pixelFormat, Flag flags, CancellationToken cancellationToken);
+		Task<TJDecompressResult^>^ decompressAsync(array<Byte>^ jpegImage, PixelFormat pixelFormat, Flag flags);
+		Task<array<Byte>^>^ compressAsync(array<Byte>^ srcImage, int width, int pitch, int height, PixelFormat pixelFormat, SubsamplingOption subsamp, int quality, Flag flags, CancellationToken cancellationToken);
+		Task<array<Byte>^>^ compressAsync(array<Byte>^ srcImage, int width, int height, PixelFormat pixelFormat, int quality);
+
+		int getThreadCount();
+		int getQueueDepth();
+		int getPeakQueueDepth();
+		int getBusyWorkers();
+		long long getJobsSubmitted();
+		long long getJobsCompleted();
+		long long getJobsCancelled();
+		long long getJobsFailed();
+		double getAverageQueueTime();
+		void resetPeakQueueDepth();
+	};
+}
@@ -0,0 +1,391 @@
+#include "arenanative.h"
+#pragma managed( push, off )
+#include <stdlib.h>
+#include <string.h>
+
+// Every allocation is aligned to this many bytes, as libjpeg-turbo's SIMD code expects.
+// Sample rows are padded to a multiple of twice as much, like libjpeg's own manager does,
+// because the AVX2 code processes 64 samples at a time and may run past the end of a row.
+#define TJCLI_ARENA_ALIGN 32
+#define TJCLI_ARENA_MIN_CHUNK 65536
+
+/// <summary>
+/// A block of heap memory which allocations are carved from.  retained is set once
+/// the chunk has survived a reset, so allocations from it count as avoided.
+/// </summary>
+struct tjcli_arena_chunk
+{
+	tjcli_arena_chunk* next;
+	unsigned char* data;
+	size_t size;
+	size_t used;
+	int retained;
+};
+
+/// <summary>
+/// The chunks of one libjpeg pool (JPOOL_PERMANENT or JPOOL_IMAGE).  chunks is the
+/// chunk currently being filled, followed by the full ones.
+/// </summary>
+struct tjcli_arena_pool
+{
+	tjcli_arena_chunk* chunks;
+	size_t used;
+	size_t capacity;
+};
+
+/// <summary>
+/// Virtual arrays are always kept entirely in memory, so these only record the
+/// request until realize_virt_arrays() and then which rows have been written.
+/// libjpeg only declares these structs, so the memory manager defines them.
+/// </summary>
+struct jvirt_sarray_control
+{
+	JSAMPARRAY memBuffer;
+	JDIMENSION rowsInArray;
+	JDIMENSION samplesPerRow;
+	JDIMENSION maxAccess;
+	JDIMENSION firstUndefRow;
+	boolean preZero;
+	jvirt_sarray_ptr next;
+};
+
+struct jvirt_barray_control
+{
+	JBLOCKARRAY memBuffer;
+	JDIMENSION rowsInArray;
+	JDIMENSION blocksPerRow;
+	JDIMENSION maxAccess;
+	JDIMENSION firstUndefRow;
+	boolean preZero;
+	jvirt_barray_ptr next;
+};
+
+/// <summary>
+/// The arena.  base is the manager jpeg_create_*() set up, which still owns the
+/// objects allocated before the arena was installed; it is destroyed with the arena.
+/// </summary>
+struct tjcli_arena
+{
+	struct jpeg_memory_mgr pub;
+	struct jpeg_memory_mgr* base;
+	tjcli_arena_pool pools[JPOOL_NUMPOOLS];
+	jvirt_sarray_ptr virtSarrays;
+	jvirt_barray_ptr virtBarrays;
+	tjcli_arena_stats stats;
+};
+
+static size_t tjcliArenaRoundUp(size_t size)
+{
+	return (size + TJCLI_ARENA_ALIGN - 1) & ~(size_t)(TJCLI_ARENA_ALIGN - 1);
+}
+
+static tjcli_arena_chunk* tjcliArenaNewChunk(tjcli_arena* arena, size_t size)
+{
+	// The chunk header and alignment slack share the heap block with the data.
+	tjcli_arena_chunk* chunk = (tjcli_arena_chunk*)malloc(sizeof(tjcli_arena_chunk) + size + TJCLI_ARENA_ALIGN);
+	if (chunk == NULL)
+		return NULL;
+	size_t start = (size_t)(chunk + 1);
+	chunk->data = (unsigned char*)tjcliArenaRoundUp(start);
+	chunk->size = size;
+	chunk->used = 0;
+	chunk->retained = 0;
+	chunk->next = NULL;
+	arena->stats.bytesReserved += size;
+	arena->stats.heapAllocations++;
+	return chunk;
+}
+
+static void tjcliArenaFreeChunks(tjcli_arena* arena, tjcli_arena_pool* pool)
+{
+	tjcli_arena_chunk* chunk = pool->chunks;
+	while (chunk != NULL)
+	{
+		tjcli_arena_chunk* next = chunk->next;
+		arena->stats.bytesReserved -= chunk->size;
+		free(chunk);
+		chunk = next;
+	}
+	pool->chunks = NULL;
+	pool->used = 0;
+	pool->capacity = 0;
+}
+
+static void* tjcliArenaAlloc(j_common_ptr cinfo, int poolId, size_t size)
+{
+	tjcli_arena* arena = (tjcli_arena*)cinfo->mem;
+	if (poolId < 0 || poolId >= JPOOL_NUMPOOLS)
+		ERREXIT1(cinfo, JERR_BAD_POOL_ID, poolId);
+	if (size > (size_t)-1 / 2)
+		ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 1);
+	size = tjcliArenaRoundUp(size == 0 ? 1 : size);
+	arena->stats.allocationRequests++;
+
+	tjcli_arena_pool* pool = &arena->pools[poolId];
+	tjcli_arena_chunk* chunk = pool->chunks;
+	if (chunk != NULL && chunk->size - chunk->used >= size)
+	{
+		if (chunk->retained)
+			arena->stats.allocationsAvoided++;
+	}
+	else
+	{
+		// Grow geometrically so an image needs only a few chunks before the reset
+		// consolidates them.
+		size_t chunkSize = pool->capacity > TJCLI_ARENA_MIN_CHUNK ? pool->capacity : TJCLI_ARENA_MIN_CHUNK;
+		if (chunkSize < size)
+			chunkSize = size;
+		chunk = tjcliArenaNewChunk(arena, chunkSize);
+		if (chunk == NULL)
+			ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 2);
+		chunk->next = pool->chunks;
+		pool->chunks = chunk;
+		pool->capacity += chunkSize;
+	}
+
+	void* result = chunk->data + chunk->used;
+	chunk->used += size;
+	pool->used += size;
+	unsigned long long inUse = arena->pools[JPOOL_PERMANENT].used + arena->pools[JPOOL_IMAGE].used;
+	if (inUse > arena->stats.peakUsage)
+		arena->stats.peakUsage = inUse;
+	return result;
+}
+
+static void* tjcliArenaAllocSmall(j_common_ptr cinfo, int poolId, size_t size)
+{
+	return tjcliArenaAlloc(cinfo, poolId, size);
+}
+
+static void* tjcliArenaAllocLarge(j_common_ptr cinfo, int poolId, size_t size)
+{
+	return tjcliArenaAlloc(cinfo, poolId, size);
+}
+
+static JSAMPARRAY tjcliArenaAllocSarray(j_common_ptr cinfo, int poolId, JDIMENSION samplesPerRow, JDIMENSION numRows)
+{
+	size_t rowAlign = 2 * TJCLI_ARENA_ALIGN;
+	size_t rowSize = ((size_t)samplesPerRow * sizeof(JSAMPLE) + rowAlign - 1) & ~(rowAlign - 1);
+	JSAMPARRAY result = (JSAMPARRAY)tjcliArenaAlloc(cinfo, poolId, (size_t)numRows * sizeof(JSAMPROW));
+	if (numRows == 0)
+		return result;
+	if (rowSize > ((size_t)-1 / 2) / numRows)
+		ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 3);
+	JSAMPLE* rows = (JSAMPLE*)tjcliArenaAlloc(cinfo, poolId, rowSize * numRows);
+	for (JDIMENSION i = 0; i < numRows; i++)
+		result[i] = rows + rowSize * i;
+	return result;
+}
+
+static JBLOCKARRAY tjcliArenaAllocBarray(j_common_ptr cinfo, int poolId, JDIMENSION blocksPerRow, JDIMENSION numRows)
+{
+	size_t rowSize = (size_t)blocksPerRow * sizeof(JBLOCK);
+	JBLOCKARRAY result = (JBLOCKARRAY)tjcliArenaAlloc(cinfo, poolId, (size_t)numRows * sizeof(JBLOCKROW));
+	if (numRows == 0)
+		return result;
+	if (rowSize > ((size_t)-1 / 2) / numRows)
+		ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 4);
+	JBLOCKROW rows = (JBLOCKROW)tjcliArenaAlloc(cinfo, poolId, rowSize * numRows);
+	for (JDIMENSION i = 0; i < numRows; i++)
+		result[i] = rows + (size_t)blocksPerRow * i;
+	return result;
+}
+
+static jvirt_sarray_ptr tjcliArenaRequestVirtSarray(j_common_ptr cinfo, int poolId, boolean preZero, JDIMENSION samplesPerRow, JDIMENSION numRows, JDIMENSION maxAccess)
+{
+	tjcli_arena* arena = (tjcli_arena*)cinfo->mem;
+	// Virtual arrays are only allowed in the image pool, as with libjpeg's manager.
+	if (poolId != JPOOL_IMAGE)
+		ERREXIT1(cinfo, JERR_BAD_POOL_ID, poolId);
+	jvirt_sarray_ptr result = (jvirt_sarray_ptr)tjcliArenaAlloc(cinfo, poolId, sizeof(struct jvirt_sarray_control));
+	result->memBuffer = NULL;
+	result->rowsInArray = numRows;
+	result->samplesPerRow = samplesPerRow;
+	result->maxAccess = maxAccess;
+	result->firstUndefRow = 0;
+	result->preZero = preZero;
+	result->next = arena->virtSarrays;
+	arena->virtSarrays = result;
+	return result;
+}
+
+static jvirt_barray_ptr tjcliArenaRequestVirtBarray(j_common_ptr cinfo, int poolId, boolean preZero, JDIMENSION blocksPerRow, JDIMENSION numRows, JDIMENSION maxAccess)
+{
+	tjcli_arena* arena = (tjcli_arena*)cinfo->mem;
+	if (poolId != JPOOL_IMAGE)
+		ERREXIT1(cinfo, JERR_BAD_POOL_ID, poolId);
+	jvirt_barray_ptr result = (jvirt_barray_ptr)tjcliArenaAlloc(cinfo, poolId, sizeof(struct jvirt_barray_control));
+	result->memBuffer = NULL;
+	result->rowsInArray = numRows;
+	result->blocksPerRow = blocksPerRow;
+	result->maxAccess = maxAccess;
+	result->firstUndefRow = 0;
+	result->preZero = preZero;
+	result->next = arena->virtBarrays;
+	arena->virtBarrays = result;
+	return result;
+}
+
+static void tjcliArenaRealizeVirtArrays(j_common_ptr cinfo)
+{
+	tjcli_arena* arena = (tjcli_arena*)cinfo->mem;
+	for (jvirt_sarray_ptr sptr = arena->virtSarrays; sptr != NULL; sptr = sptr->next)
+	{
+		if (sptr->memBuffer == NULL)
+			sptr->memBuffer = tjcliArenaAllocSarray(cinfo, JPOOL_IMAGE, sptr->samplesPerRow, sptr->rowsInArray);
+	}
+	for (jvirt_barray_ptr bptr = arena->virtBarrays; bptr != NULL; bptr = bptr->next)
+	{
+		if (bptr->memBuffer == NULL)
+			bptr->memBuffer = tjcliArenaAllocBarray(cinfo, JPOOL_IMAGE, bptr->blocksPerRow, bptr->rowsInArray);
+	}
+}
+
+/// <summary>
+/// Checks an access to rows [startRow, endRow) of a virtual array and updates the first
+/// row which has not been written yet, the way libjpeg's manager does for arrays held in
+/// memory.  Returns the first row which must be zeroed, or endRow if none.
+/// </summary>
+static JDIMENSION tjcliArenaCheckAccess(j_common_ptr cinfo, JDIMENSION* firstUndefRow, boolean preZero, JDIMENSION startRow, JDIMENSION endRow, boolean writable)
+{
+	if (*firstUndefRow >= endRow)
+		return endRow;
+	JDIMENSION undefRow;
+	if (*firstUndefRow < startRow)
+	{
+		// Rows may not be skipped when writing.
+		if (writable)
+			ERREXIT(cinfo, JERR_BAD_VIRTUAL_ACCESS);
+		undefRow = startRow;
+	}
+	else
+		undefRow = *firstUndefRow;
+	if (writable)
+		*firstUndefRow = endRow;
+	if (!preZero)
+	{
+		if (!writable)
+			ERREXIT(cinfo, JERR_BAD_VIRTUAL_ACCESS);
+		return endRow;
+	}
+	return undefRow;
+}
+
+static JSAMPARRAY tjcliArenaAccessVirtSarray(j_common_ptr cinfo, jvirt_sarray_ptr ptr, JDIMENSION startRow, JDIMENSION numRows, boolean writable)
+{
+	JDIMENSION endRow = startRow + numRows;
+	if (endRow > ptr->rowsInArray || numRows > ptr->maxAccess || ptr->memBuffer == NULL)
+		ERREXIT(cinfo, JERR_BAD_VIRTUAL_ACCESS);
+	JDIMENSION undefRow = tjcliArenaCheckAccess(cinfo, &ptr->firstUndefRow, ptr->preZero, startRow, endRow, writable);
+	// The arena's memory is reused between images, so zeroing can't be left to the heap.
+	for (; undefRow < endRow; undefRow++)
+		memset(ptr->memBuffer[undefRow], 0, (size_t)ptr->samplesPerRow * sizeof(JSAMPLE));
+	return ptr->memBuffer + startRow;
+}
+
+static JBLOCKARRAY tjcliArenaAccessVirtBarray(j_common_ptr cinfo, jvirt_barray_ptr ptr, JDIMENSION startRow, JDIMENSION numRows, boolean writable)
+{
+	JDIMENSION endRow = startRow + numRows;
+	if (endRow > ptr->rowsInArray || numRows > ptr->maxAccess || ptr->memBuffer == NULL)
+		ERREXIT(cinfo, JERR_BAD_VIRTUAL_ACCESS);
+	JDIMENSION undefRow = tjcliArenaCheckAccess(cinfo, &ptr->firstUndefRow, ptr->preZero, startRow, endRow, writable);
+	for (; undefRow < endRow; undefRow++)
+		memset(ptr->memBuffer[undefRow], 0, (size_t)ptr->blocksPerRow * sizeof(JBLOCK));
+	return ptr->memBuffer + startRow;
+}
+
+static void tjcliArenaFreePool(j_common_ptr cinfo, int poolId)
+{
+	tjcli_arena* arena = (tjcli_arena*)cinfo->mem;
+	if (poolId < 0 || poolId >= JPOOL_NUMPOOLS)
+		ERREXIT1(cinfo, JERR_BAD_POOL_ID, poolId);
+	tjcli_arena_pool* pool = &arena->pools[poolId];
+	if (poolId == JPOOL_PERMANENT)
+	{
+		tjcliArenaFreeChunks(arena, pool);
+		// libjpeg's manager frees its own permanent pool as well.  It finds its state
+		// through cinfo->mem, so it has to be put back while it runs.
+		cinfo->mem = arena->base;
+		(*arena->base->free_pool)(cinfo, poolId);
+		cinfo->mem = &arena->pub;
+		return;
+	}
+
+	arena->virtSarrays = NULL;
+	arena->virtBarrays = NULL;
+	if (pool->used == 0)
+		return;
+	arena->stats.imagesReset++;
+	if (pool->chunks != NULL && pool->chunks->next != NULL)
+	{
+		// This image needed several chunks; replace them with one that fits all of it,
+		// so the next image of the same size is served from a single chunk.
+		size_t needed = pool->used;
+		tjcliArenaFreeChunks(arena, pool);
+		tjcli_arena_chunk* chunk = tjcliArenaNewChunk(arena, needed);
+		// If that fails, the next image simply allocates as it goes.
+		if (chunk != NULL)
+		{
+			pool->chunks = chunk;
+			pool->capacity = needed;
+		}
+	}
+	for (tjcli_arena_chunk* chunk = pool->chunks; chunk != NULL; chunk = chunk->next)
+	{
+		chunk->used = 0;
+		chunk->retained = 1;
+	}
+	pool->used = 0;
+}
+
+static void tjcliArenaSelfDestruct(j_common_ptr cinfo)
+{
+	tjcli_arena* arena = (tjcli_arena*)cinfo->mem;
+	for (int i = 0; i < JPOOL_NUMPOOLS; i++)
+		tjcliArenaFreeChunks(arena, &arena->pools[i]);
+	cinfo->mem = arena->base;
+	(*arena->base->self_destruct)(cinfo);
+	free(arena);
+}
+
+/// <summary>
+/// Replaces the memory manager of a handle created by jpeg_create_compress() or
+/// jpeg_create_decompress() with an arena.  Call this straight after creating the handle,
+/// before any image has been started.  Every handle which shares virtual arrays with this
+/// one (as tjcliWriteCoefficients() does) must use an arena too.
+/// </summary>
+int tjcliInstallArena(j_common_ptr cinfo)
+{
+	tjcli_arena* arena = (tjcli_arena*)calloc(1, sizeof(tjcli_arena));
+	if (arena == NULL)
+		return -1;
+	arena->base = cinfo->mem;
+	arena->pub.alloc_small = tjcliArenaAllocSmall;
+	arena->pub.alloc_large = tjcliArenaAllocLarge;
+	arena->pub.alloc_sarray = tjcliArenaAllocSarray;
+	arena->pub.alloc_barray = tjcliArenaAllocBarray;
+	arena->pub.request_virt_sarray = tjcliArenaRequestVirtSarray;
+	arena->pub.request_virt_barray = tjcliArenaRequestVirtBarray;
+	arena->pub.realize_virt_arrays = tjcliArenaRealizeVirtArrays;
+	arena->pub.access_virt_sarray = tjcliArenaAccessVirtSarray;
+	arena->pub.access_virt_barray = tjcliArenaAccessVirtBarray;
+	arena->pub.free_pool = tjcliArenaFreePool;
+	arena->pub.self_destruct = tjcliArenaSelfDestruct;
+	arena->pub.max_memory_to_use = arena->base->max_memory_to_use;
+	arena->pub.max_alloc_chunk = arena->base->max_alloc_chunk;
+	cinfo->mem = &arena->pub;
+	return 0;
+}
+
+/// <summary>
+/// Copies the counters of the arena installed on a handle.  Returns -1 if the handle
+/// does not use an arena.
+/// </summary>
+int tjcliGetArenaStats(j_common_ptr cinfo, tjcli_arena_stats* stats)
+{
+	if (cinfo->mem == NULL || cinfo->mem->self_destruct != tjcliArenaSelfDestruct)
+		return -1;
+	*stats = ((tjcli_arena*)cinfo->mem)->stats;
+	return 0;
+}
+#pragma managed( pop )
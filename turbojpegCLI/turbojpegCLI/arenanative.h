@@ -0,0 +1,33 @@
+#pragma once
+#include "jpegnative.h"
+
+// Native arena memory manager for libjpeg.  libjpeg's own manager mallocs its
+// pools while an image is set up and frees them again when the image is done, so
+// every compress and decompress call makes dozens of heap calls, which contend for
+// the heap lock when many threads are working.  The arena keeps the memory of each
+// pool instead; after an image it is reset rather than freed, and if the image
+// needed more than one chunk, the chunks are replaced by a single chunk of the size
+// that image used.  Later images of the same size then make no heap calls at all.
+
+/// <summary>
+/// Counters kept by an arena since it was installed.
+/// </summary>
+struct tjcli_arena_stats
+{
+	// Bytes of heap memory currently held by the arena.
+	unsigned long long bytesReserved;
+	// The most bytes that were in use at once.
+	unsigned long long peakUsage;
+	// Number of allocations libjpeg asked for.
+	unsigned long long allocationRequests;
+	// Number of those which were served from memory kept from an earlier image,
+	// instead of being allocated from the heap.
+	unsigned long long allocationsAvoided;
+	// Number of times the arena allocated memory from the heap.
+	unsigned long long heapAllocations;
+	// Number of images the arena was reset after.
+	unsigned long long imagesReset;
+};
+
+int tjcliInstallArena(j_common_ptr cinfo);
+int tjcliGetArenaStats(j_common_ptr cinfo, tjcli_arena_stats* stats);
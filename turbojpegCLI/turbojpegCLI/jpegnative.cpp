@@ -0,0 +1,1821 @@
+#include "jpegnative.h"
+#include "arenanative.h"
+#pragma managed( push, off )
+#include <stdlib.h>
+#include <string.h>
+
+const int tjcliNaturalOrder[DCTSIZE2] =
+{
+	0, 1, 8, 16, 9, 2, 3, 10,
+	17, 24, 32, 25, 18, 11, 4, 5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13, 6, 7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63
+};
+
+const int tjcliPixelSize[TJCLI_NUMPF] = { 3, 3, 4, 4, 4, 4, 1, 4, 4, 4, 4, 4 };
+
+static const J_COLOR_SPACE tjcliPixelFormatToColorspace[TJCLI_NUMPF] =
+{
+	JCS_EXT_RGB, JCS_EXT_BGR, JCS_EXT_RGBX, JCS_EXT_BGRX, JCS_EXT_XBGR, JCS_EXT_XRGB,
+	JCS_GRAYSCALE, JCS_EXT_RGBA, JCS_EXT_BGRA, JCS_EXT_ABGR, JCS_EXT_ARGB, JCS_CMYK
+};
+
+// Names of the steps of an operation, recorded in tjcli_error_mgr::phase.
+static const char tjcliPhaseHeader[] = "reading the JPEG header";
+static const char tjcliPhaseStartDecompress[] = "starting decompression";
+static const char tjcliPhaseDecompress[] = "decompressing";
+static const char tjcliPhaseFinishDecompress[] = "finishing decompression";
+static const char tjcliPhaseCoefficients[] = "reading the DCT coefficients";
+static const char tjcliPhaseAccessCoefficients[] = "accessing the DCT coefficients";
+static const char tjcliPhaseStartCompress[] = "starting compression";
+static const char tjcliPhaseCompress[] = "compressing";
+static const char tjcliPhaseFinishCompress[] = "finishing compression";
+
+// MCU sizes of each subsampling option, as in tjMCUWidth and tjMCUHeight.
+static const int tjcliMCUWidth[TJCLI_NUMSAMP] = { 8, 16, 16, 8, 8, 32 };
+static const int tjcliMCUHeight[TJCLI_NUMSAMP] = { 8, 8, 16, 8, 16, 8 };
+
+static void tjcliErrorExit(j_common_ptr cinfo)
+{
+	tjcli_error_mgr* err = (tjcli_error_mgr*)cinfo->err;
+	(*cinfo->err->format_message)(cinfo, err->message);
+	longjmp(err->setjmpBuffer, 1);
+}
+
+static void tjcliOutputMessage(j_common_ptr cinfo)
+{
+	// Warnings are kept for the caller rather than written to stderr.
+	tjcli_error_mgr* err = (tjcli_error_mgr*)cinfo->err;
+	(*cinfo->err->format_message)(cinfo, err->warning);
+}
+
+/// <summary>
+/// Adds the MCUs made unusable by corrupt data just detected in the current scan.
+/// libjpeg replaces them with flat blocks until it resyncs at the next restart
+/// marker (or the end of the scan if there are none), so the damage runs from here
+/// to the next restart boundary.  Garbage found in front of a restart marker means
+/// the restart interval which just ended was decoded from garbage instead.  The
+/// decoder only exposes its position to the MCU row, so the count is an estimate.
+/// </summary>
+static void tjcliCountCorruptMcus(j_decompress_ptr cinfo, tjcli_error_mgr* err, int beforeRestart)
+{
+	if (cinfo->comps_in_scan < 1)
+		return;
+	long long mcusPerRow = (long long)cinfo->MCUs_per_row;
+	long long total = mcusPerRow * (long long)cinfo->MCU_rows_in_scan;
+	long long rowsPerIMCURow = cinfo->comps_in_scan == 1 ? cinfo->cur_comp_info[0]->v_samp_factor : 1;
+	long long interval = (long long)cinfo->restart_interval;
+	long long start = (long long)cinfo->input_iMCU_row * rowsPerIMCURow * mcusPerRow;
+	long long end = total;
+	if (beforeRestart)
+	{
+		if (interval == 0)
+			return;
+		end = (start + interval - 1) / interval * interval;
+		start = end > interval ? end - interval : 0;
+	}
+	else if (interval > 0)
+		end = (start / interval + 1) * interval;
+	if (end > total)
+		end = total;
+	// Several warnings usually describe one problem (such as a bad code followed by
+	// hitting the next marker early), so don't count the same MCUs twice.
+	if (cinfo->input_scan_number == err->corruptScan && start < err->corruptEnd)
+		start = err->corruptEnd;
+	if (end > start)
+	{
+		err->corruptMcus += end - start;
+		err->corruptScan = cinfo->input_scan_number;
+		err->corruptEnd = end;
+	}
+}
+
+static void tjcliEmitMessage(j_common_ptr cinfo, int msgLevel)
+{
+	// Trace messages are ignored.  Warnings are counted, the first one is kept,
+	// and those caused by corrupt entropy coded data are measured.
+	if (msgLevel >= 0)
+		return;
+	tjcli_error_mgr* err = (tjcli_error_mgr*)cinfo->err;
+	if (err->pub.num_warnings == 0)
+		(*cinfo->err->output_message)(cinfo);
+	err->pub.num_warnings++;
+	if (!cinfo->is_decompressor)
+		return;
+	int code = err->pub.msg_code;
+	if (code == JWRN_HIT_MARKER || code == JWRN_HUFF_BAD_CODE || code == JWRN_MUST_RESYNC)
+		tjcliCountCorruptMcus((j_decompress_ptr)cinfo, err, 0);
+	else if (code == JWRN_EXTRANEOUS_DATA && err->pub.msg_parm.i[1] >= JPEG_RST0 && err->pub.msg_parm.i[1] <= JPEG_RST0 + 7)
+		tjcliCountCorruptMcus((j_decompress_ptr)cinfo, err, 1);
+}
+
+static void tjcliProgressMonitor(j_common_ptr cinfo)
+{
+	tjcli_progress_mgr* progress = (tjcli_progress_mgr*)cinfo->progress;
+	if (!progress->cancel)
+		return;
+	// Leave the way error_exit does; the function that was called cleans up and fails.
+	tjcli_error_mgr* err = (tjcli_error_mgr*)cinfo->err;
+	strcpy(err->message, "The operation was cancelled");
+	longjmp(err->setjmpBuffer, 1);
+}
+
+/// <summary>
+/// Clears the error, warnings and phase left by the previous operation on a handle.
+/// </summary>
+static void tjcliBeginOperation(tjcli_error_mgr* err)
+{
+	err->message[0] = 0;
+	err->phase = NULL;
+	err->pub.num_warnings = 0;
+	err->warning[0] = 0;
+	err->corruptMcus = 0;
+	err->corruptScan = 0;
+	err->corruptEnd = 0;
+}
+
+/// <summary>
+/// Clears the error and phase left by the previous call on a handle, but keeps the
+/// warnings, for calls which carry on an operation begun by an earlier one.
+/// </summary>
+static void tjcliContinueOperation(tjcli_error_mgr* err)
+{
+	err->message[0] = 0;
+	err->phase = NULL;
+}
+
+static void tjcliSetError(tjcli_error_mgr* err, const char* message)
+{
+	strncpy(err->message, message, JMSG_LENGTH_MAX - 1);
+	err->message[JMSG_LENGTH_MAX - 1] = 0;
+}
+
+/// <summary>
+/// Creates a decompression handle which allocates from an arena (see arenanative.h), or
+/// returns NULL if libjpeg could not be initialized.
+/// </summary>
+tjcli_decoder* tjcliInitDecoder()
+{
+	tjcli_decoder* dec = (tjcli_decoder*)calloc(1, sizeof(tjcli_decoder));
+	if (dec == NULL)
+		return NULL;
+	dec->cinfo.err = jpeg_std_error(&dec->jerr.pub);
+	dec->jerr.pub.error_exit = tjcliErrorExit;
+	dec->jerr.pub.output_message = tjcliOutputMessage;
+	dec->jerr.pub.emit_message = tjcliEmitMessage;
+	if (setjmp(dec->jerr.setjmpBuffer))
+	{
+		free(dec);
+		return NULL;
+	}
+	jpeg_create_decompress(&dec->cinfo);
+	if (tjcliInstallArena((j_common_ptr)&dec->cinfo) == -1)
+	{
+		jpeg_destroy_decompress(&dec->cinfo);
+		free(dec);
+		return NULL;
+	}
+	dec->progress.pub.progress_monitor = tjcliProgressMonitor;
+	dec->cinfo.progress = &dec->progress.pub;
+	return dec;
+}
+
+void tjcliDestroyDecoder(tjcli_decoder* dec)
+{
+	if (dec == NULL)
+		return;
+	jpeg_destroy_decompress(&dec->cinfo);
+	free(dec);
+}
+
+/// <summary>
+/// Returns the message for the most recent failure on this handle.
+/// </summary>
+const char* tjcliGetErrorStr(tjcli_decoder* dec)
+{
+	if (dec == NULL)
+		return "Invalid handle";
+	return dec->jerr.message;
+}
+
+static void tjcliReadInitSource(j_decompress_ptr cinfo)
+{
+	tjcli_read_src* src = (tjcli_read_src*)cinfo->src;
+	src->pub.next_input_byte = src->buffer;
+	src->pub.bytes_in_buffer = 0;
+	src->bytesRead = 0;
+	src->limit = 0;
+}
+
+static boolean tjcliReadFillInputBuffer(j_decompress_ptr cinfo)
+{
+	static const JOCTET fakeEOI[2] = { 0xFF, JPEG_EOI };
+	tjcli_read_src* src = (tjcli_read_src*)cinfo->src;
+	size_t size = src->capacity;
+	if (src->limit > 0 && src->bytesRead + size > src->limit)
+		size = src->bytesRead < src->limit ? (size_t)(src->limit - src->bytesRead) : 0;
+	int count = size > 0 ? src->read(src->buffer, (int)size) : 0;
+	if (count == -1)
+		ERREXIT(cinfo, JERR_FILE_READ);
+	if (count == 0)
+	{
+		// The data ended early.  Like jpeg_mem_src(), warn and finish the image with
+		// whatever has been decoded.
+		WARNMS(cinfo, JWRN_JPEG_EOF);
+		src->pub.next_input_byte = fakeEOI;
+		src->pub.bytes_in_buffer = 2;
+		return TRUE;
+	}
+	src->bytesRead += (unsigned long long)count;
+	src->pub.next_input_byte = src->buffer;
+	src->pub.bytes_in_buffer = (size_t)count;
+	return TRUE;
+}
+
+static void tjcliReadSkipInputData(j_decompress_ptr cinfo, long numBytes)
+{
+	tjcli_read_src* src = (tjcli_read_src*)cinfo->src;
+	if (numBytes <= 0)
+		return;
+	while ((size_t)numBytes > src->pub.bytes_in_buffer)
+	{
+		numBytes -= (long)src->pub.bytes_in_buffer;
+		tjcliReadFillInputBuffer(cinfo);
+	}
+	src->pub.next_input_byte += numBytes;
+	src->pub.bytes_in_buffer -= (size_t)numBytes;
+}
+
+static void tjcliReadTermSource(j_decompress_ptr cinfo)
+{
+}
+
+/// <summary>
+/// Makes the functions below read the image through read, into chunkBuf, when they
+/// are passed a NULL jpegBuf, so that it never has to be in memory all at once.  read
+/// is called as the decoder needs data, from within the function that was called.
+/// Pass a NULL read to stop.
+/// </summary>
+void tjcliSetReadSource(tjcli_decoder* dec, unsigned char* chunkBuf, int chunkSize, tjcli_read_func read)
+{
+	dec->readSrc.pub.init_source = tjcliReadInitSource;
+	dec->readSrc.pub.fill_input_buffer = tjcliReadFillInputBuffer;
+	dec->readSrc.pub.skip_input_data = tjcliReadSkipInputData;
+	dec->readSrc.pub.resync_to_restart = jpeg_resync_to_restart;
+	dec->readSrc.pub.term_source = tjcliReadTermSource;
+	dec->readSrc.buffer = chunkBuf;
+	dec->readSrc.capacity = read == NULL ? 0 : (size_t)chunkSize;
+	dec->readSrc.read = read;
+}
+
+/// <summary>
+/// Points the decompressor at the image: the read source if one is set and jpegBuf is
+/// NULL, otherwise jpegBuf.
+/// </summary>
+static void tjcliSetSource(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	if (jpegBuf == NULL && dec->readSrc.read != NULL)
+	{
+		cinfo->src = &dec->readSrc.pub;
+		return;
+	}
+	// jpeg_mem_src() only reuses a source manager that it created.
+	if (cinfo->src == &dec->readSrc.pub)
+		cinfo->src = dec->memSrc;
+	jpeg_mem_src(cinfo, (unsigned char*)jpegBuf, jpegSize);
+	dec->memSrc = cinfo->src;
+}
+
+/// <summary>
+/// Sets whether APPn and COM markers are kept when reading images, so that
+/// tjcliWriteCoefficients() can copy them (EXIF, ICC profiles, comments, etc.)
+/// </summary>
+int tjcliSetSaveMarkers(tjcli_decoder* dec, int saveMarkers)
+{
+	tjcliBeginOperation(&dec->jerr);
+	if (setjmp(dec->jerr.setjmpBuffer))
+		return -1;
+	unsigned int lengthLimit = saveMarkers ? 0xFFFF : 0;
+	jpeg_save_markers(&dec->cinfo, JPEG_COM, lengthLimit);
+	for (int m = 0; m < 16; m++)
+		jpeg_save_markers(&dec->cinfo, JPEG_APP0 + m, lengthLimit);
+	return 0;
+}
+
+static void tjcliInitDestination(j_compress_ptr cinfo)
+{
+	tjcli_mem_dest* dest = (tjcli_mem_dest*)cinfo->dest;
+	if (dest->buffer == NULL)
+	{
+		dest->capacity = 65536;
+		dest->buffer = (unsigned char*)malloc(dest->capacity);
+		if (dest->buffer == NULL)
+		{
+			dest->capacity = 0;
+			ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+		}
+	}
+	dest->size = 0;
+	dest->pub.next_output_byte = dest->buffer;
+	dest->pub.free_in_buffer = dest->capacity;
+}
+
+static boolean tjcliEmptyOutputBuffer(j_compress_ptr cinfo)
+{
+	// The whole buffer is full; double it and carry on after the existing data.
+	tjcli_mem_dest* dest = (tjcli_mem_dest*)cinfo->dest;
+	size_t used = dest->capacity;
+	unsigned char* newBuffer = (unsigned char*)realloc(dest->buffer, dest->capacity * 2);
+	if (newBuffer == NULL)
+		ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+	dest->buffer = newBuffer;
+	dest->capacity *= 2;
+	dest->pub.next_output_byte = dest->buffer + used;
+	dest->pub.free_in_buffer = dest->capacity - used;
+	return TRUE;
+}
+
+static void tjcliTermDestination(j_compress_ptr cinfo)
+{
+	tjcli_mem_dest* dest = (tjcli_mem_dest*)cinfo->dest;
+	dest->size = dest->capacity - dest->pub.free_in_buffer;
+}
+
+static void tjcliFixedInitDestination(j_compress_ptr cinfo)
+{
+	tjcli_mem_dest* dest = (tjcli_mem_dest*)cinfo->dest;
+	dest->size = 0;
+	dest->pub.next_output_byte = dest->buffer;
+	dest->pub.free_in_buffer = dest->capacity;
+}
+
+static boolean tjcliFixedEmptyOutputBuffer(j_compress_ptr cinfo)
+{
+	// The caller's buffer can not grow (like TJFLAG_NOREALLOC).
+	ERREXIT(cinfo, JERR_BUFFER_SIZE);
+	return FALSE;
+}
+
+static void tjcliOverflowInitDestination(j_compress_ptr cinfo)
+{
+	tjcli_overflow_dest* dest = (tjcli_overflow_dest*)cinfo->dest;
+	dest->overflowSize = 0;
+	dest->overflowed = 0;
+	dest->pub.next_output_byte = dest->buffer;
+	dest->pub.free_in_buffer = dest->capacity;
+}
+
+static boolean tjcliOverflowEmptyOutputBuffer(j_compress_ptr cinfo)
+{
+	// Whichever buffer is being written is full.  Move from the caller's buffer to the
+	// overflow buffer, or double the overflow buffer, and carry on after the data.
+	tjcli_overflow_dest* dest = (tjcli_overflow_dest*)cinfo->dest;
+	size_t used = dest->overflowed ? dest->overflowCapacity : 0;
+	size_t needed = dest->overflowed ? dest->overflowCapacity * 2 : (dest->capacity > 65536 ? dest->capacity : 65536);
+	if (dest->overflowCapacity < needed)
+	{
+		unsigned char* newOverflow = (unsigned char*)realloc(dest->overflow, needed);
+		if (newOverflow == NULL)
+			ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+		dest->overflow = newOverflow;
+		dest->overflowCapacity = needed;
+	}
+	dest->overflowed = 1;
+	dest->pub.next_output_byte = dest->overflow + used;
+	dest->pub.free_in_buffer = dest->overflowCapacity - used;
+	return TRUE;
+}
+
+static void tjcliOverflowTermDestination(j_compress_ptr cinfo)
+{
+	tjcli_overflow_dest* dest = (tjcli_overflow_dest*)cinfo->dest;
+	if (dest->overflowed)
+		dest->overflowSize = dest->overflowCapacity - dest->pub.free_in_buffer;
+}
+
+static void tjcliStreamInitDestination(j_compress_ptr cinfo)
+{
+	tjcli_stream_dest* dest = (tjcli_stream_dest*)cinfo->dest;
+	dest->bytesWritten = 0;
+	dest->pub.next_output_byte = dest->buffer;
+	dest->pub.free_in_buffer = dest->capacity;
+}
+
+static boolean tjcliStreamEmptyOutputBuffer(j_compress_ptr cinfo)
+{
+	// libjpeg requires the whole buffer to be emptied, whatever free_in_buffer says.
+	tjcli_stream_dest* dest = (tjcli_stream_dest*)cinfo->dest;
+	if (dest->write(dest->buffer, (int)dest->capacity) == -1)
+		ERREXIT(cinfo, JERR_FILE_WRITE);
+	dest->bytesWritten += dest->capacity;
+	dest->pub.next_output_byte = dest->buffer;
+	dest->pub.free_in_buffer = dest->capacity;
+	return TRUE;
+}
+
+static void tjcliStreamTermDestination(j_compress_ptr cinfo)
+{
+	tjcli_stream_dest* dest = (tjcli_stream_dest*)cinfo->dest;
+	size_t size = dest->capacity - dest->pub.free_in_buffer;
+	if (size > 0 && dest->write(dest->buffer, (int)size) == -1)
+		ERREXIT(cinfo, JERR_FILE_WRITE);
+	dest->bytesWritten += size;
+}
+
+/// <summary>
+/// Creates a compression handle which allocates from an arena (see arenanative.h), or
+/// returns NULL if libjpeg could not be initialized.
+/// </summary>
+tjcli_encoder* tjcliInitEncoder()
+{
+	tjcli_encoder* enc = (tjcli_encoder*)calloc(1, sizeof(tjcli_encoder));
+	if (enc == NULL)
+		return NULL;
+	enc->cinfo.err = jpeg_std_error(&enc->jerr.pub);
+	enc->jerr.pub.error_exit = tjcliErrorExit;
+	enc->jerr.pub.output_message = tjcliOutputMessage;
+	enc->jerr.pub.emit_message = tjcliEmitMessage;
+	if (setjmp(enc->jerr.setjmpBuffer))
+	{
+		free(enc);
+		return NULL;
+	}
+	jpeg_create_compress(&enc->cinfo);
+	if (tjcliInstallArena((j_common_ptr)&enc->cinfo) == -1)
+	{
+		jpeg_destroy_compress(&enc->cinfo);
+		free(enc);
+		return NULL;
+	}
+	enc->dest.pub.init_destination = tjcliInitDestination;
+	enc->dest.pub.empty_output_buffer = tjcliEmptyOutputBuffer;
+	enc->dest.pub.term_destination = tjcliTermDestination;
+	enc->fixedDest.pub.init_destination = tjcliFixedInitDestination;
+	enc->fixedDest.pub.empty_output_buffer = tjcliFixedEmptyOutputBuffer;
+	enc->fixedDest.pub.term_destination = tjcliTermDestination;
+	enc->overflowDest.pub.init_destination = tjcliOverflowInitDestination;
+	enc->overflowDest.pub.empty_output_buffer = tjcliOverflowEmptyOutputBuffer;
+	enc->overflowDest.pub.term_destination = tjcliOverflowTermDestination;
+	enc->streamDest.pub.init_destination = tjcliStreamInitDestination;
+	enc->streamDest.pub.empty_output_buffer = tjcliStreamEmptyOutputBuffer;
+	enc->streamDest.pub.term_destination = tjcliStreamTermDestination;
+	enc->progress.pub.progress_monitor = tjcliProgressMonitor;
+	enc->cinfo.progress = &enc->progress.pub;
+	enc->cinfo.dest = &enc->dest.pub;
+	return enc;
+}
+
+void tjcliDestroyEncoder(tjcli_encoder* enc)
+{
+	if (enc == NULL)
+		return;
+	jpeg_destroy_compress(&enc->cinfo);
+	free(enc->dest.buffer);
+	free(enc->overflowDest.overflow);
+	free(enc);
+}
+
+/// <summary>
+/// Returns the message for the most recent failure on this handle.
+/// </summary>
+const char* tjcliGetErrorStr(tjcli_encoder* enc)
+{
+	if (enc == NULL)
+		return "Invalid handle";
+	return enc->jerr.message;
+}
+
+/// <summary>
+/// Sets up a compressor for an image the way tjCompress2() does: the quality, DCT
+/// method, colorspace and sampling factors.
+/// </summary>
+static void tjcliSetCompressParams(j_compress_ptr cinfo, int width, int height, int pixelFormat, int subsamp, int quality, int flags)
+{
+	cinfo->image_width = (JDIMENSION)width;
+	cinfo->image_height = (JDIMENSION)height;
+	cinfo->in_color_space = tjcliPixelFormatToColorspace[pixelFormat];
+	cinfo->input_components = tjcliPixelSize[pixelFormat];
+	jpeg_set_defaults(cinfo);
+	jpeg_set_quality(cinfo, quality, TRUE);
+	if (quality >= 96 || (flags & TJCLI_FLAG_ACCURATEDCT))
+		cinfo->dct_method = JDCT_ISLOW;
+	else
+		cinfo->dct_method = JDCT_FASTEST;
+	if (subsamp == TJCLI_SAMP_GRAY)
+		jpeg_set_colorspace(cinfo, JCS_GRAYSCALE);
+	else if (pixelFormat == TJCLI_PF_CMYK)
+		jpeg_set_colorspace(cinfo, JCS_YCCK);
+	else
+		jpeg_set_colorspace(cinfo, JCS_YCbCr);
+	cinfo->comp_info[0].h_samp_factor = tjcliMCUWidth[subsamp] / DCTSIZE;
+	cinfo->comp_info[0].v_samp_factor = tjcliMCUHeight[subsamp] / DCTSIZE;
+	for (int ci = 1; ci < cinfo->num_components; ci++)
+	{
+		cinfo->comp_info[ci].h_samp_factor = ci == 3 ? tjcliMCUWidth[subsamp] / DCTSIZE : 1;
+		cinfo->comp_info[ci].v_samp_factor = ci == 3 ? tjcliMCUHeight[subsamp] / DCTSIZE : 1;
+	}
+}
+
+/// <summary>
+/// Compresses packed pixels through the given destination manager of the handle.  If
+/// abbreviated is nonzero, the quantization and Huffman tables are left out of the image.
+/// </summary>
+static int tjcliCompress(tjcli_encoder* enc, const unsigned char* srcBuf, int width, int pitch, int height, int pixelFormat, int subsamp, int quality, int flags, struct jpeg_destination_mgr* dest, int abbreviated)
+{
+	j_compress_ptr cinfo = &enc->cinfo;
+	if (srcBuf == NULL || width < 1 || pitch < 0 || height < 1 || pixelFormat < 0 || pixelFormat >= TJCLI_NUMPF
+		|| subsamp < 0 || subsamp >= TJCLI_NUMSAMP || quality < 1 || quality > 100)
+	{
+		tjcliSetError(&enc->jerr, "Invalid argument in tjcliCompressPixels()");
+		return -1;
+	}
+	if (pitch == 0)
+		pitch = width * tjcliPixelSize[pixelFormat];
+	if (setjmp(enc->jerr.setjmpBuffer))
+	{
+		jpeg_abort_compress(cinfo);
+		return -1;
+	}
+	enc->jerr.phase = tjcliPhaseStartCompress;
+	cinfo->dest = dest;
+	tjcliSetCompressParams(cinfo, width, height, pixelFormat, subsamp, quality, flags);
+	if (abbreviated)
+	{
+		// Marking every table as already sent keeps them out of the frame.
+		jpeg_suppress_tables(cinfo, TRUE);
+		jpeg_start_compress(cinfo, FALSE);
+	}
+	else
+		jpeg_start_compress(cinfo, TRUE);
+
+	enc->jerr.phase = tjcliPhaseCompress;
+	JSAMPROW rows[4 * DCTSIZE];
+	while (cinfo->next_scanline < cinfo->image_height)
+	{
+		int y = (int)cinfo->next_scanline;
+		int count = height - y < 4 * DCTSIZE ? height - y : 4 * DCTSIZE;
+		for (int r = 0; r < count; r++)
+			rows[r] = (JSAMPROW)srcBuf + (size_t)pitch * (flags & TJCLI_FLAG_BOTTOMUP ? height - 1 - (y + r) : y + r);
+		jpeg_write_scanlines(cinfo, rows, (JDIMENSION)count);
+	}
+	enc->jerr.phase = tjcliPhaseFinishCompress;
+	jpeg_finish_compress(cinfo);
+	return 0;
+}
+
+/// <summary>
+/// Compresses into the caller's buffer through fixedDest.
+/// </summary>
+static int tjcliCompressFixed(tjcli_encoder* enc, const unsigned char* srcBuf, int width, int pitch, int height, int pixelFormat, int subsamp, int quality, int flags, unsigned char* jpegBuf, unsigned long* jpegSize, int abbreviated)
+{
+	tjcliBeginOperation(&enc->jerr);
+	if (jpegBuf == NULL || jpegSize == NULL)
+	{
+		tjcliSetError(&enc->jerr, "Invalid argument in tjcliCompressPixels()");
+		return -1;
+	}
+	enc->fixedDest.buffer = jpegBuf;
+	enc->fixedDest.capacity = *jpegSize;
+	if (tjcliCompress(enc, srcBuf, width, pitch, height, pixelFormat, subsamp, quality, flags, &enc->fixedDest.pub, abbreviated) == -1)
+		return -1;
+	*jpegSize = (unsigned long)enc->fixedDest.size;
+	return 0;
+}
+
+/// <summary>
+/// Compresses packed pixels to a JPEG image, like tjCompress2() with
+/// TJFLAG_NOREALLOC.  jpegBuf is the caller's buffer, *jpegSize is its size on entry
+/// and the size of the image on return; tjBufSize() bytes are always enough.  The
+/// quality, subsampling and DCT choices are the ones TurboJPEG makes, so the output
+/// is the same.  A pitch of 0 means unpadded rows.
+/// </summary>
+int tjcliCompressPixels(tjcli_encoder* enc, const unsigned char* srcBuf, int width, int pitch, int height, int pixelFormat, int subsamp, int quality, int flags, unsigned char* jpegBuf, unsigned long* jpegSize)
+{
+	return tjcliCompressFixed(enc, srcBuf, width, pitch, height, pixelFormat, subsamp, quality, flags, jpegBuf, jpegSize, 0);
+}
+
+/// <summary>
+/// Compresses packed pixels like tjcliCompressPixels(), but to an abbreviated image
+/// without quantization or Huffman tables.  It can only be decompressed by a decoder
+/// primed with the output of tjcliWriteTables() for the same quality, which saves
+/// several hundred bytes per image in a stream.
+/// </summary>
+int tjcliCompressAbbreviated(tjcli_encoder* enc, const unsigned char* srcBuf, int width, int pitch, int height, int pixelFormat, int subsamp, int quality, int flags, unsigned char* jpegBuf, unsigned long* jpegSize)
+{
+	return tjcliCompressFixed(enc, srcBuf, width, pitch, height, pixelFormat, subsamp, quality, flags, jpegBuf, jpegSize, 1);
+}
+
+/// <summary>
+/// Compresses packed pixels like tjcliCompressPixels() (or tjcliCompressAbbreviated() if
+/// abbreviated is nonzero), into a buffer which may be smaller than the image.  The first
+/// jpegBufSize bytes of the image go to jpegBuf, and the rest, if any, to
+/// enc->overflowDest.overflow (enc->overflowDest.overflowSize bytes).  *jpegSize is set
+/// to the size of the whole image.
+/// </summary>
+int tjcliCompressOverflow(tjcli_encoder* enc, const unsigned char* srcBuf, int width, int pitch, int height, int pixelFormat, int subsamp, int quality, int flags, int abbreviated, unsigned char* jpegBuf, unsigned long jpegBufSize, unsigned long* jpegSize)
+{
+	tjcliBeginOperation(&enc->jerr);
+	if (jpegBuf == NULL || jpegBufSize < 1 || jpegSize == NULL)
+	{
+		tjcliSetError(&enc->jerr, "Invalid argument in tjcliCompressOverflow()");
+		return -1;
+	}
+	enc->overflowDest.buffer = jpegBuf;
+	enc->overflowDest.capacity = jpegBufSize;
+	if (tjcliCompress(enc, srcBuf, width, pitch, height, pixelFormat, subsamp, quality, flags, &enc->overflowDest.pub, abbreviated) == -1)
+		return -1;
+	*jpegSize = (unsigned long)(enc->overflowDest.overflowed ? jpegBufSize + enc->overflowDest.overflowSize : jpegBufSize - enc->overflowDest.pub.free_in_buffer);
+	return 0;
+}
+
+/// <summary>
+/// Compresses packed pixels like tjcliCompressPixels() (or tjcliCompressAbbreviated() if
+/// abbreviated is nonzero), passing the image to write in chunks of chunkSize bytes from
+/// chunkBuf as they are produced, so the first bytes can be sent before the image is
+/// finished.  If write returns -1, compression stops and -1 is returned.  *jpegSize is
+/// set to the number of bytes written.
+/// </summary>
+int tjcliCompressStream(tjcli_encoder* enc, const unsigned char* srcBuf, int width, int pitch, int height, int pixelFormat, int subsamp, int quality, int flags, int abbreviated, unsigned char* chunkBuf, int chunkSize, tjcli_write_func write, unsigned long long* jpegSize)
+{
+	tjcliBeginOperation(&enc->jerr);
+	if (chunkBuf == NULL || chunkSize < 1 || write == NULL || jpegSize == NULL)
+	{
+		tjcliSetError(&enc->jerr, "Invalid argument in tjcliCompressStream()");
+		return -1;
+	}
+	enc->streamDest.buffer = chunkBuf;
+	enc->streamDest.capacity = (size_t)chunkSize;
+	enc->streamDest.write = write;
+	if (tjcliCompress(enc, srcBuf, width, pitch, height, pixelFormat, subsamp, quality, flags, &enc->streamDest.pub, abbreviated) == -1)
+		return -1;
+	*jpegSize = enc->streamDest.bytesWritten;
+	return 0;
+}
+
+/// <summary>
+/// Writes a tables-only datastream (SOI, DQT, DHT, EOI) holding the quantization
+/// tables for the given quality and the standard Huffman tables, which are all that
+/// tjcliCompressAbbreviated() leaves out.  Both tables are written whatever the
+/// colorspace, so one datastream serves color and grayscale images alike.  On
+/// success, *jpegBuf points into the encoder's buffer, which remains valid until
+/// the encoder is used again.
+/// </summary>
+int tjcliWriteTables(tjcli_encoder* enc, int quality, unsigned char** jpegBuf, unsigned long* jpegSize)
+{
+	j_compress_ptr cinfo = &enc->cinfo;
+	tjcliBeginOperation(&enc->jerr);
+	if (quality < 1 || quality > 100)
+	{
+		tjcliSetError(&enc->jerr, "Invalid argument in tjcliWriteTables()");
+		return -1;
+	}
+	if (setjmp(enc->jerr.setjmpBuffer))
+	{
+		jpeg_abort_compress(cinfo);
+		return -1;
+	}
+	enc->jerr.phase = tjcliPhaseCompress;
+	cinfo->dest = &enc->dest.pub;
+	cinfo->in_color_space = JCS_RGB;
+	cinfo->input_components = 3;
+	jpeg_set_defaults(cinfo);
+	jpeg_set_quality(cinfo, quality, TRUE);
+	jpeg_write_tables(cinfo);
+	*jpegBuf = enc->dest.buffer;
+	*jpegSize = (unsigned long)enc->dest.size;
+	return 0;
+}
+
+/// <summary>
+/// Entropy-decodes the JPEG image into the handle's coefficient arrays without
+/// performing any IDCT, upsampling or color conversion.  The coefficients stay
+/// valid until the next image is read with this handle.
+/// </summary>
+int tjcliReadCoefficients(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	dec->coefArrays = NULL;
+	tjcliBeginOperation(&dec->jerr);
+	if (setjmp(dec->jerr.setjmpBuffer))
+	{
+		dec->coefArrays = NULL;
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	// Release anything left over from the previous image.
+	jpeg_abort_decompress(cinfo);
+	tjcliSetSource(dec, jpegBuf, jpegSize);
+	dec->jerr.phase = tjcliPhaseHeader;
+	jpeg_read_header(cinfo, TRUE);
+	dec->jerr.phase = tjcliPhaseCoefficients;
+	dec->coefArrays = jpeg_read_coefficients(cinfo);
+	return 0;
+}
+
+/// <summary>
+/// Gets the size, in 8x8 blocks, of one component of the image most recently
+/// read by tjcliReadCoefficients().
+/// </summary>
+int tjcliGetBlockDimensions(tjcli_decoder* dec, int componentIndex, int* blocksWide, int* blocksHigh)
+{
+	tjcliBeginOperation(&dec->jerr);
+	if (dec->coefArrays == NULL)
+	{
+		tjcliSetError(&dec->jerr, "No coefficients have been read");
+		return -1;
+	}
+	if (componentIndex < 0 || componentIndex >= dec->cinfo.num_components)
+	{
+		tjcliSetError(&dec->jerr, "Invalid component index");
+		return -1;
+	}
+	*blocksWide = (int)dec->cinfo.comp_info[componentIndex].width_in_blocks;
+	*blocksHigh = (int)dec->cinfo.comp_info[componentIndex].height_in_blocks;
+	return 0;
+}
+
+/// <summary>
+/// Writes 1 + numAC dequantized values per luma block, in raster block order:
+/// the DC coefficient followed by the first numAC AC coefficients in zigzag
+/// order.  Values are divided by 8 so that the DC term is the block's mean
+/// sample value minus 128.  features must hold blocksWide * blocksHigh * (1 + numAC)
+/// values (see tjcliGetBlockDimensions).
+/// </summary>
+int tjcliGetLumaFeatures(tjcli_decoder* dec, int numAC, float* features)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	tjcliBeginOperation(&dec->jerr);
+	if (dec->coefArrays == NULL)
+	{
+		tjcliSetError(&dec->jerr, "No coefficients have been read");
+		return -1;
+	}
+	if (numAC < 0 || numAC >= DCTSIZE2)
+	{
+		tjcliSetError(&dec->jerr, "Invalid number of AC coefficients");
+		return -1;
+	}
+	jpeg_component_info* compptr = &cinfo->comp_info[0];
+	if (compptr->quant_table == NULL)
+	{
+		tjcliSetError(&dec->jerr, "Quantization table for the luma component is missing");
+		return -1;
+	}
+	if (setjmp(dec->jerr.setjmpBuffer))
+		return -1;
+	dec->jerr.phase = tjcliPhaseAccessCoefficients;
+
+	int numValues = 1 + numAC;
+	float scale[DCTSIZE2];
+	int position[DCTSIZE2];
+	for (int k = 0; k < numValues; k++)
+	{
+		position[k] = tjcliNaturalOrder[k];
+		scale[k] = compptr->quant_table->quantval[position[k]] / 8.0f;
+	}
+
+	// The coefficient arrays are accessed one iMCU row at a time, which is the
+	// granularity libjpeg allocated them with.
+	JDIMENSION rowsPerAccess = (JDIMENSION)compptr->v_samp_factor;
+	for (JDIMENSION blockRow = 0; blockRow < compptr->height_in_blocks; blockRow += rowsPerAccess)
+	{
+		JBLOCKARRAY rows = (*cinfo->mem->access_virt_barray)((j_common_ptr)cinfo, dec->coefArrays[0], blockRow, rowsPerAccess, FALSE);
+		for (JDIMENSION r = 0; r < rowsPerAccess && blockRow + r < compptr->height_in_blocks; r++)
+		{
+			JBLOCKROW row = rows[r];
+			for (JDIMENSION blockCol = 0; blockCol < compptr->width_in_blocks; blockCol++)
+			{
+				JCOEFPTR block = row[blockCol];
+				for (int k = 0; k < numValues; k++)
+					*features++ = block[position[k]] * scale[k];
+			}
+		}
+	}
+	return 0;
+}
+
+/// <summary>
+/// Fills rows[] with a pointer to each row of blocks of one component of the
+/// image most recently read by tjcliReadCoefficients().  The coefficient arrays
+/// are entirely in memory, so the pointers stay valid (and may be written
+/// through) until the next image is read with this handle.
+/// </summary>
+int tjcliGetBlockRows(tjcli_decoder* dec, int componentIndex, JBLOCKROW* rows)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	int blocksWide, blocksHigh;
+	if (tjcliGetBlockDimensions(dec, componentIndex, &blocksWide, &blocksHigh) == -1)
+		return -1;
+	if (setjmp(dec->jerr.setjmpBuffer))
+		return -1;
+	dec->jerr.phase = tjcliPhaseAccessCoefficients;
+	JDIMENSION rowsPerAccess = (JDIMENSION)cinfo->comp_info[componentIndex].v_samp_factor;
+	for (JDIMENSION blockRow = 0; blockRow < (JDIMENSION)blocksHigh; blockRow += rowsPerAccess)
+	{
+		JBLOCKARRAY access = (*cinfo->mem->access_virt_barray)((j_common_ptr)cinfo, dec->coefArrays[componentIndex], blockRow, rowsPerAccess, TRUE);
+		for (JDIMENSION r = 0; r < rowsPerAccess && blockRow + r < (JDIMENSION)blocksHigh; r++)
+			rows[blockRow + r] = access[r];
+	}
+	return 0;
+}
+
+/// <summary>
+/// Obscures a rectangle of the image most recently read by tjcliReadCoefficients().
+/// The rectangle is given in pixels and is enlarged to whole MCUs, so that every
+/// component is masked over the same area.  If flat is 0, the AC coefficients of
+/// each covered block are zeroed, which pixelates the area into 8x8 blocks of their
+/// average color (larger for subsampled chroma).  Otherwise every covered block is
+/// replaced by the average DC value of the area, filling it with a single color.
+/// Blocks outside the rectangle are not touched.
+/// </summary>
+int tjcliMaskRegion(tjcli_decoder* dec, int x, int y, int width, int height, int flat)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	tjcliBeginOperation(&dec->jerr);
+	if (dec->coefArrays == NULL)
+	{
+		tjcliSetError(&dec->jerr, "No coefficients have been read");
+		return -1;
+	}
+	if (x < 0 || y < 0 || width < 1 || height < 1)
+	{
+		tjcliSetError(&dec->jerr, "Invalid mask region");
+		return -1;
+	}
+	int mcuWidth = cinfo->max_h_samp_factor * DCTSIZE;
+	int mcuHeight = cinfo->max_v_samp_factor * DCTSIZE;
+	if (x >= (int)cinfo->image_width || y >= (int)cinfo->image_height)
+		return 0;
+	int right = width > (int)cinfo->image_width - x ? (int)cinfo->image_width : x + width;
+	int bottom = height > (int)cinfo->image_height - y ? (int)cinfo->image_height : y + height;
+	int mcuLeft = x / mcuWidth, mcuRight = (right + mcuWidth - 1) / mcuWidth;
+	int mcuTop = y / mcuHeight, mcuBottom = (bottom + mcuHeight - 1) / mcuHeight;
+	if (setjmp(dec->jerr.setjmpBuffer))
+		return -1;
+	dec->jerr.phase = tjcliPhaseAccessCoefficients;
+
+	for (int ci = 0; ci < cinfo->num_components; ci++)
+	{
+		jpeg_component_info* compptr = &cinfo->comp_info[ci];
+		JDIMENSION left = (JDIMENSION)(mcuLeft * compptr->h_samp_factor);
+		JDIMENSION top = (JDIMENSION)(mcuTop * compptr->v_samp_factor);
+		JDIMENSION endCol = (JDIMENSION)(mcuRight * compptr->h_samp_factor);
+		JDIMENSION endRow = (JDIMENSION)(mcuBottom * compptr->v_samp_factor);
+		if (endCol > compptr->width_in_blocks)
+			endCol = compptr->width_in_blocks;
+		if (endRow > compptr->height_in_blocks)
+			endRow = compptr->height_in_blocks;
+		JDIMENSION rowsPerAccess = (JDIMENSION)compptr->v_samp_factor;
+
+		JCOEF fill = 0;
+		if (flat)
+		{
+			// top is a multiple of v_samp_factor, so each access is one whole iMCU row.
+			long sum = 0, count = 0;
+			for (JDIMENSION blockRow = top; blockRow < endRow; blockRow += rowsPerAccess)
+			{
+				JBLOCKARRAY rows = (*cinfo->mem->access_virt_barray)((j_common_ptr)cinfo, dec->coefArrays[ci], blockRow, rowsPerAccess, FALSE);
+				for (JDIMENSION r = 0; r < rowsPerAccess && blockRow + r < endRow; r++)
+					for (JDIMENSION blockCol = left; blockCol < endCol; blockCol++)
+					{
+						sum += rows[r][blockCol][0];
+						count++;
+					}
+			}
+			if (count > 0)
+				fill = (JCOEF)(sum >= 0 ? (sum + count / 2) / count : -((-sum + count / 2) / count));
+		}
+
+		for (JDIMENSION blockRow = top; blockRow < endRow; blockRow += rowsPerAccess)
+		{
+			JBLOCKARRAY rows = (*cinfo->mem->access_virt_barray)((j_common_ptr)cinfo, dec->coefArrays[ci], blockRow, rowsPerAccess, TRUE);
+			for (JDIMENSION r = 0; r < rowsPerAccess && blockRow + r < endRow; r++)
+				for (JDIMENSION blockCol = left; blockCol < endCol; blockCol++)
+				{
+					JCOEFPTR block = rows[r][blockCol];
+					JCOEF dc = flat ? fill : block[0];
+					memset(block, 0, sizeof(JBLOCK));
+					block[0] = dc;
+				}
+		}
+	}
+	return 0;
+}
+
+/// <summary>
+/// Re-entropy-codes the coefficients held by dec (including any changes made to
+/// them) into a new JPEG image, without any requantization.  The quantization
+/// tables, sampling factors, restart interval and progressive mode of the source
+/// image are kept.  On success, *jpegBuf points to the image inside the
+/// encoder's buffer, which remains valid until the encoder is used again.
+/// </summary>
+int tjcliWriteCoefficients(tjcli_decoder* dec, tjcli_encoder* enc, int optimizeCoding, int copyMarkers, unsigned char** jpegBuf, unsigned long* jpegSize)
+{
+	j_compress_ptr cinfo = &enc->cinfo;
+	tjcliBeginOperation(&enc->jerr);
+	if (dec->coefArrays == NULL)
+	{
+		tjcliSetError(&enc->jerr, "No coefficients have been read");
+		return -1;
+	}
+	if (setjmp(enc->jerr.setjmpBuffer))
+	{
+		jpeg_abort_compress(cinfo);
+		return -1;
+	}
+	enc->jerr.phase = tjcliPhaseStartCompress;
+	cinfo->dest = &enc->dest.pub;
+	jpeg_copy_critical_parameters(&dec->cinfo, cinfo);
+	cinfo->optimize_coding = optimizeCoding ? TRUE : FALSE;
+	cinfo->arith_code = dec->cinfo.arith_code;
+	cinfo->restart_interval = dec->cinfo.restart_interval;
+	if (dec->cinfo.progressive_mode)
+		jpeg_simple_progression(cinfo);
+	jpeg_write_coefficients(cinfo, dec->coefArrays);
+	if (copyMarkers)
+	{
+		for (jpeg_saved_marker_ptr marker = dec->cinfo.marker_list; marker != NULL; marker = marker->next)
+		{
+			// jpeg_write_coefficients() already wrote these if the source had them.
+			if (cinfo->write_JFIF_header && marker->marker == JPEG_APP0 && marker->data_length >= 5
+				&& memcmp(marker->data, "JFIF", 5) == 0)
+				continue;
+			if (cinfo->write_Adobe_marker && marker->marker == JPEG_APP0 + 14 && marker->data_length >= 5
+				&& memcmp(marker->data, "Adobe", 5) == 0)
+				continue;
+			jpeg_write_marker(cinfo, marker->marker, marker->data, marker->data_length);
+		}
+	}
+	enc->jerr.phase = tjcliPhaseCompress;
+	jpeg_finish_compress(cinfo);
+	*jpegBuf = enc->dest.buffer;
+	*jpegSize = (unsigned long)enc->dest.size;
+	return 0;
+}
+
+static void tjcliSetDCTMethod(j_decompress_ptr cinfo, int flags)
+{
+	if (flags & TJCLI_FLAG_FASTDCT)
+		cinfo->dct_method = JDCT_FASTEST;
+	else if (flags & TJCLI_FLAG_ACCURATEDCT)
+		cinfo->dct_method = JDCT_ISLOW;
+}
+
+/// <summary>
+/// Finds the largest size, among the scaling factors supported by the IDCT
+/// (1/8 to 16/8 in steps of 1/8, the same set as tjGetScalingFactors()), which
+/// fits within desiredWidth x desiredHeight.  A desired dimension of 0 means the
+/// image dimension.  Returns the scaling numerator (the denominator is 8), or -1
+/// if even 1/8 scale does not fit.
+/// </summary>
+int tjcliGetScaledSize(int width, int height, int desiredWidth, int desiredHeight, int* scaledWidth, int* scaledHeight)
+{
+	if (desiredWidth == 0)
+		desiredWidth = width;
+	if (desiredHeight == 0)
+		desiredHeight = height;
+	for (int num = 2 * DCTSIZE; num >= 1; num--)
+	{
+		int w = (width * num + DCTSIZE - 1) / DCTSIZE;
+		int h = (height * num + DCTSIZE - 1) / DCTSIZE;
+		if (w <= desiredWidth && h <= desiredHeight)
+		{
+			*scaledWidth = w;
+			*scaledHeight = h;
+			return num;
+		}
+	}
+	return -1;
+}
+
+/// <summary>
+/// Records the sampling layout of an image whose header has been read.
+/// </summary>
+static void tjcliSaveLayout(tjcli_decoder* dec)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	tjcli_header_layout* layout = &dec->layout;
+	layout->numComponents = cinfo->num_components;
+	layout->maxHSamp = 1;
+	layout->maxVSamp = 1;
+	for (int ci = 0; ci < cinfo->num_components; ci++)
+	{
+		layout->hSamp[ci] = cinfo->comp_info[ci].h_samp_factor;
+		layout->vSamp[ci] = cinfo->comp_info[ci].v_samp_factor;
+		if (layout->hSamp[ci] > layout->maxHSamp)
+			layout->maxHSamp = layout->hSamp[ci];
+		if (layout->vSamp[ci] > layout->maxVSamp)
+			layout->maxVSamp = layout->vSamp[ci];
+	}
+	layout->multiScan = jpeg_has_multiple_scans(cinfo) ? 1 : 0;
+}
+
+/// <summary>
+/// Reads the dimensions of a JPEG image without decompressing it.
+/// </summary>
+int tjcliDecompressHeader(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize, int* width, int* height)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	dec->coefArrays = NULL;
+	tjcliBeginOperation(&dec->jerr);
+	if (setjmp(dec->jerr.setjmpBuffer))
+	{
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	jpeg_abort_decompress(cinfo);
+	tjcliSetSource(dec, jpegBuf, jpegSize);
+	dec->jerr.phase = tjcliPhaseHeader;
+	jpeg_read_header(cinfo, TRUE);
+	*width = (int)cinfo->image_width;
+	*height = (int)cinfo->image_height;
+	tjcliSaveLayout(dec);
+	jpeg_abort_decompress(cinfo);
+	return 0;
+}
+
+/// <summary>
+/// Returns the TJSAMP_* value matching the sampling factors of an image whose header
+/// has been read, or -1 if they match none of them.  This follows TurboJPEG, which
+/// also counts YCCK images whose K component has the luma factors.
+/// </summary>
+static int tjcliGetSubsamp(j_decompress_ptr cinfo)
+{
+	static const int componentCount[TJCLI_NUMSAMP] = { 3, 3, 3, 1, 3, 3 };
+	for (int i = 0; i < TJCLI_NUMSAMP; i++)
+	{
+		if (cinfo->num_components != componentCount[i]
+			&& !((cinfo->jpeg_color_space == JCS_YCCK || cinfo->jpeg_color_space == JCS_CMYK) && componentCount[i] == 3 && cinfo->num_components == 4))
+			continue;
+		if (cinfo->comp_info[0].h_samp_factor != tjcliMCUWidth[i] / DCTSIZE || cinfo->comp_info[0].v_samp_factor != tjcliMCUHeight[i] / DCTSIZE)
+			continue;
+		int match = 0;
+		for (int ci = 1; ci < cinfo->num_components; ci++)
+		{
+			int h = 1, v = 1;
+			if (cinfo->jpeg_color_space == JCS_YCCK && ci == 3)
+			{
+				h = tjcliMCUWidth[i] / DCTSIZE;
+				v = tjcliMCUHeight[i] / DCTSIZE;
+			}
+			if (cinfo->comp_info[ci].h_samp_factor == h && cinfo->comp_info[ci].v_samp_factor == v)
+				match++;
+		}
+		if (match == cinfo->num_components - 1)
+			return i;
+	}
+	return -1;
+}
+
+/// <summary>
+/// Reads the dimensions, subsampling (TJSAMP_*) and colorspace (TJCS_*) of a JPEG
+/// image without decompressing it, like tjDecompressHeader3().
+/// </summary>
+int tjcliDecompressHeader3(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize, int* width, int* height, int* subsamp, int* colorspace)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	dec->coefArrays = NULL;
+	tjcliBeginOperation(&dec->jerr);
+	if (setjmp(dec->jerr.setjmpBuffer))
+	{
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	jpeg_abort_decompress(cinfo);
+	tjcliSetSource(dec, jpegBuf, jpegSize);
+	dec->jerr.phase = tjcliPhaseHeader;
+	jpeg_read_header(cinfo, TRUE);
+	*width = (int)cinfo->image_width;
+	*height = (int)cinfo->image_height;
+	// The component info is freed by jpeg_abort_decompress(), so it is examined first.
+	*subsamp = tjcliGetSubsamp(cinfo);
+	tjcliSaveLayout(dec);
+	switch (cinfo->jpeg_color_space)
+	{
+	case JCS_RGB: *colorspace = 0; break;
+	case JCS_YCbCr: *colorspace = 1; break;
+	case JCS_GRAYSCALE: *colorspace = 2; break;
+	case JCS_CMYK: *colorspace = 3; break;
+	case JCS_YCCK: *colorspace = 4; break;
+	default: *colorspace = -1; break;
+	}
+	jpeg_abort_decompress(cinfo);
+	if (*width < 1 || *height < 1)
+	{
+		tjcliSetError(&dec->jerr, "Invalid data returned in header");
+		return -1;
+	}
+	if (*subsamp < 0)
+	{
+		tjcliSetError(&dec->jerr, "Could not determine subsampling type for JPEG image");
+		return -1;
+	}
+	if (*colorspace < 0)
+	{
+		tjcliSetError(&dec->jerr, "Could not determine colorspace of JPEG image");
+		return -1;
+	}
+	return 0;
+}
+
+/// <summary>
+/// Estimates the bytes of working memory libjpeg allocates to decompress the image whose
+/// header was read last at scaledWidth x scaledHeight, not counting the output buffer.
+/// This errs on the high side: it counts the context rows of fancy upsampling and a
+/// whole-image coefficient buffer for every multi-scan image.
+/// </summary>
+unsigned long long tjcliEstimateDecodeMemory(const tjcli_decoder* dec, int width, int height, int scaledWidth, int scaledHeight)
+{
+	const tjcli_header_layout* layout = &dec->layout;
+	// The DCT scaling numerator, which is the size each 8x8 block is decoded at.
+	unsigned long long blockSize = ((unsigned long long)scaledWidth * DCTSIZE + width - 1) / width;
+	if (blockSize < 1)
+		blockSize = 1;
+	if (blockSize > 2 * DCTSIZE)
+		blockSize = 2 * DCTSIZE;
+	// Tables, the input buffer, the range limit and color conversion tables and the other
+	// fixed allocations.
+	unsigned long long total = 32768;
+	unsigned long long mcuWidth = (unsigned long long)layout->maxHSamp * DCTSIZE;
+	unsigned long long mcuHeight = (unsigned long long)layout->maxVSamp * DCTSIZE;
+	unsigned long long mcusWide = ((unsigned long long)width + mcuWidth - 1) / mcuWidth;
+	unsigned long long mcusHigh = ((unsigned long long)height + mcuHeight - 1) / mcuHeight;
+	for (int ci = 0; ci < layout->numComponents; ci++)
+	{
+		unsigned long long blocksWide = mcusWide * layout->hSamp[ci];
+		unsigned long long blocksHigh = mcusHigh * layout->vSamp[ci];
+		if (layout->multiScan)
+			total += blocksWide * blocksHigh * sizeof(JBLOCK);
+		// The main buffer holds an MCU row of samples plus the context rows above and below.
+		total += blocksWide * blockSize * layout->vSamp[ci] * blockSize * 2;
+		// The upsampler expands each component to a full-width row group.
+		total += mcusWide * mcuWidth * blockSize / DCTSIZE * layout->maxVSamp * blockSize;
+	}
+	// The row pointers into the output buffer.
+	total += (unsigned long long)scaledHeight * sizeof(JSAMPROW);
+	return total;
+}
+
+/// <summary>
+/// Loads the quantization and Huffman tables from a tables-only datastream, such as
+/// the output of tjcliWriteTables().  libjpeg keeps tables for the life of the
+/// handle, so abbreviated images which leave them out can then be decompressed with
+/// any of the functions here.  Tables defined by an image decompressed later replace
+/// them, as they would in a stream.
+/// </summary>
+int tjcliReadTables(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	dec->coefArrays = NULL;
+	tjcliBeginOperation(&dec->jerr);
+	if (setjmp(dec->jerr.setjmpBuffer))
+	{
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	jpeg_abort_decompress(cinfo);
+	tjcliSetSource(dec, jpegBuf, jpegSize);
+	dec->jerr.phase = tjcliPhaseHeader;
+	if (jpeg_read_header(cinfo, FALSE) != JPEG_HEADER_TABLES_ONLY)
+	{
+		tjcliSetError(&dec->jerr, "Not a tables-only JPEG datastream");
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	return 0;
+}
+
+/// <summary>
+/// Sets the output parameters of a decompressor whose header has been read: the
+/// IDCT scaling for the desired size, the output colorspace and the flags.
+/// </summary>
+static int tjcliSetOutputParams(tjcli_decoder* dec, int desiredWidth, int desiredHeight, int pixelFormat, int flags)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	int scaledWidth, scaledHeight;
+	int num = tjcliGetScaledSize((int)cinfo->image_width, (int)cinfo->image_height, desiredWidth, desiredHeight, &scaledWidth, &scaledHeight);
+	if (num == -1)
+	{
+		tjcliSetError(&dec->jerr, "Could not scale down to desired image dimensions");
+		return -1;
+	}
+	cinfo->scale_num = (unsigned int)num;
+	cinfo->scale_denom = DCTSIZE;
+	cinfo->out_color_space = tjcliPixelFormatToColorspace[pixelFormat];
+	if (flags & TJCLI_FLAG_FASTUPSAMPLE)
+		cinfo->do_fancy_upsampling = FALSE;
+	tjcliSetDCTMethod(cinfo, flags);
+	return 0;
+}
+
+/// <summary>
+/// Reads the rest of the current output pass into dstBuf, stopping early only if
+/// the data source suspends.
+/// </summary>
+static void tjcliReadScanlines(j_decompress_ptr cinfo, unsigned char* dstBuf, int pitch, int flags)
+{
+	int height = (int)cinfo->output_height;
+	JSAMPROW rows[4 * DCTSIZE];
+	while (cinfo->output_scanline < cinfo->output_height)
+	{
+		int y = (int)cinfo->output_scanline;
+		int count = height - y < 4 * DCTSIZE ? height - y : 4 * DCTSIZE;
+		for (int r = 0; r < count; r++)
+			rows[r] = dstBuf + (size_t)pitch * (flags & TJCLI_FLAG_BOTTOMUP ? height - 1 - (y + r) : y + r);
+		if (jpeg_read_scanlines(cinfo, rows, (JDIMENSION)count) == 0)
+			break; // Suspended
+	}
+}
+
+/// <summary>
+/// Decompresses a JPEG image to packed pixels, like tjDecompress2().  The image
+/// is scaled by the IDCT to the largest supported size that fits within
+/// desiredWidth x desiredHeight (0 means the image dimension), and dstBuf must hold
+/// pitch * (scaledHeight - 1) + scaledWidth * tjcliPixelSize[pixelFormat] bytes.
+/// A pitch of 0 means unpadded rows.  BOTTOMUP, FASTUPSAMPLE, FASTDCT and
+/// ACCURATEDCT are honored.
+/// </summary>
+int tjcliDecompressPixels(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize, unsigned char* dstBuf, int desiredWidth, int pitch, int desiredHeight, int pixelFormat, int flags)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	dec->coefArrays = NULL;
+	tjcliBeginOperation(&dec->jerr);
+	if (pixelFormat < 0 || pixelFormat >= TJCLI_NUMPF || desiredWidth < 0 || desiredHeight < 0 || pitch < 0)
+	{
+		tjcliSetError(&dec->jerr, "Invalid argument in tjcliDecompressPixels()");
+		return -1;
+	}
+	if (setjmp(dec->jerr.setjmpBuffer))
+	{
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	jpeg_abort_decompress(cinfo);
+	tjcliSetSource(dec, jpegBuf, jpegSize);
+	dec->jerr.phase = tjcliPhaseHeader;
+	jpeg_read_header(cinfo, TRUE);
+	dec->jerr.phase = tjcliPhaseStartDecompress;
+	if (tjcliSetOutputParams(dec, desiredWidth, desiredHeight, pixelFormat, flags) == -1)
+	{
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+
+	jpeg_start_decompress(cinfo);
+	if (pitch == 0)
+		pitch = (int)cinfo->output_width * tjcliPixelSize[pixelFormat];
+	dec->jerr.phase = tjcliPhaseDecompress;
+	tjcliReadScanlines(cinfo, dstBuf, pitch, flags);
+	dec->jerr.phase = tjcliPhaseFinishDecompress;
+	jpeg_finish_decompress(cinfo);
+	return 0;
+}
+
+/// <summary>
+/// Decompresses a JPEG image like tjcliDecompressPixels(), but reports how well it
+/// went in *status instead of only failing.  Corrupt data is not an error: libjpeg
+/// warns, resyncs at the next restart marker and carries on, and truncated data is
+/// finished as if the missing MCUs were gray.  If a fatal error (such as a corrupt
+/// header) stops the decode part way, -1 is returned and status->rowsDecoded still
+/// says how many rows of dstBuf were filled.
+/// </summary>
+int tjcliTryDecompress(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize, unsigned char* dstBuf, int desiredWidth, int pitch, int desiredHeight, int pixelFormat, int flags, tjcli_decode_status* status)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	dec->coefArrays = NULL;
+	memset(status, 0, sizeof(tjcli_decode_status));
+	tjcliBeginOperation(&dec->jerr);
+	if (pixelFormat < 0 || pixelFormat >= TJCLI_NUMPF || desiredWidth < 0 || desiredHeight < 0 || pitch < 0)
+	{
+		tjcliSetError(&dec->jerr, "Invalid argument in tjcliTryDecompress()");
+		return -1;
+	}
+	// Modified between setjmp() and longjmp(), so it must not be cached in a register.
+	volatile int started = 0;
+	if (setjmp(dec->jerr.setjmpBuffer))
+	{
+		if (started)
+			status->rowsDecoded = (int)cinfo->output_scanline;
+		status->warnings = (int)dec->jerr.pub.num_warnings;
+		status->corruptMcus = dec->jerr.corruptMcus;
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	jpeg_abort_decompress(cinfo);
+	tjcliSetSource(dec, jpegBuf, jpegSize);
+	dec->jerr.phase = tjcliPhaseHeader;
+	jpeg_read_header(cinfo, TRUE);
+	dec->jerr.phase = tjcliPhaseStartDecompress;
+	if (tjcliSetOutputParams(dec, desiredWidth, desiredHeight, pixelFormat, flags) == -1)
+	{
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+
+	jpeg_start_decompress(cinfo);
+	started = 1;
+	if (pitch == 0)
+		pitch = (int)cinfo->output_width * tjcliPixelSize[pixelFormat];
+	dec->jerr.phase = tjcliPhaseDecompress;
+	tjcliReadScanlines(cinfo, dstBuf, pitch, flags);
+	status->rowsDecoded = (int)cinfo->output_scanline;
+	dec->jerr.phase = tjcliPhaseFinishDecompress;
+	jpeg_finish_decompress(cinfo);
+	status->warnings = (int)dec->jerr.pub.num_warnings;
+	status->corruptMcus = dec->jerr.corruptMcus;
+	return 0;
+}
+
+/// <summary>
+/// Decompresses a rough preview of a progressive JPEG image, like
+/// tjcliDecompressPixels() but using only the first maxScans scans and/or the first
+/// maxBytes bytes (0 means no limit).  The scans are read in buffered-image mode and
+/// output in a single pass, and the remaining scans are never entropy decoded, so
+/// with one or two scans (typically the DC scans, which carry the average color of
+/// each 8x8 block) this costs a fraction of a full decode.  Images with a single scan
+/// are decoded in full.  *scansUsed receives the number of scans output; if maxBytes
+/// cut a scan short, that scan is included as far as it was received.
+/// </summary>
+int tjcliDecompressPreview(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize, unsigned char* dstBuf, int desiredWidth, int pitch, int desiredHeight, int pixelFormat, int flags, int maxScans, unsigned long maxBytes, int* scansUsed)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	dec->coefArrays = NULL;
+	tjcliBeginOperation(&dec->jerr);
+	if (pixelFormat < 0 || pixelFormat >= TJCLI_NUMPF || desiredWidth < 0 || desiredHeight < 0 || pitch < 0 || maxScans < 0)
+	{
+		tjcliSetError(&dec->jerr, "Invalid argument in tjcliDecompressPreview()");
+		return -1;
+	}
+	if (setjmp(dec->jerr.setjmpBuffer))
+	{
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	jpeg_abort_decompress(cinfo);
+	tjcliSetSource(dec, jpegBuf, jpegSize);
+	dec->jerr.phase = tjcliPhaseHeader;
+	jpeg_read_header(cinfo, TRUE);
+	dec->jerr.phase = tjcliPhaseStartDecompress;
+	if (tjcliSetOutputParams(dec, desiredWidth, desiredHeight, pixelFormat, flags) == -1)
+	{
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+
+	if (!jpeg_has_multiple_scans(cinfo))
+	{
+		jpeg_start_decompress(cinfo);
+		if (pitch == 0)
+			pitch = (int)cinfo->output_width * tjcliPixelSize[pixelFormat];
+		dec->jerr.phase = tjcliPhaseDecompress;
+		tjcliReadScanlines(cinfo, dstBuf, pitch, flags);
+		dec->jerr.phase = tjcliPhaseFinishDecompress;
+		jpeg_finish_decompress(cinfo);
+		*scansUsed = 1;
+		return 0;
+	}
+
+	if (maxBytes > 0)
+	{
+		// Hide the data past the budget; the source then ends the image with a fake
+		// EOI, as it does for a truncated file.  A read source also stops reading there.
+		int reading = cinfo->src == &dec->readSrc.pub;
+		unsigned long long consumed = reading
+			? dec->readSrc.bytesRead - cinfo->src->bytes_in_buffer
+			: (unsigned long long)(cinfo->src->next_input_byte - jpegBuf);
+		unsigned long long remaining = maxBytes > consumed ? maxBytes - consumed : 0;
+		if (remaining < cinfo->src->bytes_in_buffer)
+			cinfo->src->bytes_in_buffer = (size_t)remaining;
+		if (reading)
+		{
+			dec->readSrc.bytesRead = consumed + cinfo->src->bytes_in_buffer;
+			dec->readSrc.limit = maxBytes;
+		}
+	}
+	cinfo->buffered_image = TRUE;
+	jpeg_start_decompress(cinfo);
+	dec->jerr.phase = tjcliPhaseDecompress;
+	for (;;)
+	{
+		int result = jpeg_consume_input(cinfo);
+		if (result == JPEG_REACHED_EOI)
+			break;
+		if (result == JPEG_REACHED_SOS && maxScans > 0 && cinfo->input_scan_number > maxScans)
+			break;
+	}
+	// When stopped at the start of a scan, only the scans before it are complete.
+	// Showing them needs no more input.
+	int scan = jpeg_input_complete(cinfo) ? cinfo->input_scan_number : cinfo->input_scan_number - 1;
+	jpeg_start_output(cinfo, scan);
+	if (pitch == 0)
+		pitch = (int)cinfo->output_width * tjcliPixelSize[pixelFormat];
+	tjcliReadScanlines(cinfo, dstBuf, pitch, flags);
+	jpeg_finish_output(cinfo);
+	jpeg_abort_decompress(cinfo);
+	*scansUsed = scan;
+	return 0;
+}
+
+/// <summary>
+/// Decompresses only the luma (Y) plane of a JPEG image into dstBuf, which must
+/// hold pitch * (height - 1) + width bytes; dstSize is the number of bytes from
+/// dstBuf to the end of the caller's buffer, and x is the column of dstBuf within
+/// its row.  The chroma components are entropy decoded (the format requires it)
+/// but are never inverse transformed, upsampled or color converted.  The IDCT
+/// writes whole blocks, so rows of Y are written straight into dstBuf only where
+/// the padding to a whole block stays inside the same row and inside the buffer,
+/// and the few bytes it covers to the right of the image are put back afterwards;
+/// otherwise they go through a small scratch strip and just width bytes are
+/// copied.  Images whose luma component is subsampled (unusual) and RGB images
+/// use libjpeg's grayscale conversion instead.  CMYK and YCCK images have no
+/// conversion to grayscale, so they are rejected.
+/// </summary>
+int tjcliDecompressLuma(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize, unsigned char* dstBuf, int x, int pitch, size_t dstSize, int flags)
+{
+	j_decompress_ptr cinfo = &dec->cinfo;
+	dec->coefArrays = NULL;
+	tjcliBeginOperation(&dec->jerr);
+	if (setjmp(dec->jerr.setjmpBuffer))
+	{
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	jpeg_abort_decompress(cinfo);
+	tjcliSetSource(dec, jpegBuf, jpegSize);
+	dec->jerr.phase = tjcliPhaseHeader;
+	jpeg_read_header(cinfo, TRUE);
+	dec->jerr.phase = tjcliPhaseStartDecompress;
+	if (cinfo->jpeg_color_space == JCS_CMYK || cinfo->jpeg_color_space == JCS_YCCK)
+	{
+		tjcliSetError(&dec->jerr, "Luma-only decoding is not supported for CMYK images");
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	tjcliSetDCTMethod(cinfo, flags);
+	int width = (int)cinfo->image_width, height = (int)cinfo->image_height;
+	if (pitch == 0)
+		pitch = width;
+	if (pitch < width || x < 0)
+	{
+		tjcliSetError(&dec->jerr, "Invalid pitch");
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	if (dstSize < (size_t)pitch * (height - 1) + width)
+	{
+		tjcliSetError(&dec->jerr, "Destination buffer is not large enough");
+		jpeg_abort_decompress(cinfo);
+		return -1;
+	}
+	int bottomUp = (flags & TJCLI_FLAG_BOTTOMUP) != 0;
+
+	jpeg_component_info* luma = &cinfo->comp_info[0];
+	int raw = (cinfo->jpeg_color_space == JCS_YCbCr || cinfo->jpeg_color_space == JCS_GRAYSCALE)
+		&& luma->h_samp_factor == cinfo->max_h_samp_factor
+		&& luma->v_samp_factor == cinfo->max_v_samp_factor;
+	if (!raw)
+	{
+		cinfo->out_color_space = JCS_GRAYSCALE;
+		jpeg_start_decompress(cinfo);
+		dec->jerr.phase = tjcliPhaseDecompress;
+		while (cinfo->output_scanline < cinfo->output_height)
+		{
+			JSAMPROW row = dstBuf + (size_t)pitch * (bottomUp ? height - 1 - (int)cinfo->output_scanline : (int)cinfo->output_scanline);
+			jpeg_read_scanlines(cinfo, &row, 1);
+		}
+		dec->jerr.phase = tjcliPhaseFinishDecompress;
+		jpeg_finish_decompress(cinfo);
+		return 0;
+	}
+
+	// In raw mode libjpeg hands back the component planes without upsampling or
+	// color conversion, and the coefficient controller skips the IDCT for any
+	// component that is not needed.
+	cinfo->raw_data_out = TRUE;
+	for (int ci = 1; ci < cinfo->num_components; ci++)
+		cinfo->comp_info[ci].component_needed = FALSE;
+	jpeg_start_decompress(cinfo);
+	dec->jerr.phase = tjcliPhaseDecompress;
+
+	int rowsPerCall = cinfo->max_v_samp_factor * DCTSIZE;
+	int paddedWidth = (int)luma->width_in_blocks * DCTSIZE;
+	JSAMPROW rows[4 * DCTSIZE];
+	JSAMPARRAY planes[MAX_COMPONENTS];
+	for (int ci = 0; ci < cinfo->num_components; ci++)
+		planes[ci] = rows;
+	// The padding written past the image width must stay in the same row and in the
+	// buffer.  Whatever the caller had there is saved and put back.
+	int rowHasRoom = (long long)x + paddedWidth <= pitch;
+	int tailSize = paddedWidth - width;
+	unsigned char tail[4 * DCTSIZE][4 * DCTSIZE];
+	JSAMPARRAY strip = NULL;
+	while (cinfo->output_scanline < cinfo->output_height)
+	{
+		int y = (int)cinfo->output_scanline;
+		int direct = rowHasRoom && y + rowsPerCall <= height;
+		if (direct)
+		{
+			int lowest = bottomUp ? height - 1 - y : y + rowsPerCall - 1;
+			direct = (size_t)pitch * lowest + paddedWidth <= dstSize;
+		}
+		if (direct)
+		{
+			for (int r = 0; r < rowsPerCall; r++)
+			{
+				rows[r] = dstBuf + (size_t)pitch * (bottomUp ? height - 1 - (y + r) : y + r);
+				memcpy(tail[r], rows[r] + width, tailSize);
+			}
+		}
+		else
+		{
+			if (strip == NULL)
+				strip = (*cinfo->mem->alloc_sarray)((j_common_ptr)cinfo, JPOOL_IMAGE, (JDIMENSION)paddedWidth, (JDIMENSION)rowsPerCall);
+			for (int r = 0; r < rowsPerCall; r++)
+				rows[r] = strip[r];
+		}
+		jpeg_read_raw_data(cinfo, planes, (JDIMENSION)rowsPerCall);
+		if (direct)
+		{
+			for (int r = 0; r < rowsPerCall; r++)
+				memcpy(rows[r] + width, tail[r], tailSize);
+		}
+		else
+		{
+			for (int r = 0; r < rowsPerCall && y + r < height; r++)
+				memcpy(dstBuf + (size_t)pitch * (bottomUp ? height - 1 - (y + r) : y + r), strip[r], width);
+		}
+	}
+	dec->jerr.phase = tjcliPhaseFinishDecompress;
+	jpeg_finish_decompress(cinfo);
+	return 0;
+}
+
+enum
+{
+	TJCLI_INC_HEADER = 0,
+	TJCLI_INC_START = 1,
+	TJCLI_INC_SCANLINES = 2,
+	TJCLI_INC_FINISH = 3,
+	TJCLI_INC_BUFFERED = 4,
+	TJCLI_INC_DONE = 5
+};
+
+static void tjcliSuspendingInitSource(j_decompress_ptr cinfo)
+{
+}
+
+static boolean tjcliSuspendingFillInputBuffer(j_decompress_ptr cinfo)
+{
+	static const JOCTET fakeEOI[2] = { 0xFF, JPEG_EOI };
+	tjcli_suspending_src* src = (tjcli_suspending_src*)cinfo->src;
+	if (!src->endOfData)
+		return FALSE; // Suspend until more data is fed.
+	// The data ended early.  Like jpeg_mem_src(), warn and finish the image with
+	// whatever has been decoded.
+	WARNMS(cinfo, JWRN_JPEG_EOF);
+	src->pub.next_input_byte = fakeEOI;
+	src->pub.bytes_in_buffer = 2;
+	return TRUE;
+}
+
+static void tjcliSuspendingSkipInputData(j_decompress_ptr cinfo, long numBytes)
+{
+	tjcli_suspending_src* src = (tjcli_suspending_src*)cinfo->src;
+	if (numBytes <= 0)
+		return;
+	if ((size_t)numBytes <= src->pub.bytes_in_buffer)
+	{
+		src->pub.next_input_byte += numBytes;
+		src->pub.bytes_in_buffer -= numBytes;
+	}
+	else
+	{
+		// Skip the rest as it arrives.
+		src->skipBytes += (size_t)numBytes - src->pub.bytes_in_buffer;
+		src->pub.next_input_byte += src->pub.bytes_in_buffer;
+		src->pub.bytes_in_buffer = 0;
+	}
+}
+
+static void tjcliSuspendingTermSource(j_decompress_ptr cinfo)
+{
+}
+
+/// <summary>
+/// Creates an incremental decoder, or returns NULL if libjpeg could not be initialized.
+/// </summary>
+tjcli_incremental* tjcliInitIncremental()
+{
+	tjcli_incremental* inc = (tjcli_incremental*)calloc(1, sizeof(tjcli_incremental));
+	if (inc == NULL)
+		return NULL;
+	inc->dec = tjcliInitDecoder();
+	if (inc->dec == NULL)
+	{
+		free(inc);
+		return NULL;
+	}
+	inc->src.pub.init_source = tjcliSuspendingInitSource;
+	inc->src.pub.fill_input_buffer = tjcliSuspendingFillInputBuffer;
+	inc->src.pub.skip_input_data = tjcliSuspendingSkipInputData;
+	inc->src.pub.resync_to_restart = jpeg_resync_to_restart;
+	inc->src.pub.term_source = tjcliSuspendingTermSource;
+	inc->dec->cinfo.src = &inc->src.pub;
+	inc->state = TJCLI_INC_DONE;
+	return inc;
+}
+
+void tjcliDestroyIncremental(tjcli_incremental* inc)
+{
+	if (inc == NULL)
+		return;
+	tjcliDestroyDecoder(inc->dec);
+	free(inc->src.buffer);
+	free(inc);
+}
+
+/// <summary>
+/// Returns the message for the most recent failure on this handle.
+/// </summary>
+const char* tjcliGetErrorStr(tjcli_incremental* inc)
+{
+	if (inc == NULL)
+		return "Invalid handle";
+	return inc->dec->jerr.message;
+}
+
+/// <summary>
+/// Begins a new image, discarding any data fed for the previous one.  If outputPasses
+/// is nonzero, progressive images are decoded in buffered-image mode so that each
+/// group of completed scans can be output as a coarse preview of the whole image;
+/// otherwise the pixels of a progressive image only appear once all of it has arrived.
+/// </summary>
+int tjcliIncrementalStart(tjcli_incremental* inc, int desiredWidth, int desiredHeight, int pixelFormat, int flags, int outputPasses)
+{
+	tjcliBeginOperation(&inc->dec->jerr);
+	if (pixelFormat < 0 || pixelFormat >= TJCLI_NUMPF || desiredWidth < 0 || desiredHeight < 0)
+	{
+		tjcliSetError(&inc->dec->jerr, "Invalid argument in tjcliIncrementalStart()");
+		return -1;
+	}
+	jpeg_abort_decompress(&inc->dec->cinfo);
+	inc->src.pub.next_input_byte = inc->src.buffer;
+	inc->src.pub.bytes_in_buffer = 0;
+	inc->src.skipBytes = 0;
+	inc->src.endOfData = 0;
+	inc->state = TJCLI_INC_HEADER;
+	inc->desiredWidth = desiredWidth;
+	inc->desiredHeight = desiredHeight;
+	inc->pixelFormat = pixelFormat;
+	inc->flags = flags;
+	inc->outputPasses = outputPasses;
+	inc->displayedScan = 0;
+	memset(&inc->status, 0, sizeof(inc->status));
+	return 0;
+}
+
+/// <summary>
+/// Appends data to the image.  Pass endOfData = 1 with the last piece (or alone) to
+/// let the decoder finish an image whose data ended early.
+/// </summary>
+int tjcliIncrementalFeed(tjcli_incremental* inc, const unsigned char* data, size_t size, int endOfData)
+{
+	tjcli_suspending_src* src = &inc->src;
+	// Feeding and decoding carry on the image begun by tjcliIncrementalStart(), so its
+	// warnings so far are kept.
+	tjcliContinueOperation(&inc->dec->jerr);
+	if (src->endOfData)
+	{
+		tjcliSetError(&inc->dec->jerr, "The end of the data has already been fed");
+		return -1;
+	}
+	size_t skip = src->skipBytes < size ? src->skipBytes : size;
+	data += skip;
+	size -= skip;
+	src->skipBytes -= skip;
+
+	// Move the bytes the decoder has not consumed yet to the front, then append.
+	size_t pending = src->pub.bytes_in_buffer;
+	if (pending > 0 && src->pub.next_input_byte != src->buffer)
+		memmove(src->buffer, src->pub.next_input_byte, pending);
+	if (pending + size > src->capacity)
+	{
+		size_t capacity = src->capacity < 65536 ? 65536 : src->capacity;
+		while (capacity < pending + size)
+			capacity *= 2;
+		unsigned char* buffer = (unsigned char*)realloc(src->buffer, capacity);
+		if (buffer == NULL)
+		{
+			tjcliSetError(&inc->dec->jerr, "Out of memory");
+			return -1;
+		}
+		src->buffer = buffer;
+		src->capacity = capacity;
+	}
+	if (size > 0)
+		memcpy(src->buffer + pending, data, size);
+	src->pub.next_input_byte = src->buffer;
+	src->pub.bytes_in_buffer = pending + size;
+	src->endOfData = endOfData;
+	return 0;
+}
+
+/// <summary>
+/// Decodes as much of the image as the data fed so far allows, then returns so more
+/// data can be fed; no work is repeated on the next call.  Until the header has been
+/// read, pass dstBuf = NULL; once inc->status.headerReady is set, pass a buffer of
+/// pitch * status.height bytes (the same one every time) to receive the pixels.
+/// </summary>
+int tjcliIncrementalDecode(tjcli_incremental* inc, unsigned char* dstBuf, int pitch)
+{
+	j_decompress_ptr cinfo = &inc->dec->cinfo;
+	tjcli_incremental_status* status = &inc->status;
+	tjcliContinueOperation(&inc->dec->jerr);
+	if (setjmp(inc->dec->jerr.setjmpBuffer))
+	{
+		jpeg_abort_decompress(cinfo);
+		inc->state = TJCLI_INC_DONE;
+		return -1;
+	}
+	if (inc->state == TJCLI_INC_HEADER)
+	{
+		inc->dec->jerr.phase = tjcliPhaseHeader;
+		if (jpeg_read_header(cinfo, TRUE) == JPEG_SUSPENDED)
+			return 0;
+		if (tjcliSetOutputParams(inc->dec, inc->desiredWidth, inc->desiredHeight, inc->pixelFormat, inc->flags) == -1)
+		{
+			jpeg_abort_decompress(cinfo);
+			inc->state = TJCLI_INC_DONE;
+			return -1;
+		}
+		status->progressive = jpeg_has_multiple_scans(cinfo) ? 1 : 0;
+		cinfo->buffered_image = status->progressive && inc->outputPasses ? TRUE : FALSE;
+		jpeg_calc_output_dimensions(cinfo);
+		status->width = (int)cinfo->output_width;
+		status->height = (int)cinfo->output_height;
+		status->headerReady = 1;
+		inc->state = TJCLI_INC_START;
+	}
+	if (dstBuf == NULL)
+		return 0;
+	if (pitch == 0)
+		pitch = status->width * tjcliPixelSize[inc->pixelFormat];
+
+	if (inc->state == TJCLI_INC_START)
+	{
+		inc->dec->jerr.phase = tjcliPhaseStartDecompress;
+		if (!jpeg_start_decompress(cinfo))
+			return 0;
+		inc->state = cinfo->buffered_image ? TJCLI_INC_BUFFERED : TJCLI_INC_SCANLINES;
+	}
+	if (inc->state == TJCLI_INC_SCANLINES)
+	{
+		inc->dec->jerr.phase = tjcliPhaseDecompress;
+		tjcliReadScanlines(cinfo, dstBuf, pitch, inc->flags);
+		status->rowsDecoded = (int)cinfo->output_scanline;
+		if (cinfo->output_scanline < cinfo->output_height)
+			return 0;
+		status->passesCompleted = 1;
+		inc->state = TJCLI_INC_FINISH;
+	}
+	if (inc->state == TJCLI_INC_BUFFERED)
+	{
+		inc->dec->jerr.phase = tjcliPhaseDecompress;
+		int result;
+		do
+		{
+			result = jpeg_consume_input(cinfo);
+		} while (result != JPEG_SUSPENDED && result != JPEG_REACHED_EOI);
+		int inputComplete = jpeg_input_complete(cinfo);
+		// Scans before the one being received are complete.  Showing them never needs
+		// more input, so the output pass below cannot suspend.
+		int completeScans = inputComplete ? cinfo->input_scan_number : cinfo->input_scan_number - 1;
+		if (completeScans > inc->displayedScan)
+		{
+			jpeg_start_output(cinfo, completeScans);
+			tjcliReadScanlines(cinfo, dstBuf, pitch, inc->flags);
+			jpeg_finish_output(cinfo);
+			inc->displayedScan = completeScans;
+			status->rowsDecoded = status->height;
+			status->passesCompleted++;
+		}
+		if (!inputComplete || inc->displayedScan < cinfo->input_scan_number)
+			return 0;
+		inc->state = TJCLI_INC_FINISH;
+	}
+	if (inc->state == TJCLI_INC_FINISH)
+	{
+		inc->dec->jerr.phase = tjcliPhaseFinishDecompress;
+		if (!jpeg_finish_decompress(cinfo))
+			return 0;
+		status->complete = 1;
+		inc->state = TJCLI_INC_DONE;
+	}
+	return 0;
+}
+#pragma managed( pop )
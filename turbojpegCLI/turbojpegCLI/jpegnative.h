@@ -0,0 +1,291 @@
+#pragma once
+#pragma managed( push, off )
+#include <stdio.h>
+#include <setjmp.h>
+#pragma warning( disable : 4635 )
+#include "jpeglib.h"
+#include "jerror.h"
+#pragma warning( default : 4635 )
+#pragma managed( pop )
+
+// Native helpers which drive libjpeg directly, for features that the TurboJPEG
+// API does not expose (such as access to the DCT coefficients).  Like the
+// TurboJPEG API, every function that can fail returns -1, and the reason can be
+// retrieved with tjcliGetErrorStr().  These functions are compiled as native
+// code because libjpeg reports errors with longjmp.
+
+// Flags accepted by the pixel decoding functions.  The values match the
+// TurboJPEG TJFLAG_* values (and turbojpegCLI::Flag), so flags can be passed through.
+#define TJCLI_FLAG_BOTTOMUP 2
+#define TJCLI_FLAG_FASTUPSAMPLE 256
+#define TJCLI_FLAG_FASTDCT 2048
+#define TJCLI_FLAG_ACCURATEDCT 4096
+
+// Number of subsampling options.  The values match the TurboJPEG TJSAMP_* values
+// (and turbojpegCLI::SubsamplingOption), from TJSAMP_444 = 0 to TJSAMP_411 = 5.
+#define TJCLI_NUMSAMP 6
+#define TJCLI_SAMP_GRAY 3
+
+// Number of pixel formats.  The values match the TurboJPEG TJPF_* values (and
+// turbojpegCLI::PixelFormat), from TJPF_RGB = 0 to TJPF_CMYK = 11.
+#define TJCLI_NUMPF 12
+#define TJCLI_PF_CMYK 11
+
+/// <summary>
+/// libjpeg error manager which stores messages in the handle instead of
+/// printing them, and longjmps back to the function that was called.  Because
+/// everything is kept per handle, unlike tjGetErrorStr(), errors on one thread
+/// never show up on another.  phase names the step of the current operation
+/// (so after a failure, the step which failed), and pub.num_warnings and warning
+/// hold the count and first warning of the current operation.
+/// </summary>
+struct tjcli_error_mgr
+{
+	struct jpeg_error_mgr pub;
+	jmp_buf setjmpBuffer;
+	char message[JMSG_LENGTH_MAX];
+	char warning[JMSG_LENGTH_MAX];
+	const char* phase;
+	long long corruptMcus;
+	int corruptScan;
+	long long corruptEnd;
+};
+
+/// <summary>
+/// libjpeg progress monitor which stops the current operation, as if it had failed,
+/// once cancel is set.  cancel may be set from another thread.  libjpeg calls the
+/// monitor between groups of rows, and between MCU rows while it reads a multi-scan
+/// image, so an operation stops soon after.
+/// </summary>
+struct tjcli_progress_mgr
+{
+	struct jpeg_progress_mgr pub;
+	volatile long cancel;
+};
+
+/// <summary>
+/// Fills buffer with up to size bytes of a JPEG image for a tjcli_read_src.  Returns the
+/// number of bytes read, 0 at the end of the data, or -1 to stop decompression.
+/// </summary>
+typedef int (*tjcli_read_func)(unsigned char* buffer, int size);
+
+/// <summary>
+/// libjpeg source manager which reads the image through a callback, a chunk the size
+/// of a caller's buffer at a time, as the decoder needs it.  bytesRead counts the bytes
+/// read since the image started, and if limit is nonzero, no more than that are read.
+/// </summary>
+struct tjcli_read_src
+{
+	struct jpeg_source_mgr pub;
+	unsigned char* buffer;
+	size_t capacity;
+	tjcli_read_func read;
+	unsigned long long bytesRead;
+	unsigned long long limit;
+};
+
+/// <summary>
+/// Sampling layout of the last image whose header was read, which
+/// tjcliEstimateDecodeMemory() needs after libjpeg has freed the component info.
+/// multiScan is set for progressive and other multi-scan images, which libjpeg decodes
+/// through a buffer of the whole image's coefficients.
+/// </summary>
+struct tjcli_header_layout
+{
+	int numComponents;
+	int maxHSamp;
+	int maxVSamp;
+	int hSamp[MAX_COMPONENTS];
+	int vSamp[MAX_COMPONENTS];
+	int multiScan;
+};
+
+/// <summary>
+/// A reusable libjpeg decompression handle.  If readSrc.read is set (see
+/// tjcliSetReadSource()), functions passed a NULL jpegBuf read through readSrc, and
+/// memSrc keeps the jpeg_mem_src() manager for when they are passed a buffer again.
+/// </summary>
+struct tjcli_decoder
+{
+	struct jpeg_decompress_struct cinfo;
+	struct tjcli_error_mgr jerr;
+	jvirt_barray_ptr* coefArrays;
+	struct tjcli_read_src readSrc;
+	struct jpeg_source_mgr* memSrc;
+	struct tjcli_progress_mgr progress;
+	struct tjcli_header_layout layout;
+};
+
+/// <summary>
+/// libjpeg destination manager which writes into a buffer that grows as needed.
+/// The buffer is kept between images so it only grows a few times.
+/// </summary>
+struct tjcli_mem_dest
+{
+	struct jpeg_destination_mgr pub;
+	unsigned char* buffer;
+	size_t capacity;
+	size_t size;
+};
+
+/// <summary>
+/// libjpeg destination manager which writes into a caller's buffer and, if the image
+/// does not fit, carries on in an overflow buffer owned by the handle, so the image
+/// never has to be compressed again.  The overflow buffer is kept between images.
+/// </summary>
+struct tjcli_overflow_dest
+{
+	struct jpeg_destination_mgr pub;
+	unsigned char* buffer;
+	size_t capacity;
+	unsigned char* overflow;
+	size_t overflowCapacity;
+	size_t overflowSize;
+	int overflowed;
+};
+
+/// <summary>
+/// Receives one chunk of a JPEG image from a tjcli_stream_dest.  Returns 0, or -1 to
+/// stop compression.
+/// </summary>
+typedef int (*tjcli_write_func)(const unsigned char* data, int size);
+
+/// <summary>
+/// libjpeg destination manager which passes the image to a callback in chunks of the
+/// size of a caller's buffer as the entropy coder fills it, and the final partial chunk
+/// when compression finishes, so the whole image is never held in memory.
+/// </summary>
+struct tjcli_stream_dest
+{
+	struct jpeg_destination_mgr pub;
+	unsigned char* buffer;
+	size_t capacity;
+	tjcli_write_func write;
+	unsigned long long bytesWritten;
+};
+
+/// <summary>
+/// A reusable libjpeg compression handle.  dest grows as needed, fixedDest writes
+/// into a caller's buffer and fails if the image does not fit, overflowDest writes
+/// into a caller's buffer and spills into its own, and streamDest passes the image
+/// on in chunks.
+/// </summary>
+struct tjcli_encoder
+{
+	struct jpeg_compress_struct cinfo;
+	struct tjcli_error_mgr jerr;
+	struct tjcli_mem_dest dest;
+	struct tjcli_mem_dest fixedDest;
+	struct tjcli_overflow_dest overflowDest;
+	struct tjcli_stream_dest streamDest;
+	struct tjcli_progress_mgr progress;
+};
+
+/// <summary>
+/// Outcome of tjcliTryDecompress().  corruptMcus estimates how many MCUs were lost
+/// to corrupt data (libjpeg fills them with flat gray blocks), counting from the MCU
+/// row where each problem was detected to the next restart marker.
+/// </summary>
+struct tjcli_decode_status
+{
+	int rowsDecoded;
+	int warnings;
+	long long corruptMcus;
+};
+
+/// <summary>
+/// libjpeg source manager for data that arrives in pieces.  When the decoder runs
+/// out of bytes it suspends instead of failing, and the unconsumed bytes are kept
+/// so it can resume where it stopped once more data is appended.
+/// </summary>
+struct tjcli_suspending_src
+{
+	struct jpeg_source_mgr pub;
+	unsigned char* buffer;
+	size_t capacity;
+	size_t skipBytes;
+	int endOfData;
+};
+
+/// <summary>
+/// Progress reported by tjcliIncrementalDecode().  rowsDecoded counts the rows of
+/// the output image that are valid (all of them once a progressive pass has been
+/// output), and passesCompleted counts the progressive passes output so far.
+/// </summary>
+struct tjcli_incremental_status
+{
+	int headerReady;
+	int width;
+	int height;
+	int progressive;
+	int rowsDecoded;
+	int passesCompleted;
+	int complete;
+};
+
+/// <summary>
+/// State of an image being decoded as its data arrives.
+/// </summary>
+struct tjcli_incremental
+{
+	tjcli_decoder* dec;
+	struct tjcli_suspending_src src;
+	int state;
+	int pixelFormat;
+	int flags;
+	int desiredWidth;
+	int desiredHeight;
+	int outputPasses;
+	int displayedScan;
+	struct tjcli_incremental_status status;
+};
+
+/// <summary>
+/// tjcliNaturalOrder[i] is the natural-order position of the i'th coefficient
+/// in zigzag order, so tjcliNaturalOrder[1] is the first AC coefficient.
+/// </summary>
+extern const int tjcliNaturalOrder[DCTSIZE2];
+
+/// <summary>
+/// Bytes per pixel of each pixel format.
+/// </summary>
+extern const int tjcliPixelSize[TJCLI_NUMPF];
+
+tjcli_decoder* tjcliInitDecoder();
+void tjcliDestroyDecoder(tjcli_decoder* dec);
+const char* tjcliGetErrorStr(tjcli_decoder* dec);
+int tjcliSetSaveMarkers(tjcli_decoder* dec, int saveMarkers);
+void tjcliSetReadSource(tjcli_decoder* dec, unsigned char* chunkBuf, int chunkSize, tjcli_read_func read);
+
+tjcli_encoder* tjcliInitEncoder();
+void tjcliDestroyEncoder(tjcli_encoder* enc);
+const char* tjcliGetErrorStr(tjcli_encoder* enc);
+int tjcliCompressPixels(tjcli_encoder* enc, const unsigned char* srcBuf, int width, int pitch, int height, int pixelFormat, int subsamp, int quality, int flags, unsigned char* jpegBuf, unsigned long* jpegSize);
+int tjcliCompressAbbreviated(tjcli_encoder* enc, const unsigned char* srcBuf, int width, int pitch, int height, int pixelFormat, int subsamp, int quality, int flags, unsigned char* jpegBuf, unsigned long* jpegSize);
+int tjcliCompressOverflow(tjcli_encoder* enc, const unsigned char* srcBuf, int width, int pitch, int height, int pixelFormat, int subsamp, int quality, int flags, int abbreviated, unsigned char* jpegBuf, unsigned long jpegBufSize, unsigned long* jpegSize);
+int tjcliCompressStream(tjcli_encoder* enc, const unsigned char* srcBuf, int width, int pitch, int height, int pixelFormat, int subsamp, int quality, int flags, int abbreviated, unsigned char* chunkBuf, int chunkSize, tjcli_write_func write, unsigned long long* jpegSize);
+int tjcliWriteTables(tjcli_encoder* enc, int quality, unsigned char** jpegBuf, unsigned long* jpegSize);
+
+int tjcliReadCoefficients(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize);
+int tjcliGetBlockDimensions(tjcli_decoder* dec, int componentIndex, int* blocksWide, int* blocksHigh);
+int tjcliGetLumaFeatures(tjcli_decoder* dec, int numAC, float* features);
+int tjcliGetBlockRows(tjcli_decoder* dec, int componentIndex, JBLOCKROW* rows);
+int tjcliMaskRegion(tjcli_decoder* dec, int x, int y, int width, int height, int flat);
+int tjcliWriteCoefficients(tjcli_decoder* dec, tjcli_encoder* enc, int optimizeCoding, int copyMarkers, unsigned char** jpegBuf, unsigned long* jpegSize);
+
+int tjcliGetScaledSize(int width, int height, int desiredWidth, int desiredHeight, int* scaledWidth, int* scaledHeight);
+int tjcliDecompressHeader(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize, int* width, int* height);
+int tjcliDecompressHeader3(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize, int* width, int* height, int* subsamp, int* colorspace);
+unsigned long long tjcliEstimateDecodeMemory(const tjcli_decoder* dec, int width, int height, int scaledWidth, int scaledHeight);
+int tjcliReadTables(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize);
+int tjcliDecompressPixels(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize, unsigned char* dstBuf, int desiredWidth, int pitch, int desiredHeight, int pixelFormat, int flags);
+int tjcliDecompressLuma(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize, unsigned char* dstBuf, int x, int pitch, size_t dstSize, int flags);
+int tjcliDecompressPreview(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize, unsigned char* dstBuf, int desiredWidth, int pitch, int desiredHeight, int pixelFormat, int flags, int maxScans, unsigned long maxBytes, int* scansUsed);
+int tjcliTryDecompress(tjcli_decoder* dec, const unsigned char* jpegBuf, unsigned long jpegSize, unsigned char* dstBuf, int desiredWidth, int pitch, int desiredHeight, int pixelFormat, int flags, tjcli_decode_status* status);
+
+tjcli_incremental* tjcliInitIncremental();
+void tjcliDestroyIncremental(tjcli_incremental* inc);
+const char* tjcliGetErrorStr(tjcli_incremental* inc);
+int tjcliIncrementalStart(tjcli_incremental* inc, int desiredWidth, int desiredHeight, int pixelFormat, int flags, int outputPasses);
+int tjcliIncrementalFeed(tjcli_incremental* inc, const unsigned char* data, size_t size, int endOfData);
+int tjcliIncrementalDecode(tjcli_incremental* inc, unsigned char* dstBuf, int pitch);
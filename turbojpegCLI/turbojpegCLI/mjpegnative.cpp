@@ -0,0 +1,379 @@
+#include "mjpegnative.h"
+#pragma managed( push, off )
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+enum
+{
+	TJCLI_MJPEG_SEARCH_SOI = 0,
+	TJCLI_MJPEG_MARKER = 1,
+	TJCLI_MJPEG_ENTROPY = 2
+};
+
+static int tjcliLowestBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+/// <summary>
+/// Returns the index of the first 0xFF byte in data, or size if there is none.
+/// Every JPEG marker starts with 0xFF and the byte is rare in entropy coded data
+/// (it is always followed by a stuffed 0x00), so this scans 16 bytes per step.
+/// </summary>
+size_t tjcliFindMarkerPrefix(const unsigned char* data, size_t size)
+{
+	size_t i = 0;
+	const __m128i ff = _mm_set1_epi8((char)0xFF);
+	for (; i + 16 <= size; i += 16)
+	{
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + i)), ff));
+		if (mask != 0)
+			return i + tjcliLowestBit((unsigned int)mask);
+	}
+	for (; i < size; i++)
+		if (data[i] == 0xFF)
+			return i;
+	return size;
+}
+
+/// <summary>
+/// Creates a splitter.  Frames larger than maxFrameSize bytes are discarded as
+/// corrupt, which bounds memory use if the stream never produces an EOI marker.
+/// </summary>
+tjcli_mjpeg_parser* tjcliInitMjpegParser(size_t maxFrameSize)
+{
+	tjcli_mjpeg_parser* parser = (tjcli_mjpeg_parser*)calloc(1, sizeof(tjcli_mjpeg_parser));
+	if (parser == NULL)
+		return NULL;
+	parser->maxFrameSize = maxFrameSize;
+	parser->state = TJCLI_MJPEG_SEARCH_SOI;
+	return parser;
+}
+
+void tjcliDestroyMjpegParser(tjcli_mjpeg_parser* parser)
+{
+	if (parser == NULL)
+		return;
+	free(parser->buffer);
+	free(parser);
+}
+
+/// <summary>
+/// Discards any partial frame, so the next frame starts at the next SOI marker.
+/// </summary>
+void tjcliResetMjpegParser(tjcli_mjpeg_parser* parser)
+{
+	parser->size = 0;
+	parser->scanPos = 0;
+	parser->frameSize = 0;
+	parser->state = TJCLI_MJPEG_SEARCH_SOI;
+}
+
+/// <summary>
+/// Returns the message for the most recent failure on this handle.
+/// </summary>
+const char* tjcliGetErrorStr(tjcli_mjpeg_parser* parser)
+{
+	if (parser == NULL)
+		return "Invalid handle";
+	return parser->message;
+}
+
+static void tjcliDiscard(tjcli_mjpeg_parser* parser, size_t count)
+{
+	memmove(parser->buffer, parser->buffer + count, parser->size - count);
+	parser->size -= count;
+	parser->scanPos = parser->scanPos > count ? parser->scanPos - count : 0;
+}
+
+/// <summary>
+/// Appends bytes from the stream.  Call tjcliMjpegNextFrame() until it returns 0
+/// after each push.
+/// </summary>
+int tjcliMjpegPush(tjcli_mjpeg_parser* parser, const unsigned char* data, size_t size)
+{
+	if (parser->size + size > parser->capacity)
+	{
+		size_t capacity = parser->capacity < 65536 ? 65536 : parser->capacity;
+		while (capacity < parser->size + size)
+			capacity *= 2;
+		unsigned char* buffer = (unsigned char*)realloc(parser->buffer, capacity);
+		if (buffer == NULL)
+		{
+			strcpy(parser->message, "Out of memory");
+			return -1;
+		}
+		parser->buffer = buffer;
+		parser->capacity = capacity;
+	}
+	memcpy(parser->buffer + parser->size, data, size);
+	parser->size += size;
+	return 0;
+}
+
+/// <summary>
+/// Finds the next complete frame in the pushed bytes.  Returns 1 and sets *frame
+/// and *frameSize (the frame runs from SOI to EOI inclusive, and stays valid until
+/// the next call) or returns 0 if more bytes are needed.  The frame is delimited by
+/// walking the marker segments by their lengths and scanning entropy coded data for
+/// markers, so EOI markers inside embedded thumbnails do not end the frame early.
+/// </summary>
+int tjcliMjpegNextFrame(tjcli_mjpeg_parser* parser, const unsigned char** frame, size_t* frameSize)
+{
+	if (parser->frameSize > 0)
+	{
+		tjcliDiscard(parser, parser->frameSize);
+		parser->frameSize = 0;
+		parser->scanPos = 0;
+		parser->state = TJCLI_MJPEG_SEARCH_SOI;
+	}
+	unsigned char* buf = parser->buffer;
+	for (;;)
+	{
+		if (parser->state != TJCLI_MJPEG_SEARCH_SOI && parser->size > parser->maxFrameSize)
+		{
+			parser->corruptFrames++;
+			tjcliResetMjpegParser(parser);
+			return 0;
+		}
+		size_t pos = parser->scanPos;
+		if (parser->state == TJCLI_MJPEG_SEARCH_SOI)
+		{
+			size_t i = pos + tjcliFindMarkerPrefix(buf + pos, parser->size - pos);
+			if (i + 1 >= parser->size)
+			{
+				// Keep a trailing 0xFF; its D8 may arrive in the next push.
+				tjcliDiscard(parser, i < parser->size ? i : parser->size);
+				return 0;
+			}
+			if (buf[i + 1] == 0xD8)
+			{
+				tjcliDiscard(parser, i);
+				parser->scanPos = 2;
+				parser->state = TJCLI_MJPEG_MARKER;
+			}
+			else
+				parser->scanPos = i + 1;
+		}
+		else if (parser->state == TJCLI_MJPEG_MARKER)
+		{
+			if (pos >= parser->size)
+				return 0;
+			unsigned char code = pos + 1 < parser->size ? buf[pos + 1] : 0xFF;
+			if (buf[pos] != 0xFF || code == 0x00)
+			{
+				// Lost sync, most likely because the frame was truncated and a segment
+				// length skipped into the frames after it.  Search again for an SOI
+				// marker from just after the start of the bad frame.
+				parser->corruptFrames++;
+				parser->scanPos = 2;
+				parser->state = TJCLI_MJPEG_SEARCH_SOI;
+				continue;
+			}
+			if (pos + 1 >= parser->size)
+				return 0;
+			if (code == 0xFF)
+				parser->scanPos = pos + 1;
+			else if (code == 0xD9)
+			{
+				parser->frameSize = pos + 2;
+				*frame = buf;
+				*frameSize = parser->frameSize;
+				return 1;
+			}
+			else if (code == 0xD8)
+			{
+				// A new frame started before the last one ended.
+				parser->corruptFrames++;
+				tjcliDiscard(parser, pos);
+				parser->scanPos = 2;
+			}
+			else if ((code >= 0xD0 && code <= 0xD7) || code == 0x01)
+				parser->scanPos = pos + 2;
+			else
+			{
+				if (pos + 3 >= parser->size)
+					return 0;
+				size_t length = ((size_t)buf[pos + 2] << 8) | buf[pos + 3];
+				if (length < 2)
+				{
+					parser->corruptFrames++;
+					parser->scanPos = 2;
+					parser->state = TJCLI_MJPEG_SEARCH_SOI;
+					continue;
+				}
+				parser->scanPos = pos + 2 + length;
+				if (code == 0xDA)
+					parser->state = TJCLI_MJPEG_ENTROPY;
+			}
+		}
+		else
+		{
+			if (pos >= parser->size)
+				return 0;
+			size_t i = pos + tjcliFindMarkerPrefix(buf + pos, parser->size - pos);
+			if (i + 1 >= parser->size)
+			{
+				parser->scanPos = i;
+				return 0;
+			}
+			unsigned char code = buf[i + 1];
+			if (code == 0x00 || (code >= 0xD0 && code <= 0xD7))
+				parser->scanPos = i + 2;
+			else if (code == 0xFF)
+				parser->scanPos = i + 1;
+			else
+			{
+				parser->scanPos = i;
+				parser->state = TJCLI_MJPEG_MARKER;
+			}
+		}
+	}
+}
+
+static const unsigned long long TJCLI_PRIME1 = 11400714785074694791ULL;
+static const unsigned long long TJCLI_PRIME2 = 14029467366897019727ULL;
+static const unsigned long long TJCLI_PRIME3 = 1609587929392839161ULL;
+static const unsigned long long TJCLI_PRIME4 = 9650029242287828579ULL;
+static const unsigned long long TJCLI_PRIME5 = 2870177450012600261ULL;
+
+static unsigned long long tjcliRotl64(unsigned long long x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static unsigned long long tjcliRead64(const unsigned char* p)
+{
+	unsigned long long v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static unsigned long long tjcliHashRound(unsigned long long acc, unsigned long long input)
+{
+	return tjcliRotl64(acc + input * TJCLI_PRIME2, 31) * TJCLI_PRIME1;
+}
+
+static unsigned long long tjcliHashMerge(unsigned long long acc, unsigned long long v)
+{
+	return (acc ^ tjcliHashRound(0, v)) * TJCLI_PRIME1 + TJCLI_PRIME4;
+}
+
+/// <summary>
+/// An xxHash64-style hash: four independent multiply-rotate lanes consume 32 bytes
+/// per step, which runs at several GB/s, far faster than decoding the frame.
+/// </summary>
+static unsigned long long tjcliHashBytes(const unsigned char* p, size_t size, unsigned long long seed)
+{
+	const unsigned char* end = p + size;
+	unsigned long long h;
+	if (size >= 32)
+	{
+		unsigned long long v1 = seed + TJCLI_PRIME1 + TJCLI_PRIME2;
+		unsigned long long v2 = seed + TJCLI_PRIME2;
+		unsigned long long v3 = seed;
+		unsigned long long v4 = seed - TJCLI_PRIME1;
+		do
+		{
+			v1 = tjcliHashRound(v1, tjcliRead64(p));
+			v2 = tjcliHashRound(v2, tjcliRead64(p + 8));
+			v3 = tjcliHashRound(v3, tjcliRead64(p + 16));
+			v4 = tjcliHashRound(v4, tjcliRead64(p + 24));
+			p += 32;
+		} while (end - p >= 32);
+		h = tjcliRotl64(v1, 1) + tjcliRotl64(v2, 7) + tjcliRotl64(v3, 12) + tjcliRotl64(v4, 18);
+		h = tjcliHashMerge(h, v1);
+		h = tjcliHashMerge(h, v2);
+		h = tjcliHashMerge(h, v3);
+		h = tjcliHashMerge(h, v4);
+	}
+	else
+		h = seed + TJCLI_PRIME5;
+	h += (unsigned long long)size;
+	for (; end - p >= 8; p += 8)
+		h = tjcliRotl64(h ^ tjcliHashRound(0, tjcliRead64(p)), 27) * TJCLI_PRIME1 + TJCLI_PRIME4;
+	for (; p < end; p++)
+		h = tjcliRotl64(h ^ (*p * TJCLI_PRIME5), 11) * TJCLI_PRIME1;
+	h ^= h >> 33;
+	h *= TJCLI_PRIME2;
+	h ^= h >> 29;
+	h *= TJCLI_PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+unsigned long long tjcliHashJpeg(const unsigned char* data, size_t size)
+{
+	unsigned long long h = 0;
+	size_t pos = 2;
+	while (pos + 4 <= size && data[pos] == 0xFF)
+	{
+		unsigned char code = data[pos + 1];
+		if (code == 0xFF)
+		{
+			pos++;
+			continue;
+		}
+		if ((code >= 0xD0 && code <= 0xD7) || code == 0x01)
+		{
+			pos += 2;
+			continue;
+		}
+		if (code == 0xDA)
+			break;
+		size_t segmentSize = 2 + (((size_t)data[pos + 2] << 8) | data[pos + 3]);
+		if (pos + segmentSize > size)
+			break;
+		// As in tjcliHashJpegHeader(), the JFIF and Adobe markers decide the colorspace
+		// and are hashed; only the other APPn segments and comments are left out.
+		if (!((code >= 0xE1 && code <= 0xED) || code == 0xEF || code == 0xFE))
+			h = tjcliHashBytes(data + pos, segmentSize, h);
+		pos += segmentSize;
+	}
+	// The first scan and everything after it, or the unparsed remainder of a malformed frame.
+	if (pos < size)
+		h = tjcliHashBytes(data + pos, size - pos, h);
+	return h;
+}
+
+unsigned long long tjcliHashJpegHeader(const unsigned char* data, size_t size)
+{
+	unsigned long long h = 0;
+	size_t pos = 2;
+	while (pos + 4 <= size && data[pos] == 0xFF)
+	{
+		unsigned char code = data[pos + 1];
+		if (code == 0xFF)
+		{
+			pos++;
+			continue;
+		}
+		if ((code >= 0xD0 && code <= 0xD7) || code == 0x01)
+		{
+			pos += 2;
+			continue;
+		}
+		size_t segmentSize = 2 + (((size_t)data[pos + 2] << 8) | data[pos + 3]);
+		if (pos + segmentSize > size)
+			return 0;
+		// JFIF and Adobe markers decide the colorspace, so only the other APPn segments
+		// (such as EXIF) and comments are left out.
+		if (!((code >= 0xE1 && code <= 0xED) || code == 0xEF || code == 0xFE))
+			h = tjcliHashBytes(data + pos, segmentSize, h);
+		if (code == 0xDA)
+			return h;
+		pos += segmentSize;
+	}
+	return 0;
+}
+#pragma managed( pop )
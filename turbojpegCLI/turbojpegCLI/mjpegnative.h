@@ -0,0 +1,50 @@
+#pragma once
+#include <stddef.h>
+
+// Native Motion-JPEG stream splitter.  Bytes from a camera or file are pushed in
+// chunks of any size, and complete JPEG frames are taken out one at a time.  This
+// works for raw concatenated JPEG streams and for multipart (multipart/x-mixed-replace)
+// HTTP streams alike, because the part headers and boundaries between frames are
+// simply skipped while searching for the next SOI marker.
+
+/// <summary>
+/// Splitter state.  buffer holds the bytes of the frame being assembled, starting at
+/// its SOI marker, and scanPos is how far they have been parsed.
+/// </summary>
+struct tjcli_mjpeg_parser
+{
+	unsigned char* buffer;
+	size_t size;
+	size_t capacity;
+	size_t scanPos;
+	size_t frameSize;
+	size_t maxFrameSize;
+	int state;
+	unsigned long long corruptFrames;
+	char message[200];
+};
+
+tjcli_mjpeg_parser* tjcliInitMjpegParser(size_t maxFrameSize);
+void tjcliDestroyMjpegParser(tjcli_mjpeg_parser* parser);
+void tjcliResetMjpegParser(tjcli_mjpeg_parser* parser);
+const char* tjcliGetErrorStr(tjcli_mjpeg_parser* parser);
+int tjcliMjpegPush(tjcli_mjpeg_parser* parser, const unsigned char* data, size_t size);
+int tjcliMjpegNextFrame(tjcli_mjpeg_parser* parser, const unsigned char** frame, size_t* frameSize);
+size_t tjcliFindMarkerPrefix(const unsigned char* data, size_t size);
+
+/// <summary>
+/// Returns a 64-bit hash of the image content of a JPEG frame: its tables, frame and
+/// scan headers and entropy coded data.  APPn segments other than JFIF (APP0) and
+/// Adobe (APP14), which decide the colorspace, and COM segments are skipped, so frames
+/// that differ only in metadata such as an EXIF timestamp hash the same.
+/// </summary>
+unsigned long long tjcliHashJpeg(const unsigned char* data, size_t size);
+
+/// <summary>
+/// Returns a 64-bit hash of the headers of a JPEG frame: every segment up to and
+/// including the first scan header, leaving out the APPn segments other than JFIF
+/// (APP0) and Adobe (APP14), and comments.  Frames with the same hash have the same
+/// dimensions, subsampling, colorspace and tables.  Returns 0 if no scan header is
+/// found.
+/// </summary>
+unsigned long long tjcliHashJpegHeader(const unsigned char* data, size_t size);
@@ -0,0 +1,459 @@
+// windows.h comes first so that jmorecfg.h sees basetsd.h's INT32.
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "schedulernative.h"
+#pragma managed( push, off )
+#include <stdlib.h>
+#include <string.h>
+
+#define TJCLI_MAX_NUMA_NODES 64
+
+/// <summary>
+/// A worker's jobs, as a doubly linked list.  The owner takes jobs from the tail (newest
+/// first) and thieves from the head (oldest first).  count may be read without the lock
+/// as a hint.
+/// </summary>
+struct tjcli_deque
+{
+	SRWLOCK lock;
+	tjcli_job* head;
+	tjcli_job* tail;
+	volatile long count;
+};
+
+struct tjcli_worker
+{
+	tjcli_scheduler* sched;
+	int index;
+	int node;
+	HANDLE thread;
+	tjcli_deque deque;
+	int* victims;
+	tjcli_decoder* dec;
+	tjcli_encoder* enc;
+	tjcli_tensor_ctx* tensor;
+	unsigned long long jobsRun;
+	unsigned long long jobsStolen;
+	unsigned long long jobsStolenRemote;
+};
+
+/// <summary>
+/// queued counts the jobs in all deques.  It is changed with interlocked operations, and
+/// idle workers sleep on workAvailable until it is nonzero.  Threads waiting for a group
+/// sleep on jobsDone.
+/// </summary>
+struct tjcli_scheduler
+{
+	tjcli_worker* workers;
+	int workerCount;
+	int nodeCount;
+	SRWLOCK lock;
+	CONDITION_VARIABLE workAvailable;
+	CONDITION_VARIABLE jobsDone;
+	volatile long queued;
+	volatile long nextWorker;
+	int stopping;
+};
+
+static void tjcliPushJob(tjcli_deque* deque, tjcli_job* job)
+{
+	AcquireSRWLockExclusive(&deque->lock);
+	job->next = NULL;
+	job->prev = deque->tail;
+	if (deque->tail != NULL)
+		deque->tail->next = job;
+	else
+		deque->head = job;
+	deque->tail = job;
+	deque->count++;
+	ReleaseSRWLockExclusive(&deque->lock);
+}
+
+static tjcli_job* tjcliTakeJob(tjcli_deque* deque, int fromTail)
+{
+	if (deque->count == 0)
+		return NULL;
+	AcquireSRWLockExclusive(&deque->lock);
+	tjcli_job* job = fromTail ? deque->tail : deque->head;
+	if (job != NULL)
+	{
+		if (job->prev != NULL)
+			job->prev->next = job->next;
+		else
+			deque->head = job->next;
+		if (job->next != NULL)
+			job->next->prev = job->prev;
+		else
+			deque->tail = job->prev;
+		job->prev = job->next = NULL;
+		deque->count--;
+	}
+	ReleaseSRWLockExclusive(&deque->lock);
+	return job;
+}
+
+static tjcli_job* tjcliFindJob(tjcli_worker* worker)
+{
+	tjcli_scheduler* sched = worker->sched;
+	tjcli_job* job = tjcliTakeJob(&worker->deque, 1);
+	if (job == NULL)
+	{
+		// Steal, trying the workers on this node first (the victims are in that order).
+		for (int i = 0; i < sched->workerCount - 1 && job == NULL; i++)
+		{
+			tjcli_worker* victim = &sched->workers[worker->victims[i]];
+			job = tjcliTakeJob(&victim->deque, 0);
+			if (job != NULL)
+			{
+				worker->jobsStolen++;
+				if (victim->node != worker->node)
+					worker->jobsStolenRemote++;
+			}
+		}
+	}
+	if (job != NULL)
+		InterlockedDecrement(&sched->queued);
+	return job;
+}
+
+static tjcli_job* tjcliGroupJob(tjcli_job_group* group, long index)
+{
+	return (tjcli_job*)((char*)group->first + group->stride * index);
+}
+
+static void tjcliRunJob(tjcli_worker* worker, tjcli_job* job)
+{
+	tjcli_scheduler* sched = worker->sched;
+	tjcli_job_group* group = job->group;
+	job->func(worker, job);
+	worker->jobsRun++;
+	// Queue the group's next job here, where this worker will most likely run it itself.
+	long next = InterlockedIncrement(&group->next) - 1;
+	if (next < group->count)
+	{
+		InterlockedIncrement(&sched->queued);
+		tjcliPushJob(&worker->deque, tjcliGroupJob(group, next));
+	}
+	// The group belongs to the waiting thread, which may return as soon as pending is 0.
+	if (InterlockedDecrement(&group->pending) == 0)
+	{
+		AcquireSRWLockExclusive(&sched->lock);
+		WakeAllConditionVariable(&sched->jobsDone);
+		ReleaseSRWLockExclusive(&sched->lock);
+	}
+}
+
+static DWORD WINAPI tjcliWorkerMain(LPVOID param)
+{
+	tjcli_worker* worker = (tjcli_worker*)param;
+	tjcli_scheduler* sched = worker->sched;
+	for (;;)
+	{
+		tjcli_job* job = tjcliFindJob(worker);
+		if (job != NULL)
+		{
+			tjcliRunJob(worker, job);
+			continue;
+		}
+		AcquireSRWLockExclusive(&sched->lock);
+		while (sched->queued == 0 && !sched->stopping)
+			SleepConditionVariableSRW(&sched->workAvailable, &sched->lock, INFINITE, 0);
+		int stopping = sched->stopping;
+		ReleaseSRWLockExclusive(&sched->lock);
+		if (stopping)
+			return 0;
+	}
+}
+
+static int tjcliCountBits(KAFFINITY mask)
+{
+	int count = 0;
+	for (; mask != 0; mask &= mask - 1)
+		count++;
+	return count;
+}
+
+/// <summary>
+/// Fills nodes with the processors of each NUMA node that has any, and returns the number
+/// of nodes, or 0 if the topology is not available.
+/// </summary>
+static int tjcliGetNumaNodes(GROUP_AFFINITY* nodes, int maxNodes)
+{
+	ULONG highest = 0;
+	if (!GetNumaHighestNodeNumber(&highest))
+		return 0;
+	int count = 0;
+	for (ULONG node = 0; node <= highest && count < maxNodes; node++)
+	{
+		GROUP_AFFINITY mask;
+		if (GetNumaNodeProcessorMaskEx((USHORT)node, &mask) && mask.Mask != 0)
+			nodes[count++] = mask;
+	}
+	return count;
+}
+
+static void tjcliStopWorkers(tjcli_scheduler* sched, int started)
+{
+	AcquireSRWLockExclusive(&sched->lock);
+	sched->stopping = 1;
+	WakeAllConditionVariable(&sched->workAvailable);
+	ReleaseSRWLockExclusive(&sched->lock);
+	for (int i = 0; i < started; i++)
+	{
+		WaitForSingleObject(sched->workers[i].thread, INFINITE);
+		CloseHandle(sched->workers[i].thread);
+	}
+}
+
+/// <summary>
+/// Starts a scheduler with the given number of worker threads, or one per processor if
+/// workerCount is 0 or less.  Returns NULL if the threads could not be started.
+/// </summary>
+tjcli_scheduler* tjcliInitScheduler(int workerCount)
+{
+	GROUP_AFFINITY nodes[TJCLI_MAX_NUMA_NODES];
+	int processors[TJCLI_MAX_NUMA_NODES + 1];
+	int nodeCount = tjcliGetNumaNodes(nodes, TJCLI_MAX_NUMA_NODES);
+	// processors[n] is the number of processors on the nodes before node n.
+	processors[0] = 0;
+	for (int n = 0; n < nodeCount; n++)
+		processors[n + 1] = processors[n] + tjcliCountBits(nodes[n].Mask);
+	int totalProcessors = nodeCount > 0 ? processors[nodeCount] : (int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+	if (workerCount <= 0)
+		workerCount = totalProcessors > 0 ? totalProcessors : 1;
+
+	tjcli_scheduler* sched = (tjcli_scheduler*)calloc(1, sizeof(tjcli_scheduler));
+	if (sched == NULL)
+		return NULL;
+	sched->workers = (tjcli_worker*)calloc(workerCount, sizeof(tjcli_worker));
+	int* victims = (int*)calloc((size_t)workerCount * workerCount, sizeof(int));
+	if (sched->workers == NULL || victims == NULL)
+	{
+		free(victims);
+		free(sched->workers);
+		free(sched);
+		return NULL;
+	}
+	sched->workerCount = workerCount;
+	sched->nodeCount = nodeCount > 0 ? nodeCount : 1;
+	InitializeSRWLock(&sched->lock);
+	InitializeConditionVariable(&sched->workAvailable);
+	InitializeConditionVariable(&sched->jobsDone);
+
+	// Spread the workers over the nodes in proportion to their processors, in blocks so
+	// that neighbouring workers share a node.
+	for (int i = 0; i < workerCount; i++)
+	{
+		tjcli_worker* worker = &sched->workers[i];
+		worker->sched = sched;
+		worker->index = i;
+		worker->victims = victims + (size_t)i * workerCount;
+		InitializeSRWLock(&worker->deque.lock);
+		if (nodeCount > 1)
+		{
+			long long position = (long long)i * totalProcessors / workerCount;
+			while (processors[worker->node + 1] <= position)
+				worker->node++;
+		}
+	}
+	for (int i = 0; i < workerCount; i++)
+	{
+		tjcli_worker* worker = &sched->workers[i];
+		int v = 0;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (int j = 1; j < workerCount; j++)
+			{
+				int other = (i + j) % workerCount;
+				if ((sched->workers[other].node == worker->node) == (pass == 0))
+					worker->victims[v++] = other;
+			}
+		}
+	}
+
+	for (int i = 0; i < workerCount; i++)
+	{
+		tjcli_worker* worker = &sched->workers[i];
+		worker->thread = CreateThread(NULL, 0, tjcliWorkerMain, worker, CREATE_SUSPENDED, NULL);
+		if (worker->thread == NULL)
+		{
+			tjcliStopWorkers(sched, i);
+			free(victims);
+			free(sched->workers);
+			free(sched);
+			return NULL;
+		}
+		// Binding is best effort: without it the worker still runs, just anywhere.
+		if (nodeCount > 1)
+			SetThreadGroupAffinity(worker->thread, &nodes[worker->node], NULL);
+		ResumeThread(worker->thread);
+	}
+	return sched;
+}
+
+/// <summary>
+/// Stops the worker threads and frees the scheduler and the workers' handles.  No group
+/// may be running.
+/// </summary>
+void tjcliDestroyScheduler(tjcli_scheduler* sched)
+{
+	if (sched == NULL)
+		return;
+	tjcliStopWorkers(sched, sched->workerCount);
+	for (int i = 0; i < sched->workerCount; i++)
+	{
+		tjcliDestroyDecoder(sched->workers[i].dec);
+		tjcliDestroyEncoder(sched->workers[i].enc);
+		tjcliDestroyTensorContext(sched->workers[i].tensor);
+	}
+	free(sched->workers[0].victims);
+	free(sched->workers);
+	free(sched);
+}
+
+int tjcliGetSchedulerStats(tjcli_scheduler* sched, tjcli_scheduler_stats* stats)
+{
+	if (sched == NULL || stats == NULL)
+		return -1;
+	memset(stats, 0, sizeof(tjcli_scheduler_stats));
+	stats->workerCount = sched->workerCount;
+	stats->numaNodeCount = sched->nodeCount;
+	// The counters are written by their workers without locking, so this is a snapshot.
+	for (int i = 0; i < sched->workerCount; i++)
+	{
+		stats->jobsRun += sched->workers[i].jobsRun;
+		stats->jobsStolen += sched->workers[i].jobsStolen;
+		stats->jobsStolenRemote += sched->workers[i].jobsStolenRemote;
+	}
+	return 0;
+}
+
+/// <summary>
+/// Runs count jobs, stored stride bytes apart starting at first, and waits until all of
+/// them have finished.  Up to maxConcurrent jobs are dealt to the workers' deques in
+/// turn; each worker that finishes one queues the group's next job on its own deque.
+/// Any number of threads may run groups on the same scheduler at once.
+/// </summary>
+int tjcliRunJobs(tjcli_scheduler* sched, tjcli_job_group* group, tjcli_job* first, size_t stride, long count, long maxConcurrent)
+{
+	if (sched == NULL || group == NULL || first == NULL || stride < sizeof(tjcli_job) || count < 0 || maxConcurrent < 1)
+		return -1;
+	if (count == 0)
+		return 0;
+	long initial = count < maxConcurrent ? count : maxConcurrent;
+	group->first = first;
+	group->stride = stride;
+	group->count = count;
+	group->next = initial;
+	group->pending = count;
+	for (long i = 0; i < count; i++)
+		tjcliGroupJob(group, i)->group = group;
+
+	InterlockedExchangeAdd(&sched->queued, initial);
+	unsigned long start = (unsigned long)InterlockedExchangeAdd(&sched->nextWorker, initial);
+	for (long i = 0; i < initial; i++)
+		tjcliPushJob(&sched->workers[(start + i) % sched->workerCount].deque, tjcliGroupJob(group, i));
+
+	AcquireSRWLockExclusive(&sched->lock);
+	WakeAllConditionVariable(&sched->workAvailable);
+	while (group->pending > 0)
+		SleepConditionVariableSRW(&sched->jobsDone, &sched->lock, INFINITE, 0);
+	ReleaseSRWLockExclusive(&sched->lock);
+	return 0;
+}
+
+/// <summary>
+/// Returns the worker's decompressor, creating it on first use, or NULL if it could not
+/// be created.
+/// </summary>
+tjcli_decoder* tjcliWorkerDecoder(tjcli_worker* worker)
+{
+	if (worker->dec == NULL)
+		worker->dec = tjcliInitDecoder();
+	return worker->dec;
+}
+
+/// <summary>
+/// Returns the worker's compressor, creating it on first use, or NULL if it could not
+/// be created.
+/// </summary>
+tjcli_encoder* tjcliWorkerEncoder(tjcli_worker* worker)
+{
+	if (worker->enc == NULL)
+		worker->enc = tjcliInitEncoder();
+	return worker->enc;
+}
+
+/// <summary>
+/// Returns the worker's tensor decoding context, creating it on first use, or NULL if it
+/// could not be created.
+/// </summary>
+tjcli_tensor_ctx* tjcliWorkerTensorContext(tjcli_worker* worker)
+{
+	if (worker->tensor == NULL)
+		worker->tensor = tjcliInitTensorContext();
+	return worker->tensor;
+}
+
+static void tjcliSetJobMessage(char* message, const char* text)
+{
+	strncpy(message, text, JMSG_LENGTH_MAX - 1);
+	message[JMSG_LENGTH_MAX - 1] = 0;
+}
+
+void tjcliRunDecompressJob(tjcli_worker* worker, tjcli_job* job)
+{
+	tjcli_decompress_job* d = (tjcli_decompress_job*)job;
+	tjcli_decoder* dec = tjcliWorkerDecoder(worker);
+	d->status = -1;
+	if (dec == NULL)
+	{
+		tjcliSetJobMessage(d->message, "Unable to create a libjpeg decompressor");
+		return;
+	}
+	int jpegWidth, jpegHeight;
+	if (tjcliDecompressHeader(dec, d->jpegBuf, d->jpegSize, &jpegWidth, &jpegHeight) == -1)
+	{
+		tjcliSetJobMessage(d->message, tjcliGetErrorStr(dec));
+		return;
+	}
+	if (tjcliGetScaledSize(jpegWidth, jpegHeight, d->desiredWidth, d->desiredHeight, &d->width, &d->height) == -1)
+	{
+		tjcliSetJobMessage(d->message, "Could not scale down to desired image dimensions");
+		return;
+	}
+	d->pitch = d->width * tjcliPixelSize[d->pixelFormat];
+	unsigned long long bytes = (unsigned long long)d->pitch * d->height + tjcliEstimateDecodeMemory(dec, jpegWidth, jpegHeight, d->width, d->height);
+	if (d->admission->admit(d->index, d->width, d->height, bytes, &d->dstBuf) == -1)
+	{
+		tjcliSetJobMessage(d->message, "The image was not admitted by the memory budget");
+		return;
+	}
+	d->status = tjcliDecompressPixels(dec, d->jpegBuf, d->jpegSize, d->dstBuf, d->width, d->pitch, d->height, d->pixelFormat, d->flags);
+	if (d->status == -1)
+		tjcliSetJobMessage(d->message, tjcliGetErrorStr(dec));
+	d->admission->release(d->index);
+}
+
+void tjcliRunTensorJob(tjcli_worker* worker, tjcli_job* job)
+{
+	tjcli_tensor_job* t = (tjcli_tensor_job*)job;
+	tjcli_tensor_ctx* ctx = tjcliWorkerTensorContext(worker);
+	t->status = -1;
+	if (t->jpegBuf == NULL || t->jpegSize == 0)
+		tjcliSetJobMessage(t->message, "No JPEG image data");
+	else if (ctx == NULL)
+		tjcliSetJobMessage(t->message, "Unable to create a libjpeg decompressor");
+	else if (t->admission->admit(t->index, 0, 0, tjcliEstimateTensorMemory(ctx, t->jpegBuf, t->jpegSize, t->params), NULL) == -1)
+		tjcliSetJobMessage(t->message, "The image was not admitted by the memory budget");
+	else
+	{
+		t->status = tjcliDecodeToTensor(ctx, t->jpegBuf, t->jpegSize, t->params, t->dst, t->isFloat, &t->info);
+		if (t->status == -1)
+			tjcliSetJobMessage(t->message, tjcliGetErrorStr(ctx));
+		t->admission->release(t->index);
+	}
+	if (t->status == -1)
+		tjcliFillTensor(t->params, t->dst, t->isFloat);
+}
+#pragma managed( pop )
@@ -0,0 +1,128 @@
+#pragma once
+#include "tensornative.h"
+
+// Native work-stealing job scheduler shared by the wrapper's batch APIs.  Each worker
+// thread owns a deque of jobs and its own lazily created libjpeg handles.  A worker runs
+// the newest job of its own deque first and, once that is empty, steals the oldest job
+// of another worker's deque, looking at workers on its own NUMA node before the others.
+// Workers are spread over the NUMA nodes in proportion to their processors and bound to
+// their node, and they create their handles themselves so the memory is local to it.
+
+struct tjcli_scheduler;
+struct tjcli_worker;
+struct tjcli_job;
+
+typedef void (*tjcli_job_func)(struct tjcli_worker* worker, struct tjcli_job* job);
+
+/// <summary>
+/// A unit of work.  Job types put this first and add their own fields after it, and the
+/// function casts the job back to its type.  Jobs must not fail by unwinding; they record
+/// the outcome in their own fields.  prev and next link the job into a worker's deque,
+/// so queueing a job never allocates.
+/// </summary>
+struct tjcli_job
+{
+	tjcli_job_func func;
+	struct tjcli_job_group* group;
+	struct tjcli_job* prev;
+	struct tjcli_job* next;
+};
+
+/// <summary>
+/// A set of jobs of the same type, stored contiguously stride bytes apart, which are
+/// submitted and waited for together.  At most maxConcurrent of them are queued or
+/// running at once: the rest are queued by the workers as earlier ones finish.
+/// </summary>
+struct tjcli_job_group
+{
+	struct tjcli_job* first;
+	size_t stride;
+	long count;
+	volatile long next;
+	volatile long pending;
+};
+
+/// <summary>
+/// Counters covering the life of a scheduler.
+/// </summary>
+struct tjcli_scheduler_stats
+{
+	int workerCount;
+	int numaNodeCount;
+	unsigned long long jobsRun;
+	unsigned long long jobsStolen;
+	unsigned long long jobsStolenRemote;
+};
+
+tjcli_scheduler* tjcliInitScheduler(int workerCount);
+void tjcliDestroyScheduler(tjcli_scheduler* sched);
+int tjcliGetSchedulerStats(tjcli_scheduler* sched, tjcli_scheduler_stats* stats);
+int tjcliRunJobs(tjcli_scheduler* sched, tjcli_job_group* group, tjcli_job* first, size_t stride, long count, long maxConcurrent);
+
+/// <summary>
+/// Called by a job on its worker thread once it has read the image's header, before
+/// anything is allocated for the image.  bytes is the job's estimated memory.  If dstBuf
+/// is not NULL, the callee also supplies a width x height output buffer through it.
+/// Returns 0 to run the job, or -1 to fail it.  Once a job has been admitted, release is
+/// called with its index when it no longer needs the memory.
+/// </summary>
+typedef int (*tjcli_admit_func)(int index, int width, int height, unsigned long long bytes, unsigned char** dstBuf);
+typedef void (*tjcli_release_func)(int index);
+
+struct tjcli_job_admission
+{
+	tjcli_admit_func admit;
+	tjcli_release_func release;
+};
+
+tjcli_decoder* tjcliWorkerDecoder(tjcli_worker* worker);
+tjcli_encoder* tjcliWorkerEncoder(tjcli_worker* worker);
+tjcli_tensor_ctx* tjcliWorkerTensorContext(tjcli_worker* worker);
+
+/// <summary>
+/// Decompresses one JPEG image with the worker's decoder, at the largest scale which fits
+/// in desiredWidth x desiredHeight, into a buffer supplied by admission once the header
+/// has been read.  width, pitch and height are set to the scaled size.  status is 0 on
+/// success or -1, in which case message holds the reason.
+/// </summary>
+struct tjcli_decompress_job
+{
+	struct tjcli_job pub;
+	const unsigned char* jpegBuf;
+	unsigned long jpegSize;
+	int desiredWidth;
+	int desiredHeight;
+	int pixelFormat;
+	int flags;
+	int index;
+	const tjcli_job_admission* admission;
+	unsigned char* dstBuf;
+	int width;
+	int pitch;
+	int height;
+	int status;
+	char message[JMSG_LENGTH_MAX];
+};
+
+/// <summary>
+/// Decodes one JPEG image into one slot of a tensor with the worker's tensor context,
+/// once admission has admitted its estimated memory.  status is 0 on success or -1, in
+/// which case the slot was filled with the padding value and message holds the reason.
+/// </summary>
+struct tjcli_tensor_job
+{
+	struct tjcli_job pub;
+	const unsigned char* jpegBuf;
+	unsigned long jpegSize;
+	const tjcli_tensor_params* params;
+	void* dst;
+	int isFloat;
+	int index;
+	const tjcli_job_admission* admission;
+	tjcli_tensor_info info;
+	int status;
+	char message[JMSG_LENGTH_MAX];
+};
+
+void tjcliRunDecompressJob(tjcli_worker* worker, tjcli_job* job);
+void tjcliRunTensorJob(tjcli_worker* worker, tjcli_job* job);
@@ -0,0 +1,348 @@
+#include "tensornative.h"
+#pragma managed( push, off )
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+
+/// <summary>
+/// Creates a tensor decoding context, or returns NULL if libjpeg could not be initialized.
+/// </summary>
+tjcli_tensor_ctx* tjcliInitTensorContext()
+{
+	tjcli_tensor_ctx* ctx = (tjcli_tensor_ctx*)calloc(1, sizeof(tjcli_tensor_ctx));
+	if (ctx == NULL)
+		return NULL;
+	ctx->dec = tjcliInitDecoder();
+	if (ctx->dec == NULL)
+	{
+		free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+void tjcliDestroyTensorContext(tjcli_tensor_ctx* ctx)
+{
+	if (ctx == NULL)
+		return;
+	tjcliDestroyDecoder(ctx->dec);
+	free(ctx->pixels);
+	free(ctx->row);
+	free(ctx->xIndex);
+	free(ctx->xWeight);
+	free(ctx);
+}
+
+/// <summary>
+/// Returns the message for the most recent failure on this context.
+/// </summary>
+const char* tjcliGetErrorStr(tjcli_tensor_ctx* ctx)
+{
+	if (ctx == NULL)
+		return "Invalid handle";
+	return tjcliGetErrorStr(ctx->dec);
+}
+
+static int tjcliGrow(tjcli_tensor_ctx* ctx, void** buffer, size_t* size, size_t needed)
+{
+	if (*size >= needed)
+		return 0;
+	void* newBuffer = realloc(*buffer, needed);
+	if (newBuffer == NULL)
+	{
+		strcpy(ctx->dec->jerr.message, "Out of memory");
+		return -1;
+	}
+	*buffer = newBuffer;
+	*size = needed;
+	return 0;
+}
+
+/// <summary>
+/// out[i] = a[i] + (b[i] - a[i]) * weight, widening bytes to floats.  This is the
+/// vertical half of the bilinear resize (and a plain conversion when weight is 0).
+/// </summary>
+static void tjcliLerpRows(const unsigned char* a, const unsigned char* b, float weight, float* out, int count)
+{
+	int i = 0;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 w = _mm_set1_ps(weight);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+		__m128i a16[2] = { _mm_unpacklo_epi8(va, zero), _mm_unpackhi_epi8(va, zero) };
+		__m128i b16[2] = { _mm_unpacklo_epi8(vb, zero), _mm_unpackhi_epi8(vb, zero) };
+		for (int half = 0; half < 2; half++)
+		{
+			__m128 fa = _mm_cvtepi32_ps(_mm_unpacklo_epi16(a16[half], zero));
+			__m128 fb = _mm_cvtepi32_ps(_mm_unpacklo_epi16(b16[half], zero));
+			_mm_storeu_ps(out + i + half * 8, _mm_add_ps(fa, _mm_mul_ps(_mm_sub_ps(fb, fa), w)));
+			fa = _mm_cvtepi32_ps(_mm_unpackhi_epi16(a16[half], zero));
+			fb = _mm_cvtepi32_ps(_mm_unpackhi_epi16(b16[half], zero));
+			_mm_storeu_ps(out + i + half * 8 + 4, _mm_add_ps(fa, _mm_mul_ps(_mm_sub_ps(fb, fa), w)));
+		}
+	}
+	for (; i < count; i++)
+		out[i] = a[i] + (b[i] - a[i]) * weight;
+}
+
+/// <summary>
+/// out[i] = in[i] * scale[i % channels] + bias[i % channels] for interleaved rows.
+/// scale12 and bias12 hold the per-channel values repeated to 12 entries, the
+/// smallest length that is a whole number of both pixels and SSE registers.
+/// </summary>
+static void tjcliNormalizeRow(const float* in, float* out, int count, const float* scale12, const float* bias12)
+{
+	int i = 0;
+	__m128 s0 = _mm_loadu_ps(scale12), s1 = _mm_loadu_ps(scale12 + 4), s2 = _mm_loadu_ps(scale12 + 8);
+	__m128 b0 = _mm_loadu_ps(bias12), b1 = _mm_loadu_ps(bias12 + 4), b2 = _mm_loadu_ps(bias12 + 8);
+	for (; i + 12 <= count; i += 12)
+	{
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i), s0), b0));
+		_mm_storeu_ps(out + i + 4, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), s1), b1));
+		_mm_storeu_ps(out + i + 8, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 8), s2), b2));
+	}
+	for (; i < count; i++)
+		out[i] = in[i] * scale12[i % 12] + bias12[i % 12];
+}
+
+/// <summary>
+/// Rounds and clamps floats to bytes.
+/// </summary>
+static void tjcliPackRow(const float* in, unsigned char* out, int count)
+{
+	int i = 0;
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (; i + 16 <= count; i += 16)
+	{
+		// cvttps truncates, so add 0.5 first; packs saturate to 0..255.
+		__m128i v0 = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(in + i), half));
+		__m128i v1 = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(in + i + 4), half));
+		__m128i v2 = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(in + i + 8), half));
+		__m128i v3 = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(in + i + 12), half));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3)));
+	}
+	for (; i < count; i++)
+	{
+		float v = in[i] + 0.5f;
+		out[i] = v <= 0 ? 0 : v >= 255 ? 255 : (unsigned char)v;
+	}
+}
+
+/// <summary>
+/// Fills a whole tensor slot with the padding value.  Used for letterbox borders
+/// and for images that fail to decode.
+/// </summary>
+void tjcliFillTensor(const tjcli_tensor_params* params, void* dst, int isFloat)
+{
+	size_t plane = (size_t)params->width * params->height;
+	if (!isFloat)
+	{
+		memset(dst, params->padValue, plane * params->channels);
+		return;
+	}
+	float* out = (float*)dst;
+	for (int c = 0; c < params->channels; c++)
+	{
+		float value = params->padValue * params->scale[c] + params->bias[c];
+		if (params->nhwc)
+			for (size_t i = 0; i < plane; i++)
+				out[i * params->channels + c] = value;
+		else
+			for (size_t i = 0; i < plane; i++)
+				out[c * plane + i] = value;
+	}
+}
+
+/// <summary>
+/// Works out the size of the image within its slot, and the size to decode it at.
+/// </summary>
+static void tjcliTensorLayout(int srcWidth, int srcHeight, const tjcli_tensor_params* params, int* contentWidth, int* contentHeight, int* decodedWidth, int* decodedHeight)
+{
+	int dstWidth = params->width, dstHeight = params->height;
+	*contentWidth = dstWidth;
+	*contentHeight = dstHeight;
+	if (params->letterbox)
+	{
+		double scale = (double)dstWidth / srcWidth < (double)dstHeight / srcHeight ? (double)dstWidth / srcWidth : (double)dstHeight / srcHeight;
+		int w = (int)(srcWidth * scale + 0.5);
+		int h = (int)(srcHeight * scale + 0.5);
+		*contentWidth = w < 1 ? 1 : w > dstWidth ? dstWidth : w;
+		*contentHeight = h < 1 ? 1 : h > dstHeight ? dstHeight : h;
+	}
+
+	// Pick the smallest IDCT scale (up to 1/1) that is no smaller than the content.
+	*decodedWidth = srcWidth;
+	*decodedHeight = srcHeight;
+	for (int num = 1; num <= DCTSIZE; num++)
+	{
+		int w = (srcWidth * num + DCTSIZE - 1) / DCTSIZE;
+		int h = (srcHeight * num + DCTSIZE - 1) / DCTSIZE;
+		if (w >= *contentWidth && h >= *contentHeight)
+		{
+			*decodedWidth = w;
+			*decodedHeight = h;
+			break;
+		}
+	}
+}
+
+/// <summary>
+/// Estimates the memory tjcliDecodeToTensor() needs for an image: the decoded image it
+/// resizes from, and libjpeg's working memory.  Returns 0 if the header can not be read,
+/// in which case tjcliDecodeToTensor() fails on the image as well.
+/// </summary>
+unsigned long long tjcliEstimateTensorMemory(tjcli_tensor_ctx* ctx, const unsigned char* jpegBuf, unsigned long jpegSize, const tjcli_tensor_params* params)
+{
+	int srcWidth, srcHeight;
+	if (tjcliDecompressHeader(ctx->dec, jpegBuf, jpegSize, &srcWidth, &srcHeight) == -1)
+		return 0;
+	int contentWidth, contentHeight, decodedWidth, decodedHeight;
+	tjcliTensorLayout(srcWidth, srcHeight, params, &contentWidth, &contentHeight, &decodedWidth, &decodedHeight);
+	return (unsigned long long)decodedWidth * params->channels * decodedHeight
+		+ tjcliEstimateDecodeMemory(ctx->dec, srcWidth, srcHeight, decodedWidth, decodedHeight);
+}
+
+/// <summary>
+/// Decodes a JPEG image into one slot of a tensor (params->width x params->height
+/// x params->channels values of float or byte, in NCHW or NHWC order).  The IDCT
+/// first scales the image down to the smallest size that is still at least as
+/// large as the target, then a bilinear resize produces the exact target size,
+/// fused with normalization and the layout conversion, so each output value of the
+/// image is computed and written in a single pass.  When letterboxing, the slot is
+/// first filled with the padding value and the image area is then written over it.
+/// </summary>
+int tjcliDecodeToTensor(tjcli_tensor_ctx* ctx, const unsigned char* jpegBuf, unsigned long jpegSize, const tjcli_tensor_params* params, void* dst, int isFloat, tjcli_tensor_info* info)
+{
+	int srcWidth, srcHeight;
+	if (tjcliDecompressHeader(ctx->dec, jpegBuf, jpegSize, &srcWidth, &srcHeight) == -1)
+		return -1;
+	int channels = params->channels;
+	int dstWidth = params->width, dstHeight = params->height;
+	int contentWidth, contentHeight, decodedWidth, decodedHeight;
+	tjcliTensorLayout(srcWidth, srcHeight, params, &contentWidth, &contentHeight, &decodedWidth, &decodedHeight);
+	int contentX = (dstWidth - contentWidth) / 2, contentY = (dstHeight - contentHeight) / 2;
+	size_t decodedPitch = (size_t)decodedWidth * channels;
+	if (tjcliGrow(ctx, (void**)&ctx->pixels, &ctx->pixelsSize, decodedPitch * decodedHeight) == -1
+		|| tjcliGrow(ctx, (void**)&ctx->row, &ctx->rowSize, sizeof(float) * (decodedPitch > (size_t)contentWidth * channels ? decodedPitch : (size_t)contentWidth * channels) * 2) == -1
+		|| tjcliGrow(ctx, (void**)&ctx->xIndex, &ctx->xIndexSize, sizeof(int) * contentWidth) == -1
+		|| tjcliGrow(ctx, (void**)&ctx->xWeight, &ctx->xWeightSize, sizeof(float) * contentWidth) == -1)
+		return -1;
+	if (tjcliDecompressPixels(ctx->dec, jpegBuf, jpegSize, ctx->pixels, decodedWidth, 0, decodedHeight, params->pixelFormat, params->flags) == -1)
+		return -1;
+
+	if (info != NULL)
+	{
+		info->srcWidth = srcWidth;
+		info->srcHeight = srcHeight;
+		info->contentX = contentX;
+		info->contentY = contentY;
+		info->contentWidth = contentWidth;
+		info->contentHeight = contentHeight;
+	}
+	if (contentWidth != dstWidth || contentHeight != dstHeight)
+		tjcliFillTensor(params, dst, isFloat);
+
+	// Horizontal sampling positions, using pixel centers.
+	int resizeX = decodedWidth != contentWidth;
+	if (resizeX)
+	{
+		float ratio = (float)decodedWidth / contentWidth;
+		for (int x = 0; x < contentWidth; x++)
+		{
+			float sx = (x + 0.5f) * ratio - 0.5f;
+			if (sx < 0)
+				sx = 0;
+			int ix = (int)sx;
+			if (ix >= decodedWidth - 1)
+			{
+				ix = decodedWidth - 1;
+				sx = (float)ix;
+			}
+			ctx->xIndex[x] = ix;
+			ctx->xWeight[x] = sx - ix;
+		}
+	}
+	float scale12[12], bias12[12];
+	for (int i = 0; i < 12; i++)
+	{
+		scale12[i] = isFloat ? params->scale[i % channels] : 1.0f;
+		bias12[i] = isFloat ? params->bias[i % channels] : 0.0f;
+	}
+
+	size_t plane = (size_t)dstWidth * dstHeight;
+	int rowValues = contentWidth * channels;
+	float* vertical = ctx->row;
+	float* resized = ctx->row + (decodedPitch > (size_t)rowValues ? decodedPitch : (size_t)rowValues);
+	float yRatio = (float)decodedHeight / contentHeight;
+	for (int y = 0; y < contentHeight; y++)
+	{
+		float sy = (y + 0.5f) * yRatio - 0.5f;
+		if (sy < 0)
+			sy = 0;
+		int iy = (int)sy;
+		if (iy >= decodedHeight - 1)
+		{
+			iy = decodedHeight - 1;
+			sy = (float)iy;
+		}
+		const unsigned char* row0 = ctx->pixels + decodedPitch * iy;
+		const unsigned char* row1 = iy + 1 < decodedHeight ? row0 + decodedPitch : row0;
+		tjcliLerpRows(row0, row1, decodedHeight != contentHeight ? sy - iy : 0.0f, vertical, (int)decodedPitch);
+
+		const float* interleaved = vertical;
+		if (resizeX)
+		{
+			for (int x = 0; x < contentWidth; x++)
+			{
+				const float* left = vertical + ctx->xIndex[x] * channels;
+				const float* right = ctx->xIndex[x] + 1 < decodedWidth ? left + channels : left;
+				float w = ctx->xWeight[x];
+				for (int c = 0; c < channels; c++)
+					resized[x * channels + c] = left[c] + (right[c] - left[c]) * w;
+			}
+			interleaved = resized;
+		}
+
+		int oy = contentY + y;
+		if (params->nhwc)
+		{
+			size_t offset = ((size_t)oy * dstWidth + contentX) * channels;
+			if (isFloat)
+				tjcliNormalizeRow(interleaved, (float*)dst + offset, rowValues, scale12, bias12);
+			else
+				tjcliPackRow(interleaved, (unsigned char*)dst + offset, rowValues);
+		}
+		else
+		{
+			// Normalize (or round) in place, then scatter the channels to their planes.
+			float* normalized = resized;
+			if (isFloat)
+				tjcliNormalizeRow(interleaved, normalized, rowValues, scale12, bias12);
+			else if (normalized != interleaved)
+				memcpy(normalized, interleaved, sizeof(float) * rowValues);
+			size_t offset = (size_t)oy * dstWidth + contentX;
+			for (int c = 0; c < channels; c++)
+			{
+				if (isFloat)
+				{
+					float* out = (float*)dst + c * plane + offset;
+					for (int x = 0; x < contentWidth; x++)
+						out[x] = normalized[x * channels + c];
+				}
+				else
+				{
+					unsigned char* out = (unsigned char*)dst + c * plane + offset;
+					for (int x = 0; x < contentWidth; x++)
+					{
+						float v = normalized[x * channels + c] + 0.5f;
+						out[x] = v <= 0 ? 0 : v >= 255 ? 255 : (unsigned char)v;
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
+#pragma managed( pop )
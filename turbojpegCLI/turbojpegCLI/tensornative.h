@@ -0,0 +1,66 @@
+#pragma once
+#include "jpegnative.h"
+
+// Native kernels which decode JPEG images into the planes of an ML input tensor.
+// Like the other tjcli* functions, every function that can fail returns -1, and
+// the reason can be retrieved with tjcliGetErrorStr().
+
+/// <summary>
+/// Describes one image slot of the destination tensor and how pixels are mapped
+/// into it.  For float tensors each value is pixel * scale[c] + bias[c], where
+/// pixel is 0 to 255; for byte tensors the pixel is stored as is.
+/// </summary>
+struct tjcli_tensor_params
+{
+	int width;
+	int height;
+	int pixelFormat;
+	int channels;
+	int nhwc;
+	int letterbox;
+	int flags;
+	unsigned char padValue;
+	float scale[3];
+	float bias[3];
+};
+
+/// <summary>
+/// Where the image ended up within its tensor slot.  When letterboxing, the
+/// image is scaled by contentWidth / srcWidth and centered, and the rest of the
+/// slot is filled with the padding value.
+/// </summary>
+struct tjcli_tensor_info
+{
+	int srcWidth;
+	int srcHeight;
+	int contentX;
+	int contentY;
+	int contentWidth;
+	int contentHeight;
+};
+
+/// <summary>
+/// Per-thread state for tensor decoding: a decompressor plus scratch buffers
+/// which only ever grow, so a context can decode a stream of images without
+/// allocating.
+/// </summary>
+struct tjcli_tensor_ctx
+{
+	tjcli_decoder* dec;
+	unsigned char* pixels;
+	size_t pixelsSize;
+	float* row;
+	size_t rowSize;
+	int* xIndex;
+	size_t xIndexSize;
+	float* xWeight;
+	size_t xWeightSize;
+};
+
+tjcli_tensor_ctx* tjcliInitTensorContext();
+void tjcliDestroyTensorContext(tjcli_tensor_ctx* ctx);
+const char* tjcliGetErrorStr(tjcli_tensor_ctx* ctx);
+
+unsigned long long tjcliEstimateTensorMemory(tjcli_tensor_ctx* ctx, const unsigned char* jpegBuf, unsigned long jpegSize, const tjcli_tensor_params* params);
+int tjcliDecodeToTensor(tjcli_tensor_ctx* ctx, const unsigned char* jpegBuf, unsigned long jpegSize, const tjcli_tensor_params* params, void* dst, int isFloat, tjcli_tensor_info* info);
+void tjcliFillTensor(const tjcli_tensor_params* params, void* dst, int isFloat);